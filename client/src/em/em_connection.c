@@ -18,6 +18,7 @@
 #include <gst/gstobject.h>
 #include <stdbool.h>
 #include <string.h>
+#include <zlib.h>
 
 #include "em_app_log.h"
 #include "em_status.h"
@@ -39,6 +40,85 @@
 
 #define DEFAULT_WEBSOCKET_URI "ws://" DEFAULT_SERVER_IP ":52356/ws"
 
+//! ENet channel for state and frame messages (sequenced, unreliable).
+#define EM_ENET_CHANNEL_MESSAGES 0
+//! ENet channel for high-rate tracking messages (unsequenced).
+#define EM_ENET_CHANNEL_TRACKING 1
+
+//! Magic tag distinguishing clock sync packets from protobuf messages on the
+//! data channel. Must match the server, see ems_gstreamer_pipeline.c.
+#define EM_CLOCK_SYNC_MAGIC 0x454D434C4B303100ULL
+
+//! How often a clock sync round trip is initiated.
+#define EM_CLOCK_SYNC_INTERVAL_MS 250
+
+//! Round trips kept for minimum-RTT filtering.
+#define EM_CLOCK_SYNC_WINDOW 16
+
+/*!
+ * One NTP-style clock sync round trip over the reliable data channel.
+ *
+ * The client fills in @ref magic, @ref t0_client_tx and its current filtered
+ * result, the server echoes the packet back with @ref t1_server_rx and
+ * @ref t2_server_tx filled in. Layout must match the server, see
+ * ems_gstreamer_pipeline.c.
+ */
+struct em_clock_sync_packet
+{
+	uint64_t magic;
+	//! Client monotonic time the request was sent.
+	int64_t t0_client_tx;
+	//! Server monotonic time the request was received.
+	int64_t t1_server_rx;
+	//! Server monotonic time the reply was sent.
+	int64_t t2_server_tx;
+	//! The client's current filtered offset (client - server), for the server.
+	int64_t reported_offset;
+	//! The client's current minimum RTT, for the server.
+	int64_t reported_rtt;
+};
+
+//! Magic tag marking a quad layer packet on the ENet message channel.
+//! Must match the server, see ems_compositor.cpp.
+#define EM_QUAD_LAYER_MAGIC 0x454D515541443031ULL
+
+/*!
+ * One quad (UI) layer update from the server, followed by @ref payload_size
+ * bytes of zlib-compressed RGBA8 rows (top-down, tightly packed). The server
+ * only sends one when the quad's pixels or placement changed, so these are
+ * rare compared to video frames. Layout must match the server, see
+ * ems_compositor.cpp.
+ */
+struct em_quad_layer_packet
+{
+	uint64_t magic;
+	//! Pixel size of the decompressed payload.
+	uint32_t width;
+	uint32_t height;
+	//! Quad extent in meters.
+	float size_x;
+	float size_y;
+	//! Pose of the quad, interpreted in our world space.
+	float position[3];
+	float orientation_xyzw[4];
+	//! 0 hides the quad without discarding our pixels.
+	uint32_t visible;
+	//! Compressed bytes following this header, 0 for a placement or
+	//! visibility only update.
+	uint32_t payload_size;
+};
+
+//! One filtered-candidate sample, see em_conn_handle_clock_sync_reply.
+struct em_clock_sync_sample
+{
+	//! Offset (client - server) this round trip measured.
+	int64_t offset;
+	//! Round trip time with the server's turnaround subtracted.
+	int64_t rtt;
+	//! Client monotonic time the reply arrived.
+	int64_t when_ns;
+};
+
 /*!
  * Data required for the handshake to complete and to maintain the connection.
  */
@@ -48,6 +128,9 @@ struct _EmConnection
 	SoupSession *soup_session;
 	gchar *websocket_uri;
 	gchar *host_address;
+	/// Session resume token issued by the server; presented on reconnect so
+	/// a brief drop restores the negotiated state with an ICE restart only.
+	gchar *resume_token;
 	/// Cancellable for websocket connection process
 	GCancellable *ws_cancel;
 	SoupWebsocketConnection *ws;
@@ -55,16 +138,49 @@ struct _EmConnection
 	GstPipeline *pipeline;
 	GstElement *webrtcbin;
 	GstWebRTCDataChannel *datachannel;
+	/// Unreliable/unordered channel dedicated to high-rate tracking.
+	GstWebRTCDataChannel *tracking_datachannel;
+
+	/// Negotiate the full WebRTC stack instead of shipping raw RTP/UDP video
+	/// with ENet message channels. Must be set before connecting.
+	gboolean use_webrtc;
+
+	/// Codec of the incoming stream, announced by the server after the
+	/// websocket comes up and before the pipeline is requested.
+	enum em_video_codec video_codec;
 
 	enum em_status status;
 
-	/// Offset between the server and client system clock.
+	/// Offset between the server and client system clock (client - server),
+	/// estimated NTP-style over the data channel and slewed towards the
+	/// minimum-RTT sample of the recent window.
 	int64_t server_offset;
+	/// Smallest filtered round trip time seen in the recent window.
+	int64_t server_rtt;
+	/// Estimated drift of the offset, in ns per second, for diagnostics.
+	double server_offset_drift;
+
+	/// Ring of recent round trips, see em_conn_handle_clock_sync_reply.
+	struct em_clock_sync_sample clock_samples[EM_CLOCK_SYNC_WINDOW];
+	guint clock_sample_head;
+	guint clock_sample_count;
+
+	/// Source id of the periodic clock sync request.
+	guint clock_sync_timeout_id;
 
 	ENetHost *client;
 	ENetPeer *peer;
 	struct os_thread_helper enet_thread;
 	GAsyncQueue *packet_queue;
+
+	/// Latest quad layer packet from the server, swapped in on the ENet
+	/// thread and consumed by the render loop through
+	/// em_connection_dup_quad_layer.
+	GMutex quad_mutex;
+	GBytes *quad_packet;
+	/// Bumped with every stored packet, so the consumer can tell a new
+	/// one arrived without comparing contents.
+	guint64 quad_generation;
 };
 
 G_DEFINE_TYPE(EmConnection, em_connection, G_TYPE_OBJECT)
@@ -133,6 +249,13 @@ em_connection_init(EmConnection *em_conn)
 	em_conn->soup_session = soup_session_new();
 	em_conn->websocket_uri = g_strdup(DEFAULT_WEBSOCKET_URI);
 	em_conn->server_offset = 0;
+	em_conn->video_codec = EM_VIDEO_CODEC_H264;
+	g_mutex_init(&em_conn->quad_mutex);
+#ifdef USE_WEBRTC
+	em_conn->use_webrtc = TRUE;
+#else
+	em_conn->use_webrtc = FALSE;
+#endif
 }
 
 static void
@@ -152,6 +275,9 @@ em_connection_finalize(GObject *object)
 	EmConnection *self = EM_CONNECTION(object);
 
 	g_free(self->websocket_uri);
+	g_free(self->resume_token);
+	g_clear_pointer(&self->quad_packet, g_bytes_unref);
+	g_mutex_clear(&self->quad_mutex);
 }
 
 static void
@@ -318,6 +444,8 @@ em_conn_disconnect_internal(EmConnection *em_conn, enum em_status status)
 		g_signal_emit(em_conn, signals[SIGNAL_ON_DROP_PIPELINE], 0);
 	}
 
+	g_clear_handle_id(&em_conn->clock_sync_timeout_id, g_source_remove);
+
 	if (em_conn->ws) {
 		soup_websocket_connection_close(em_conn->ws, 0, "");
 	}
@@ -325,7 +453,12 @@ em_conn_disconnect_internal(EmConnection *em_conn, enum em_status status)
 
 	gst_clear_object(&em_conn->webrtcbin);
 	gst_clear_object(&em_conn->datachannel);
+	gst_clear_object(&em_conn->tracking_datachannel);
 	gst_clear_object(&em_conn->pipeline);
+
+	// A full teardown invalidates the negotiated state the token stands for.
+	g_clear_pointer(&em_conn->resume_token, g_free);
+
 	em_conn_update_status(em_conn, status);
 }
 
@@ -350,28 +483,89 @@ em_conn_data_channel_message_string_cb(GstWebRTCDataChannel *datachannel, gchar
 	ALOGI("%s: Received data channel message: %s", __FUNCTION__, str);
 }
 
+static gboolean
+em_conn_clock_sync_send_cb(EmConnection *em_conn)
+{
+	if (em_conn->datachannel == NULL) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	struct em_clock_sync_packet packet = {0};
+	packet.magic = EM_CLOCK_SYNC_MAGIC;
+	packet.reported_offset = em_conn->server_offset;
+	packet.reported_rtt = em_conn->server_rtt;
+	packet.t0_client_tx = (int64_t)os_monotonic_get_ns();
+
+	GBytes *bytes = g_bytes_new(&packet, sizeof(packet));
+	gst_webrtc_data_channel_send_data_full(em_conn->datachannel, bytes, NULL);
+	g_bytes_unref(bytes);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+em_conn_handle_clock_sync_reply(EmConnection *self, const struct em_clock_sync_packet *packet, int64_t t3)
+{
+	const int64_t t0 = packet->t0_client_tx;
+	const int64_t t1 = packet->t1_server_rx;
+	const int64_t t2 = packet->t2_server_tx;
+
+	// The server's turnaround time does not count towards the path delay.
+	const int64_t rtt = (t3 - t0) - (t2 - t1);
+	if (rtt < 0) {
+		return;
+	}
+
+	struct em_clock_sync_sample *sample = &self->clock_samples[self->clock_sample_head];
+	sample->offset = ((t0 - t1) + (t3 - t2)) / 2;
+	sample->rtt = rtt;
+	sample->when_ns = t3;
+	self->clock_sample_head = (self->clock_sample_head + 1) % EM_CLOCK_SYNC_WINDOW;
+	self->clock_sample_count = MIN(self->clock_sample_count + 1, (guint)EM_CLOCK_SYNC_WINDOW);
+
+	// The sample with the smallest RTT crossed the network with the least
+	// queueing delay, so its offset has the smallest asymmetry error.
+	const struct em_clock_sync_sample *best = NULL;
+	for (guint i = 0; i < self->clock_sample_count; i++) {
+		if (best == NULL || self->clock_samples[i].rtt < best->rtt) {
+			best = &self->clock_samples[i];
+		}
+	}
+
+	self->server_rtt = best->rtt;
+
+	if (self->server_offset == 0) {
+		self->server_offset = best->offset;
+		return;
+	}
+
+	// Track how fast the clocks are drifting apart, then slew towards the
+	// filtered offset instead of jumping: a single spike must not yank
+	// every latency number computed from the offset.
+	const int64_t error = best->offset - self->server_offset;
+	const double elapsed_s = (double)EM_CLOCK_SYNC_INTERVAL_MS * 1e-3;
+	self->server_offset_drift += (((double)error / elapsed_s) - self->server_offset_drift) / 16.0;
+	self->server_offset += error / 8;
+
+	ALOGD("Clock sync: offset %.3fms rtt %.3fms drift %.1fns/s", time_ns_to_ms_f(self->server_offset),
+	      time_ns_to_ms_f(self->server_rtt), self->server_offset_drift);
+}
+
 static void
 emconn_data_channel_message_data_cb(GstWebRTCDataChannel *datachannel, GBytes *bytes, EmConnection *self)
 {
-	uint64_t client_now = os_monotonic_get_ns();
+	int64_t client_now = (int64_t)os_monotonic_get_ns();
 
 	gsize bytes_size;
 	gconstpointer bytes_pointer = g_bytes_get_data(bytes, &bytes_size);
-	if (bytes_size != 8) {
+
+	if (bytes_size != sizeof(struct em_clock_sync_packet) ||
+	    ((const struct em_clock_sync_packet *)bytes_pointer)->magic != EM_CLOCK_SYNC_MAGIC) {
 		ALOGE("Unexpected data channel message size!");
 		return;
 	}
 
-	// This is a bad way to sync the server and client clock (transmission latency not counted).
-	uint64_t server_now = *(uint64_t *)bytes_pointer;
-	int64_t server_offset = (int64_t)client_now - (int64_t)(server_now);
-
-	ALOGD("Server offset %.2fms", time_ns_to_ms_f(server_offset));
-
-	if (self->server_offset == 0 ||                          // Initial offset
-	    (labs(server_offset) < labs(self->server_offset))) { // If we get a smaller offset, use it
-		self->server_offset = server_offset;
-	}
+	em_conn_handle_clock_sync_reply(self, bytes_pointer, client_now);
 }
 
 int64_t
@@ -380,6 +574,65 @@ em_connection_get_server_clock_offset(EmConnection *emconn)
 	return emconn->server_offset;
 }
 
+enum em_video_codec
+em_connection_get_video_codec(EmConnection *em_conn)
+{
+	return em_conn->video_codec;
+}
+
+bool
+em_connection_poll_quad_layer(EmConnection *em_conn, guint64 *inout_generation, struct em_quad_layer_update *out_update)
+{
+	g_mutex_lock(&em_conn->quad_mutex);
+	if (em_conn->quad_packet == NULL || em_conn->quad_generation == *inout_generation) {
+		g_mutex_unlock(&em_conn->quad_mutex);
+		return false;
+	}
+	GBytes *bytes = g_bytes_ref(em_conn->quad_packet);
+	*inout_generation = em_conn->quad_generation;
+	g_mutex_unlock(&em_conn->quad_mutex);
+
+	gsize bytes_size = 0;
+	const guint8 *data = g_bytes_get_data(bytes, &bytes_size);
+	const struct em_quad_layer_packet *packet = (const struct em_quad_layer_packet *)data;
+
+	memset(out_update, 0, sizeof(*out_update));
+	out_update->width = packet->width;
+	out_update->height = packet->height;
+	out_update->size_x = packet->size_x;
+	out_update->size_y = packet->size_y;
+	memcpy(out_update->position, packet->position, sizeof(out_update->position));
+	memcpy(out_update->orientation_xyzw, packet->orientation_xyzw, sizeof(out_update->orientation_xyzw));
+	out_update->visible = packet->visible != 0;
+
+	if (packet->payload_size == 0) {
+		g_bytes_unref(bytes);
+		return true;
+	}
+
+	if (sizeof(*packet) + packet->payload_size > bytes_size) {
+		ALOGE("Truncated quad layer packet (%u payload bytes in a %zu byte packet).", packet->payload_size,
+		      bytes_size);
+		g_bytes_unref(bytes);
+		return false;
+	}
+
+	uLongf raw_size = (uLongf)packet->width * packet->height * 4;
+	guint8 *pixels = g_malloc(raw_size);
+
+	int zret = uncompress(pixels, &raw_size, data + sizeof(*packet), packet->payload_size);
+	g_bytes_unref(bytes);
+	if (zret != Z_OK || raw_size != (uLongf)packet->width * packet->height * 4) {
+		ALOGE("Failed to decompress quad layer pixels (%d).", zret);
+		g_free(pixels);
+		return false;
+	}
+
+	out_update->pixels = g_bytes_new_take(pixels, raw_size);
+
+	return true;
+}
+
 static void
 em_conn_webrtc_deep_notify_callback(GstObject *self, GstObject *prop_object, GParamSpec *prop, EmConnection *em_conn)
 {
@@ -421,12 +674,28 @@ em_conn_webrtc_on_incoming_stream(GstElement *webrtc, GstPad *pad, gpointer user
 static void
 em_conn_webrtc_on_data_channel_cb(GstElement *webrtcbin, GstWebRTCDataChannel *data_channel, EmConnection *em_conn)
 {
-	ALOGI("Successfully created datachannel");
+	g_autofree gchar *label = NULL;
+	g_object_get(data_channel, "label", &label, NULL);
+
+	ALOGI("Successfully created datachannel '%s'", label ? label : "(null)");
+
+	if (label != NULL && g_str_equal(label, "tracking")) {
+		g_assert_null(em_conn->tracking_datachannel);
+		em_conn->tracking_datachannel = GST_WEBRTC_DATA_CHANNEL(data_channel);
+		return;
+	}
 
 	g_assert_null(em_conn->datachannel);
 
 	em_conn->datachannel = GST_WEBRTC_DATA_CHANNEL(data_channel);
 
+	// Drive the clock sync exchange from our side, we are the one that
+	// needs the offset to interpret the server's timestamps.
+	if (em_conn->clock_sync_timeout_id == 0) {
+		em_conn->clock_sync_timeout_id =
+		    g_timeout_add(EM_CLOCK_SYNC_INTERVAL_MS, G_SOURCE_FUNC(em_conn_clock_sync_send_cb), em_conn);
+	}
+
 	em_conn_update_status(em_conn, EM_STATUS_CONNECTED);
 	g_signal_emit(em_conn, signals[SIGNAL_CONNECTED], 0);
 }
@@ -602,6 +871,79 @@ em_conn_webrtc_process_candidate(EmConnection *em_conn, guint mlineindex, const
 	g_signal_emit_by_name(em_conn->webrtcbin, "add-ice-candidate", mlineindex, candidate);
 }
 
+/*!
+ * Advertise the decoders available on this device, so the server can warn
+ * when its configured codec will not decode in hardware here.
+ */
+static void
+em_conn_send_supported_codecs(EmConnection *em_conn)
+{
+	// clang-format off
+	static const struct
+	{
+		const char *name;
+		const char *decoders[2];
+	} codecs[] = {
+	    {"h264", {"amcviddec-c2qtiavcdecoder", "avdec_h264"}},
+	    {"h265", {"amcviddec-c2qtihevcdecoder", "avdec_h265"}},
+	    {"av1", {"amcviddec-c2qtiav1decoder", "dav1ddec"}},
+	};
+	// clang-format on
+
+	JsonBuilder *builder;
+	JsonNode *root;
+	gchar *msg_str;
+
+	builder = json_builder_new();
+	json_builder_begin_object(builder);
+	json_builder_set_member_name(builder, "msg");
+	json_builder_add_string_value(builder, "codecs");
+
+	json_builder_set_member_name(builder, "supported");
+	json_builder_begin_array(builder);
+	for (guint i = 0; i < G_N_ELEMENTS(codecs); i++) {
+		for (guint j = 0; j < G_N_ELEMENTS(codecs[i].decoders); j++) {
+			GstElementFactory *factory = gst_element_factory_find(codecs[i].decoders[j]);
+			if (factory == NULL) {
+				continue;
+			}
+			gst_object_unref(factory);
+			json_builder_add_string_value(builder, codecs[i].name);
+			break;
+		}
+	}
+	json_builder_end_array(builder);
+	json_builder_end_object(builder);
+
+	root = json_builder_get_root(builder);
+
+	msg_str = json_to_string(root, TRUE);
+	ALOGI("Advertising supported codecs: %s", msg_str);
+	soup_websocket_connection_send_text(em_conn->ws, msg_str);
+	g_clear_pointer(&msg_str, g_free);
+
+	json_node_unref(root);
+	g_object_unref(builder);
+}
+
+static void
+em_conn_create_pipeline(EmConnection *em_conn)
+{
+	ALOGI("Creating pipeline");
+	g_assert_null(em_conn->pipeline);
+	g_signal_emit(em_conn, signals[SIGNAL_ON_NEED_PIPELINE], 0);
+	if (em_conn->pipeline == NULL) {
+		ALOGE("on-need-pipeline signal did not return a pipeline!");
+		em_connection_disconnect(em_conn);
+		return;
+	}
+	// OK, if we get here, we have a websocket connection, and a pipeline fully configured
+	// so we can start the pipeline playing
+
+	ALOGI("Setting pipeline state to PLAYING");
+	gst_element_set_state(GST_ELEMENT(em_conn->pipeline), GST_STATE_PLAYING);
+}
+
 static void
 em_conn_on_ws_message_cb(SoupWebsocketConnection *connection, gint type, GBytes *message, EmConnection *em_conn)
 {
@@ -623,9 +965,50 @@ em_conn_on_ws_message_cb(SoupWebsocketConnection *connection, gint type, GBytes
 		msg_type = json_object_get_string_member(msg, "msg");
 		ALOGI("Websocket message received: %s", msg_type);
 
-		if (g_str_equal(msg_type, "offer")) {
+		if (g_str_equal(msg_type, "codec")) {
+			const gchar *codec = json_object_get_string_member(msg, "codec");
+
+			if (g_str_equal(codec, "h265")) {
+				em_conn->video_codec = EM_VIDEO_CODEC_H265;
+			} else if (g_str_equal(codec, "av1")) {
+				em_conn->video_codec = EM_VIDEO_CODEC_AV1;
+			} else {
+				if (!g_str_equal(codec, "h264")) {
+					ALOGW("Unknown codec '%s' announced, assuming h264.", codec);
+				}
+				em_conn->video_codec = EM_VIDEO_CODEC_H264;
+			}
+
+			// A codec announcement means the server admitted us as a
+			// new client: a pipeline kept alive for a resume attempt
+			// is stale and negotiation starts over.
+			if (em_conn->pipeline != NULL) {
+				gst_element_set_state(GST_ELEMENT(em_conn->pipeline), GST_STATE_NULL);
+				g_signal_emit(em_conn, signals[SIGNAL_ON_DROP_PIPELINE], 0);
+				g_clear_handle_id(&em_conn->clock_sync_timeout_id, g_source_remove);
+				gst_clear_object(&em_conn->webrtcbin);
+				gst_clear_object(&em_conn->datachannel);
+				gst_clear_object(&em_conn->tracking_datachannel);
+				gst_clear_object(&em_conn->pipeline);
+			}
+
+			// The decode chain depends on the codec, so the pipeline is
+			// only requested now that it is known.
+			em_conn_create_pipeline(em_conn);
+		} else if (g_str_equal(msg_type, "session")) {
+			// Resume token for reconnecting within the grace window.
+			g_free(em_conn->resume_token);
+			em_conn->resume_token = g_strdup(json_object_get_string_member(msg, "token"));
+		} else if (g_str_equal(msg_type, "offer")) {
 			const gchar *offer_sdp = json_object_get_string_member(msg, "sdp");
 			em_conn_webrtc_process_sdp_offer(em_conn, offer_sdp);
+
+			// On a resume the offer only restarts ICE: the data
+			// channels are still up, so we are connected again as soon
+			// as it is applied.
+			if (em_conn->datachannel != NULL) {
+				em_conn_update_status(em_conn, EM_STATUS_CONNECTED);
+			}
 		} else if (g_str_equal(msg_type, "candidate")) {
 			JsonObject *candidate;
 
@@ -664,27 +1047,19 @@ em_conn_websocket_connected_cb(GObject *session, GAsyncResult *res, EmConnection
 	}
 	g_assert_no_error(error);
 
-#ifndef USE_WEBRTC
-	em_conn->status = EM_STATUS_CONNECTED;
-#endif
+	if (!em_conn->use_webrtc) {
+		// No WebRTC negotiation to wait for: the raw transport is ready as
+		// soon as the websocket (and ENet) connections are up.
+		em_conn->status = EM_STATUS_CONNECTED;
+	}
 
 	ALOGI("WebSocket connected");
 	g_signal_connect(em_conn->ws, "message", G_CALLBACK(em_conn_on_ws_message_cb), em_conn);
 	g_signal_emit(em_conn, signals[SIGNAL_WEBSOCKET_CONNECTED], 0);
 
-	ALOGI("Creating pipeline");
-	g_assert_null(em_conn->pipeline);
-	g_signal_emit(em_conn, signals[SIGNAL_ON_NEED_PIPELINE], 0);
-	if (em_conn->pipeline == NULL) {
-		ALOGE("on-need-pipeline signal did not return a pipeline!");
-		em_connection_disconnect(em_conn);
-		return;
-	}
-	// OK, if we get here, we have a websocket connection, and a pipeline fully configured
-	// so we can start the pipeline playing
-
-	ALOGI("Setting pipeline state to PLAYING");
-	gst_element_set_state(GST_ELEMENT(em_conn->pipeline), GST_STATE_PLAYING);
+	// The server announces its codec right after accepting us; the pipeline
+	// is created once that arrives, see the "codec" message handler.
+	em_conn_send_supported_codecs(em_conn);
 }
 
 void
@@ -698,7 +1073,10 @@ em_connection_set_pipeline(EmConnection *em_conn, GstPipeline *pipeline)
 	gst_clear_object(&em_conn->pipeline);
 	em_conn->pipeline = gst_object_ref_sink(pipeline);
 
-#ifdef USE_WEBRTC
+	if (!em_conn->use_webrtc) {
+		return;
+	}
+
 	em_conn_update_status(em_conn, EM_STATUS_NEGOTIATING);
 
 	em_conn->webrtcbin = gst_bin_get_by_name(GST_BIN(em_conn->pipeline), "webrtc");
@@ -716,7 +1094,6 @@ em_connection_set_pipeline(EmConnection *em_conn, GstPipeline *pipeline)
 	                 G_CALLBACK(em_conn_webrtc_deep_notify_callback), em_conn);
 	g_signal_connect(em_conn->webrtcbin, "prepare-data-channel", G_CALLBACK(em_conn_webrtc_on_prepare_data_channel),
 	                 NULL);
-#endif
 }
 
 enum em_status
@@ -726,11 +1103,23 @@ em_connection_get_status(EmConnection *em_conn)
 }
 
 void
-handle_enet_event(ENetEvent *event)
+handle_enet_event(EmConnection *conn, ENetEvent *event)
 {
 	switch (event->type) {
 	case ENET_EVENT_TYPE_RECEIVE: {
-		ALOGI("ENet received a packet.");
+		if (event->packet->dataLength >= sizeof(struct em_quad_layer_packet) &&
+		    ((const struct em_quad_layer_packet *)event->packet->data)->magic == EM_QUAD_LAYER_MAGIC) {
+			// Quad layer update; park it for the render loop,
+			// which decompresses and uploads on the GL thread.
+			GBytes *bytes = g_bytes_new(event->packet->data, event->packet->dataLength);
+			g_mutex_lock(&conn->quad_mutex);
+			g_clear_pointer(&conn->quad_packet, g_bytes_unref);
+			conn->quad_packet = bytes;
+			conn->quad_generation++;
+			g_mutex_unlock(&conn->quad_mutex);
+		} else {
+			ALOGI("ENet received a packet.");
+		}
 		enet_packet_destroy(event->packet);
 	} break;
 	case ENET_EVENT_TYPE_DISCONNECT: {
@@ -763,7 +1152,7 @@ enet_thread_func(void *ptr)
 		ENetPacket *packet;
 
 		while ((packet = g_async_queue_try_pop(conn->packet_queue)) != NULL) {
-			int channel_id = 0;
+			int channel_id = GPOINTER_TO_INT(packet->userData);
 			int ret = enet_peer_send(conn->peer, channel_id, packet);
 			if (ret) {
 				ALOGE("enet_peer_send error: %d", ret);
@@ -778,11 +1167,11 @@ enet_thread_func(void *ptr)
 		// Block for up to 10 milliseconds, or until an event occurs
 		if (enet_host_service(conn->client, &event, 10) > 0) {
 			// Handle the event
-			handle_enet_event(&event);
+			handle_enet_event(conn, &event);
 
 			// Check for more events that might have arrived quickly
 			while (enet_host_service(conn->client, &event, 0) > 0) {
-				handle_enet_event(&event);
+				handle_enet_event(conn, &event);
 			}
 		}
 	}
@@ -793,7 +1182,17 @@ enet_thread_func(void *ptr)
 void
 em_connection_connect(EmConnection *em_conn)
 {
-	em_connection_disconnect(em_conn);
+	if (em_conn->resume_token != NULL && em_conn->pipeline != NULL) {
+		// Reconnect with the negotiated state kept alive: only the
+		// websocket is replaced, the server restores the rest with an
+		// ICE restart when it accepts the token.
+		if (em_conn->ws != NULL) {
+			soup_websocket_connection_close(em_conn->ws, 0, "");
+		}
+		g_clear_object(&em_conn->ws);
+	} else {
+		em_connection_disconnect(em_conn);
+	}
 	if (!em_conn->ws_cancel) {
 		em_conn->ws_cancel = g_cancellable_new();
 	}
@@ -802,21 +1201,26 @@ em_connection_connect(EmConnection *em_conn)
 	// Set connection timeout
 	soup_session_set_timeout(em_conn->soup_session, 5);
 
-	ALOGI("calling soup_session_websocket_connect_async. websocket_uri = %s", em_conn->websocket_uri);
+	gchar *uri = em_conn->resume_token != NULL
+	                 ? g_strdup_printf("%s?resume=%s", em_conn->websocket_uri, em_conn->resume_token)
+	                 : g_strdup(em_conn->websocket_uri);
+
+	ALOGI("calling soup_session_websocket_connect_async. websocket_uri = %s", uri);
 
-	soup_session_websocket_connect_async(em_conn->soup_session,                                     // session
-	                                     soup_message_new(SOUP_METHOD_GET, em_conn->websocket_uri), // message
-	                                     NULL,                                                      // origin
-	                                     NULL,                                                      // protocols
-	                                     0,                                                         // io_priority
-	                                     em_conn->ws_cancel,                                        // cancellable
-	                                     (GAsyncReadyCallback)em_conn_websocket_connected_cb,       // callback
-	                                     em_conn);                                                  // user_data
+	soup_session_websocket_connect_async(em_conn->soup_session,                               // session
+	                                     soup_message_new(SOUP_METHOD_GET, uri),              // message
+	                                     NULL,                                                // origin
+	                                     NULL,                                                // protocols
+	                                     0,                                                   // io_priority
+	                                     em_conn->ws_cancel,                                  // cancellable
+	                                     (GAsyncReadyCallback)em_conn_websocket_connected_cb, // callback
+	                                     em_conn);                                            // user_data
+	g_free(uri);
 
 	em_conn_update_status(em_conn, EM_STATUS_CONNECTING);
 
-	// ENet
-	{
+	// ENet, kept across reconnects.
+	if (em_conn->client == NULL) {
 		ENetHost *client = {0};
 		client = enet_host_create(NULL /* create a client host */, 1 /* only allow 1 outgoing connection */,
 		                          2 /* allow up 2 channels to be used, 0 and 1 */,
@@ -889,19 +1293,18 @@ em_connection_disconnect(EmConnection *em_conn)
 	em_conn_disconnect_internal(em_conn, EM_STATUS_IDLE_NOT_CONNECTED);
 }
 
-bool
-em_connection_send_bytes_via_enet(EmConnection *em_conn, GBytes *bytes)
+static bool
+em_connection_send_bytes_via_enet_on(EmConnection *em_conn, GBytes *bytes, int channel_id, enet_uint32 flags)
 {
 	gsize length = 0;
 	const gchar *msg_data = g_bytes_get_data(bytes, &length);
 
-	ENetPacketFlag flag = ENET_PACKET_FLAG_UNSEQUENCED;
-
-	ENetPacket *packet = enet_packet_create(msg_data, length, flag);
+	ENetPacket *packet = enet_packet_create(msg_data, length, flags);
 	if (!packet) {
 		// Failed to create the packet (e.g., memory allocation failed)
 		return false;
 	}
+	packet->userData = GINT_TO_POINTER(channel_id);
 
 	// We cannot send it directly from here, as ENet is not thread safe.
 	g_async_queue_push(em_conn->packet_queue, packet);
@@ -909,6 +1312,13 @@ em_connection_send_bytes_via_enet(EmConnection *em_conn, GBytes *bytes)
 	return TRUE;
 }
 
+bool
+em_connection_send_bytes_via_enet(EmConnection *em_conn, GBytes *bytes)
+{
+	// Sequenced but unreliable: a late state message must not delay newer ones.
+	return em_connection_send_bytes_via_enet_on(em_conn, bytes, EM_ENET_CHANNEL_MESSAGES, 0);
+}
+
 bool
 em_connection_send_bytes(EmConnection *em_conn, GBytes *bytes)
 {
@@ -917,14 +1327,49 @@ em_connection_send_bytes(EmConnection *em_conn, GBytes *bytes)
 		return false;
 	}
 
-#ifdef USE_WEBRTC
-	gboolean success = gst_webrtc_data_channel_send_data_full(em_conn->datachannel, bytes, NULL);
-	return success == TRUE;
-#else
+	if (em_conn->use_webrtc) {
+		gboolean success = gst_webrtc_data_channel_send_data_full(em_conn->datachannel, bytes, NULL);
+		return success == TRUE;
+	}
+
 	//	gsize length = 0;
 	//	const gchar *msg_data = g_bytes_get_data(bytes, &length);
 	//	soup_websocket_connection_send_binary(em_conn->ws, msg_data, length);
 	em_connection_send_bytes_via_enet(em_conn, bytes);
 	return TRUE;
-#endif
+}
+
+bool
+em_connection_send_tracking_bytes(EmConnection *em_conn, GBytes *bytes)
+{
+	if (em_conn->status != EM_STATUS_CONNECTED) {
+		return false;
+	}
+
+	if (em_conn->use_webrtc) {
+		// Fall back to the reliable channel until the tracking channel is up.
+		if (em_conn->tracking_datachannel == NULL) {
+			return em_connection_send_bytes(em_conn, bytes);
+		}
+		gboolean success = gst_webrtc_data_channel_send_data_full(em_conn->tracking_datachannel, bytes, NULL);
+		return success == TRUE;
+	}
+
+	// Dedicated channel so tracking never queues behind other messages, and
+	// unsequenced since each message supersedes the previous one anyway.
+	return em_connection_send_bytes_via_enet_on(em_conn, bytes, EM_ENET_CHANNEL_TRACKING,
+	                                            ENET_PACKET_FLAG_UNSEQUENCED);
+}
+
+void
+em_connection_set_use_webrtc(EmConnection *em_conn, bool use_webrtc)
+{
+	g_assert(em_conn->pipeline == NULL);
+	em_conn->use_webrtc = use_webrtc;
+}
+
+bool
+em_connection_get_use_webrtc(EmConnection *em_conn)
+{
+	return em_conn->use_webrtc;
 }
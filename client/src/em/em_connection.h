@@ -16,6 +16,8 @@
 
 #include "em_status.h"
 
+//! Compile-time default transport, can be overridden at runtime with
+//! em_connection_set_use_webrtc() before connecting.
 //#define USE_WEBRTC
 //#define USE_DECODEBIN3
 
@@ -25,6 +27,14 @@
 
 G_BEGIN_DECLS
 
+//! Video codec of the stream, announced by the server over signaling.
+enum em_video_codec
+{
+	EM_VIDEO_CODEC_H264,
+	EM_VIDEO_CODEC_H265,
+	EM_VIDEO_CODEC_AV1,
+};
+
 #define EM_TYPE_CONNECTION em_connection_get_type()
 
 G_DECLARE_FINAL_TYPE(EmConnection, em_connection, EM, CONNECTION, GObject)
@@ -66,6 +76,16 @@ em_connection_disconnect(EmConnection *em_conn);
 bool
 em_connection_send_bytes(EmConnection *em_conn, GBytes *bytes);
 
+/*!
+ * Send a message to the server over the unreliable/unordered tracking channel.
+ *
+ * Falls back to the reliable channel while the tracking channel is not up yet.
+ *
+ * @memberof EmConnection
+ */
+bool
+em_connection_send_tracking_bytes(EmConnection *em_conn, GBytes *bytes);
+
 /*!
  * Assign a pipeline for use.
  *
@@ -77,7 +97,73 @@ em_connection_set_pipeline(EmConnection *em_conn, GstPipeline *pipeline);
 enum em_status
 em_connection_get_status(EmConnection *em_conn);
 
+/*!
+ * Select the transport: the full WebRTC stack, or raw RTP/UDP video with ENet
+ * message channels for trusted LANs (wired, network-over-usb), which skips
+ * ICE/DTLS/SRTP entirely.
+ *
+ * Must be called before @ref em_connection_connect. Defaults to whether
+ * USE_WEBRTC was defined at compile time.
+ *
+ * @memberof EmConnection
+ */
+void
+em_connection_set_use_webrtc(EmConnection *em_conn, bool use_webrtc);
+
+bool
+em_connection_get_use_webrtc(EmConnection *em_conn);
+
 int64_t
 em_connection_get_server_clock_offset(EmConnection *emconn);
 
+/*!
+ * A quad (UI) layer update received from the server, see
+ * em_connection_poll_quad_layer.
+ */
+struct em_quad_layer_update
+{
+	//! Pixel size of @ref pixels.
+	uint32_t width;
+	uint32_t height;
+	//! Quad extent in meters.
+	float size_x;
+	float size_y;
+	//! Pose of the quad in our world space.
+	float position[3];
+	float orientation_xyzw[4];
+	//! False hides the quad, @ref pixels stays NULL.
+	bool visible;
+	//! Decompressed RGBA8 rows (top-down, tightly packed), or NULL for a
+	//! placement or visibility only update. Unref when done.
+	GBytes *pixels;
+};
+
+/*!
+ * Hand out the newest quad layer update, if one arrived since the caller's
+ * last poll.
+ *
+ * The server ships quad layers out of band over the reliable ENet channel and
+ * only when they changed, so these are rare compared to video frames. Pass the
+ * same @p inout_generation each time, starting from 0; it is advanced when an
+ * update is returned. Decompression runs on the calling thread.
+ *
+ * @memberof EmConnection
+ */
+bool
+em_connection_poll_quad_layer(EmConnection *em_conn,
+                              guint64 *inout_generation,
+                              struct em_quad_layer_update *out_update);
+
+/*!
+ * Codec of the incoming video stream.
+ *
+ * Valid once @ref EmConnection::on-need-pipeline fires: the pipeline is only
+ * requested after the server has announced its codec, so the handler can
+ * build the matching decode chain.
+ *
+ * @memberof EmConnection
+ */
+enum em_video_codec
+em_connection_get_video_codec(EmConnection *em_conn);
+
 G_END_DECLS
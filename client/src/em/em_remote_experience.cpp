@@ -14,6 +14,10 @@
 // clang-format off
 
 #include <linux/time.h>
+#include <sys/system_properties.h>
+#if __ANDROID_API__ >= 30
+#include <android/thermal.h>
+#endif
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
@@ -22,11 +26,13 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <exception>
 #include <memory>
 #include <os/os_time.h>
-#include <GLES2/gl2.h>
+#include <os/os_threading.h>
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
 
 #include "electricmaple.pb.h"
@@ -34,6 +40,7 @@
 #include "em_connection.h"
 #include "em_stream_client.h"
 #include "em_sample.h"
+#include "em_trace.h"
 #include "pb_encode.h"
 #include "em/render/gl_swapchain.h"
 #include "em/render/render.hpp"
@@ -67,15 +74,112 @@ struct _EmRemoteExperience
 
 	GLSwapchain swapchainBuffers;
 
+	//! Rendering both eyes in one pass into an array swapchain (GL_OVR_multiview2).
+	bool multiview;
+
+	//! Swapchain image acquired ahead of time, so the runtime works on its
+	//! availability while we pull the sample and locate poses. See
+	//! em_remote_experience_acquire_image_early.
+	uint32_t acquiredImageIndex;
+	bool imageAcquired;
+
 	std::atomic_int64_t nextUpMessage{1};
+
+	//! Sends tracking messages at a fixed high rate, decoupled from render rate.
+	struct os_thread_helper tracking_thread;
+	//! Input state to sample from the tracking thread. Set once before the thread starts.
+	InputState *trackingInputState;
+	//! Most recent predicted display time from xrWaitFrame, for the tracking thread.
+	std::atomic<XrTime> lastPredictedDisplayTime;
+	//! CLOCK_MONOTONIC time at which @ref lastPredictedDisplayTime was stored.
+	std::atomic<int64_t> lastPredictedStoredAt;
+
+	//! Hand joints as last sent, for delta encoding. Indexed like XrHandJointEXT.
+	std::array<em_proto_HandJointLocation, XR_HAND_JOINT_COUNT_EXT> lastSentJoints[Side::COUNT];
+	//! Tracking messages sent since the last full (non-sparse) joint update.
+	uint32_t trackingSendsSinceFullJoints;
+	int64_t trackingSequenceIdx;
+
+	//! Grab values as last sent on the input fast path, see
+	//! em_remote_experience_report_input.
+	std::array<float, Side::COUNT> lastSentGrab;
+	bool inputEverSent;
+	int64_t inputSequenceIdx;
+
+	/*!
+	 * Server-driven quad (UI) layer: the server ships its pixels losslessly
+	 * over the reliable ENet channel only when they changed, and we
+	 * composite it here as its own layer on top of the video projection,
+	 * so UI never picks up video encode artifacts. See
+	 * em_remote_experience_update_quad_layer.
+	 */
+	struct
+	{
+		//! Generation of the last consumed update, see em_connection_poll_quad_layer.
+		guint64 generation;
+		XrSwapchain swapchain;
+		//! Swapchain images, the GL upload targets.
+		std::vector<XrSwapchainImageForGL> images;
+		uint32_t width;
+		uint32_t height;
+		XrPosef pose;
+		XrExtent2Df size;
+		bool visible;
+	} quad;
+
+	/*!
+	 * Performance HUD bookkeeping, see em_remote_experience_push_hud_sample.
+	 * Toggled at runtime with `adb shell setprop debug.electricmaple.hud 1`;
+	 * the property is re-read about once a second.
+	 */
+	struct
+	{
+		bool enabled;
+		uint32_t framesSincePropPoll;
+		//! When and at what byte count the bitrate was last sampled.
+		int64_t lastBitrateSampleTime;
+		int64_t lastReceivedBytes;
+		float bitrateMbps;
+		//! Stream client drop total at the previous frame, for deltas.
+		uint32_t lastDroppedFrames;
+	} hud;
+
+	/*!
+	 * Device health reporting, see em_remote_experience_send_health_report.
+	 * One report per second tells the server when the headset itself, not
+	 * the network, is the bottleneck.
+	 */
+	struct
+	{
+#if __ANDROID_API__ >= 30
+		//! Thermal service handle, acquired lazily. May stay null.
+		AThermalManager *thermalManager;
+#endif
+		int64_t lastReportTime;
+		//! Stream client display miss total at the previous report.
+		uint32_t lastDisplayMisses;
+	} health;
 };
 
 static constexpr size_t em_proto_UpMessage_size =
     sizeof(_em_proto_HandJointLocation) * 26 * 2 + sizeof(_em_proto_UpMessage);
 static constexpr size_t kUpBufferSize = em_proto_UpMessage_size + 10;
 
-bool
-em_remote_experience_emit_upmessage(EmRemoteExperience *exp, em_proto_UpMessage *upMessage)
+//! Tracking messages per second sent by the dedicated tracking thread.
+static constexpr int64_t kTrackingRateHz = 250;
+static constexpr int64_t kTrackingPeriodNs = 1000 * 1000 * 1000 / kTrackingRateHz;
+
+//! Send the complete joint set every this many tracking messages, so a lost
+//! packet cannot leave the server with a stale joint for long.
+static constexpr uint32_t kHandJointsFullInterval = 30;
+
+//! A joint is re-sent when it moved more than this (meters) since last sent.
+static constexpr float kHandJointPositionEpsilon = 0.001f;
+//! ... or when its orientation dot product dropped below this.
+static constexpr float kHandJointOrientationDotMin = 0.99999f;
+
+static bool
+em_remote_experience_emit_upmessage_on(EmRemoteExperience *exp, em_proto_UpMessage *upMessage, bool unreliable)
 {
 	int64_t message_id = exp->nextUpMessage++;
 	upMessage->id = message_id;
@@ -88,26 +192,40 @@ em_remote_experience_emit_upmessage(EmRemoteExperience *exp, em_proto_UpMessage
 
 	// Send data
 	GBytes *bytes = g_bytes_new(buffer, os.bytes_written);
-	bool bResult = em_connection_send_bytes(exp->connection, bytes);
+	bool bResult = unreliable ? em_connection_send_tracking_bytes(exp->connection, bytes)
+	                          : em_connection_send_bytes(exp->connection, bytes);
 	g_bytes_unref(bytes);
 
 	return bResult;
 }
 
+bool
+em_remote_experience_emit_upmessage(EmRemoteExperience *exp, em_proto_UpMessage *upMessage)
+{
+	return em_remote_experience_emit_upmessage_on(exp, upMessage, false);
+}
+
+//! Joints to encode, passed as the pb_callback_t argument.
+struct HandJointEncodeArg
+{
+	const em_proto_HandJointLocation *joints;
+	int count;
+};
+
 bool
 ProtoMessage_encode_hand_joint_locations(pb_ostream_t *ostream, const pb_field_t *field, void *const *arg)
 {
-	auto *source = (em_proto_HandJointLocation *)(*arg);
+	auto *source = (const HandJointEncodeArg *)(*arg);
 
 	// Encode all elements
-	for (int i = 0; i < 26; i++) {
+	for (int i = 0; i < source->count; i++) {
 		if (!pb_encode_tag_for_field(ostream, field)) {
 			const char *error = PB_GET_ERROR(ostream);
 			ALOGE("ProtoMessage_encode_hand_joint_locations error: %s", error);
 			return false;
 		}
 
-		if (!pb_encode_submessage(ostream, em_proto_HandJointLocation_fields, source + i)) {
+		if (!pb_encode_submessage(ostream, em_proto_HandJointLocation_fields, source->joints + i)) {
 			const char *error = PB_GET_ERROR(ostream);
 			ALOGE("ProtoMessage_encode_hand_joint_locations error: %s", error);
 			return false;
@@ -120,6 +238,29 @@ ProtoMessage_encode_hand_joint_locations(pb_ostream_t *ostream, const pb_field_t
 	return true;
 }
 
+//! Whether @p cur differs enough from the joint as last sent to be worth re-sending.
+static bool
+hand_joint_changed(const em_proto_HandJointLocation &last, const em_proto_HandJointLocation &cur)
+{
+	if (last.has_pose != cur.has_pose) {
+		return true;
+	}
+	const float dx = cur.pose.position.x - last.pose.position.x;
+	const float dy = cur.pose.position.y - last.pose.position.y;
+	const float dz = cur.pose.position.z - last.pose.position.z;
+	if (dx * dx + dy * dy + dz * dz > kHandJointPositionEpsilon * kHandJointPositionEpsilon) {
+		return true;
+	}
+	const float dot = cur.pose.orientation.w * last.pose.orientation.w +
+	                  cur.pose.orientation.x * last.pose.orientation.x +
+	                  cur.pose.orientation.y * last.pose.orientation.y +
+	                  cur.pose.orientation.z * last.pose.orientation.z;
+	if (dot < kHandJointOrientationDotMin && dot > -kHandJointOrientationDotMin) {
+		return true;
+	}
+	return cur.radius != last.radius;
+}
+
 em_proto_Pose
 convert_pose(XrPosef pose)
 {
@@ -241,8 +382,13 @@ em_remote_experience_report_pose(EmRemoteExperience *exp, XrTime predictedDispla
 		tracking.controller_grab_value_right = inputState.handGrab[Side::RIGHT];
 	}
 
-	std::array<em_proto_HandJointLocation, XR_HAND_JOINT_COUNT_EXT> hand_joint_locations_left{};
-	std::array<em_proto_HandJointLocation, XR_HAND_JOINT_COUNT_EXT> hand_joint_locations_right{};
+	// Periodically send the complete joint set; in between only the joints
+	// that moved, delta-encoded against what we last sent.
+	bool sparse_joints = exp->trackingSendsSinceFullJoints < kHandJointsFullInterval;
+	exp->trackingSendsSinceFullJoints = sparse_joints ? exp->trackingSendsSinceFullJoints + 1 : 0;
+
+	HandJointEncodeArg joint_encode_args[Side::COUNT] = {};
+	em_proto_HandJointLocation changed_joints[Side::COUNT][XR_HAND_JOINT_COUNT_EXT];
 
 	// Get hand joint locations
 	if (inputState.pfnXrLocateHandJointsEXT != nullptr && inputState.xrHandTrackerEXTLeft != nullptr &&
@@ -267,41 +413,131 @@ em_remote_experience_report_pose(EmRemoteExperience *exp, XrTime predictedDispla
 				continue;
 			}
 
-			auto &hand_joint_locations = hand == inputState.xrHandTrackerEXTLeft
-			                                 ? hand_joint_locations_left
-			                                 : hand_joint_locations_right;
+			const int side = hand == inputState.xrHandTrackerEXTLeft ? Side::LEFT : Side::RIGHT;
+			auto &last_sent = exp->lastSentJoints[side];
+			HandJointEncodeArg &encode_arg = joint_encode_args[side];
+			encode_arg.joints = changed_joints[side];
 
 			for (int i = 0; i < locationsEXT.jointCount; i++) {
-				hand_joint_locations[i].index = i;
-				hand_joint_locations[i].has_pose = locationsEXT.isActive;
-
-				const auto &joint_pose = locationsEXT.jointLocations[i].pose;
-
-				hand_joint_locations[i].pose = convert_pose(joint_pose);
-
-				hand_joint_locations[i].radius = locationsEXT.jointLocations[i].radius;
+				em_proto_HandJointLocation location = {};
+				location.index = i;
+				location.has_pose = locationsEXT.isActive;
+				location.pose = convert_pose(locationsEXT.jointLocations[i].pose);
+				location.radius = locationsEXT.jointLocations[i].radius;
+
+				if (sparse_joints && !hand_joint_changed(last_sent[i], location)) {
+					continue;
+				}
+
+				changed_joints[side][encode_arg.count++] = location;
+				last_sent[i] = location;
 			}
 
-			auto &locations = hand == inputState.xrHandTrackerEXTLeft ? tracking.hand_joint_locations_left
-			                                                          : tracking.hand_joint_locations_right;
-			locations.arg = hand_joint_locations.data();
+			auto &locations = side == Side::LEFT ? tracking.hand_joint_locations_left
+			                                     : tracking.hand_joint_locations_right;
+			locations.arg = &encode_arg;
 			locations.funcs.encode = ProtoMessage_encode_hand_joint_locations;
 		}
 	}
 
+	tracking.hand_joints_sparse = sparse_joints;
+	tracking.timestamp = predictedDisplayTime;
+	tracking.sequence_idx = ++exp->trackingSequenceIdx;
+
 	em_proto_UpMessage upMessage = em_proto_UpMessage_init_default;
 	upMessage.has_tracking = true;
 	upMessage.tracking = tracking;
 
-	// Send message.
-	if (!em_remote_experience_emit_upmessage(exp, &upMessage)) {
+	// Send message over the unreliable tracking channel: a lost packet is
+	// immediately superseded by the next one anyway.
+	if (!em_remote_experience_emit_upmessage_on(exp, &upMessage, true)) {
 		ALOGE("Could not queue HMD pose message!");
 	}
 }
 
+void
+em_remote_experience_report_input(EmRemoteExperience *exp, const InputState &inputState)
+{
+	if (em_connection_get_status(exp->connection) != EM_STATUS_CONNECTED) {
+		return;
+	}
+
+	if (exp->inputEverSent && inputState.handGrab[Side::LEFT] == exp->lastSentGrab[Side::LEFT] &&
+	    inputState.handGrab[Side::RIGHT] == exp->lastSentGrab[Side::RIGHT]) {
+		return;
+	}
+
+	em_proto_UpMessage upMessage = em_proto_UpMessage_init_default;
+	upMessage.has_input = true;
+	upMessage.input.grab_value_left = inputState.handGrab[Side::LEFT];
+	upMessage.input.grab_value_right = inputState.handGrab[Side::RIGHT];
+	upMessage.input.sequence_idx = ++exp->inputSequenceIdx;
+
+	// Reliable channel: unlike a pose, a lost input edge is not harmlessly
+	// superseded by the next sample, it is a dropped button press.
+	if (!em_remote_experience_emit_upmessage_on(exp, &upMessage, false)) {
+		ALOGE("Could not queue input message!");
+		return;
+	}
+
+	exp->lastSentGrab = inputState.handGrab;
+	exp->inputEverSent = true;
+}
+
+/*!
+ * Thread function sending tracking messages at @ref kTrackingRateHz,
+ * decoupled from the render rate: fresher poses reach the server even when
+ * rendering stalls, and rendering never waits on a send.
+ */
+static void *
+em_remote_experience_tracking_thread_func(void *ptr)
+{
+	EmRemoteExperience *exp = (EmRemoteExperience *)ptr;
+
+	os_thread_helper_lock(&exp->tracking_thread);
+	while (os_thread_helper_is_running_locked(&exp->tracking_thread)) {
+		os_thread_helper_unlock(&exp->tracking_thread);
+
+		if (em_connection_get_status(exp->connection) == EM_STATUS_CONNECTED) {
+			XrTime displayTime = exp->lastPredictedDisplayTime;
+			if (displayTime != 0) {
+				// Sample at the predicted display time advanced by however much
+				// wall time passed since xrWaitFrame predicted it.
+				XrTime sampleTime =
+				    displayTime + (os_monotonic_get_ns() - exp->lastPredictedStoredAt);
+				em_remote_experience_report_pose(exp, sampleTime, *exp->trackingInputState);
+			}
+		}
+
+		os_nanosleep(kTrackingPeriodNs);
+
+		os_thread_helper_lock(&exp->tracking_thread);
+	}
+	os_thread_helper_unlock(&exp->tracking_thread);
+
+	return NULL;
+}
+
+static bool
+gl_has_extension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char *ext = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+		if (ext != nullptr && strcmp(ext, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static void
 em_remote_experience_dispose(EmRemoteExperience *exp)
 {
+	os_thread_helper_stop_and_wait(&exp->tracking_thread);
+	os_thread_helper_destroy(&exp->tracking_thread);
+
 	if (exp->stream_client) {
 		em_stream_client_stop(exp->stream_client);
 		if (exp->renderer) {
@@ -318,9 +554,17 @@ em_remote_experience_dispose(EmRemoteExperience *exp)
 		em_connection_disconnect(exp->connection);
 	}
 
+#if __ANDROID_API__ >= 30
+	if (exp->health.thermalManager != nullptr) {
+		AThermal_releaseManager(exp->health.thermalManager);
+		exp->health.thermalManager = nullptr;
+	}
+#endif
+
 	g_clear_object(&exp->stream_client);
 	g_clear_object(&exp->connection);
 	exp->swapchainBuffers.reset();
+	std::vector<XrSwapchainImageForGL>().swap(exp->quad.images);
 
 	if (exp->renderer) {
 		ALOGW(
@@ -337,6 +581,11 @@ em_remote_experience_dispose(EmRemoteExperience *exp)
 static void
 em_remote_experience_finalize(EmRemoteExperience *exp)
 {
+	if (exp->quad.swapchain != XR_NULL_HANDLE) {
+		xrDestroySwapchain(exp->quad.swapchain);
+		exp->quad.swapchain = XR_NULL_HANDLE;
+	}
+
 	if (exp->xr_owned.swapchain != XR_NULL_HANDLE) {
 		xrDestroySwapchain(exp->xr_owned.swapchain);
 		exp->xr_owned.swapchain = XR_NULL_HANDLE;
@@ -370,6 +619,10 @@ em_remote_experience_new(EmConnection *connection,
 	self->xr_not_owned.instance = instance;
 	self->xr_not_owned.session = session;
 
+	g_assert(os_thread_helper_init(&self->tracking_thread) >= 0);
+	// Make the very first tracking message carry the full joint set.
+	self->trackingSendsSinceFullJoints = kHandJointsFullInterval;
+
 	// Get the extension function for converting times.
 	{
 		XrResult result =
@@ -389,6 +642,11 @@ em_remote_experience_new(EmConnection *connection,
 		ALOGE("Failed to make EGL context current.");
 	}
 
+	self->multiview = gl_has_extension("GL_OVR_multiview2");
+	ALOGI("%s: GL_OVR_multiview2 %s", __FUNCTION__,
+	      self->multiview ? "supported, rendering both eyes in one pass"
+	                      : "not supported, falling back to side-by-side");
+
 	{
 		//		uint32_t formatCount;
 		//		xrEnumerateSwapchainFormats(session, 0, &formatCount, NULL);
@@ -402,11 +660,12 @@ em_remote_experience_new(EmConnection *connection,
 		swapchainInfo.type = XR_TYPE_SWAPCHAIN_CREATE_INFO;
 		swapchainInfo.usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
 		swapchainInfo.format = GL_SRGB8_ALPHA8;
-		swapchainInfo.width = self->eye_extents.width * 2;
+		// One layer per eye with multiview, both eyes side by side without.
+		swapchainInfo.width = self->multiview ? self->eye_extents.width : self->eye_extents.width * 2;
 		swapchainInfo.height = self->eye_extents.height;
 		swapchainInfo.sampleCount = 1;
 		swapchainInfo.faceCount = 1;
-		swapchainInfo.arraySize = 1;
+		swapchainInfo.arraySize = self->multiview ? 2 : 1;
 		swapchainInfo.mipCount = 1;
 
 		XrResult result = xrCreateSwapchain(session, &swapchainInfo, &self->xr_owned.swapchain);
@@ -418,7 +677,8 @@ em_remote_experience_new(EmConnection *connection,
 		}
 	}
 
-	if (!self->swapchainBuffers.enumerateAndGenerateFramebuffers(self->xr_owned.swapchain)) {
+	if (!self->swapchainBuffers.enumerateAndGenerateFramebuffers(self->xr_owned.swapchain,
+	                                                             self->multiview ? 2 : 1)) {
 		ALOGE("%s: Failed to enumerate swapchain images or associate them with framebuffer object names.",
 		      __FUNCTION__);
 		em_remote_experience_destroy(&self);
@@ -428,7 +688,7 @@ em_remote_experience_new(EmConnection *connection,
 	try {
 		ALOGI("%s: Setup renderer...", __FUNCTION__);
 		self->renderer = std::make_unique<Renderer>();
-		self->renderer->setupRender();
+		self->renderer->setupRender(self->multiview);
 	} catch (std::exception const &e) {
 		ALOGE("%s: Caught exception setting up renderer: %s", __FUNCTION__, e.what());
 		self->renderer->reset();
@@ -484,6 +744,142 @@ em_remote_experience_destroy(EmRemoteExperience **ptr_exp)
 	*ptr_exp = NULL;
 }
 
+/*!
+ * Acquire the next swapchain image without waiting on it.
+ *
+ * Issued as early as possible — right after the previous release and again at
+ * the top of the frame — so the runtime's availability wait runs concurrently
+ * with the sample pull and pose locate. By the time the frame needs the image,
+ * xrWaitSwapchainImage usually returns immediately instead of blocking for
+ * milliseconds after we already waited on the decoder. No-op while an image
+ * is already held.
+ */
+static void
+em_remote_experience_acquire_image_early(EmRemoteExperience *exp)
+{
+	if (exp->imageAcquired) {
+		return;
+	}
+
+	XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
+	XrResult result = xrAcquireSwapchainImage(exp->xr_owned.swapchain, &acquireInfo, &exp->acquiredImageIndex);
+
+	if (XR_FAILED(result)) {
+		ALOGE("Failed to acquire swapchain image (%d)", result);
+		std::abort();
+	}
+
+	exp->imageAcquired = true;
+}
+
+/*!
+ * Pick up a pending quad (UI) layer update from the server, recreating the
+ * quad swapchain when the pixel size changed and uploading the new pixels.
+ *
+ * Must run with the EGL context current, which the frame loop guarantees.
+ * Updates only arrive when the quad actually changed, so this is almost
+ * always a cheap generation check.
+ */
+static void
+em_remote_experience_update_quad_layer(EmRemoteExperience *exp)
+{
+	struct em_quad_layer_update update = {};
+	if (!em_connection_poll_quad_layer(exp->connection, &exp->quad.generation, &update)) {
+		return;
+	}
+
+	exp->quad.pose.position = {update.position[0], update.position[1], update.position[2]};
+	exp->quad.pose.orientation = {update.orientation_xyzw[0], update.orientation_xyzw[1],
+	                              update.orientation_xyzw[2], update.orientation_xyzw[3]};
+	exp->quad.size = {update.size_x, update.size_y};
+	exp->quad.visible = update.visible;
+
+	if (update.pixels == NULL) {
+		// Placement or visibility only update, the pixels we have stay.
+		return;
+	}
+
+	if (exp->quad.swapchain == XR_NULL_HANDLE || exp->quad.width != update.width ||
+	    exp->quad.height != update.height) {
+		if (exp->quad.swapchain != XR_NULL_HANDLE) {
+			xrDestroySwapchain(exp->quad.swapchain);
+			exp->quad.swapchain = XR_NULL_HANDLE;
+			exp->quad.images.clear();
+		}
+
+		XrSwapchainCreateInfo swapchainInfo = {};
+		swapchainInfo.type = XR_TYPE_SWAPCHAIN_CREATE_INFO;
+		swapchainInfo.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+		swapchainInfo.format = GL_SRGB8_ALPHA8;
+		swapchainInfo.width = update.width;
+		swapchainInfo.height = update.height;
+		swapchainInfo.sampleCount = 1;
+		swapchainInfo.faceCount = 1;
+		swapchainInfo.arraySize = 1;
+		swapchainInfo.mipCount = 1;
+
+		XrResult result = xrCreateSwapchain(exp->xr_not_owned.session, &swapchainInfo, &exp->quad.swapchain);
+		if (XR_FAILED(result)) {
+			ALOGE("%s: Failed to create quad swapchain (%d)", __FUNCTION__, result);
+			g_bytes_unref(update.pixels);
+			return;
+		}
+
+		uint32_t imageCount = 0;
+		xrEnumerateSwapchainImages(exp->quad.swapchain, 0, &imageCount, nullptr);
+		exp->quad.images.resize(imageCount, {kGLSwapchainImageType});
+		result = xrEnumerateSwapchainImages(
+		    exp->quad.swapchain, imageCount, &imageCount,
+		    reinterpret_cast<XrSwapchainImageBaseHeader *>(exp->quad.images.data()));
+		if (XR_FAILED(result)) {
+			ALOGE("%s: Failed to enumerate quad swapchain images (%d)", __FUNCTION__, result);
+			xrDestroySwapchain(exp->quad.swapchain);
+			exp->quad.swapchain = XR_NULL_HANDLE;
+			exp->quad.images.clear();
+			g_bytes_unref(update.pixels);
+			return;
+		}
+
+		exp->quad.width = update.width;
+		exp->quad.height = update.height;
+	}
+
+	// The wire format is top-down, GL wants the bottom row first.
+	gsize pixels_size = 0;
+	uint8_t *pixels = static_cast<uint8_t *>(g_bytes_unref_to_data(update.pixels, &pixels_size));
+	const size_t stride = (size_t)update.width * 4;
+	std::vector<uint8_t> row(stride);
+	for (uint32_t y = 0; y < update.height / 2; y++) {
+		uint8_t *top = pixels + (size_t)y * stride;
+		uint8_t *bottom = pixels + (size_t)(update.height - 1 - y) * stride;
+		memcpy(row.data(), top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row.data(), stride);
+	}
+
+	XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
+	uint32_t index = 0;
+	XrResult result = xrAcquireSwapchainImage(exp->quad.swapchain, &acquireInfo, &index);
+	if (XR_FAILED(result)) {
+		ALOGE("%s: Failed to acquire quad swapchain image (%d)", __FUNCTION__, result);
+		g_free(pixels);
+		return;
+	}
+
+	XrSwapchainImageWaitInfo waitInfo{XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, nullptr, XR_INFINITE_DURATION};
+	xrWaitSwapchainImage(exp->quad.swapchain, &waitInfo);
+
+	glBindTexture(GL_TEXTURE_2D, exp->quad.images[index].image);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)update.width, (GLsizei)update.height, GL_RGBA,
+	                GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	XrSwapchainImageReleaseInfo releaseInfo{XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO};
+	xrReleaseSwapchainImage(exp->quad.swapchain, &releaseInfo);
+
+	g_free(pixels);
+}
+
 EmPollRenderResult
 em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &inputState)
 {
@@ -511,6 +907,10 @@ em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &
 		return EM_POLL_RENDER_RESULT_SHOULD_NOT_RENDER;
 	}
 
+	// Kick off the swapchain image acquisition before the pose locate and
+	// the decode wait below, so those overlap the image becoming available.
+	em_remote_experience_acquire_image_early(exp);
+
 	XrViewLocateInfo locateInfo = {.type = XR_TYPE_VIEW_LOCATE_INFO,
 	                               .viewConfigurationType = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO,
 	                               .displayTime = frameState.predictedDisplayTime,
@@ -538,7 +938,6 @@ em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &
 	layer.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
 	layer.viewCount = 2;
 
-	// TODO use multiview/array swapchain instead of two draw calls for side by side?
 	XrCompositionLayerProjectionView projectionViews[2] = {};
 	projectionViews[0].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
 	projectionViews[1].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
@@ -547,12 +946,18 @@ em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &
 
 	// Render
 
-	// Set EGL context
-	if (!em_egl_context_make_current(exp->egl_context)) {
+	// This thread keeps its context permanently current; GStreamer works
+	// in its own shared context and hands textures over with fences. The
+	// check is a thread-local read, the real MakeCurrent only runs on the
+	// first frame (or if something external stole the context).
+	if (!em_egl_context_is_current(exp->egl_context) && !em_egl_context_make_current(exp->egl_context)) {
 		ALOGE("FRED: mainloop_one: Failed make egl context current");
 		return EM_POLL_RENDER_RESULT_ERROR_EGL;
 	}
 
+	// Pick up a new quad (UI) layer from the server, if one arrived.
+	em_remote_experience_update_quad_layer(exp);
+
 	bool shouldRender = frameState.shouldRender == XR_TRUE;
 	EmPollRenderResult prResult = EM_POLL_RENDER_RESULT_SHOULD_NOT_RENDER;
 	if (shouldRender) {
@@ -560,15 +965,34 @@ em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &
 		    exp, &beginTime, frameState.predictedDisplayTime, views, &layer, projectionViews);
 	}
 
+	XrCompositionLayerQuad quadLayer = {};
+
 	std::vector<XrCompositionLayerBaseHeader *> layers;
-	layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader *>(&layer));
+	if (em_poll_render_result_include_layer(prResult)) {
+		layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader *>(&layer));
+
+		// The server's quad (UI) layer, composited locally on top of
+		// the video so it stays crisp between its rare updates.
+		if (exp->quad.visible && exp->quad.swapchain != XR_NULL_HANDLE) {
+			quadLayer.type = XR_TYPE_COMPOSITION_LAYER_QUAD;
+			quadLayer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+			quadLayer.space = exp->xr_owned.worldSpace;
+			quadLayer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+			quadLayer.subImage.swapchain = exp->quad.swapchain;
+			quadLayer.subImage.imageRect = {{0, 0}, {(int32_t)exp->quad.width, (int32_t)exp->quad.height}};
+			quadLayer.subImage.imageArrayIndex = 0;
+			quadLayer.pose = exp->quad.pose;
+			quadLayer.size = exp->quad.size;
+			layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader *>(&quadLayer));
+		}
+	}
 
 	// Submit frame
 	XrFrameEndInfo endInfo = {};
 	endInfo.type = XR_TYPE_FRAME_END_INFO;
 	endInfo.displayTime = frameState.predictedDisplayTime;
 	endInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
-	endInfo.layerCount = em_poll_render_result_include_layer(prResult) ? 1 : 0;
+	endInfo.layerCount = (uint32_t)layers.size();
 	endInfo.layers = layers.data();
 
 	result = xrEndFrame(session, &endInfo);
@@ -577,8 +1001,16 @@ em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &
 		return EM_POLL_RENDER_RESULT_ERROR_ENDFRAME;
 	}
 
-	if (em_connection_get_status(exp->connection) == EM_STATUS_CONNECTED) {
-		em_remote_experience_report_pose(exp, frameState.predictedDisplayTime, inputState);
+	// Tracking is reported from its own high-rate thread; here we only
+	// refresh the display-time estimate it extrapolates from, and start it
+	// on the first frame once the input state exists.
+	exp->lastPredictedStoredAt = os_monotonic_get_ns();
+	exp->lastPredictedDisplayTime = frameState.predictedDisplayTime;
+	if (exp->trackingInputState == nullptr) {
+		exp->trackingInputState = &inputState;
+		int ret = os_thread_helper_start(&exp->tracking_thread, &em_remote_experience_tracking_thread_func, exp);
+		(void)ret;
+		g_assert(ret == 0);
 	}
 
 	return prResult;
@@ -620,6 +1052,99 @@ report_frame_timing(EmRemoteExperience *exp,
 	em_remote_experience_emit_upmessage(exp, &upMsg);
 }
 
+//! Whether the performance HUD was switched on from the shell:
+//! `adb shell setprop debug.electricmaple.hud 1`.
+static bool
+hud_sysprop_enabled()
+{
+	char value[PROP_VALUE_MAX];
+	return __system_property_get("debug.electricmaple.hud", value) > 0 && value[0] == '1';
+}
+
+//! Turn this frame's sample and the stream client counters into one HUD
+//! datapoint per graph and hand it to the renderer.
+static void
+em_remote_experience_push_hud_sample(EmRemoteExperience *exp, const struct em_sample *sample)
+{
+	Renderer::HudSample hud = {};
+
+	// Stage timestamps are only comparable once clock sync has kicked in
+	// and the server started stamping frames, same as the BENCHMARK line.
+	if (sample->server_render_begin_time != 0) {
+		hud.decode_ms = time_ns_to_ms_f(sample->client_decode_time - sample->client_receive_time);
+		hud.network_ms = time_ns_to_ms_f(sample->client_receive_time - sample->server_push_time);
+	}
+	hud.jitter_ms = time_ns_to_ms_f(sample->jitter_buffer_latency);
+
+	// Bitrate is re-derived from the byte total about once a second, so
+	// the graph shows a readable rate rather than per-frame burstiness.
+	const int64_t now = os_monotonic_get_ns();
+	const int64_t bytes = em_stream_client_get_received_bytes(exp->stream_client);
+	if (exp->hud.lastBitrateSampleTime == 0) {
+		exp->hud.lastBitrateSampleTime = now;
+		exp->hud.lastReceivedBytes = bytes;
+	} else if (now - exp->hud.lastBitrateSampleTime >= 1000 * 1000 * 1000) {
+		exp->hud.bitrateMbps =
+		    (float)(bytes - exp->hud.lastReceivedBytes) * 8000.0f / (float)(now - exp->hud.lastBitrateSampleTime);
+		exp->hud.lastBitrateSampleTime = now;
+		exp->hud.lastReceivedBytes = bytes;
+	}
+	hud.bitrate_mbps = exp->hud.bitrateMbps;
+
+	const uint32_t droppedTotal = em_stream_client_get_dropped_frames(exp->stream_client);
+	hud.dropped_frames = (float)(droppedTotal - exp->hud.lastDroppedFrames);
+	exp->hud.lastDroppedFrames = droppedTotal;
+
+	exp->renderer->pushHudSample(hud);
+}
+
+//! One second between health reports: thermal state moves over minutes and
+//! the decode interval is already smoothed, so anything faster is noise.
+static constexpr int64_t kHealthReportIntervalNs = 1000 * 1000 * 1000;
+
+/*!
+ * Send the periodic UpHealthMessage: thermal status, decoder cadence and
+ * display misses since the last report. The server folds it into its encode
+ * ladder decisions, so a throttling headset is stepped down before the user
+ * sees stutter. Rate-limited internally, cheap to call every frame.
+ */
+static void
+em_remote_experience_send_health_report(EmRemoteExperience *exp)
+{
+	const int64_t now = os_monotonic_get_ns();
+	if (exp->health.lastReportTime != 0 && now - exp->health.lastReportTime < kHealthReportIntervalNs) {
+		return;
+	}
+	if (em_connection_get_status(exp->connection) != EM_STATUS_CONNECTED) {
+		return;
+	}
+	exp->health.lastReportTime = now;
+
+	em_proto_UpMessage upMessage = em_proto_UpMessage_init_default;
+	upMessage.has_health = true;
+
+#if __ANDROID_API__ >= 30
+	if (exp->health.thermalManager == nullptr) {
+		exp->health.thermalManager = AThermal_acquireManager();
+	}
+	if (exp->health.thermalManager != nullptr) {
+		upMessage.health.thermal_status =
+		    static_cast<int32_t>(AThermal_getCurrentThermalStatus(exp->health.thermalManager));
+	}
+#endif
+
+	upMessage.health.decode_interval_ms = em_stream_client_get_decode_interval_ms(exp->stream_client);
+
+	const uint32_t misses = em_stream_client_get_display_misses(exp->stream_client);
+	upMessage.health.display_misses = static_cast<int32_t>(misses - exp->health.lastDisplayMisses);
+	exp->health.lastDisplayMisses = misses;
+
+	// Unreliable is fine here, the next report supersedes a lost one.
+	if (!em_remote_experience_emit_upmessage_on(exp, &upMessage, true)) {
+		ALOGW("Could not queue health message!");
+	}
+}
+
 EmPollRenderResult
 em_remote_experience_inner_poll_and_render_frame(EmRemoteExperience *exp,
                                                  const struct timespec *beginFrameTime,
@@ -654,10 +1179,18 @@ em_remote_experience_inner_poll_and_render_frame(EmRemoteExperience *exp,
 	projectionViews[0].fov = views[0].fov;
 	projectionViews[0].subImage.imageRect.offset = {0, 0};
 	projectionViews[0].subImage.imageRect.extent = {static_cast<int32_t>(width), static_cast<int32_t>(height)};
+	projectionViews[0].subImage.imageArrayIndex = 0;
 	projectionViews[1].subImage.swapchain = exp->xr_owned.swapchain;
 	projectionViews[1].pose = views[1].pose;
 	projectionViews[1].fov = views[1].fov;
-	projectionViews[1].subImage.imageRect.offset = {static_cast<int32_t>(width), 0};
+	if (exp->multiview) {
+		// Each eye is a layer of the array swapchain.
+		projectionViews[1].subImage.imageRect.offset = {0, 0};
+		projectionViews[1].subImage.imageArrayIndex = 1;
+	} else {
+		projectionViews[1].subImage.imageRect.offset = {static_cast<int32_t>(width), 0};
+		projectionViews[1].subImage.imageArrayIndex = 0;
+	}
 	projectionViews[1].subImage.imageRect.extent = {static_cast<int32_t>(width), static_cast<int32_t>(height)};
 
 	struct timespec decodeEndTime;
@@ -682,14 +1215,10 @@ em_remote_experience_inner_poll_and_render_frame(EmRemoteExperience *exp,
 	//	projectionViews[1].pose = sample->poses[1];
 	// #endif
 
-	XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
-	uint32_t imageIndex;
-	result = xrAcquireSwapchainImage(exp->xr_owned.swapchain, &acquireInfo, &imageIndex);
-
-	if (XR_FAILED(result)) {
-		ALOGE("Failed to acquire swapchain image (%d)", result);
-		std::abort();
-	}
+	// The image was acquired at the top of the frame (or right after the
+	// previous release), so the runtime has had the whole sample pull and
+	// pose locate to make it available and this wait is usually immediate.
+	uint32_t imageIndex = exp->acquiredImageIndex;
 
 	XrSwapchainImageWaitInfo waitInfo = {.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO,
 	                                     .timeout = XR_INFINITE_DURATION};
@@ -709,20 +1238,54 @@ em_remote_experience_inner_poll_and_render_frame(EmRemoteExperience *exp,
 	}
 	glBindFramebuffer(GL_FRAMEBUFFER, exp->swapchainBuffers.framebufferNameAtSwapchainIndex(imageIndex));
 
-	glViewport(0, 0, width * 2, height);
+	glViewport(0, 0, exp->multiview ? width : width * 2, height);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
 	// Disable gamma correction, as the frame texture is already in sRGB space.
 	// This has effects only when we are drawing to a sRGB framebuffer.
 	glDisable(GL_FRAMEBUFFER_SRGB_EXT);
 
-	exp->renderer->draw(sample->frame_texture_id, sample->frame_texture_target);
+	if (sample->have_poses) {
+		// Timewarp: the frame was rendered with the poses carried in its
+		// down-message, warp it to the freshly predicted view poses so
+		// perceived rotational latency is bounded by local frame time
+		// instead of the network round trip.
+		exp->renderer->drawReprojected(sample->frame_texture_id, sample->frame_texture_target, sample->poses,
+		                               views, static_cast<int32_t>(width), static_cast<int32_t>(height));
+	} else if (sample->frame_width <= 0 ||
+	           !exp->renderer->blitFrame(sample->frame_texture_id, sample->frame_texture_target,
+	                                     sample->frame_width, sample->frame_height,
+	                                     static_cast<int32_t>(width * 2), static_cast<int32_t>(height))) {
+		// No blit-capable texture: fall back to the sampling pass.
+		exp->renderer->draw(sample->frame_texture_id, sample->frame_texture_target);
+	}
+
+	// Performance HUD on top of the frame, while its framebuffer is still
+	// bound. The toggle property is only re-read about once a second, a
+	// sysprop lookup is not free.
+	if (exp->hud.framesSincePropPoll++ >= 60) {
+		exp->hud.framesSincePropPoll = 0;
+		exp->hud.enabled = hud_sysprop_enabled();
+	}
+	if (exp->hud.enabled) {
+		em_remote_experience_push_hud_sample(exp, sample);
+		exp->renderer->drawHud(static_cast<int32_t>(width), static_cast<int32_t>(height));
+	}
+
+	// Health reporting is independent of the HUD toggle: the server acts
+	// on it whether or not anyone is watching the graphs.
+	em_remote_experience_send_health_report(exp);
 
 	// Release
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	xrReleaseSwapchainImage(exp->xr_owned.swapchain, NULL);
+	exp->imageAcquired = false;
+
+	// Start acquiring the next image right away, overlapping the next
+	// frame's decode and xrWaitFrame.
+	em_remote_experience_acquire_image_early(exp);
 
 	// TODO check here to see if we already overshot the predicted display time, maybe?
 
@@ -742,15 +1305,33 @@ em_remote_experience_inner_poll_and_render_frame(EmRemoteExperience *exp,
 		uint64_t client_render_duration = client_now - sample->client_render_begin_time;
 		uint64_t total_duration = client_now - sample->server_render_begin_time;
 
+		// Parsed by scripts/benchmark/collect_results.py, keep it valid JSON.
 		ALOGD(
 		    "BENCHMARK {\"frame\": %ld, \"server_render_ms\": %.1f, "
-		    "server_encode_transmit_ms\":%.1f, "
+		    "\"server_encode_transmit_ms\": %.1f, "
 		    "\"client_decode_ms\": %.1f, \"client_wait_ms\": %.1f, "
-		    "\"client_render_ms\": %.1f,total_ms\": %.1f}",
+		    "\"client_render_ms\": %.1f, \"total_ms\": %.1f, \"jitter_buffer_ms\": %.1f}",
 		    sample->frame_sequence_id, time_ns_to_ms_f(server_render_duration),
 		    time_ns_to_ms_f(server_encode_transmit_duration), time_ns_to_ms_f(client_decode_duration),
 		    time_ns_to_ms_f(client_wait_duration), time_ns_to_ms_f(client_render_duration),
-		    time_ns_to_ms_f(total_duration));
+		    time_ns_to_ms_f(total_duration), time_ns_to_ms_f(sample->jitter_buffer_latency));
+
+		// The sample carries the server-side stamps of this frame too, so
+		// one client trace shows the whole server-to-display path.
+		if (em_trace_is_enabled()) {
+			int64_t frame = sample->frame_sequence_id;
+			em_trace_slice("server_render", EM_TRACE_LANE_SERVER_RENDER, frame,
+			               sample->server_render_begin_time, sample->server_push_time);
+			em_trace_slice("encode_transmit", EM_TRACE_LANE_NETWORK, frame, sample->server_push_time,
+			               sample->client_receive_time);
+			em_trace_slice("decode", EM_TRACE_LANE_DECODE, frame, sample->client_receive_time,
+			               sample->client_decode_time);
+			em_trace_slice("wait", EM_TRACE_LANE_DECODE, frame, sample->client_decode_time,
+			               sample->client_render_begin_time);
+			em_trace_slice("render", EM_TRACE_LANE_RENDER, frame, sample->client_render_begin_time,
+			               (int64_t)client_now);
+			em_trace_instant("display", EM_TRACE_LANE_RENDER, frame, (int64_t)client_now);
+		}
 	}
 
 	// Send frame report
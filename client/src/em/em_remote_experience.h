@@ -127,6 +127,18 @@ em_remote_experience_destroy(EmRemoteExperience **ptr_exp);
 EmPollRenderResult
 em_remote_experience_poll_and_render_frame(EmRemoteExperience *exp, InputState &inputState);
 
+/*!
+ * Send a compact input-only message if any input value changed since the
+ * last call.
+ *
+ * Call right after syncing actions, so button and trigger edges go out the
+ * moment they are sampled instead of riding the next tracking message. Sent
+ * reliably; the server dispatches it ahead of all tracking work. Cheap
+ * no-op while nothing changes.
+ */
+void
+em_remote_experience_report_input(EmRemoteExperience *exp, const InputState &inputState);
+
 /*!
  * Check for a delivered frame, rendering it if available.
  *
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES3/gl3.h>
 #include <openxr/openxr.h>
 
@@ -23,6 +25,10 @@ struct em_sample
 {
 	GLuint frame_texture_id;
 	GLenum frame_texture_target;
+	//! Decoded frame size, for paths that copy rather than sample with
+	//! normalized coordinates.
+	int32_t frame_width;
+	int32_t frame_height;
 
 	bool have_poses;
 	XrPosef poses[2];
@@ -33,4 +39,17 @@ struct em_sample
 	int64_t client_receive_time;
 	int64_t client_decode_time;
 	int64_t client_render_begin_time;
+
+	//! Latency the adaptive jitter buffer was adding when this frame was
+	//! pulled, to make the latency/no-drop tradeoff visible alongside the
+	//! stage timestamps.
+	int64_t jitter_buffer_latency;
+
+	//! EGL_KHR_fence_sync fence GStreamer's GL thread inserted after its
+	//! last write to frame_texture_id. The stream client queues a
+	//! server-side wait on it in the render context when the sample is
+	//! pulled, and destroys it with the sample; neither end ever switches
+	//! contexts. EGL_NO_SYNC_KHR when fences are unavailable and the
+	//! GstGLSyncMeta fallback was used instead.
+	EGLSyncKHR frame_ready_fence;
 };
@@ -35,27 +35,77 @@
 #include <linux/time.h>
 #include <openxr/openxr.h>
 #include <pb_decode.h>
+#include <pb_encode.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#include <EGL/eglext.h>
 #include <GLES2/gl2ext.h>
 
-// Thresholds for reusing last DownMsg when we received too many frames without DownMsgs in a row.
-#define EM_NO_DOWN_MSG_FALLBACK_TIMEOUT_SECS 1
-#define EM_NO_DOWN_MSG_FALLBACK_SKIPPED_FRAME_THRESHOLD 10
-
 #define USE_MANUAL_NTP
 
 #define USE_DECODEBIN3
 
+#define RTP_TWOBYTES_HDR_EXT_ID 1 // Must be in the [1,15] range
+#define RTP_TWOBYTES_HDR_EXT_MAX_SIZE 255
+
+//! Must be larger than the number of frames the depayloader can have in flight.
+#define EM_METADATA_RING_SIZE 8
+
+/*!
+ * One extension payload pulled out of an incoming RTP packet, waiting to be
+ * attached to the depayloaded frame with the same PTS.
+ */
+struct em_metadata_slot
+{
+	GstClockTime pts;
+	int64_t receive_time;
+	guint size;
+	char data[RTP_TWOBYTES_HDR_EXT_MAX_SIZE];
+};
+
 struct em_sc_sample
 {
 	struct em_sample base;
 	GstSample *sample;
 };
 
+/*
+ * Bounds and cadence of the adaptive jitter buffer controller, see
+ * em_stream_client_adjust_jitterbuffer.
+ */
+//! Floor on clean networks; below this scheduling noise dominates anyway.
+#define EM_JITTER_LATENCY_MIN_MS 5
+#define EM_JITTER_LATENCY_MAX_MS 100
+//! Starting point until the first measurements come in.
+#define EM_JITTER_LATENCY_INITIAL_MS 50
+//! How fast the buffer creeps down when the network is clean.
+#define EM_JITTER_SHRINK_STEP_MS 5
+//! Headroom multiplier over the measured average inter-arrival jitter.
+#define EM_JITTER_LATENCY_HEADROOM 4
+#define EM_JITTER_ADJUST_INTERVAL_MS 1000
+
+// The shared frame state is the index of the most recently produced slot plus
+// a freshness bit, packed into one atomic int.
+#define EM_FRAME_SLOT_MASK 0x3
+#define EM_FRAME_SLOT_FRESH 0x4
+
+/*!
+ * One slot of the decode-to-render triple buffer.
+ */
+struct em_frame_slot
+{
+	//! Decoded sample, owned by the slot while it sits in the buffer.
+	GstSample *sample;
+	//! When the streaming thread finished pulling the sample.
+	int64_t decode_end_time;
+	//! Texture-ready fence inserted on GStreamer's GL thread, handed to
+	//! the render thread with the sample. See create_ready_fence_gl_func.
+	EGLSyncKHR ready_fence;
+};
+
 struct _EmStreamClient
 {
 	GObject parent;
@@ -80,37 +130,87 @@ struct _EmStreamClient
 
 	EmEglContext *egl_context;
 
+	/*!
+	 * EGL fence entry points, resolved once in
+	 * em_stream_client_set_egl_context. All three are either set or NULL:
+	 * without EGL_KHR_fence_sync and EGL_KHR_wait_sync the decode-to-render
+	 * handoff falls back to the GstGLSyncMeta round trip.
+	 */
+	PFNEGLCREATESYNCKHRPROC egl_create_sync;
+	PFNEGLDESTROYSYNCKHRPROC egl_destroy_sync;
+	PFNEGLWAITSYNCKHRPROC egl_wait_sync;
+
 	struct os_thread_helper play_thread;
 
 	bool pipeline_is_running;
 	bool received_first_frame;
 
-	GMutex sample_mutex;
-	GstSample *sample;
-	int64_t sample_decode_end_time;
+	/*!
+	 * Triple buffer handing decoded samples from the GStreamer streaming
+	 * thread to the render thread. The producer and consumer each own one
+	 * slot outright (@ref frame_write_slot / @ref frame_read_slot) and swap
+	 * it for the shared slot in @ref frame_latest with a single atomic
+	 * exchange, so neither thread ever waits on the other and the render
+	 * thread always sees the newest finished frame (latest-wins).
+	 */
+	struct em_frame_slot frame_slots[3];
+	//! Shared slot index plus @ref EM_FRAME_SLOT_FRESH, see @ref frame_slots.
+	gint frame_latest;
+	//! Slot the streaming thread fills next. Only touched by the producer.
+	gint frame_write_slot;
+	//! Slot the render thread last consumed. Only touched by the consumer.
+	gint frame_read_slot;
 
-	GMutex skipped_frames_mutex;
-	uint32_t skipped_frames;
 	em_proto_DownMessage last_down_msg;
 
-	// todo: this may not be an ideal way to handle data racing
-	GMutex metadata_preservation_mutex;
-	GstBuffer *preserved_metadata_struct_buf;
+	/*!
+	 * Extension payloads extracted from incoming RTP packets, keyed by the
+	 * packet PTS so the depay src probe can attach the metadata belonging
+	 * to exactly the frame it sees. Single producer (depay sink probe),
+	 * single consumer (depay src probe), published via @ref metadata_head.
+	 */
+	struct em_metadata_slot metadata_ring[EM_METADATA_RING_SIZE];
+	gint metadata_head;
 
 	GArray *latency_collection;
 	int64_t latency_calculation_window; // Nanoseconds
 	int64_t latency_last_time_query;
 
 	int64_t average_latency; // Nanoseconds
-	int max_jitter_latency;
+
+	//! Decoded frames overwritten in the triple buffer before the render
+	//! thread consumed them, i.e. dropped. Total since stream start.
+	gint dropped_frames;
+	//! Total video RTP bytes seen by the depayloader probe, for bandwidth
+	//! display. Only written on the streaming thread.
+	gint64 received_bytes;
+
+	//! When the previous frame left the decoder, zero before the first
+	//! frame. Only touched on the streaming thread.
+	int64_t last_decode_end_time;
+	//! Smoothed interval between frames leaving the decoder, ms. Climbs
+	//! as thermal throttling slows the decoder, see the health report.
+	float decode_interval_ewma_ms;
+	//! Frames whose decode interval blew well past the smoothed cadence,
+	//! i.e. missed at least one display period. Total since stream start.
+	gint display_misses;
+
+	//! Whether the stream rides webrtcbin; retransmission only works there.
+	bool use_webrtc;
+	//! The video session's jitterbuffer, kept from new_jitterbuffer_callback.
+	GstElement *video_jitterbuffer;
+	//! Current jitter buffer latency in ms, see em_stream_client_adjust_jitterbuffer.
+	guint jitter_latency_ms;
+	//! num-lost at the previous adjustment, for per-interval deltas.
+	guint64 jitter_prev_lost;
+	//! Source id of the periodic jitter buffer adjustment.
+	guint jitter_timer_id;
 
 	guint timeout_src_id_dot_data;
 };
 
 G_DEFINE_TYPE(EmStreamClient, em_stream_client, G_TYPE_OBJECT)
 
-#define RTP_TWOBYTES_HDR_EXT_ID 1 // Must be in the [1,15] range
-
 // clang-format off
 #define SINK_CAPS \
     "video/x-raw(" GST_CAPS_FEATURE_MEMORY_GL_MEMORY "), "              \
@@ -133,7 +233,10 @@ em_stream_client_init(EmStreamClient *self)
 
 	self->loop = g_main_loop_new(NULL, FALSE);
 	g_assert(os_thread_helper_init(&self->play_thread) >= 0);
-	g_mutex_init(&self->sample_mutex);
+
+	self->frame_latest = 0;
+	self->frame_write_slot = 1;
+	self->frame_read_slot = 2;
 
 	const gchar *tags[] = {NULL};
 	const GstMetaInfo *info = gst_meta_register_custom("down-message", tags, NULL, NULL, NULL);
@@ -141,15 +244,16 @@ em_stream_client_init(EmStreamClient *self)
 		ALOGE("Failed to register custom meta 'down-message'.");
 	}
 
-	g_mutex_init(&self->skipped_frames_mutex);
-	self->skipped_frames = 0;
-
-	g_mutex_init(&self->metadata_preservation_mutex);
-	self->preserved_metadata_struct_buf = NULL;
+	for (gsize i = 0; i < EM_METADATA_RING_SIZE; i++) {
+		self->metadata_ring[i].pts = GST_CLOCK_TIME_NONE;
+	}
+	self->metadata_head = 0;
 
 	self->latency_collection = g_array_new(FALSE, FALSE, sizeof(gint64));
 	self->latency_calculation_window = time_s_to_ns(3);
 	self->latency_last_time_query = os_monotonic_get_ns();
+
+	self->jitter_latency_ms = EM_JITTER_LATENCY_INITIAL_MS;
 }
 
 static void
@@ -159,7 +263,14 @@ em_stream_client_finalize(GObject *gobject)
 	em_stream_client_stop(self);
 	g_clear_object(&self->loop);
 	g_clear_object(&self->connection);
-	gst_clear_object(&self->sample);
+	for (gsize i = 0; i < G_N_ELEMENTS(self->frame_slots); i++) {
+		g_clear_pointer(&self->frame_slots[i].sample, gst_sample_unref);
+		if (self->frame_slots[i].ready_fence != EGL_NO_SYNC_KHR && self->egl_destroy_sync != NULL) {
+			self->egl_destroy_sync(em_egl_context_get_display(self->egl_context),
+			                       self->frame_slots[i].ready_fence);
+			self->frame_slots[i].ready_fence = EGL_NO_SYNC_KHR;
+		}
+	}
 	gst_clear_object(&self->pipeline);
 	gst_clear_object(&self->gst_gl_display);
 	gst_clear_object(&self->gst_gl_gstreamer_context);
@@ -311,6 +422,33 @@ gst_bus_cb(GstBus *bus, GstMessage *message, gpointer data)
 	return TRUE;
 }
 
+//! Arguments for create_ready_fence_gl_func, which gets a single pointer.
+struct em_ready_fence_args
+{
+	EmStreamClient *sc;
+	EGLSyncKHR fence;
+};
+
+/*!
+ * Runs on GStreamer's GL thread, where its context is permanently current:
+ * inserts a fence behind the decoder's last write to the frame texture. The
+ * render thread waits on the fence in its own (share-group) context, so the
+ * per-frame handoff costs neither side a MakeCurrent.
+ */
+static void
+create_ready_fence_gl_func(GstGLContext *context, gpointer data)
+{
+	(void)context;
+	struct em_ready_fence_args *args = data;
+	EmStreamClient *sc = args->sc;
+
+	args->fence = sc->egl_create_sync(em_egl_context_get_display(sc->egl_context), EGL_SYNC_FENCE_KHR, NULL);
+	// A fence only becomes reachable for other contexts once the commands
+	// before it are flushed; do that here so the waiter never stalls on
+	// an unflushed queue.
+	glFlush();
+}
+
 static GstFlowReturn
 on_new_sample_cb(GstAppSink *appsink, gpointer user_data)
 {
@@ -320,55 +458,74 @@ on_new_sample_cb(GstAppSink *appsink, gpointer user_data)
 
 	// TODO record the frame ID, get frame pose
 
-	GstSample *prev_sample = NULL;
 	GstSample *sample = gst_app_sink_pull_sample(appsink);
 	g_assert_nonnull(sample);
 
-	// Drop it like it's hot
-	bool drop_frame = false;
-
 	GstBuffer *buffer = gst_sample_get_buffer(sample);
 	GstCustomMeta *custom_meta = gst_buffer_get_custom_meta(buffer, "down-message");
 	if (!custom_meta) {
 		ALOGW("new_sample_cb: got buffer without down-message.");
-		//		drop_frame = true;
 	}
 
-	int64_t last_frame_diff_ns = decode_end_time - sc->sample_decode_end_time;
-	if (last_frame_diff_ns >= time_s_to_ns(EM_NO_DOWN_MSG_FALLBACK_TIMEOUT_SECS)) {
-		ALOGW("new_sample_cb: Not dropping frame, since we haven't had one since a second.");
-		//		drop_frame = false;
+	// If the previous frame is still sitting unconsumed in the shared slot
+	// we overwrite it: latest-wins, deterministically.
+	struct em_frame_slot *slot = &sc->frame_slots[sc->frame_write_slot];
+	if (slot->sample != NULL) {
+		// The render thread takes the sample out of a slot it consumes,
+		// so one still being here means this frame was decoded but
+		// never shown.
+		g_atomic_int_inc(&sc->dropped_frames);
 	}
-
-	bool skipped_frames_threshold_reached = false;
-	{
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->skipped_frames_mutex);
-		if (sc->skipped_frames >= EM_NO_DOWN_MSG_FALLBACK_SKIPPED_FRAME_THRESHOLD) {
-			skipped_frames_threshold_reached = true;
-		}
+	g_clear_pointer(&slot->sample, gst_sample_unref);
+	slot->sample = sample;
+	slot->decode_end_time = decode_end_time;
+
+	// Replace the slot's texture-ready fence along with its sample. The
+	// render thread never saw the old fence (it comes with the sample),
+	// so destroying it here is safe.
+	if (slot->ready_fence != EGL_NO_SYNC_KHR) {
+		sc->egl_destroy_sync(em_egl_context_get_display(sc->egl_context), slot->ready_fence);
+		slot->ready_fence = EGL_NO_SYNC_KHR;
 	}
-
-	if (skipped_frames_threshold_reached) {
-		//		ALOGW("sample_cb: Not dropping frame, since we already skipped 10 frames.");
-		drop_frame = false;
-	}
-
-	if (drop_frame) {
-		return GST_FLOW_OK;
+	if (sc->gst_gl_gstreamer_context == NULL) {
+		// Available from the first sample on; cached so the fence hop
+		// does not query per frame. The render thread only reads this
+		// after consuming a slot published below, so the write is safe.
+		gst_gl_query_local_gl_context(sc->appsink, GST_PAD_SINK, &sc->gst_gl_gstreamer_context);
 	}
-
-	{
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->sample_mutex);
-		prev_sample = sc->sample;
-		sc->sample = sample;
-		sc->sample_decode_end_time = decode_end_time;
-		sc->received_first_frame = true;
+	if (sc->egl_create_sync != NULL && sc->gst_gl_gstreamer_context != NULL) {
+		struct em_ready_fence_args args = {.sc = sc, .fence = EGL_NO_SYNC_KHR};
+		gst_gl_context_thread_add(sc->gst_gl_gstreamer_context, create_ready_fence_gl_func, &args);
+		slot->ready_fence = args.fence;
 	}
 
-	// Release the previous sample.
-	if (prev_sample) {
-		gst_sample_unref(prev_sample);
+	// Track how fast frames leave the decoder: this interval climbs well
+	// before throttling turns into visible stutter, so it is the early
+	// signal of the health report.
+	if (sc->last_decode_end_time != 0) {
+		float interval_ms = (float)(decode_end_time - sc->last_decode_end_time) * 1e-6f;
+		if (sc->decode_interval_ewma_ms <= 0.0f) {
+			sc->decode_interval_ewma_ms = interval_ms;
+		} else {
+			if (interval_ms > 1.8f * sc->decode_interval_ewma_ms) {
+				// Late by most of a display period on top of the
+				// usual cadence.
+				g_atomic_int_inc(&sc->display_misses);
+			}
+			sc->decode_interval_ewma_ms += 0.1f * (interval_ms - sc->decode_interval_ewma_ms);
+		}
 	}
+	sc->last_decode_end_time = decode_end_time;
+
+	// Publish the slot and take back whatever was shared before. Retries
+	// only if the render thread swapped in between, so this never spins.
+	gint latest;
+	do {
+		latest = g_atomic_int_get(&sc->frame_latest);
+	} while (!g_atomic_int_compare_and_exchange(&sc->frame_latest, latest,
+	                                            sc->frame_write_slot | EM_FRAME_SLOT_FRESH));
+	sc->frame_write_slot = latest & EM_FRAME_SLOT_MASK;
+	sc->received_first_frame = true;
 
 	return GST_FLOW_OK;
 }
@@ -380,19 +537,16 @@ rtpdepay_sink_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 
 	int64_t frame_receive_time = os_monotonic_get_ns();
 
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->metadata_preservation_mutex);
-
-	// Is not yet consumed.
-	if (sc->preserved_metadata_struct_buf) {
-		return GST_PAD_PROBE_OK;
-	}
-
 	GstBuffer *buffer = gst_pad_probe_info_get_buffer(info);
 
+	// Every video RTP packet passes this probe, so tallying here measures
+	// the stream bandwidth actually arriving, including retransmissions.
+	sc->received_bytes += (gint64)gst_buffer_get_size(buffer);
+
 	GstRTPBuffer rtp_buffer = GST_RTP_BUFFER_INIT;
 
 	// Extract Downstream metadata from rtp header
-	if (!gst_rtp_buffer_map(buffer, GST_MAP_READWRITE, &rtp_buffer)) {
+	if (!gst_rtp_buffer_map(buffer, GST_MAP_READ, &rtp_buffer)) {
 		ALOGE("Failed to map GstBuffer");
 		return GST_PAD_PROBE_OK;
 	}
@@ -414,13 +568,28 @@ rtpdepay_sink_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 		goto no_buf;
 	}
 
-	// Repack the protobuf into a GstBuffer
-	sc->preserved_metadata_struct_buf = gst_buffer_new_memdup(payload_ptr, size);
-	if (!sc->preserved_metadata_struct_buf) {
-		ALOGE("Failed to allocate GstBuffer with payload.");
+	if (size > RTP_TWOBYTES_HDR_EXT_MAX_SIZE) {
+		ALOGE("Twobyte extension payload too large: %u", size);
+		goto no_buf;
+	}
+
+	gint head = g_atomic_int_get(&sc->metadata_head);
+
+	// Every packet of a frame carries the same extension, only keep the
+	// first one so the recorded receive time is the frame's arrival.
+	if (head > 0 && sc->metadata_ring[(head - 1) % EM_METADATA_RING_SIZE].pts == GST_BUFFER_PTS(buffer)) {
 		goto no_buf;
 	}
 
+	struct em_metadata_slot *slot = &sc->metadata_ring[head % EM_METADATA_RING_SIZE];
+	slot->pts = GST_BUFFER_PTS(buffer);
+	slot->receive_time = frame_receive_time;
+	slot->size = size;
+	memcpy(slot->data, payload_ptr, size);
+
+	// Publish, the src probe never reads past the head.
+	g_atomic_int_set(&sc->metadata_head, head + 1);
+
 	gst_rtp_buffer_unmap(&rtp_buffer);
 	return GST_PAD_PROBE_OK;
 
@@ -448,14 +617,29 @@ rtpdepay_src_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 
 	EmStreamClient *sc = (EmStreamClient *)user_data;
 
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->metadata_preservation_mutex);
-
-	if (!sc->preserved_metadata_struct_buf) {
-		ALOGE("preserved_metadata_struct_buf is NULL");
+	gint head = g_atomic_int_get(&sc->metadata_head);
+	if (head == 0) {
+		ALOGE("No extension payload received yet");
 		return GST_PAD_PROBE_OK;
 	}
 
-	int64_t frame_receive_time = os_monotonic_get_ns();
+	// Find the payload extracted from the packets this frame was
+	// depayloaded from, the depayloader keeps the packet PTS.
+	struct em_metadata_slot *match = NULL;
+	for (gint i = head - 1; i >= head - EM_METADATA_RING_SIZE && i >= 0; i--) {
+		struct em_metadata_slot *slot = &sc->metadata_ring[i % EM_METADATA_RING_SIZE];
+		if (slot->pts == pts) {
+			match = slot;
+			break;
+		}
+	}
+
+	if (match == NULL) {
+		// Fall back to the newest payload, a slightly stale pose beats
+		// the no-down-message fallback path in the sample callback.
+		ALOGW("No extension payload matching PTS %" GST_TIME_FORMAT ", using newest", GST_TIME_ARGS(pts));
+		match = &sc->metadata_ring[(head - 1) % EM_METADATA_RING_SIZE];
+	}
 
 	GstBuffer *buffer = gst_pad_probe_info_get_buffer(info);
 
@@ -463,22 +647,26 @@ rtpdepay_src_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 	GstCustomMeta *custom_meta = gst_buffer_add_custom_meta(buffer, "down-message");
 	if (custom_meta == NULL) {
 		ALOGE("Failed to add GstCustomMeta");
-		gst_buffer_unref(sc->preserved_metadata_struct_buf);
-		sc->preserved_metadata_struct_buf = NULL;
+		return GST_PAD_PROBE_OK;
+	}
+
+	GstBuffer *protobuf_buf = gst_buffer_new_memdup(match->data, match->size);
+	if (protobuf_buf == NULL) {
+		ALOGE("Failed to allocate GstBuffer with payload.");
 		return GST_PAD_PROBE_OK;
 	}
 
 	GstStructure *custom_structure = gst_custom_meta_get_structure(custom_meta);
-	gst_structure_set(custom_structure, "protobuf", GST_TYPE_BUFFER, sc->preserved_metadata_struct_buf, NULL);
+	gst_structure_set(custom_structure, "protobuf", GST_TYPE_BUFFER, protobuf_buf, NULL);
 
-	// Set the frame receive time
+	// Set the frame receive time, recorded when the frame's first packet
+	// arrived rather than when the depayloader was done with it.
 	GValue frame_receive_time_value = G_VALUE_INIT;
 	g_value_init(&frame_receive_time_value, G_TYPE_INT64);
-	g_value_set_int64(&frame_receive_time_value, frame_receive_time);
+	g_value_set_int64(&frame_receive_time_value, match->receive_time);
 	gst_structure_set_value(custom_structure, "frame-receive-time", &frame_receive_time_value);
 
-	gst_buffer_unref(sc->preserved_metadata_struct_buf);
-	sc->preserved_metadata_struct_buf = NULL;
+	gst_buffer_unref(protobuf_buf);
 
 	return GST_PAD_PROBE_OK;
 }
@@ -486,7 +674,9 @@ rtpdepay_src_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 static void
 on_new_transceiver(GstElement *webrtc, GstWebRTCRTPTransceiver *trans)
 {
-	g_object_set(trans, "fec-type", GST_WEBRTC_FEC_TYPE_ULP_RED, NULL);
+	// Mirror the server's transceiver setup: ULPFEC/RED recovery plus
+	// NACK-driven retransmission, see connect_webrtc_to_tee() on the server.
+	g_object_set(trans, "fec-type", GST_WEBRTC_FEC_TYPE_ULP_RED, "do-nack", TRUE, NULL);
 }
 
 static GstPadProbeReturn
@@ -666,44 +856,10 @@ video_depay_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 	return GST_PAD_PROBE_OK;
 }
 
-gboolean
-print_jitterbuffter_stats(GstElement *jitterbuffer)
+static gboolean
+adjust_jitterbuffer_cb(EmStreamClient *sc)
 {
-	if (!jitterbuffer) {
-		return G_SOURCE_CONTINUE;
-	}
-
-	gchar *name = gst_object_get_name(GST_OBJECT(jitterbuffer));
-	ALOGI("The name of the element is: %s", name);
-	g_free(name);
-
-	gint percent;
-	g_object_get(G_OBJECT(jitterbuffer), "percent", &percent, NULL);
-	ALOGI("Jitterbuffer percent: %d", percent);
-
-	GstStructure *stats = NULL;
-	g_object_get(G_OBJECT(jitterbuffer), "stats", &stats, NULL);
-
-	if (stats) {
-		guint64 num_pushed, num_lost, avg_jitter;
-
-		// Extract values from the GstStructure
-		if (gst_structure_get_uint64(stats, "num-pushed", &num_pushed)) {
-			ALOGI("Number of buffers pushed: %" G_GUINT64_FORMAT, num_pushed);
-		}
-
-		if (gst_structure_get_uint64(stats, "num-lost", &num_lost)) {
-			ALOGI("Number of packets lost: %" G_GUINT64_FORMAT, num_lost);
-		}
-
-		if (gst_structure_get_uint64(stats, "avg-jitter", &avg_jitter)) {
-			ALOGI("Average jitter: %.2f ms", time_ns_to_ms_f(avg_jitter));
-		}
-
-		// Free the GstStructure
-		gst_structure_free(stats);
-	}
-
+	em_stream_client_adjust_jitterbuffer(sc);
 	return G_SOURCE_CONTINUE;
 }
 
@@ -717,8 +873,31 @@ new_jitterbuffer_callback(GstElement *rtpbin, GstElement *jitterbuffer, guint se
 	//	gst_clear_object(&srcpad);
 	//		g_object_set(jitterbuffer, "drop-on-latency", TRUE, NULL);
 	//	g_object_set(jitterbuffer, "mode", "none", NULL);
-	// FIXME: the returned id is leaked, but this is for test so we don't handle it for now
-	g_timeout_add_seconds(1, G_SOURCE_FUNC(print_jitterbuffter_stats), jitterbuffer);
+
+	// Only the video session's jitterbuffer drives latency adaptation.
+	if (session != 0) {
+		return;
+	}
+
+	gst_clear_object(&sc->video_jitterbuffer);
+	sc->video_jitterbuffer = gst_object_ref(jitterbuffer);
+	sc->jitter_prev_lost = 0;
+
+	g_object_set(jitterbuffer, "latency", sc->jitter_latency_ms, NULL);
+
+	// With WebRTC the server runs an rtprtxsend (do-nack), so actually ask
+	// for retransmissions. One retry within the buffer's own latency window:
+	// a repair that cannot arrive before we would play out anyway is not
+	// worth requesting on our latency budget.
+	if (sc->use_webrtc) {
+		g_object_set(jitterbuffer, "do-retransmission", TRUE, "rtx-max-retries", 1, "rtx-deadline",
+		             (gint)sc->jitter_latency_ms, NULL);
+	}
+
+	if (sc->jitter_timer_id == 0) {
+		sc->jitter_timer_id =
+		    g_timeout_add(EM_JITTER_ADJUST_INTERVAL_MS, G_SOURCE_FUNC(adjust_jitterbuffer_cb), sc);
+	}
 }
 
 static void
@@ -730,55 +909,92 @@ on_need_pipeline_cb(EmConnection *em_conn, gpointer user_data)
 
 	GError *error = NULL;
 
-#ifdef USE_WEBRTC
-	// clang-format off
-    gchar *pipeline_string = g_strdup_printf(
-            "webrtcbin name=webrtc bundle-policy=max-bundle latency=50 ! "
-            "rtph264depay name=depay ! "
-            "decodebin3 ! "
-            "glsinkbin name=glsink");
-	// clang-format on
-#else
-	gchar *pipeline_string = g_strdup_printf(
-	    "rtpbin name=rtpbin latency=80 "
+	// The decode chain has to match the codec the server announced over
+	// signaling, see em_connection_get_video_codec().
+	const char *encoding_name = "H264";
+	const char *depay = "rtph264depay";
+	const char *parse = "h264parse";
+	const char *amc_decoder = "amcviddec-c2qtiavcdecoder";
+	switch (em_connection_get_video_codec(em_conn)) {
+	case EM_VIDEO_CODEC_H265:
+		encoding_name = "H265";
+		depay = "rtph265depay";
+		parse = "h265parse";
+		amc_decoder = "amcviddec-c2qtihevcdecoder";
+		break;
+	case EM_VIDEO_CODEC_AV1:
+		encoding_name = "AV1";
+		depay = "rtpav1depay";
+		parse = "av1parse";
+		amc_decoder = "amcviddec-c2qtiav1decoder";
+		break;
+	case EM_VIDEO_CODEC_H264:
+	default: break;
+	}
+
+	sc->use_webrtc = em_connection_get_use_webrtc(em_conn);
+
+	gchar *pipeline_string = NULL;
+	if (em_connection_get_use_webrtc(em_conn)) {
+		// clang-format off
+		pipeline_string = g_strdup_printf(
+		    "webrtcbin name=webrtc bundle-policy=max-bundle latency=%u ! "
+		    "%s name=depay ! "
+		    "decodebin3 ! "
+		    "glsinkbin name=glsink",
+		    sc->jitter_latency_ms, depay);
+		// clang-format on
+	} else {
+		pipeline_string = g_strdup_printf(
+		    "rtpbin name=rtpbin latency=%u "
 #ifndef USE_MANUAL_NTP
-	    "ntp-sync=true "
+		    "ntp-sync=true "
 #endif
-	    // Video
-	    "udpsrc name=videoudpsrc port=5000 buffer-size=4000000 "
-	    "caps=\"application/x-rtp,media=video,payload=96,clock-rate=90000,encoding-name=H264\" ! "
-	    "rtpbin.recv_rtp_sink_0 "
-	    "udpsrc port=5001 ! rtpbin.recv_rtcp_sink_0 "
-	    "rtpbin.send_rtcp_src_0 ! udpsink host=" DEFAULT_SERVER_IP
-	    " port=5005 sync=false async=false "
-	    // Video
-	    "rtpbin. ! "
-	    "rtph264depay name=depay ! "
-	    "queue ! "
+		    // Video. The extmap entry tells our rtpsession the server tags
+		    // every packet with a transport-wide sequence number, which makes
+		    // it return TWCC feedback over the RTCP path below; the server's
+		    // congestion controller runs off that feedback.
+		    "udpsrc name=videoudpsrc port=5000 buffer-size=4000000 "
+		    "caps=\"application/x-rtp,media=video,payload=96,clock-rate=90000,encoding-name=%s,"
+		    "extmap-1=(string)\\\"http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\\\"\" ! "
+		    "rtpbin.recv_rtp_sink_0 "
+		    "udpsrc port=5001 ! rtpbin.recv_rtcp_sink_0 "
+		    "rtpbin.send_rtcp_src_0 ! udpsink host=" DEFAULT_SERVER_IP
+		    " port=5005 sync=false async=false "
+		    // Video
+		    "rtpbin. ! "
+		    "%s name=depay ! "
+		    "queue ! "
 #ifndef USE_DECODEBIN3
-	    "h264parse ! "
-	    "amcviddec-c2qtiavcdecoder ! "
-	    "video/x-raw(memory:GLMemory),format=(string)RGBA,texture-target=(string)external-oes ! "
+		    "%s ! "
+		    "%s ! "
+		    "video/x-raw(memory:GLMemory),format=(string)RGBA,texture-target=(string)external-oes ! "
 #else
-	    "decodebin3 ! "
+		    "decodebin3 ! "
 #endif
-	    "queue ! "
-	    "glsinkbin name=glsink " // Setting sync=false on sink here won't work, as the sink will be replaced later.
-	    // Audio
-	    "udpsrc name=audioudpsrc port=5002 buffer-size=4000000 "
-	    "caps=\"application/x-rtp,media=audio,payload=127,clock-rate=48000,encoding-name=OPUS\" ! "
-	    "rtpbin.recv_rtp_sink_1 "
-	    "udpsrc port=5003 ! rtpbin.recv_rtcp_sink_1 "
-	    "rtpbin.send_rtcp_src_1 ! udpsink host=" DEFAULT_SERVER_IP
-	    " port=5007 sync=false async=false "
-	    //  Audio
-	    "rtpbin. ! "
-	    "rtpopusdepay name=audiodepay ! "
-	    "queue ! "
-	    "opusdec ! "
-	    "queue ! "
-	    "openslessink name=audio-sink sync=true provide-clock=false buffer-time=20000 latency-time=20000 ");
+		    "queue ! "
+		    "glsinkbin name=glsink " // Setting sync=false on sink here won't work, as the sink will be replaced
+		                             // later.
+		    // Audio
+		    "udpsrc name=audioudpsrc port=5002 buffer-size=4000000 "
+		    "caps=\"application/x-rtp,media=audio,payload=127,clock-rate=48000,encoding-name=OPUS\" ! "
+		    "rtpbin.recv_rtp_sink_1 "
+		    "udpsrc port=5003 ! rtpbin.recv_rtcp_sink_1 "
+		    "rtpbin.send_rtcp_src_1 ! udpsink host=" DEFAULT_SERVER_IP
+		    " port=5007 sync=false async=false "
+		    //  Audio
+		    "rtpbin. ! "
+		    "rtpopusdepay name=audiodepay ! "
+		    "queue ! "
+		    "opusdec ! "
+		    "queue ! "
+		    "openslessink name=audio-sink sync=true provide-clock=false buffer-time=20000 latency-time=20000 ",
+#ifndef USE_DECODEBIN3
+		    sc->jitter_latency_ms, encoding_name, depay, parse, amc_decoder);
+#else
+		    sc->jitter_latency_ms, encoding_name, depay);
 #endif
+	}
 
 	sc->pipeline = gst_object_ref_sink(gst_parse_launch(pipeline_string, &error));
 	if (sc->pipeline == NULL) {
@@ -794,17 +1010,23 @@ on_need_pipeline_cb(EmConnection *em_conn, gpointer user_data)
 	gst_pipeline_use_clock(GST_PIPELINE(sc->pipeline), net_clock);
 #endif
 
-#ifdef USE_WEBRTC
-	GstElement *webrtcbin = gst_bin_get_by_name(GST_BIN(sc->pipeline), "webrtc");
-	g_signal_connect(webrtcbin, "on-new-transceiver", G_CALLBACK(on_new_transceiver), NULL);
-	gst_object_unref(webrtcbin);
-#else
-	GstElement *rtpbin = gst_bin_get_by_name(GST_BIN(sc->pipeline), "rtpbin");
-	if (rtpbin) {
-		g_signal_connect(rtpbin, "new-jitterbuffer", G_CALLBACK(new_jitterbuffer_callback), sc);
-		gst_object_unref(rtpbin);
+	if (em_connection_get_use_webrtc(em_conn)) {
+		GstElement *webrtcbin = gst_bin_get_by_name(GST_BIN(sc->pipeline), "webrtc");
+		g_signal_connect(webrtcbin, "on-new-transceiver", G_CALLBACK(on_new_transceiver), NULL);
+		// The actual jitterbuffers live in webrtcbin's internal rtpbin.
+		GstElement *rtpbin = gst_bin_get_by_name(GST_BIN(webrtcbin), "rtpbin");
+		if (rtpbin) {
+			g_signal_connect(rtpbin, "new-jitterbuffer", G_CALLBACK(new_jitterbuffer_callback), sc);
+			gst_object_unref(rtpbin);
+		}
+		gst_object_unref(webrtcbin);
+	} else {
+		GstElement *rtpbin = gst_bin_get_by_name(GST_BIN(sc->pipeline), "rtpbin");
+		if (rtpbin) {
+			g_signal_connect(rtpbin, "new-jitterbuffer", G_CALLBACK(new_jitterbuffer_callback), sc);
+			gst_object_unref(rtpbin);
+		}
 	}
-#endif
 
 	// We convert the string SINK_CAPS above into a GstCaps that elements below can understand.
 	// the "video/x-raw(" GST_CAPS_FEATURE_MEMORY_GL_MEMORY ")," part of the caps is read :
@@ -961,6 +1183,24 @@ em_stream_client_set_egl_context(EmStreamClient *sc, EmEglContext *egl_context)
 {
 	sc->egl_context = g_object_ref(egl_context);
 
+	// Resolve the fence entry points for the decode-to-render texture
+	// handoff. Both extensions are universal on the Android drivers we
+	// run on, but a miss just means the sync meta fallback stays in use.
+	const char *egl_extensions = eglQueryString(em_egl_context_get_display(egl_context), EGL_EXTENSIONS);
+	if (egl_extensions != NULL && strstr(egl_extensions, "EGL_KHR_fence_sync") != NULL &&
+	    strstr(egl_extensions, "EGL_KHR_wait_sync") != NULL) {
+		sc->egl_create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+		sc->egl_destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+		sc->egl_wait_sync = (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+	}
+	if (sc->egl_create_sync == NULL || sc->egl_destroy_sync == NULL || sc->egl_wait_sync == NULL) {
+		ALOGW("%s: No EGL fence sync, frame handoff will marshal through the GStreamer GL thread.",
+		      __FUNCTION__);
+		sc->egl_create_sync = NULL;
+		sc->egl_destroy_sync = NULL;
+		sc->egl_wait_sync = NULL;
+	}
+
 	if (!em_egl_context_make_current(sc->egl_context)) {
 		ALOGE("%s: Failed make egl context current", __FUNCTION__);
 		return;
@@ -1006,6 +1246,8 @@ em_stream_client_stop(EmStreamClient *sc)
 	if (sc->connection != NULL) {
 		em_connection_disconnect(sc->connection);
 	}
+	g_clear_handle_id(&sc->jitter_timer_id, g_source_remove);
+	gst_clear_object(&sc->video_jitterbuffer);
 	gst_clear_object(&sc->pipeline);
 	gst_clear_object(&sc->appsink);
 	gst_clear_object(&sc->gst_gl_gstreamer_context);
@@ -1081,6 +1323,30 @@ em_stream_client_get_average_frame_latency(EmStreamClient *sc)
 	return ave_latency;
 }
 
+uint32_t
+em_stream_client_get_dropped_frames(EmStreamClient *sc)
+{
+	return (uint32_t)g_atomic_int_get(&sc->dropped_frames);
+}
+
+int64_t
+em_stream_client_get_received_bytes(EmStreamClient *sc)
+{
+	return sc->received_bytes;
+}
+
+float
+em_stream_client_get_decode_interval_ms(EmStreamClient *sc)
+{
+	return sc->decode_interval_ewma_ms;
+}
+
+uint32_t
+em_stream_client_get_display_misses(EmStreamClient *sc)
+{
+	return (uint32_t)g_atomic_int_get(&sc->display_misses);
+}
+
 struct em_sample *
 em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode_end)
 {
@@ -1089,35 +1355,28 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
 		return NULL;
 	}
 
-	// We actually pull the sample in the new-sample signal handler,
-	// so here we're just receiving the sample already pulled.
-	GstSample *sample = NULL;
-	int64_t decode_end_time = 0;
-	{
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->sample_mutex);
-		sample = sc->sample;
-		sc->sample = NULL;
-		decode_end_time = sc->sample_decode_end_time;
-	}
-
-	if (sample == NULL) {
-		if (gst_app_sink_is_eos(GST_APP_SINK(sc->appsink))) {
-			ALOGW("%s: EOS", __FUNCTION__);
-			// TODO trigger teardown?
-		}
-		{
-			g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->skipped_frames_mutex);
-			sc->skipped_frames += 1;
-			//			ALOGW("pull_sample: The latest sample is NULL. Skipped %d frames.",
-			// sc->skipped_frames);
+	// We actually pull the sample in the new-sample signal handler, so here
+	// we just swap our slot for the shared one if a fresh frame is waiting.
+	gint latest;
+	do {
+		latest = g_atomic_int_get(&sc->frame_latest);
+		if ((latest & EM_FRAME_SLOT_FRESH) == 0) {
+			if (gst_app_sink_is_eos(GST_APP_SINK(sc->appsink))) {
+				ALOGW("%s: EOS", __FUNCTION__);
+				// TODO trigger teardown?
+			}
+			return NULL;
 		}
-		return NULL;
-	}
+	} while (!g_atomic_int_compare_and_exchange(&sc->frame_latest, latest, sc->frame_read_slot));
+	sc->frame_read_slot = latest & EM_FRAME_SLOT_MASK;
 
-	{
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&sc->skipped_frames_mutex);
-		sc->skipped_frames = 0;
-	}
+	struct em_frame_slot *slot = &sc->frame_slots[sc->frame_read_slot];
+	GstSample *sample = slot->sample;
+	slot->sample = NULL;
+	int64_t decode_end_time = slot->decode_end_time;
+	// The fence travels with the sample from here on.
+	EGLSyncKHR ready_fence = slot->ready_fence;
+	slot->ready_fence = EGL_NO_SYNC_KHR;
 
 	os_ns_to_timespec(decode_end_time, out_decode_end);
 
@@ -1210,6 +1469,7 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
 	}
 
 	ret->base.client_render_begin_time = os_monotonic_get_ns();
+	ret->base.jitter_buffer_latency = (int64_t)sc->jitter_latency_ms * GST_MSECOND;
 
 	GstVideoInfo info;
 	gst_video_info_from_caps(&info, caps);
@@ -1227,6 +1487,9 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
     }
 #endif
 
+	ret->base.frame_width = GST_VIDEO_INFO_WIDTH(&info);
+	ret->base.frame_height = GST_VIDEO_INFO_HEIGHT(&info);
+
 	GstVideoFrame frame;
 	GstMapFlags flags = (GstMapFlags)(GST_MAP_READ | GST_MAP_GL);
 	gst_video_frame_map(&frame, &info, buffer, flags);
@@ -1237,7 +1500,9 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
 		/* Get GStreamer's gl context. */
 		// TODO: check if this is not the same context we actually did set on the pipeline
 		gst_gl_query_local_gl_context(sc->appsink, GST_PAD_SINK, &sc->gst_gl_gstreamer_context);
+	}
 
+	if (sc->frame_texture_target == 0) {
 		/* Check if we have 2D or OES textures */
 		GstStructure *s = gst_caps_get_structure(caps, 0);
 		const gchar *texture_target_str = gst_structure_get_string(s, "texture-target");
@@ -1252,12 +1517,21 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
 	}
 	ret->base.frame_texture_target = sc->frame_texture_target;
 
-	GstGLSyncMeta *sync_meta = gst_buffer_get_gl_sync_meta(buffer);
-	if (sync_meta) {
-		/* MOSHI: the set_sync() seems to be needed for resizing */
-		gst_gl_sync_meta_set_sync_point(sync_meta, sc->gst_gl_gstreamer_context);
-		gst_gl_sync_meta_wait(sync_meta, sc->gst_gl_gstreamer_context);
+	if (ready_fence != EGL_NO_SYNC_KHR) {
+		// Queue a server-side wait behind the decoder's fence in the
+		// render context, which is permanently current on this thread.
+		// Unlike the sync meta path below this never marshals onto the
+		// GStreamer GL thread, so the two threads stay unserialized.
+		sc->egl_wait_sync(em_egl_context_get_display(sc->egl_context), ready_fence, 0);
+	} else {
+		GstGLSyncMeta *sync_meta = gst_buffer_get_gl_sync_meta(buffer);
+		if (sync_meta) {
+			/* MOSHI: the set_sync() seems to be needed for resizing */
+			gst_gl_sync_meta_set_sync_point(sync_meta, sc->gst_gl_gstreamer_context);
+			gst_gl_sync_meta_wait(sync_meta, sc->gst_gl_gstreamer_context);
+		}
 	}
+	ret->base.frame_ready_fence = ready_fence;
 
 	gst_video_frame_unmap(&frame);
 	// Move sample ownership into the return value
@@ -1271,6 +1545,9 @@ em_stream_client_release_sample(EmStreamClient *sc, struct em_sample *ems)
 {
 	struct em_sc_sample *impl = (struct em_sc_sample *)ems;
 	//	ALOGI("Releasing sample with texture ID %d", ems->frame_texture_id);
+	if (impl->base.frame_ready_fence != EGL_NO_SYNC_KHR) {
+		sc->egl_destroy_sync(em_egl_context_get_display(sc->egl_context), impl->base.frame_ready_fence);
+	}
 	gst_sample_unref(impl->sample);
 	free(impl);
 }
@@ -1279,18 +1556,89 @@ em_stream_client_release_sample(EmStreamClient *sc, struct em_sample *ems)
  * Helper functions
  */
 
+/*!
+ * Ask the server for an encoder intra refresh, so the picture recovers from
+ * loss without waiting for (or paying the size spike of) a full IDR frame.
+ */
+static void
+em_stream_client_request_refresh(EmStreamClient *sc, guint64 lost_packets)
+{
+	if (sc->connection == NULL) {
+		return;
+	}
+
+	em_proto_UpMessage msg = em_proto_UpMessage_init_default;
+	msg.has_refresh_request = true;
+	msg.refresh_request.lost_packets = (int64_t)lost_packets;
+
+	uint8_t buffer[32];
+	pb_ostream_t os = pb_ostream_from_buffer(buffer, sizeof(buffer));
+	if (!pb_encode(&os, &em_proto_UpMessage_msg, &msg)) {
+		ALOGE("Failed to encode refresh request!");
+		return;
+	}
+
+	GBytes *bytes = g_bytes_new(buffer, os.bytes_written);
+	em_connection_send_bytes(sc->connection, bytes);
+	g_bytes_unref(bytes);
+}
+
 void
 em_stream_client_adjust_jitterbuffer(EmStreamClient *sc)
 {
-	int target_jitter_latency = time_ns_to_ms_f(sc->average_latency) * 1.5f;
-	sc->max_jitter_latency = MAX(sc->max_jitter_latency - 10, target_jitter_latency);
+	if (sc->video_jitterbuffer == NULL) {
+		return;
+	}
 
-	//	GstElement *jitterbuffer = gst_bin_get_by_name(GST_BIN(sc->pipeline), "jitter");
-	//	if (jitterbuffer) {
-	//		g_object_set(jitterbuffer, "latency", sc->max_jitter_latency, NULL);
-	//		g_object_unref(jitterbuffer);
-	//		ALOGI("jitterbuffer latency changed to %d ms", sc->max_jitter_latency);
-	//	}
+	GstStructure *stats = NULL;
+	g_object_get(sc->video_jitterbuffer, "stats", &stats, NULL);
+	if (stats == NULL) {
+		return;
+	}
+
+	guint64 avg_jitter = 0;
+	guint64 num_lost = 0;
+	gst_structure_get_uint64(stats, "avg-jitter", &avg_jitter);
+	gst_structure_get_uint64(stats, "num-lost", &num_lost);
+	gst_structure_free(stats);
+
+	const guint64 lost_delta = num_lost - sc->jitter_prev_lost;
+	sc->jitter_prev_lost = num_lost;
+
+	// Enough headroom over the measured inter-arrival jitter that a normal
+	// excursion doesn't turn into a late (lost) packet.
+	guint target_ms = (guint)(time_ns_to_ms_f(avg_jitter) * EM_JITTER_LATENCY_HEADROOM + 0.5);
+	target_ms = CLAMP(target_ms, EM_JITTER_LATENCY_MIN_MS, EM_JITTER_LATENCY_MAX_MS);
+
+	guint latency_ms = sc->jitter_latency_ms;
+	if (lost_delta > 0) {
+		// Recover the picture with an intra refresh instead of waiting
+		// out the damage until the next periodic keyframe.
+		em_stream_client_request_refresh(sc, lost_delta);
+		// Losing packets: the buffer is clearly too shallow, grow quickly.
+		latency_ms = MIN(MAX(target_ms, latency_ms * 2), EM_JITTER_LATENCY_MAX_MS);
+	} else if (target_ms > latency_ms) {
+		latency_ms = target_ms;
+	} else {
+		// Clean network: creep down towards the target so a transient quiet
+		// period doesn't immediately cost us resilience.
+		latency_ms = MAX(latency_ms - EM_JITTER_SHRINK_STEP_MS, target_ms);
+	}
+
+	if (latency_ms == sc->jitter_latency_ms) {
+		return;
+	}
+
+	sc->jitter_latency_ms = latency_ms;
+	g_object_set(sc->video_jitterbuffer, "latency", latency_ms, NULL);
+	// The LATENCY message this posts makes gst_bus_cb() recalculate.
+
+	// The retransmission deadline tracks the buffer: it is pointless to wait
+	// for a repair beyond the point we would have played the packet out.
+	if (sc->use_webrtc) {
+		g_object_set(sc->video_jitterbuffer, "rtx-deadline", (gint)latency_ms, NULL);
+	}
 
-	// We'll do gst_bin_recalculate_latency() in gst_bus_cb()
+	ALOGI("Jitterbuffer latency adjusted to %u ms (avg jitter %.2f ms, lost %" G_GUINT64_FORMAT " this interval)",
+	      latency_ms, time_ns_to_ms_f(avg_jitter), lost_delta);
 }
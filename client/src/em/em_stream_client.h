@@ -61,6 +61,35 @@ em_stream_client_stop(EmStreamClient *sc);
 int64_t
 em_stream_client_get_average_frame_latency(EmStreamClient *sc);
 
+/*!
+ * Decoded frames that were overwritten before the render thread picked them
+ * up, total since stream start. For the stats HUD.
+ */
+uint32_t
+em_stream_client_get_dropped_frames(EmStreamClient *sc);
+
+/*!
+ * Total video RTP bytes received so far; sample twice and divide by the
+ * elapsed time to get bandwidth. For the stats HUD.
+ */
+int64_t
+em_stream_client_get_received_bytes(EmStreamClient *sc);
+
+/*!
+ * Smoothed interval between frames leaving the decoder, in milliseconds, or
+ * zero before enough frames arrived. Climbs when the decoder is thermally
+ * throttled. For the health report.
+ */
+float
+em_stream_client_get_decode_interval_ms(EmStreamClient *sc);
+
+/*!
+ * Decoded frames that arrived well over a display period late, total since
+ * stream start. For the health report.
+ */
+uint32_t
+em_stream_client_get_display_misses(EmStreamClient *sc);
+
 /*!
  * Attempt to retrieve a sample, if one has been decoded.
  *
@@ -78,6 +107,14 @@ em_stream_client_try_pull_sample(EmStreamClient *sc, struct timespec *out_decode
 void
 em_stream_client_release_sample(EmStreamClient *sc, struct em_sample *ems);
 
+/*!
+ * Run one step of the adaptive jitter buffer controller.
+ *
+ * Shrinks the video jitterbuffer latency towards single-digit milliseconds
+ * while the measured inter-arrival jitter is low, grows it on jitter or
+ * packet loss. Called periodically once the video jitterbuffer exists; the
+ * currently applied latency is exposed through @ref em_sample.
+ */
 void
 em_stream_client_adjust_jitterbuffer(EmStreamClient *sc);
 
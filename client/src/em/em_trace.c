@@ -0,0 +1,109 @@
+// Copyright 2023, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+
+/*!
+ * @file
+ * @brief  Per-frame trace events in the Perfetto/Chrome JSON format.
+ * @author Rylie Pavlik <rpavlik@collabora.com>
+ * @ingroup em_client
+ */
+#include "em_trace.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "em_app_log.h"
+
+/*
+ * Written as Chrome JSON trace events so the Perfetto UI opens the file
+ * directly and every event carries its frame_sequence_id as an argument.
+ * The stage timestamps come out of struct em_sample, which already holds
+ * the server-side stamps of each frame, so one client trace shows the
+ * whole server-to-display path of every frame.
+ */
+
+//! The pid all client events are filed under, the server writer uses 1.
+#define EM_TRACE_PID 2
+
+static GMutex trace_mutex;
+static FILE *trace_file = NULL;
+
+static const char *lane_names[] = {
+    [EM_TRACE_LANE_SERVER_RENDER] = "server render",
+    [EM_TRACE_LANE_NETWORK] = "encode + transmit",
+    [EM_TRACE_LANE_DECODE] = "decode",
+    [EM_TRACE_LANE_RENDER] = "client render",
+};
+
+static gpointer
+trace_open(gpointer unused)
+{
+	const char *path = g_getenv("EM_TRACE_JSON");
+	if (path == NULL) {
+		return NULL;
+	}
+
+	trace_file = fopen(path, "w");
+	if (trace_file == NULL) {
+		ALOGW("Failed to open trace file '%s', tracing disabled.", path);
+		return NULL;
+	}
+
+	ALOGI("Writing per-frame trace events to '%s'.", path);
+
+	// The JSON array format tolerates a missing closing bracket, so an
+	// aborted run still yields a loadable trace.
+	fprintf(trace_file, "[\n");
+	fprintf(trace_file,
+	        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+	        "\"args\":{\"name\":\"em-client\"}},\n",
+	        EM_TRACE_PID);
+	for (gsize i = 0; i < G_N_ELEMENTS(lane_names); i++) {
+		fprintf(trace_file,
+		        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%" G_GSIZE_FORMAT ","
+		        "\"args\":{\"name\":\"%s\"}},\n",
+		        EM_TRACE_PID, i, lane_names[i]);
+	}
+
+	return NULL;
+}
+
+bool
+em_trace_is_enabled(void)
+{
+	static GOnce once = G_ONCE_INIT;
+	g_once(&once, trace_open, NULL);
+	return trace_file != NULL;
+}
+
+void
+em_trace_slice(const char *name, enum em_trace_lane lane, int64_t frame_sequence_id, int64_t begin_ns, int64_t end_ns)
+{
+	if (!em_trace_is_enabled()) {
+		return;
+	}
+
+	g_mutex_lock(&trace_mutex);
+	fprintf(trace_file,
+	        "{\"name\":\"%s\",\"cat\":\"em\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+	        "\"pid\":%d,\"tid\":%d,\"args\":{\"frame_sequence_id\":%" PRId64 "}},\n",
+	        name, begin_ns / 1e3, (end_ns - begin_ns) / 1e3, EM_TRACE_PID, (int)lane, frame_sequence_id);
+	g_mutex_unlock(&trace_mutex);
+}
+
+void
+em_trace_instant(const char *name, enum em_trace_lane lane, int64_t frame_sequence_id, int64_t when_ns)
+{
+	if (!em_trace_is_enabled()) {
+		return;
+	}
+
+	g_mutex_lock(&trace_mutex);
+	fprintf(trace_file,
+	        "{\"name\":\"%s\",\"cat\":\"em\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+	        "\"pid\":%d,\"tid\":%d,\"args\":{\"frame_sequence_id\":%" PRId64 "}},\n",
+	        name, when_ns / 1e3, EM_TRACE_PID, (int)lane, frame_sequence_id);
+	g_mutex_unlock(&trace_mutex);
+}
@@ -0,0 +1,57 @@
+// Copyright 2023, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+
+/*!
+ * @file
+ * @brief  Per-frame trace events in the Perfetto/Chrome JSON format.
+ * @author Rylie Pavlik <rpavlik@collabora.com>
+ * @ingroup em_client
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Which track a trace event lands on in the viewer. One lane per frame
+ * stage, so overlapping work on consecutive frames stays readable.
+ */
+enum em_trace_lane
+{
+	EM_TRACE_LANE_SERVER_RENDER,
+	EM_TRACE_LANE_NETWORK,
+	EM_TRACE_LANE_DECODE,
+	EM_TRACE_LANE_RENDER,
+};
+
+/*!
+ * Whether tracing was enabled by setting EM_TRACE_JSON to an output path.
+ *
+ * Checked lazily on first call; use it to skip argument computation that is
+ * only needed for the trace.
+ */
+bool
+em_trace_is_enabled(void);
+
+/*!
+ * Write one complete slice, timestamps in ns.
+ *
+ * The frame id is attached as a "frame_sequence_id" argument so slices of
+ * the same frame can be found across lanes (and in the matching server
+ * trace). Thread-safe, cheap no-op while tracing is disabled.
+ */
+void
+em_trace_slice(const char *name, enum em_trace_lane lane, int64_t frame_sequence_id, int64_t begin_ns, int64_t end_ns);
+
+//! Write one instant event, same conventions as @ref em_trace_slice.
+void
+em_trace_instant(const char *name, enum em_trace_lane lane, int64_t frame_sequence_id, int64_t when_ns);
+
+#ifdef __cplusplus
+}
+#endif
@@ -136,6 +136,12 @@ em_egl_context_make_current(EmEglContext *self)
 	return true;
 }
 
+bool
+em_egl_context_is_current(EmEglContext *self)
+{
+	return eglGetCurrentContext() == self->context;
+}
+
 static void
 finalize(GObject *gobject)
 {
@@ -166,3 +172,9 @@ em_egl_context_get_context(EmEglContext *self)
 {
 	return self->context;
 }
+
+EGLDisplay
+em_egl_context_get_display(EmEglContext *self)
+{
+	return self->display;
+}
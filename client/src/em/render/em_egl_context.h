@@ -29,7 +29,16 @@ em_egl_context_get_graphics_binding(EmEglContext *self);
 bool
 em_egl_context_make_current(EmEglContext *self);
 
+/// Whether this context is already current on the calling thread. A cheap
+/// thread-local read, so callers can skip the driver-locking MakeCurrent on
+/// their per-frame path.
+bool
+em_egl_context_is_current(EmEglContext *self);
+
 EGLContext
 em_egl_context_get_context(EmEglContext *self);
 
-G_END_DECLS
\ No newline at end of file
+EGLDisplay
+em_egl_context_get_display(EmEglContext *self);
+
+G_END_DECLS
@@ -11,7 +11,9 @@
 
 #include "gl_swapchain.h"
 
+#include <EGL/egl.h>
 #include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
 #include <openxr/openxr.h>
 
 #include <cassert>
@@ -24,10 +26,21 @@ GLSwapchain::~GLSwapchain()
 }
 
 bool
-GLSwapchain::enumerateAndGenerateFramebuffers(XrSwapchain swapchain)
+GLSwapchain::enumerateAndGenerateFramebuffers(XrSwapchain swapchain, uint32_t arraySize)
 {
 	assert(swapchainImages_.empty());
 	assert(framebuffers_.empty());
+
+	PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC framebufferTextureMultiviewOVR = nullptr;
+	if (arraySize > 1) {
+		framebufferTextureMultiviewOVR = reinterpret_cast<PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC>(
+		    eglGetProcAddress("glFramebufferTextureMultiviewOVR"));
+		if (framebufferTextureMultiviewOVR == nullptr) {
+			ALOGE("%s: glFramebufferTextureMultiviewOVR not available", __FUNCTION__);
+			return false;
+		}
+	}
+
 	uint32_t countOutput = 0;
 	if (!XR_UNQUALIFIED_SUCCESS(xrEnumerateSwapchainImages(swapchain, 0, &countOutput, nullptr))) {
 		ALOGE("%s: Failed initial call to xrEnumerateSwapchainImages", __FUNCTION__);
@@ -68,8 +81,14 @@ GLSwapchain::enumerateAndGenerateFramebuffers(XrSwapchain swapchain)
 		// bind this name as the active framebuffer
 		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
 		// associate a swapchain image as the texture object/image for this framebuffer
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, swapchainImages_[i].image,
-		                       0);
+		if (arraySize > 1) {
+			framebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			                               swapchainImages_[i].image, 0, 0,
+			                               static_cast<GLsizei>(arraySize));
+		} else {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+			                       swapchainImages_[i].image, 0);
+		}
 
 		// check to make sure we can actually render to this.
 		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
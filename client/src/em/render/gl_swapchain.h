@@ -45,9 +45,12 @@ public:
 	// destructor calls reset
 	~GLSwapchain();
 
-	/// Enumerate the swapchain images and generate/associate framebuffer object names with each
+	/// Enumerate the swapchain images and generate/associate framebuffer object names with each.
+	/// With @p arraySize greater than 1 the images are attached with
+	/// glFramebufferTextureMultiviewOVR so a single pass renders all layers,
+	/// which requires GL_OVR_multiview2.
 	bool
-	enumerateAndGenerateFramebuffers(XrSwapchain swapchain);
+	enumerateAndGenerateFramebuffers(XrSwapchain swapchain, uint32_t arraySize = 1);
 
 	/// Get the number of images in the swapchain
 	uint32_t
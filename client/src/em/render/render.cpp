@@ -15,6 +15,7 @@
 #include <GLES3/gl3.h>
 #include <openxr/openxr.h>
 
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
@@ -50,6 +51,159 @@ static constexpr const GLchar *fragmentShaderSource = R"(#version 300 es
     }
 )";
 
+// Multiview vertex shader: both eyes in one pass, each view samples its half
+// of the side-by-side texture.
+static constexpr const GLchar *multiviewVertexShaderSource = R"(#version 300 es
+    #extension GL_OVR_multiview2 : require
+    layout(num_views = 2) in;
+    in vec3 position;
+    in vec2 uv;
+    out vec2 frag_uv;
+
+    void main() {
+        gl_Position = vec4(position, 1.0);
+        frag_uv = vec2(uv.x * 0.5 + 0.5 * float(gl_ViewID_OVR), uv.y);
+    }
+)";
+
+// Reprojection vertex shader: turn the quad corners into view rays spanning
+// the eye's frustum, interpolation keeps them linear in tangent space.
+static constexpr const GLchar *reprojVertexShaderSource = R"(#version 300 es
+    in vec3 position;
+    in vec2 uv;
+    uniform vec4 tanFov; // tan of the left, right, up, down fov angles
+    out vec3 ray;
+
+    void main() {
+        gl_Position = vec4(position, 1.0);
+        ray = vec3(mix(tanFov.x, tanFov.y, position.x * 0.5 + 0.5),
+                   mix(tanFov.w, tanFov.z, position.y * 0.5 + 0.5),
+                   -1.0);
+    }
+)";
+
+// Reprojection fragment shader: rotate the display ray into the space the
+// frame was rendered in and project it back through the same fov, sampling
+// this eye's half of the side-by-side texture. Rays leaving the source
+// frustum become black, like any timewarp border.
+static constexpr const GLchar *reprojFragmentShaderSource = R"(#version 300 es
+    #extension GL_OES_EGL_image_external_essl3 : require
+    precision highp float;
+
+    in vec3 ray;
+    out vec4 frag_color;
+    uniform samplerExternalOES textureSampler;
+    uniform mat3 warp;   // current head space -> render head space
+    uniform vec4 tanFov;
+    uniform vec4 uvRect; // this eye's window into the texture: offset.xy, scale.zw
+
+    void main() {
+        vec3 dir = warp * ray;
+        if (dir.z >= 0.0) {
+            frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+        vec2 t = dir.xy / -dir.z;
+        vec2 st = vec2((t.x - tanFov.x) / (tanFov.y - tanFov.x),
+                       (tanFov.z - t.y) / (tanFov.z - tanFov.w));
+        if (any(lessThan(st, vec2(0.0))) || any(greaterThan(st, vec2(1.0)))) {
+            frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+        frag_color = texture(textureSampler, uvRect.xy + st * uvRect.zw);
+    }
+)";
+
+// Multiview reprojection shaders: same warp as above but for both eyes in one
+// pass, indexing the per-eye uniforms with gl_ViewID_OVR (fragment-stage use
+// is what OVR_multiview2 adds over OVR_multiview).
+static constexpr const GLchar *multiviewReprojVertexShaderSource = R"(#version 300 es
+    #extension GL_OVR_multiview2 : require
+    layout(num_views = 2) in;
+    in vec3 position;
+    in vec2 uv;
+    uniform vec4 tanFov[2]; // tan of the left, right, up, down fov angles
+    out vec3 ray;
+
+    void main() {
+        gl_Position = vec4(position, 1.0);
+        vec4 fov = tanFov[gl_ViewID_OVR];
+        ray = vec3(mix(fov.x, fov.y, position.x * 0.5 + 0.5),
+                   mix(fov.w, fov.z, position.y * 0.5 + 0.5),
+                   -1.0);
+    }
+)";
+
+static constexpr const GLchar *multiviewReprojFragmentShaderSource = R"(#version 300 es
+    #extension GL_OVR_multiview2 : require
+    #extension GL_OES_EGL_image_external_essl3 : require
+    precision highp float;
+
+    in vec3 ray;
+    out vec4 frag_color;
+    uniform samplerExternalOES textureSampler;
+    uniform mat3 warp[2];   // current head space -> render head space
+    uniform vec4 tanFov[2];
+
+    void main() {
+        int v = int(gl_ViewID_OVR);
+        vec3 dir = warp[v] * ray;
+        if (dir.z >= 0.0) {
+            frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+        vec2 t = dir.xy / -dir.z;
+        vec4 fov = tanFov[v];
+        vec2 st = vec2((t.x - fov.x) / (fov.y - fov.x),
+                       (fov.z - t.y) / (fov.z - fov.w));
+        if (any(lessThan(st, vec2(0.0))) || any(greaterThan(st, vec2(1.0)))) {
+            frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+        frag_color = texture(textureSampler, vec2(0.5 * float(v), 0.0) + st * vec2(0.5, 1.0));
+    }
+)";
+
+// Stats HUD vertex shader: a unit quad stretched to a per-instance rect,
+// every bar of every graph is one instance of a single draw.
+static constexpr const GLchar *hudVertexShaderSource = R"(#version 300 es
+    in vec2 corner;  // unit quad corner, (0,0)..(1,1)
+    in vec4 rect;    // per instance: origin.xy, size.zw, in NDC
+    in vec4 color;   // per instance
+    out vec4 frag_tint;
+
+    void main() {
+        gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+        frag_tint = color;
+    }
+)";
+
+// Multiview variant, the HUD sits at the same place in both eyes.
+static constexpr const GLchar *multiviewHudVertexShaderSource = R"(#version 300 es
+    #extension GL_OVR_multiview2 : require
+    layout(num_views = 2) in;
+    in vec2 corner;
+    in vec4 rect;
+    in vec4 color;
+    out vec4 frag_tint;
+
+    void main() {
+        gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);
+        frag_tint = color;
+    }
+)";
+
+static constexpr const GLchar *hudFragmentShaderSource = R"(#version 300 es
+    precision mediump float;
+
+    in vec4 frag_tint;
+    out vec4 frag_color;
+
+    void main() {
+        frag_color = frag_tint;
+    }
+)";
+
 // Function to check shader compilation errors
 void
 checkShaderCompilation(GLuint shader)
@@ -76,23 +230,23 @@ checkProgramLinking(GLuint program)
 	}
 }
 
-void
-Renderer::setupShaders()
+static GLuint
+buildProgram(const GLchar *vertexSource, const GLchar *fragmentSource)
 {
 	// Compile the vertex shader
 	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+	glShaderSource(vertexShader, 1, &vertexSource, NULL);
 	glCompileShader(vertexShader);
 	checkShaderCompilation(vertexShader);
 
 	// Compile the fragment shader
 	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
 	glCompileShader(fragmentShader);
 	checkShaderCompilation(fragmentShader);
 
 	// Create and link the shader program
-	program = glCreateProgram();
+	GLuint program = glCreateProgram();
 	glAttachShader(program, vertexShader);
 	glAttachShader(program, fragmentShader);
 	glLinkProgram(program);
@@ -102,7 +256,26 @@ Renderer::setupShaders()
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 
+	return program;
+}
+
+void
+Renderer::setupShaders()
+{
+	if (multiview_) {
+		program = buildProgram(multiviewVertexShaderSource, fragmentShaderSource);
+		reprojProgram = buildProgram(multiviewReprojVertexShaderSource, multiviewReprojFragmentShaderSource);
+	} else {
+		program = buildProgram(vertexShaderSource, fragmentShaderSource);
+		reprojProgram = buildProgram(reprojVertexShaderSource, reprojFragmentShaderSource);
+	}
+
 	textureSamplerLocation_ = glGetUniformLocation(program, "textureSampler");
+
+	reprojTextureSamplerLocation_ = glGetUniformLocation(reprojProgram, "textureSampler");
+	reprojWarpLocation_ = glGetUniformLocation(reprojProgram, "warp");
+	reprojTanFovLocation_ = glGetUniformLocation(reprojProgram, "tanFov");
+	reprojUvRectLocation_ = glGetUniformLocation(reprojProgram, "uvRect");
 }
 
 struct TextureCoord
@@ -154,7 +327,7 @@ Renderer::~Renderer()
 }
 
 void
-Renderer::setupRender()
+Renderer::setupRender(bool useMultiview)
 {
 #ifndef NDEBUG
 	ALOGI("Using GL debug callback");
@@ -162,8 +335,11 @@ Renderer::setupRender()
 #else
 	ALOGI("Not using GL debug callback");
 #endif
+	multiview_ = useMultiview;
 	setupShaders();
 	setupQuadVertexData();
+	setupHud();
+	glGenFramebuffers(1, &blitFramebuffer_);
 }
 
 void
@@ -173,6 +349,10 @@ Renderer::reset()
 		glDeleteProgram(program);
 		program = 0;
 	}
+	if (reprojProgram != 0) {
+		glDeleteProgram(reprojProgram);
+		reprojProgram = 0;
+	}
 	if (quadVAO != 0) {
 		glDeleteVertexArrays(1, &quadVAO);
 		quadVAO = 0;
@@ -181,6 +361,26 @@ Renderer::reset()
 		glDeleteBuffers(1, &quadVBO);
 		quadVBO = 0;
 	}
+	if (blitFramebuffer_ != 0) {
+		glDeleteFramebuffers(1, &blitFramebuffer_);
+		blitFramebuffer_ = 0;
+	}
+	if (hudProgram_ != 0) {
+		glDeleteProgram(hudProgram_);
+		hudProgram_ = 0;
+	}
+	if (hudVAO_ != 0) {
+		glDeleteVertexArrays(1, &hudVAO_);
+		hudVAO_ = 0;
+	}
+	if (hudCornerVBO_ != 0) {
+		glDeleteBuffers(1, &hudCornerVBO_);
+		hudCornerVBO_ = 0;
+	}
+	if (hudInstanceVBO_ != 0) {
+		glDeleteBuffers(1, &hudInstanceVBO_);
+		hudInstanceVBO_ = 0;
+	}
 }
 
 void
@@ -207,3 +407,277 @@ Renderer::draw(GLuint texture, GLenum texture_target) const
 
 	CHECK_GL_ERROR();
 }
+
+bool
+Renderer::blitFrame(GLuint texture,
+                    GLenum texture_target,
+                    int32_t srcWidth,
+                    int32_t srcHeight,
+                    int32_t dstWidth,
+                    int32_t dstHeight) const
+{
+	// External OES textures (the normal MediaCodec output) are not
+	// framebuffer-attachable, and an array framebuffer cannot take a
+	// side-by-side 2D blit.
+	if (texture_target != GL_TEXTURE_2D || multiview_ || blitFramebuffer_ == 0) {
+		return false;
+	}
+
+	CHECK_GL_ERROR();
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, blitFramebuffer_);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		return false;
+	}
+
+	glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	CHECK_GL_ERROR();
+	return true;
+}
+
+static XrQuaternionf
+quatConjugate(const XrQuaternionf &q)
+{
+	return {-q.x, -q.y, -q.z, q.w};
+}
+
+static XrQuaternionf
+quatMultiply(const XrQuaternionf &a, const XrQuaternionf &b)
+{
+	return {
+	    a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+	    a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+	    a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+	    a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+	};
+}
+
+/// Column-major, as glUniformMatrix3fv wants it.
+static void
+quatToMat3(const XrQuaternionf &q, GLfloat out[9])
+{
+	const float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	const float s = len > 0.0f ? 1.0f / len : 1.0f;
+	const float x = q.x * s;
+	const float y = q.y * s;
+	const float z = q.z * s;
+	const float w = q.w * s;
+
+	out[0] = 1.0f - 2.0f * (y * y + z * z);
+	out[1] = 2.0f * (x * y + w * z);
+	out[2] = 2.0f * (x * z - w * y);
+
+	out[3] = 2.0f * (x * y - w * z);
+	out[4] = 1.0f - 2.0f * (x * x + z * z);
+	out[5] = 2.0f * (y * z + w * x);
+
+	out[6] = 2.0f * (x * z + w * y);
+	out[7] = 2.0f * (y * z - w * x);
+	out[8] = 1.0f - 2.0f * (x * x + y * y);
+}
+
+void
+Renderer::drawReprojected(GLuint texture,
+                          GLenum texture_target,
+                          const XrPosef *renderPoses,
+                          const XrView *views,
+                          int32_t eyeWidth,
+                          int32_t eyeHeight) const
+{
+	CHECK_GL_ERROR();
+
+	glUseProgram(reprojProgram);
+	CHECK_GL_ERROR();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(texture_target, texture);
+	glUniform1i(reprojTextureSamplerLocation_, 0);
+	CHECK_GL_ERROR();
+
+	glBindVertexArray(quadVAO);
+
+	GLfloat tanFovs[8];
+	GLfloat warps[18];
+	for (int eye = 0; eye < 2; eye++) {
+		const XrFovf &fov = views[eye].fov;
+		tanFovs[eye * 4 + 0] = std::tan(fov.angleLeft);
+		tanFovs[eye * 4 + 1] = std::tan(fov.angleRight);
+		tanFovs[eye * 4 + 2] = std::tan(fov.angleUp);
+		tanFovs[eye * 4 + 3] = std::tan(fov.angleDown);
+
+		// Rotation taking a direction in the current predicted head
+		// space into the space the server rendered the frame in.
+		XrQuaternionf delta = quatMultiply(quatConjugate(renderPoses[eye].orientation), //
+		                                   views[eye].pose.orientation);
+		quatToMat3(delta, warps + eye * 9);
+	}
+
+	if (multiview_) {
+		// Single pass into both layers of the array framebuffer.
+		glUniform4fv(reprojTanFovLocation_, 2, tanFovs);
+		glUniformMatrix3fv(reprojWarpLocation_, 2, GL_FALSE, warps);
+
+		glViewport(0, 0, eyeWidth, eyeHeight);
+		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	} else {
+		for (int eye = 0; eye < 2; eye++) {
+			glUniform4fv(reprojTanFovLocation_, 1, tanFovs + eye * 4);
+			glUniform4f(reprojUvRectLocation_, eye * 0.5f, 0.0f, 0.5f, 1.0f);
+			glUniformMatrix3fv(reprojWarpLocation_, 1, GL_FALSE, warps + eye * 9);
+
+			glViewport(eye * eyeWidth, 0, eyeWidth, eyeHeight);
+			glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+		}
+	}
+
+	glBindVertexArray(0);
+
+	CHECK_GL_ERROR();
+}
+
+//! Full-scale value and color of one HUD graph.
+struct HudGraphStyle
+{
+	float scale;
+	float r;
+	float g;
+	float b;
+};
+
+//! In HudSample field order.
+static constexpr HudGraphStyle kHudGraphStyles[] = {
+    {33.3f, 0.3f, 0.9f, 0.3f},  // decode time in ms, green
+    {100.0f, 0.3f, 0.6f, 1.0f}, // network latency in ms, blue
+    {100.0f, 1.0f, 0.9f, 0.2f}, // jitter buffer depth in ms, yellow
+    {100.0f, 0.2f, 0.9f, 0.9f}, // bitrate in Mbps, cyan
+    {5.0f, 0.9f, 0.3f, 0.9f},   // dropped frames, magenta
+};
+
+void
+Renderer::setupHud()
+{
+	hudProgram_ = buildProgram(multiview_ ? multiviewHudVertexShaderSource : hudVertexShaderSource,
+	                           hudFragmentShaderSource);
+
+	const GLuint cornerLocation = glGetAttribLocation(hudProgram_, "corner");
+	const GLuint rectLocation = glGetAttribLocation(hudProgram_, "rect");
+	const GLuint colorLocation = glGetAttribLocation(hudProgram_, "color");
+
+	static constexpr GLfloat corners[] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f};
+
+	glGenVertexArrays(1, &hudVAO_);
+	glGenBuffers(1, &hudCornerVBO_);
+	glGenBuffers(1, &hudInstanceVBO_);
+
+	glBindVertexArray(hudVAO_);
+
+	glBindBuffer(GL_ARRAY_BUFFER, hudCornerVBO_);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(cornerLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid *)0);
+	glEnableVertexAttribArray(cornerLocation);
+
+	// The instance buffer is streamed in drawHud, only lay out the
+	// attributes here: 8 floats per instance, rect then color.
+	glBindBuffer(GL_ARRAY_BUFFER, hudInstanceVBO_);
+	glVertexAttribPointer(rectLocation, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)0);
+	glEnableVertexAttribArray(rectLocation);
+	glVertexAttribDivisor(rectLocation, 1);
+	glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat),
+	                      (GLvoid *)(4 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(colorLocation);
+	glVertexAttribDivisor(colorLocation, 1);
+
+	glBindVertexArray(0);
+}
+
+void
+Renderer::pushHudSample(const HudSample &sample)
+{
+	static_assert(sizeof(kHudGraphStyles) / sizeof(kHudGraphStyles[0]) == kHudGraphCount,
+	              "one style per HudSample field");
+
+	const float values[kHudGraphCount] = {
+	    sample.decode_ms, sample.network_ms, sample.jitter_ms, sample.bitrate_mbps, sample.dropped_frames,
+	};
+	for (int i = 0; i < kHudGraphCount; i++) {
+		hudHistory_[i][hudCursor_] = values[i];
+	}
+	hudCursor_ = (hudCursor_ + 1) % kHudHistory;
+}
+
+void
+Renderer::drawHud(int32_t eyeWidth, int32_t eyeHeight)
+{
+	CHECK_GL_ERROR();
+
+	// Layout: graphs stacked in the lower left of each eye, decode time on
+	// top. All values in NDC.
+	constexpr float kLeft = -0.9f;
+	constexpr float kWidth = 0.55f;
+	constexpr float kBottom = -0.85f;
+	constexpr float kGraphHeight = 0.10f;
+	constexpr float kGraphGap = 0.04f;
+	constexpr float kBarWidth = kWidth / kHudHistory;
+
+	hudInstances_.clear();
+
+	auto pushInstance = [this](float x, float y, float w, float h, float r, float g, float b, float a) {
+		hudInstances_.insert(hudInstances_.end(), {x, y, w, h, r, g, b, a});
+	};
+
+	for (int graph = 0; graph < kHudGraphCount; graph++) {
+		const HudGraphStyle &style = kHudGraphStyles[graph];
+		const float y0 = kBottom + (kGraphHeight + kGraphGap) * (kHudGraphCount - 1 - graph);
+
+		// Translucent backdrop so the graph reads over any scene.
+		pushInstance(kLeft, y0, kWidth, kGraphHeight, 0.0f, 0.0f, 0.0f, 0.5f);
+
+		for (int i = 0; i < kHudHistory; i++) {
+			// Oldest bar (the cursor) leftmost, newest rightmost.
+			const float value = hudHistory_[graph][(hudCursor_ + i) % kHudHistory];
+			float v = value / style.scale;
+			const bool clipped = v > 1.0f;
+			if (clipped) {
+				v = 1.0f;
+			}
+			if (v <= 0.0f) {
+				continue;
+			}
+			// Off-scale bars turn red instead of clamping silently.
+			pushInstance(kLeft + kBarWidth * i, y0, kBarWidth * 0.8f, kGraphHeight * v,
+			             clipped ? 1.0f : style.r, clipped ? 0.2f : style.g, clipped ? 0.2f : style.b,
+			             0.9f);
+		}
+	}
+
+	const GLsizei instanceCount = (GLsizei)(hudInstances_.size() / 8);
+
+	glUseProgram(hudProgram_);
+	glBindVertexArray(hudVAO_);
+	glBindBuffer(GL_ARRAY_BUFFER, hudInstanceVBO_);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(hudInstances_.size() * sizeof(float)), hudInstances_.data(),
+	             GL_STREAM_DRAW);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	if (multiview_) {
+		// Single pass puts the HUD in both layers at the same spot.
+		glViewport(0, 0, eyeWidth, eyeHeight);
+		glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, instanceCount);
+	} else {
+		for (int eye = 0; eye < 2; eye++) {
+			glViewport(eye * eyeWidth, 0, eyeWidth, eyeHeight);
+			glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, instanceCount);
+		}
+	}
+
+	glDisable(GL_BLEND);
+	glBindVertexArray(0);
+
+	CHECK_GL_ERROR();
+}
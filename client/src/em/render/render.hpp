@@ -13,8 +13,10 @@
 
 #include <EGL/egl.h>
 #include <GLES3/gl3.h>
+#include <openxr/openxr.h>
 
 #include <memory>
+#include <vector>
 
 class Renderer
 {
@@ -30,9 +32,12 @@ public:
 	Renderer &
 	operator=(Renderer &&) = delete;
 
-	/// Create resources. Must call with EGL Context current
+	/// Create resources. Must call with EGL Context current.
+	/// With @p useMultiview the shaders render both eyes in a single pass
+	/// into an array framebuffer (GL_OVR_multiview2), otherwise they draw
+	/// side by side.
 	void
-	setupRender();
+	setupRender(bool useMultiview = false);
 
 	/// Destroy resources. Must call with EGL context current.
 	void
@@ -42,15 +47,86 @@ public:
 	void
 	draw(GLuint texture, GLenum texture_target) const;
 
+	/// Copy the decoded frame into the currently bound draw framebuffer with
+	/// the blit engine instead of a full-screen sampling pass, for frames
+	/// that need no reprojection. Only possible when the decoder handed us a
+	/// framebuffer-attachable GL_TEXTURE_2D (external OES textures, i.e.
+	/// direct MediaCodec/dmabuf imports, cannot be attached) and we are not
+	/// rendering into an array framebuffer. Returns false when the frame
+	/// cannot be blitted and the caller should fall back to draw().
+	bool
+	blitFrame(GLuint texture, GLenum texture_target, int32_t srcWidth, int32_t srcHeight, int32_t dstWidth, int32_t dstHeight) const;
+
+	/// Draw the side-by-side texture to the framebuffer, rotationally
+	/// reprojecting each eye from @p renderPoses (the poses the frame was
+	/// rendered with on the server) to the freshly located @p views.
+	/// Translation is ignored, as is usual for timewarp. Sets its own
+	/// per-eye viewports. Must call with EGL Context current.
+	void
+	drawReprojected(GLuint texture,
+	                GLenum texture_target,
+	                const XrPosef *renderPoses,
+	                const XrView *views,
+	                int32_t eyeWidth,
+	                int32_t eyeHeight) const;
+
+	/// One rendered frame's worth of stats HUD datapoints, see pushHudSample.
+	struct HudSample
+	{
+		float decode_ms;
+		float network_ms;
+		float jitter_ms;
+		float bitrate_mbps;
+		float dropped_frames;
+	};
+
+	/// Append one frame's datapoints to the HUD history ring.
+	void
+	pushHudSample(const HudSample &sample);
+
+	/// Draw the stats HUD over the current framebuffer: one bar graph per
+	/// metric in pushHudSample, all bars of all graphs in a single
+	/// instanced draw per eye. Sets its own per-eye viewports like
+	/// drawReprojected. Must call with EGL Context current.
+	void
+	drawHud(int32_t eyeWidth, int32_t eyeHeight);
+
 private:
 	void
 	setupShaders();
 	void
 	setupQuadVertexData();
+	void
+	setupHud();
+
+	//! Frames of history each HUD graph keeps, one bar per frame.
+	static constexpr int kHudHistory = 96;
+	//! Graphs drawn, must match the fields of HudSample.
+	static constexpr int kHudGraphCount = 5;
+
+	bool multiview_ = false;
 
 	GLuint program = 0;
+	GLuint reprojProgram = 0;
 	GLuint quadVAO = 0;
 	GLuint quadVBO = 0;
+	GLuint blitFramebuffer_ = 0;
 
 	GLint textureSamplerLocation_ = 0;
+	GLint reprojTextureSamplerLocation_ = 0;
+	GLint reprojWarpLocation_ = 0;
+	GLint reprojTanFovLocation_ = 0;
+	GLint reprojUvRectLocation_ = 0;
+
+	GLuint hudProgram_ = 0;
+	GLuint hudVAO_ = 0;
+	GLuint hudCornerVBO_ = 0;
+	GLuint hudInstanceVBO_ = 0;
+
+	//! Per-metric history ring, values in each metric's own unit.
+	float hudHistory_[kHudGraphCount][kHudHistory] = {};
+	//! Next slot of the ring to write, the oldest datapoint.
+	int hudCursor_ = 0;
+	//! Staging buffer for per-instance data, kept to avoid reallocation.
+	std::vector<float> hudInstances_;
 };
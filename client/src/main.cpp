@@ -26,6 +26,8 @@
 #include <unistd.h>
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
@@ -54,7 +56,8 @@ struct em_state
 	XrInstance instance;
 	XrSystemId system;
 	XrSession session;
-	XrSessionState sessionState;
+	//! Written by the main thread's event pump, read by the render thread.
+	std::atomic<XrSessionState> sessionState;
 
 	uint32_t width;
 	uint32_t height;
@@ -64,6 +67,12 @@ struct em_state
 	InputState input;
 
 	bool window_initialized;
+
+	//! Keeps the render thread looping, cleared on shutdown.
+	std::atomic<bool> render_thread_running;
+	//! Set around each frame cycle, so the event pump can park the render
+	//! thread before calling xrEndSession.
+	std::atomic<bool> render_in_frame;
 };
 
 em_state _state = {};
@@ -275,9 +284,12 @@ initialize_actions(struct em_state &state)
 /**
  * Poll for Android and OpenXR events, and handle them
  *
+ * Runs on the main thread; the render thread paces itself on xrWaitFrame
+ * independently, so a slow callback here no longer delays frame submission.
+ *
  * @param state app state
  *
- * @return true if we should go to the render code
+ * @return true if the session is ready and actions were synced
  */
 bool
 poll_events(struct android_app *app, struct em_state &state)
@@ -313,6 +325,10 @@ poll_events(struct android_app *app, struct em_state &state)
 		if (buffer.type == XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED) {
 			XrEventDataSessionStateChanged *event = (XrEventDataSessionStateChanged *)&buffer;
 
+			// Publish the new state before acting on it, the render
+			// thread gates its frame cycle on it.
+			state.sessionState = event->state;
+
 			switch (event->state) {
 			case XR_SESSION_STATE_IDLE: ALOGI("OpenXR session is now IDLE"); break;
 			case XR_SESSION_STATE_READY: {
@@ -332,14 +348,17 @@ poll_events(struct android_app *app, struct em_state &state)
 			case XR_SESSION_STATE_FOCUSED: ALOGI("OpenXR session is now FOCUSED"); break;
 			case XR_SESSION_STATE_STOPPING:
 				ALOGI("OpenXR session is now STOPPING");
+				// Wait out a frame cycle that was already past the
+				// state check, xrEndSession must not race xrEndFrame.
+				while (state.render_in_frame) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
 				xrEndSession(state.session);
 				break;
 			case XR_SESSION_STATE_LOSS_PENDING: ALOGI("OpenXR session is now LOSS_PENDING"); break;
 			case XR_SESSION_STATE_EXITING: ALOGI("OpenXR session is now EXITING"); break;
 			default: break;
 			}
-
-			state.sessionState = event->state;
 		}
 
 		buffer.type = XR_TYPE_EVENT_DATA_BUFFER;
@@ -391,6 +410,37 @@ poll_events(struct android_app *app, struct em_state &state)
 	return true;
 }
 
+/**
+ * Body of the dedicated render thread: runs the xrWaitFrame -> render ->
+ * xrEndFrame cycle at display rate, decoupled from the main thread's Android
+ * and OpenXR event pump and from the stream client's GLib mainloop thread.
+ * The EGL context is only ever made current from here (and the decode thread,
+ * guarded inside the stream client).
+ */
+void
+render_thread_func(EmRemoteExperience *remote_experience)
+{
+	ALOGI("Render thread running");
+
+	while (_state.render_thread_running) {
+		// Publish that a frame cycle may be in flight before re-checking
+		// the session state, see the STOPPING handling in poll_events.
+		_state.render_in_frame = true;
+
+		const XrSessionState sessionState = _state.sessionState;
+		if (sessionState >= XR_SESSION_STATE_READY && sessionState < XR_SESSION_STATE_STOPPING) {
+			// Paced by xrWaitFrame inside.
+			em_remote_experience_poll_and_render_frame(remote_experience, _state.input);
+			_state.render_in_frame = false;
+		} else {
+			_state.render_in_frame = false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+
+	ALOGI("Render thread exiting");
+}
+
 void
 connected_cb(EmConnection *connection, struct em_state *state)
 {
@@ -582,15 +632,27 @@ android_main(struct android_app *app)
 	// End of remote-rendering-specific setup, into main loop
 	//
 
-	ALOGI("Starting main rendering loop");
+	ALOGI("Starting render thread and event loop");
+
+	_state.render_thread_running = true;
+	std::thread render_thread(render_thread_func, remote_experience);
 
 	while (!app->destroyRequested) {
 		if (poll_events(app, _state)) {
-			em_remote_experience_poll_and_render_frame(remote_experience, _state.input);
+			// Actions were just synced: push any input edge to the
+			// server immediately on its fast path, rather than
+			// waiting for the tracking thread's next tick.
+			em_remote_experience_report_input(remote_experience, _state.input);
+			// Nothing to do beyond pumping events and syncing actions;
+			// pace this loop so it does not spin while resumed.
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
 		}
 	}
 
-	ALOGI("Exited main loop, cleaning up");
+	ALOGI("Exited event loop, cleaning up");
+
+	_state.render_thread_running = false;
+	render_thread.join();
 
 	//
 	// Clean up RR structures
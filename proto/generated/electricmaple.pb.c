@@ -45,6 +45,15 @@ PB_BIND(em_proto_TouchControllerRight, em_proto_TouchControllerRight, AUTO)
 PB_BIND(em_proto_UpFrameMessage, em_proto_UpFrameMessage, AUTO)
 
 
+PB_BIND(em_proto_UpRefreshRequestMessage, em_proto_UpRefreshRequestMessage, AUTO)
+
+
+PB_BIND(em_proto_UpInputMessage, em_proto_UpInputMessage, AUTO)
+
+
+PB_BIND(em_proto_UpHealthMessage, em_proto_UpHealthMessage, AUTO)
+
+
 PB_BIND(em_proto_UpMessage, em_proto_UpMessage, 2)
 
 
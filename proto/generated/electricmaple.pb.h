@@ -73,6 +73,16 @@ typedef struct _em_proto_TrackingMessage {
     /* GRAB is different from GRIP */
     float controller_grab_value_left;
     float controller_grab_value_right;
+    /* When true, hand_joint_locations_* only carry the joints that moved
+ since the last full update; the receiver keeps its previous values
+ for the rest. */
+    bool hand_joints_sparse;
+    /* Per-eye gaze point in that eye's half of the stream texture,
+ normalized to [0,1] with the origin at the top left. Only sent by
+ clients with eye tracking; the server centers its encoding region
+ of interest here instead of on the lens axis. */
+    pb_size_t gaze_points_count;
+    em_proto_Vec2 gaze_points[2];
 } em_proto_TrackingMessage;
 
 typedef struct _em_proto_InputThumbstick {
@@ -132,12 +142,46 @@ typedef struct _em_proto_UpFrameMessage {
     int64_t average_latency;
 } em_proto_UpFrameMessage;
 
+/* Sent after detected loss: asks the encoder for an intra refresh so the
+ picture recovers without a full-size IDR frame. */
+typedef struct _em_proto_UpRefreshRequestMessage {
+    int64_t lost_packets;
+} em_proto_UpRefreshRequestMessage;
+
+/* Compact controller input state, sent on its own the moment a value
+ changes so button and trigger edges skip the bulky tracking path on
+ both ends. The same values still ride along in TrackingMessage. */
+typedef struct _em_proto_UpInputMessage {
+    float grab_value_left;
+    float grab_value_right;
+    int64_t sequence_idx;
+} em_proto_UpInputMessage;
+
+/* Periodic device health report: tells the server when the headset itself,
+ not the network, is the bottleneck, so the encode ladder can step down
+ before thermal throttling turns into visible stutter. */
+typedef struct _em_proto_UpHealthMessage {
+    /* Android PowerManager THERMAL_STATUS_* value, 0 when none or unknown. */
+    int32_t thermal_status;
+    /* Smoothed interval between frames leaving the decoder, milliseconds. */
+    float decode_interval_ms;
+    /* Decoded frames that missed at least one display period since the
+ previous report. */
+    int32_t display_misses;
+} em_proto_UpHealthMessage;
+
 typedef struct _em_proto_UpMessage {
     int64_t id;
     bool has_tracking;
     em_proto_TrackingMessage tracking;
     bool has_frame;
     em_proto_UpFrameMessage frame;
+    bool has_refresh_request;
+    em_proto_UpRefreshRequestMessage refresh_request;
+    bool has_input;
+    em_proto_UpInputMessage input;
+    bool has_health;
+    em_proto_UpHealthMessage health;
 } em_proto_UpMessage;
 
 typedef struct _em_proto_DownFrameDataMessage {
@@ -188,7 +232,7 @@ extern "C" {
 #define em_proto_Vec2_init_default               {0, 0}
 #define em_proto_Pose_init_default               {false, em_proto_Vec3_init_default, false, em_proto_Quaternion_init_default}
 #define em_proto_HandJointLocation_init_default  {0, false, em_proto_Pose_init_default, 0}
-#define em_proto_TrackingMessage_init_default    {false, em_proto_Pose_init_default, false, em_proto_Vec3_init_default, false, em_proto_Vec3_init_default, 0, {em_proto_Pose_init_default, em_proto_Pose_init_default}, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, 0, 0, {{NULL}, NULL}, {{NULL}, NULL}, 0, 0}
+#define em_proto_TrackingMessage_init_default    {false, em_proto_Pose_init_default, false, em_proto_Vec3_init_default, false, em_proto_Vec3_init_default, 0, {em_proto_Pose_init_default, em_proto_Pose_init_default}, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, false, em_proto_Pose_init_default, 0, 0, {{NULL}, NULL}, {{NULL}, NULL}, 0, 0, 0, 0, {em_proto_Vec2_init_default, em_proto_Vec2_init_default}}
 #define em_proto_InputThumbstick_init_default    {false, em_proto_Vec2_init_default, 0, 0}
 #define em_proto_InputValueTouch_init_default    {0, 0}
 #define em_proto_InputClickTouch_init_default    {0, 0}
@@ -196,7 +240,10 @@ extern "C" {
 #define em_proto_TouchControllerLeft_init_default {false, em_proto_InputClickTouch_init_default, false, em_proto_InputClickTouch_init_default, false, em_proto_InputClickTouch_init_default, false, em_proto_TouchControllerCommon_init_default}
 #define em_proto_TouchControllerRight_init_default {false, em_proto_InputClickTouch_init_default, false, em_proto_InputClickTouch_init_default, false, em_proto_InputClickTouch_init_default, false, em_proto_TouchControllerCommon_init_default}
 #define em_proto_UpFrameMessage_init_default     {0, 0, 0, 0, 0}
-#define em_proto_UpMessage_init_default          {0, false, em_proto_TrackingMessage_init_default, false, em_proto_UpFrameMessage_init_default}
+#define em_proto_UpRefreshRequestMessage_init_default {0}
+#define em_proto_UpInputMessage_init_default     {0, 0, 0}
+#define em_proto_UpHealthMessage_init_default    {0, 0, 0}
+#define em_proto_UpMessage_init_default          {0, false, em_proto_TrackingMessage_init_default, false, em_proto_UpFrameMessage_init_default, false, em_proto_UpRefreshRequestMessage_init_default, false, em_proto_UpInputMessage_init_default, false, em_proto_UpHealthMessage_init_default}
 #define em_proto_DownFrameDataMessage_init_default {0, 0, {em_proto_Pose_init_default, em_proto_Pose_init_default}, 0, 0, 0, 0}
 #define em_proto_DownMessage_init_default        {false, em_proto_DownFrameDataMessage_init_default}
 #define em_proto_Quaternion_init_zero            {0, 0, 0, 0}
@@ -204,7 +251,7 @@ extern "C" {
 #define em_proto_Vec2_init_zero                  {0, 0}
 #define em_proto_Pose_init_zero                  {false, em_proto_Vec3_init_zero, false, em_proto_Quaternion_init_zero}
 #define em_proto_HandJointLocation_init_zero     {0, false, em_proto_Pose_init_zero, 0}
-#define em_proto_TrackingMessage_init_zero       {false, em_proto_Pose_init_zero, false, em_proto_Vec3_init_zero, false, em_proto_Vec3_init_zero, 0, {em_proto_Pose_init_zero, em_proto_Pose_init_zero}, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, 0, 0, {{NULL}, NULL}, {{NULL}, NULL}, 0, 0}
+#define em_proto_TrackingMessage_init_zero       {false, em_proto_Pose_init_zero, false, em_proto_Vec3_init_zero, false, em_proto_Vec3_init_zero, 0, {em_proto_Pose_init_zero, em_proto_Pose_init_zero}, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, false, em_proto_Pose_init_zero, 0, 0, {{NULL}, NULL}, {{NULL}, NULL}, 0, 0, 0, 0, {em_proto_Vec2_init_zero, em_proto_Vec2_init_zero}}
 #define em_proto_InputThumbstick_init_zero       {false, em_proto_Vec2_init_zero, 0, 0}
 #define em_proto_InputValueTouch_init_zero       {0, 0}
 #define em_proto_InputClickTouch_init_zero       {0, 0}
@@ -212,7 +259,10 @@ extern "C" {
 #define em_proto_TouchControllerLeft_init_zero   {false, em_proto_InputClickTouch_init_zero, false, em_proto_InputClickTouch_init_zero, false, em_proto_InputClickTouch_init_zero, false, em_proto_TouchControllerCommon_init_zero}
 #define em_proto_TouchControllerRight_init_zero  {false, em_proto_InputClickTouch_init_zero, false, em_proto_InputClickTouch_init_zero, false, em_proto_InputClickTouch_init_zero, false, em_proto_TouchControllerCommon_init_zero}
 #define em_proto_UpFrameMessage_init_zero        {0, 0, 0, 0, 0}
-#define em_proto_UpMessage_init_zero             {0, false, em_proto_TrackingMessage_init_zero, false, em_proto_UpFrameMessage_init_zero}
+#define em_proto_UpRefreshRequestMessage_init_zero {0}
+#define em_proto_UpInputMessage_init_zero        {0, 0, 0}
+#define em_proto_UpHealthMessage_init_zero       {0, 0, 0}
+#define em_proto_UpMessage_init_zero             {0, false, em_proto_TrackingMessage_init_zero, false, em_proto_UpFrameMessage_init_zero, false, em_proto_UpRefreshRequestMessage_init_zero, false, em_proto_UpInputMessage_init_zero, false, em_proto_UpHealthMessage_init_zero}
 #define em_proto_DownFrameDataMessage_init_zero  {0, 0, {em_proto_Pose_init_zero, em_proto_Pose_init_zero}, 0, 0, 0, 0}
 #define em_proto_DownMessage_init_zero           {false, em_proto_DownFrameDataMessage_init_zero}
 
@@ -245,6 +295,8 @@ extern "C" {
 #define em_proto_TrackingMessage_hand_joint_locations_right_tag 12
 #define em_proto_TrackingMessage_controller_grab_value_left_tag 13
 #define em_proto_TrackingMessage_controller_grab_value_right_tag 14
+#define em_proto_TrackingMessage_hand_joints_sparse_tag 15
+#define em_proto_TrackingMessage_gaze_points_tag 16
 #define em_proto_InputThumbstick_xy_tag          1
 #define em_proto_InputThumbstick_click_tag       2
 #define em_proto_InputThumbstick_touch_tag       3
@@ -269,9 +321,19 @@ extern "C" {
 #define em_proto_UpFrameMessage_begin_frame_time_tag 3
 #define em_proto_UpFrameMessage_display_time_tag 4
 #define em_proto_UpFrameMessage_average_latency_tag 5
+#define em_proto_UpRefreshRequestMessage_lost_packets_tag 1
+#define em_proto_UpInputMessage_grab_value_left_tag 1
+#define em_proto_UpInputMessage_grab_value_right_tag 2
+#define em_proto_UpInputMessage_sequence_idx_tag 3
+#define em_proto_UpHealthMessage_thermal_status_tag 1
+#define em_proto_UpHealthMessage_decode_interval_ms_tag 2
+#define em_proto_UpHealthMessage_display_misses_tag 3
 #define em_proto_UpMessage_id_tag                1
 #define em_proto_UpMessage_tracking_tag          2
 #define em_proto_UpMessage_frame_tag             3
+#define em_proto_UpMessage_refresh_request_tag   4
+#define em_proto_UpMessage_input_tag             5
+#define em_proto_UpMessage_health_tag            6
 #define em_proto_DownFrameDataMessage_frame_sequence_id_tag 1
 #define em_proto_DownFrameDataMessage_view_poses_tag 2
 #define em_proto_DownFrameDataMessage_render_begin_time_tag 3
@@ -332,7 +394,9 @@ X(a, STATIC,   SINGULAR, INT64,    sequence_idx,     10) \
 X(a, CALLBACK, REPEATED, MESSAGE,  hand_joint_locations_left,  11) \
 X(a, CALLBACK, REPEATED, MESSAGE,  hand_joint_locations_right,  12) \
 X(a, STATIC,   SINGULAR, FLOAT,    controller_grab_value_left,  13) \
-X(a, STATIC,   SINGULAR, FLOAT,    controller_grab_value_right,  14)
+X(a, STATIC,   SINGULAR, FLOAT,    controller_grab_value_right,  14) \
+X(a, STATIC,   SINGULAR, BOOL,     hand_joints_sparse,  15) \
+X(a, STATIC,   REPEATED, MESSAGE,  gaze_points,      16)
 #define em_proto_TrackingMessage_CALLBACK pb_default_field_callback
 #define em_proto_TrackingMessage_DEFAULT NULL
 #define em_proto_TrackingMessage_head_pose_MSGTYPE em_proto_Pose
@@ -345,6 +409,7 @@ X(a, STATIC,   SINGULAR, FLOAT,    controller_grab_value_right,  14)
 #define em_proto_TrackingMessage_controller_aim_right_MSGTYPE em_proto_Pose
 #define em_proto_TrackingMessage_hand_joint_locations_left_MSGTYPE em_proto_HandJointLocation
 #define em_proto_TrackingMessage_hand_joint_locations_right_MSGTYPE em_proto_HandJointLocation
+#define em_proto_TrackingMessage_gaze_points_MSGTYPE em_proto_Vec2
 
 #define em_proto_InputThumbstick_FIELDLIST(X, a) \
 X(a, STATIC,   OPTIONAL, MESSAGE,  xy,                1) \
@@ -410,14 +475,39 @@ X(a, STATIC,   SINGULAR, INT64,    average_latency,   5)
 #define em_proto_UpFrameMessage_CALLBACK NULL
 #define em_proto_UpFrameMessage_DEFAULT NULL
 
+#define em_proto_UpRefreshRequestMessage_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT64,    lost_packets,      1)
+#define em_proto_UpRefreshRequestMessage_CALLBACK NULL
+#define em_proto_UpRefreshRequestMessage_DEFAULT NULL
+
+#define em_proto_UpInputMessage_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, FLOAT,    grab_value_left,   1) \
+X(a, STATIC,   SINGULAR, FLOAT,    grab_value_right,   2) \
+X(a, STATIC,   SINGULAR, INT64,    sequence_idx,      3)
+#define em_proto_UpInputMessage_CALLBACK NULL
+#define em_proto_UpInputMessage_DEFAULT NULL
+
+#define em_proto_UpHealthMessage_FIELDLIST(X, a) \
+X(a, STATIC,   SINGULAR, INT32,    thermal_status,    1) \
+X(a, STATIC,   SINGULAR, FLOAT,    decode_interval_ms,   2) \
+X(a, STATIC,   SINGULAR, INT32,    display_misses,    3)
+#define em_proto_UpHealthMessage_CALLBACK NULL
+#define em_proto_UpHealthMessage_DEFAULT NULL
+
 #define em_proto_UpMessage_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, INT64,    id,                1) \
 X(a, STATIC,   OPTIONAL, MESSAGE,  tracking,          2) \
-X(a, STATIC,   OPTIONAL, MESSAGE,  frame,             3)
+X(a, STATIC,   OPTIONAL, MESSAGE,  frame,             3) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  refresh_request,   4) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  input,             5) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  health,            6)
 #define em_proto_UpMessage_CALLBACK NULL
 #define em_proto_UpMessage_DEFAULT NULL
 #define em_proto_UpMessage_tracking_MSGTYPE em_proto_TrackingMessage
 #define em_proto_UpMessage_frame_MSGTYPE em_proto_UpFrameMessage
+#define em_proto_UpMessage_refresh_request_MSGTYPE em_proto_UpRefreshRequestMessage
+#define em_proto_UpMessage_input_MSGTYPE em_proto_UpInputMessage
+#define em_proto_UpMessage_health_MSGTYPE em_proto_UpHealthMessage
 
 #define em_proto_DownFrameDataMessage_FIELDLIST(X, a) \
 X(a, STATIC,   SINGULAR, INT64,    frame_sequence_id,   1) \
@@ -449,6 +539,9 @@ extern const pb_msgdesc_t em_proto_TouchControllerCommon_msg;
 extern const pb_msgdesc_t em_proto_TouchControllerLeft_msg;
 extern const pb_msgdesc_t em_proto_TouchControllerRight_msg;
 extern const pb_msgdesc_t em_proto_UpFrameMessage_msg;
+extern const pb_msgdesc_t em_proto_UpRefreshRequestMessage_msg;
+extern const pb_msgdesc_t em_proto_UpInputMessage_msg;
+extern const pb_msgdesc_t em_proto_UpHealthMessage_msg;
 extern const pb_msgdesc_t em_proto_UpMessage_msg;
 extern const pb_msgdesc_t em_proto_DownFrameDataMessage_msg;
 extern const pb_msgdesc_t em_proto_DownMessage_msg;
@@ -467,6 +560,9 @@ extern const pb_msgdesc_t em_proto_DownMessage_msg;
 #define em_proto_TouchControllerLeft_fields &em_proto_TouchControllerLeft_msg
 #define em_proto_TouchControllerRight_fields &em_proto_TouchControllerRight_msg
 #define em_proto_UpFrameMessage_fields &em_proto_UpFrameMessage_msg
+#define em_proto_UpRefreshRequestMessage_fields &em_proto_UpRefreshRequestMessage_msg
+#define em_proto_UpInputMessage_fields &em_proto_UpInputMessage_msg
+#define em_proto_UpHealthMessage_fields &em_proto_UpHealthMessage_msg
 #define em_proto_UpMessage_fields &em_proto_UpMessage_msg
 #define em_proto_DownFrameDataMessage_fields &em_proto_DownFrameDataMessage_msg
 #define em_proto_DownMessage_fields &em_proto_DownMessage_msg
@@ -487,6 +583,9 @@ extern const pb_msgdesc_t em_proto_DownMessage_msg;
 #define em_proto_TouchControllerLeft_size        58
 #define em_proto_TouchControllerRight_size       58
 #define em_proto_UpFrameMessage_size             55
+#define em_proto_UpHealthMessage_size            27
+#define em_proto_UpInputMessage_size             21
+#define em_proto_UpRefreshRequestMessage_size    11
 #define em_proto_Vec2_size                       10
 #define em_proto_Vec3_size                       15
 
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+
+# Copyright 2026, Collabora, Ltd.
+#
+# SPDX-License-Identifier: BSL-1.0
+
+"""Summarize one benchmark scenario into latency and freeze percentiles.
+
+Joins the client's per-frame BENCHMARK records (adb logcat capture, see
+run_scenarios.sh) with the server's per-frame trace events by
+frame_sequence_id when a server trace is given (EMS_TRACE_JSON), and with
+the per-second metrics CSV for bitrate/NACK context. The BENCHMARK records
+already carry the server-side stamps of their frame, so latency percentiles
+work from the client log alone.
+
+Usage:
+  collect_results.py results/loss-2pct.client.log \
+      [--server-trace trace.json] [--metrics-csv results/loss-2pct.metrics.csv]
+"""
+
+import argparse
+import json
+import re
+import sys
+
+# "MM-DD HH:MM:SS.mmm ... BENCHMARK {json}" as produced by `adb logcat -v time`.
+BENCHMARK_RE = re.compile(
+    r"(?P<ts>\d\d-\d\d \d\d:\d\d:\d\d\.\d+)?.*BENCHMARK (?P<json>\{.*\})"
+)
+
+# A frame later than this multiple of the median inter-frame gap is a freeze.
+FREEZE_GAP_FACTOR = 3.0
+
+
+def percentile(values, pct):
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    index = min(int(len(ordered) * pct / 100.0), len(ordered) - 1)
+    return ordered[index]
+
+
+def parse_logcat_time(text):
+    """Seconds since midnight; good enough to measure gaps within a run."""
+    hours, minutes, seconds = text.split(" ")[1].split(":")
+    return int(hours) * 3600 + int(minutes) * 60 + float(seconds)
+
+
+def load_client_frames(path):
+    frames = {}
+    with open(path, encoding="utf-8", errors="replace") as log:
+        for line in log:
+            match = BENCHMARK_RE.search(line)
+            if match is None:
+                continue
+            try:
+                record = json.loads(match.group("json"))
+            except json.JSONDecodeError:
+                continue
+            if match.group("ts") is not None:
+                record["arrival_s"] = parse_logcat_time(match.group("ts"))
+            frames[record["frame"]] = record
+    return frames
+
+
+def load_server_trace(path):
+    """frame_sequence_id -> server rtp_send timestamp (us) from the trace."""
+    send_times = {}
+    with open(path, encoding="utf-8") as trace:
+        for line in trace:
+            line = line.strip().rstrip(",")
+            if '"rtp_send"' not in line:
+                continue
+            try:
+                event = json.loads(line)
+            except json.JSONDecodeError:
+                continue
+            send_times[event["args"]["frame_sequence_id"]] = event["ts"]
+    return send_times
+
+
+def freeze_durations(frames):
+    """Gaps between consecutive displayed frames that exceed the threshold."""
+    arrivals = sorted(f["arrival_s"] for f in frames.values() if "arrival_s" in f)
+    if len(arrivals) < 2:
+        return [], 0.0
+    gaps = [b - a for a, b in zip(arrivals, arrivals[1:])]
+    median_gap = percentile(gaps, 50)
+    threshold = median_gap * FREEZE_GAP_FACTOR
+    freezes = [gap for gap in gaps if gap > threshold]
+    return freezes, threshold
+
+
+def report(label, values, unit="ms"):
+    print(
+        f"  {label:<24} p50 {percentile(values, 50):7.1f}  "
+        f"p90 {percentile(values, 90):7.1f}  p99 {percentile(values, 99):7.1f} {unit}"
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("client_log", help="captured BENCHMARK lines")
+    parser.add_argument("--server-trace", help="EMS_TRACE_JSON output to join by frame")
+    parser.add_argument("--metrics-csv", help="server --metrics-csv output")
+    args = parser.parse_args()
+
+    frames = load_client_frames(args.client_log)
+    if not frames:
+        sys.exit(f"No BENCHMARK records in {args.client_log}")
+
+    sequence_ids = sorted(frames)
+    print(f"{len(frames)} frames, sequence {sequence_ids[0]}..{sequence_ids[-1]}")
+
+    print("Latency:")
+    for key, label in [
+        ("total_ms", "server render to display"),
+        ("server_render_ms", "server render"),
+        ("server_encode_transmit_ms", "encode + transmit"),
+        ("client_decode_ms", "client decode"),
+        ("client_wait_ms", "client wait"),
+        ("jitter_buffer_ms", "jitter buffer"),
+    ]:
+        report(label, [f[key] for f in frames.values() if key in f])
+
+    if args.server_trace:
+        send_times = load_server_trace(args.server_trace)
+        joined = sorted(set(send_times) & set(frames))
+        dropped = sorted(set(send_times) - set(frames))
+        print(
+            f"Server trace join: {len(joined)} frames on both sides, "
+            f"{len(dropped)} sent but never displayed "
+            f"({100.0 * len(dropped) / max(len(send_times), 1):.1f}%)"
+        )
+
+    expected = sequence_ids[-1] - sequence_ids[0] + 1
+    missing = expected - len(frames)
+    print(f"Frames missing from the sequence: {missing} ({100.0 * missing / expected:.1f}%)")
+
+    freezes, threshold = freeze_durations(frames)
+    if threshold > 0.0:
+        print(
+            f"Freezes (display gap > {threshold * 1000.0:.0f} ms): {len(freezes)}, "
+            f"total {sum(freezes):.2f} s"
+        )
+        if freezes:
+            report("freeze duration", [f * 1000.0 for f in freezes])
+
+    if args.metrics_csv:
+        with open(args.metrics_csv, encoding="utf-8") as csv:
+            rows = csv.read().splitlines()
+        print(f"Server metrics: {len(rows) - 1} samples in {args.metrics_csv}")
+
+
+if __name__ == "__main__":
+    main()
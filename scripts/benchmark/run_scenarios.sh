@@ -0,0 +1,55 @@
+#!/bin/sh
+
+# Copyright 2026, Collabora, Ltd.
+#
+# SPDX-License-Identifier: BSL-1.0
+#
+# Runs the server through every impairment scenario in scenarios.txt and
+# collects one server metrics CSV plus one client BENCHMARK log per scenario
+# into the results directory. The client app must already be installed on the
+# device reachable through adb, and is expected to reconnect on its own when
+# the server comes back between scenarios.
+#
+# Usage: run_scenarios.sh [results_dir] [seconds_per_scenario]
+#
+# Summarize afterwards with:
+#   collect_results.py results/<name>.client.log --metrics-csv results/<name>.metrics.csv
+
+set -eu
+
+EM_ROOT=$(cd "$(dirname "$0")" && cd ../.. && pwd)
+SERVER="$EM_ROOT/server/build/src/ems/ems_streaming_server"
+SCENARIOS="$EM_ROOT/scripts/benchmark/scenarios.txt"
+
+RESULTS_DIR=${1:-results}
+DURATION=${2:-120}
+
+mkdir -p "$RESULTS_DIR"
+
+grep -v '^[[:space:]]*\(#\|$\)' "$SCENARIOS" | while read -r name loss delay jitter rate; do
+	echo "=== Scenario $name: loss ${loss}% delay ${delay}ms jitter ${jitter}ms rate ${rate}kbps ==="
+
+	adb logcat -c
+
+	"$SERVER" \
+		--impair-loss "$loss" \
+		--impair-delay-ms "$delay" \
+		--impair-jitter-ms "$jitter" \
+		--impair-rate-kbps "$rate" \
+		--metrics-csv "$RESULTS_DIR/$name.metrics.csv" \
+		>"$RESULTS_DIR/$name.server.log" 2>&1 &
+	server_pid=$!
+
+	sleep "$DURATION"
+
+	kill "$server_pid" 2>/dev/null || true
+	wait "$server_pid" 2>/dev/null || true
+
+	# Only the frame records; -v time keeps the arrival timestamps the
+	# freeze detection needs.
+	adb logcat -d -v time | grep BENCHMARK >"$RESULTS_DIR/$name.client.log" || true
+
+	echo "Collected $(wc -l <"$RESULTS_DIR/$name.client.log") client frame records."
+done
+
+echo "All scenarios done, results in $RESULTS_DIR/"
@@ -16,23 +16,38 @@
 #include <cstddef>
 #include <memory>
 #include <mutex>
-#include <type_traits>
+#include <vector>
 
-#include "util/u_generic_callbacks.hpp"
+/*!
+ * One registered callback.
+ */
+struct ems_callbacks_entry
+{
+	ems_callbacks_func_t func;
+	uint32_t event_mask;
+	void *userdata;
+};
 
+/*
+ * RCU-style dispatch: the registered callbacks live in an immutable vector
+ * published through an atomically loaded/stored shared_ptr. ems_callbacks_call
+ * runs at tracking rate and only grabs a reference to the current snapshot,
+ * never a lock; a reader that raced a concurrent ems_callbacks_add keeps the
+ * old snapshot alive through its shared_ptr until it is done with it. The
+ * mutex only serializes the (rare) writers, which copy, modify and republish.
+ */
 struct ems_callbacks
 {
 	std::mutex mutex;
-	xrt::auxiliary::util::GenericCallbacks<ems_callbacks_func_t, enum ems_callbacks_event> callbacks_collection;
+	std::shared_ptr<const std::vector<ems_callbacks_entry>> snapshot;
 };
 
 struct ems_callbacks *
 ems_callbacks_create()
 {
-	// auto ret = std::make_unique<ems_callbacks>();
-
-	// return ret.release();
-	return new ems_callbacks;
+	auto *callbacks = new ems_callbacks;
+	callbacks->snapshot = std::make_shared<const std::vector<ems_callbacks_entry>>();
+	return callbacks;
 }
 
 void
@@ -54,23 +69,32 @@ void
 ems_callbacks_add(struct ems_callbacks *callbacks, uint32_t event_mask, ems_callbacks_func_t func, void *userdata)
 {
 	std::unique_lock<std::mutex> lock(callbacks->mutex);
-	callbacks->callbacks_collection.addCallback(func, event_mask, userdata);
+
+	// Copy-on-write: readers keep using the old snapshot undisturbed.
+	auto next = std::make_shared<std::vector<ems_callbacks_entry>>(*callbacks->snapshot);
+	next->push_back({func, event_mask, userdata});
+
+	std::atomic_store(&callbacks->snapshot,
+	                  std::shared_ptr<const std::vector<ems_callbacks_entry>>(std::move(next)));
 }
 
 void
 ems_callbacks_reset(struct ems_callbacks *callbacks)
 {
 	std::unique_lock<std::mutex> lock(callbacks->mutex);
-	callbacks->callbacks_collection = {};
+	std::atomic_store(&callbacks->snapshot, std::make_shared<const std::vector<ems_callbacks_entry>>());
 }
 
 void
 ems_callbacks_call(struct ems_callbacks *callbacks, enum ems_callbacks_event event, const em_UpMessageSuper *message)
 {
-	std::unique_lock<std::mutex> lock(callbacks->mutex);
-	auto invoker = [=](enum ems_callbacks_event ev, ems_callbacks_func_t callback, void *userdata) {
-		callback(ev, message, userdata);
-		return false; // do not remove
-	};
-	callbacks->callbacks_collection.invokeCallbacks(event, invoker);
+	// Lock-free in steady state, see the comment on ems_callbacks.
+	auto snapshot = std::atomic_load(&callbacks->snapshot);
+
+	for (const ems_callbacks_entry &entry : *snapshot) {
+		if ((entry.event_mask & (uint32_t)event) == 0) {
+			continue;
+		}
+		entry.func(event, message, entry.userdata);
+	}
 }
@@ -17,8 +17,11 @@
 
 #include "ems_compositor.h"
 
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <zlib.h>
 
 #include "electricmaple.pb.h"
 #include "ems_instance.h"
@@ -39,8 +42,21 @@
 #include "vk/vk_image_readback_to_xf_pool.h"
 
 #include "ems_config.h"
+#include "ems_trace.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 DEBUG_GET_ONCE_LOG_OPTION(log, "XRT_COMPOSITOR_LOG", U_LOGGING_INFO)
+DEBUG_GET_ONCE_BOOL_OPTION(dmabuf_export, "EMS_DMABUF_EXPORT", false)
+DEBUG_GET_ONCE_BOOL_OPTION(async_readback, "EMS_ASYNC_READBACK", true)
+DEBUG_GET_ONCE_BOOL_OPTION(nv12_compute, "EMS_NV12_COMPUTE", true)
+DEBUG_GET_ONCE_BOOL_OPTION(realtime_queue, "EMS_REALTIME_QUEUE", false)
+
+#ifdef EMS_HAVE_NV12_COMPUTE
+#include "shaders/ems_nv12_pack.comp.h"
+#endif
 
 /*
  *
@@ -136,6 +152,9 @@ static const char *optional_device_extensions[] = {
 #ifdef VK_EXT_robustness2
 	VK_EXT_ROBUSTNESS_2_EXTENSION_NAME,
 #endif
+#ifdef VK_EXT_external_memory_dma_buf
+	VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+#endif
 };
 
 static VkResult
@@ -192,6 +211,53 @@ compositor_init_vulkan(struct ems_compositor *c)
 	struct comp_vulkan_results vk_res = {};
 	bool bundle_ret = comp_vulkan_init_bundle(vk, &vk_args, &vk_res);
 
+#ifdef VK_EXT_global_priority
+	/*
+	 * Optionally recreate the device asking for a realtime-priority queue,
+	 * so our blit/readback submissions don't sit behind the app's command
+	 * buffers when the game saturates the GPU and encode misses its slot.
+	 * This has to happen right here: nothing device-owned exists yet, and
+	 * global priority can only be requested at device creation. Denied
+	 * priority (VK_ERROR_NOT_PERMITTED_EXT on most drivers) falls back to
+	 * the default-priority device.
+	 */
+	if (bundle_ret && debug_get_bool_option_realtime_queue()) {
+		struct vk_device_features device_features = {};
+		device_features.timeline_semaphore = vk->features.timeline_semaphore;
+
+		vk->vkDeviceWaitIdle(vk->device);
+		vk->vkDestroyDevice(vk->device, NULL);
+		vk->device = VK_NULL_HANDLE;
+
+		VkResult vret = vk_create_device( //
+			vk, // vk_bundle
+			vk_res.selected_gpu_index, // gpu_index, the one the bundle picked
+			false, // only_compute
+			VK_QUEUE_GLOBAL_PRIORITY_HIGH_EXT, // global_priority
+			required_device_extension_list, // required_device_ext_list
+			optional_device_extension_list, // optional_device_ext_list
+			&device_features); // optional_device_features
+		if (vret == VK_SUCCESS) {
+			EMS_COMP_INFO(c, "Streaming compositor queue running at high global priority.");
+		} else {
+			EMS_COMP_WARN(c, "High global priority queue denied (%s), using default priority.",
+			              vk_result_string(vret));
+			vret = vk_create_device( //
+				vk, // vk_bundle
+				vk_res.selected_gpu_index, // gpu_index
+				false, // only_compute
+				VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_EXT, // global_priority
+				required_device_extension_list, // required_device_ext_list
+				optional_device_extension_list, // optional_device_ext_list
+				&device_features); // optional_device_features
+		}
+		if (vret != VK_SUCCESS) {
+			EMS_COMP_ERROR(c, "vk_create_device: %s", vk_result_string(vret));
+			bundle_ret = false;
+		}
+	}
+#endif
+
 	u_string_list_destroy(&required_instance_ext_list);
 	u_string_list_destroy(&optional_instance_ext_list);
 	u_string_list_destroy(&required_device_extension_list);
@@ -234,6 +300,556 @@ compositor_init_vulkan(struct ems_compositor *c)
 	return true;
 }
 
+/*!
+ * Create the linear images that back the zero-copy DMABUF streaming path and
+ * export their memory as fds. Any failure simply leaves the path disabled and
+ * we fall back to the CPU readback below.
+ */
+static bool
+compositor_init_dmabuf_export(struct ems_compositor *c)
+{
+#if defined(XRT_GRAPHICS_BUFFER_HANDLE_IS_FD) && defined(VK_EXT_external_memory_dma_buf)
+	struct vk_bundle *vk = get_vk(c);
+
+	if (!debug_get_bool_option_dmabuf_export()) {
+		return false;
+	}
+
+	const struct ems_device_config *config = ems_config_get();
+
+	VkExtent2D extent = {};
+	extent.width = (uint32_t)config->resolution_stream_stereo_pixels.w;
+	extent.height = (uint32_t)config->resolution_stream_stereo_pixels.h;
+
+	for (size_t i = 0; i < ARRAY_SIZE(c->dmabuf.frames); i++) {
+		struct ems_dmabuf_frame *frame = &c->dmabuf.frames[i];
+		frame->fd = -1;
+
+		VkExternalMemoryImageCreateInfo external_image_info = {};
+		external_image_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+		external_image_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+		// Linear so the consumer can import it without DRM modifier negotiation.
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.pNext = &external_image_info;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		image_info.extent = {extent.width, extent.height, 1};
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.tiling = VK_IMAGE_TILING_LINEAR;
+		image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkResult ret = vk->vkCreateImage(vk->device, &image_info, NULL, &frame->image);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateImage(dmabuf): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkMemoryRequirements requirements = {};
+		vk->vkGetImageMemoryRequirements(vk->device, frame->image, &requirements);
+
+		uint32_t memory_type_index = 0;
+		if (!vk_get_memory_type(vk, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                        &memory_type_index)) {
+			EMS_COMP_WARN(c, "No memory type for DMABUF export image.");
+			return false;
+		}
+
+		VkMemoryDedicatedAllocateInfo dedicated_info = {};
+		dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicated_info.image = frame->image;
+
+		VkExportMemoryAllocateInfo export_info = {};
+		export_info.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+		export_info.pNext = &dedicated_info;
+		export_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+		VkMemoryAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocate_info.pNext = &export_info;
+		allocate_info.allocationSize = requirements.size;
+		allocate_info.memoryTypeIndex = memory_type_index;
+
+		ret = vk->vkAllocateMemory(vk->device, &allocate_info, NULL, &frame->device_memory);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkAllocateMemory(dmabuf): %s", vk_result_string(ret));
+			return false;
+		}
+
+		ret = vk->vkBindImageMemory(vk->device, frame->image, frame->device_memory, 0);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkBindImageMemory(dmabuf): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkMemoryGetFdInfoKHR get_fd_info = {};
+		get_fd_info.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+		get_fd_info.memory = frame->device_memory;
+		get_fd_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+		ret = vk->vkGetMemoryFdKHR(vk->device, &get_fd_info, &frame->fd);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkGetMemoryFdKHR: %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkImageSubresource subresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+		VkSubresourceLayout layout = {};
+		vk->vkGetImageSubresourceLayout(vk->device, frame->image, &subresource, &layout);
+
+		frame->size = requirements.size;
+		frame->stride = (uint32_t)layout.rowPitch;
+		frame->in_flight = false;
+	}
+
+	EMS_COMP_INFO(c, "DMABUF export enabled, streaming without CPU readback.");
+
+	return true;
+#else
+	(void)c;
+	return false;
+#endif
+}
+
+static void
+compositor_fini_dmabuf_export(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	for (size_t i = 0; i < ARRAY_SIZE(c->dmabuf.frames); i++) {
+		struct ems_dmabuf_frame *frame = &c->dmabuf.frames[i];
+
+		// Note: zero-initialized frames have fd == 0, which is not ours.
+		if (frame->fd > 0) {
+#ifdef __linux__
+			close(frame->fd);
+#endif
+			frame->fd = -1;
+		}
+		if (frame->image != VK_NULL_HANDLE) {
+			vk->vkDestroyImage(vk->device, frame->image, NULL);
+			frame->image = VK_NULL_HANDLE;
+		}
+		if (frame->device_memory != VK_NULL_HANDLE) {
+			vk->vkFreeMemory(vk->device, frame->device_memory, NULL);
+			frame->device_memory = VK_NULL_HANDLE;
+		}
+	}
+
+	c->dmabuf.enabled = false;
+}
+
+/*!
+ * (Re)create the NV12 plane targets and host visible staging buffers at
+ * @p extent. In async mode every readback slot gets its own staging buffer, so
+ * the collector can push a finished frame while the next one is recorded.
+ */
+static bool
+compositor_nv12_pack_alloc_targets(struct ems_compositor *c, VkExtent2D extent)
+{
+	struct vk_bundle *vk = get_vk(c);
+	struct ems_nv12_pack *p = &c->nv12.pack;
+	VkResult ret;
+
+	// Plane targets, written as storage images and copied out to the buffers.
+	struct
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		VkImage *image;
+		VkImageView *view;
+		VkDeviceMemory *memory;
+	} planes[2] = {
+		{VK_FORMAT_R8_UNORM, extent, &p->y_image, &p->y_view, &p->y_memory},
+		{VK_FORMAT_R8G8_UNORM, {extent.width / 2, extent.height / 2}, &p->uv_image, &p->uv_view, &p->uv_memory},
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(planes); i++) {
+		const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+		ret = vk_create_image_simple( //
+			vk, // vk_bundle
+			planes[i].extent, // extent
+			planes[i].format, // format
+			usage, // usage
+			planes[i].memory, // out_mem
+			planes[i].image); // out_image
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vk_create_image_simple(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		ret = vk_create_view( //
+			vk, // vk_bundle
+			*planes[i].image, // image
+			VK_IMAGE_VIEW_TYPE_2D, // type
+			planes[i].format, // format
+			{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, // subresource_range
+			planes[i].view); // out_view
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vk_create_view(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+	}
+
+	// Host visible staging buffers, Y plane followed by the UV plane.
+	p->buffer_size = (VkDeviceSize)extent.width * extent.height * 3 / 2;
+	p->buffer_count = c->readback.running ? EMS_READBACK_MAX_IN_FLIGHT : 1;
+
+	for (uint32_t i = 0; i < p->buffer_count; i++) {
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = p->buffer_size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		ret = vk->vkCreateBuffer(vk->device, &buffer_info, NULL, &p->buffers[i]);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateBuffer(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkMemoryRequirements requirements = {};
+		vk->vkGetBufferMemoryRequirements(vk->device, p->buffers[i], &requirements);
+
+		uint32_t memory_type_index = 0;
+		if (!vk_get_memory_type(vk, requirements.memoryTypeBits,
+		                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                        &memory_type_index)) {
+			EMS_COMP_WARN(c, "No memory type for NV12 readback buffer.");
+			return false;
+		}
+
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = requirements.size;
+		alloc_info.memoryTypeIndex = memory_type_index;
+
+		ret = vk->vkAllocateMemory(vk->device, &alloc_info, NULL, &p->buffer_memories[i]);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkAllocateMemory(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		vk->vkBindBufferMemory(vk->device, p->buffers[i], p->buffer_memories[i], 0);
+
+		ret = vk->vkMapMemory(vk->device, p->buffer_memories[i], 0, VK_WHOLE_SIZE, 0, &p->mapped[i]);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkMapMemory(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+	}
+
+	p->extent = extent;
+
+	return true;
+}
+
+static void
+compositor_nv12_pack_free_targets(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+	struct ems_nv12_pack *p = &c->nv12.pack;
+
+	if (p->y_view != VK_NULL_HANDLE) {
+		vk->vkDestroyImageView(vk->device, p->y_view, NULL);
+		p->y_view = VK_NULL_HANDLE;
+	}
+	if (p->uv_view != VK_NULL_HANDLE) {
+		vk->vkDestroyImageView(vk->device, p->uv_view, NULL);
+		p->uv_view = VK_NULL_HANDLE;
+	}
+	if (p->y_image != VK_NULL_HANDLE) {
+		vk->vkDestroyImage(vk->device, p->y_image, NULL);
+		vk->vkFreeMemory(vk->device, p->y_memory, NULL);
+		p->y_image = VK_NULL_HANDLE;
+		p->y_memory = VK_NULL_HANDLE;
+	}
+	if (p->uv_image != VK_NULL_HANDLE) {
+		vk->vkDestroyImage(vk->device, p->uv_image, NULL);
+		vk->vkFreeMemory(vk->device, p->uv_memory, NULL);
+		p->uv_image = VK_NULL_HANDLE;
+		p->uv_memory = VK_NULL_HANDLE;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(p->buffers); i++) {
+		if (p->buffers[i] != VK_NULL_HANDLE) {
+			vk->vkDestroyBuffer(vk->device, p->buffers[i], NULL);
+			p->buffers[i] = VK_NULL_HANDLE;
+		}
+		if (p->buffer_memories[i] != VK_NULL_HANDLE) {
+			if (p->mapped[i] != NULL) {
+				vk->vkUnmapMemory(vk->device, p->buffer_memories[i]);
+			}
+			vk->vkFreeMemory(vk->device, p->buffer_memories[i], NULL);
+			p->buffer_memories[i] = VK_NULL_HANDLE;
+			p->mapped[i] = NULL;
+		}
+	}
+	p->buffer_count = 0;
+}
+
+/*!
+ * Point the static descriptor set at the current plane views, redone whenever
+ * the targets are reallocated for a new stream size.
+ */
+static void
+compositor_nv12_pack_write_descriptors(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+	struct ems_nv12_pack *p = &c->nv12.pack;
+
+	VkDescriptorImageInfo src_info = {};
+	src_info.sampler = p->sampler;
+	src_info.imageView = c->bounce.view;
+	src_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo y_info = {};
+	y_info.imageView = p->y_view;
+	y_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkDescriptorImageInfo uv_info = {};
+	uv_info.imageView = p->uv_view;
+	uv_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet writes[3] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = p->descriptor_set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo = &src_info;
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = p->descriptor_set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo = &y_info;
+	writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[2].dstSet = p->descriptor_set;
+	writes[2].dstBinding = 2;
+	writes[2].descriptorCount = 1;
+	writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[2].pImageInfo = &uv_info;
+
+	vk->vkUpdateDescriptorSets(vk->device, ARRAY_SIZE(writes), writes, 0, NULL);
+}
+
+/*!
+ * Create the compute pipeline and plane targets for the GPU NV12 packer. Any
+ * failure leaves the path disabled and we keep pushing RGBx through the
+ * pipeline's videoconvert element as before.
+ */
+static bool
+compositor_init_nv12_pack(struct ems_compositor *c)
+{
+#ifdef EMS_HAVE_NV12_COMPUTE
+	struct vk_bundle *vk = get_vk(c);
+	struct ems_nv12_pack *p = &c->nv12.pack;
+	VkResult ret;
+
+	if (!debug_get_bool_option_nv12_compute()) {
+		return false;
+	}
+	// The DMABUF path pushes RGBx buffers, the appsrc can only be
+	// negotiated as one format.
+	if (c->dmabuf.enabled) {
+		return false;
+	}
+	if (c->bounce.view == VK_NULL_HANDLE) {
+		return false;
+	}
+
+	const struct ems_device_config *config = ems_config_get();
+
+	VkExtent2D extent = {};
+	extent.width = (uint32_t)config->resolution_stream_stereo_pixels.w;
+	extent.height = (uint32_t)config->resolution_stream_stereo_pixels.h;
+
+	// The shader writes chroma per 2x2 quad.
+	if (extent.width % 2 != 0 || extent.height % 2 != 0) {
+		EMS_COMP_WARN(c, "Stream size not even, can not subsample chroma.");
+		return false;
+	}
+
+	// Plane targets and staging buffers, shared with the resolution switch.
+	if (!compositor_nv12_pack_alloc_targets(c, extent)) {
+		return false;
+	}
+
+	// Sampler, only used for texelFetch so filtering does not matter.
+	{
+		VkSamplerCreateInfo sampler_info = {};
+		sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		sampler_info.magFilter = VK_FILTER_NEAREST;
+		sampler_info.minFilter = VK_FILTER_NEAREST;
+		sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+		ret = vk->vkCreateSampler(vk->device, &sampler_info, NULL, &p->sampler);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateSampler(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+	}
+
+	// Descriptor set layout, pool and the one static set.
+	{
+		VkDescriptorSetLayoutBinding bindings[3] = {};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = ARRAY_SIZE(bindings);
+		layout_info.pBindings = bindings;
+
+		ret = vk->vkCreateDescriptorSetLayout(vk->device, &layout_info, NULL, &p->descriptor_set_layout);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateDescriptorSetLayout(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkDescriptorPoolSize pool_sizes[2] = {};
+		pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pool_sizes[0].descriptorCount = 1;
+		pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		pool_sizes[1].descriptorCount = 2;
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = 1;
+		pool_info.poolSizeCount = ARRAY_SIZE(pool_sizes);
+		pool_info.pPoolSizes = pool_sizes;
+
+		ret = vk->vkCreateDescriptorPool(vk->device, &pool_info, NULL, &p->descriptor_pool);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateDescriptorPool(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkDescriptorSetAllocateInfo set_info = {};
+		set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		set_info.descriptorPool = p->descriptor_pool;
+		set_info.descriptorSetCount = 1;
+		set_info.pSetLayouts = &p->descriptor_set_layout;
+
+		ret = vk->vkAllocateDescriptorSets(vk->device, &set_info, &p->descriptor_set);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkAllocateDescriptorSets(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		compositor_nv12_pack_write_descriptors(c);
+	}
+
+	// Pipeline layout and compute pipeline.
+	{
+		VkPushConstantRange push_range = {};
+		push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_range.size = sizeof(uint32_t) * 2;
+
+		VkPipelineLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_info.setLayoutCount = 1;
+		layout_info.pSetLayouts = &p->descriptor_set_layout;
+		layout_info.pushConstantRangeCount = 1;
+		layout_info.pPushConstantRanges = &push_range;
+
+		ret = vk->vkCreatePipelineLayout(vk->device, &layout_info, NULL, &p->pipeline_layout);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreatePipelineLayout(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkShaderModuleCreateInfo module_info = {};
+		module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		module_info.codeSize = sizeof(ems_nv12_pack_comp);
+		module_info.pCode = ems_nv12_pack_comp;
+
+		VkShaderModule module = VK_NULL_HANDLE;
+		ret = vk->vkCreateShaderModule(vk->device, &module_info, NULL, &module);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateShaderModule(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+
+		VkComputePipelineCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeline_info.stage.module = module;
+		pipeline_info.stage.pName = "main";
+		pipeline_info.layout = p->pipeline_layout;
+
+		ret = vk->vkCreateComputePipelines(vk->device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &p->pipeline);
+
+		vk->vkDestroyShaderModule(vk->device, module, NULL);
+
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateComputePipelines(nv12): %s", vk_result_string(ret));
+			return false;
+		}
+	}
+
+	EMS_COMP_INFO(c, "GPU NV12 packing enabled, pipelines built without videoconvert.");
+
+	return true;
+#else
+	(void)c;
+	return false;
+#endif
+}
+
+static void
+compositor_fini_nv12_pack(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+	struct ems_nv12_pack *p = &c->nv12.pack;
+
+	if (p->pipeline != VK_NULL_HANDLE) {
+		vk->vkDestroyPipeline(vk->device, p->pipeline, NULL);
+		p->pipeline = VK_NULL_HANDLE;
+	}
+	if (p->pipeline_layout != VK_NULL_HANDLE) {
+		vk->vkDestroyPipelineLayout(vk->device, p->pipeline_layout, NULL);
+		p->pipeline_layout = VK_NULL_HANDLE;
+	}
+	if (p->descriptor_pool != VK_NULL_HANDLE) {
+		// Also frees the set.
+		vk->vkDestroyDescriptorPool(vk->device, p->descriptor_pool, NULL);
+		p->descriptor_pool = VK_NULL_HANDLE;
+		p->descriptor_set = VK_NULL_HANDLE;
+	}
+	if (p->descriptor_set_layout != VK_NULL_HANDLE) {
+		vk->vkDestroyDescriptorSetLayout(vk->device, p->descriptor_set_layout, NULL);
+		p->descriptor_set_layout = VK_NULL_HANDLE;
+	}
+	if (p->sampler != VK_NULL_HANDLE) {
+		vk->vkDestroySampler(vk->device, p->sampler, NULL);
+		p->sampler = VK_NULL_HANDLE;
+	}
+
+	compositor_nv12_pack_free_targets(c);
+
+	c->nv12.enabled = false;
+}
+
 /*
  *
  * Other init functions.
@@ -307,31 +923,862 @@ compositor_init_sys_info(struct ems_compositor *c, struct xrt_device *xdev)
 		assert(u_verify_blend_mode_valid(xdev->hmd->blend_modes[i]));
 		sys_info->supported_blend_modes[i] = xdev->hmd->blend_modes[i];
 	}
-	sys_info->supported_blend_mode_count = (uint8_t)xdev->hmd->blend_mode_count;
+	sys_info->supported_blend_mode_count = (uint8_t)xdev->hmd->blend_mode_count;
+
+	// Refresh rates.
+	sys_info->refresh_rate_count = 1;
+	sys_info->refresh_rates_hz[0] = (float)(1. / time_ns_to_s(c->settings.frame_interval_ns));
+
+	return true;
+}
+
+static inline em_proto_Pose
+to_proto(const struct xrt_pose &pose)
+{
+	em_proto_Pose ret = em_proto_Pose_init_default;
+	ret.has_position = true;
+	ret.position = {pose.position.x, pose.position.y, pose.position.z};
+	ret.has_orientation = true;
+	ret.orientation = {pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z};
+	return ret;
+}
+
+/*
+ *
+ * Frame handling functions.
+ *
+ */
+
+/*!
+ * Build the down message for a completed frame and push it into the pipeline.
+ * Runs on the collector thread in async mode.
+ */
+static void
+push_completed_readback(struct ems_compositor *c, struct ems_readback_inflight *slot)
+{
+	struct xrt_frame *frame = &slot->wrap->base_frame;
+
+	int64_t system_clock = os_monotonic_get_ns();
+	int64_t pipeline_clock = ems_gstreamer_pipeline_get_current_time(c->gstreamer_pipeline);
+
+	em_proto_DownMessage msg = em_proto_DownMessage_init_default;
+	msg.has_frame_data = true;
+	msg.frame_data.frame_sequence_id = slot->frame_id;
+	msg.frame_data.render_begin_time = slot->begin_ns;
+	msg.frame_data.frame_push_time = system_clock;
+	msg.frame_data.frame_push_clock_time = pipeline_clock;
+	msg.frame_data.server_system_clock_pipeline_clock_offset = system_clock - pipeline_clock;
+	msg.frame_data.view_poses_count = 2;
+	msg.frame_data.view_poses[0] = to_proto(slot->view_poses[0]);
+	msg.frame_data.view_poses[1] = to_proto(slot->view_poses[1]);
+
+	slot->wrap = NULL;
+
+	ems_trace_instant("appsrc_push", EMS_TRACE_LANE_READBACK, slot->frame_id, system_clock);
+
+	GBytes *downMsg_bytes = ems_gstreamer_pipeline_encode_down_msg(&msg);
+	ems_gstreamer_src_push_frame(c->gstreamer_src, frame, downMsg_bytes);
+
+	// Dereference this frame - by now we should have pushed it.
+	xrt_frame_reference(&frame, NULL);
+}
+
+/*!
+ * NV12 twin of @ref push_completed_readback: the planes sit in the slot's own
+ * staging buffer, which stays untouched until the slot is recycled, so pushing
+ * from the collector thread is safe. Runs on the collector thread.
+ */
+static void
+push_completed_nv12(struct ems_compositor *c, struct ems_readback_inflight *slot)
+{
+	int64_t system_clock = os_monotonic_get_ns();
+	int64_t pipeline_clock = ems_gstreamer_pipeline_get_current_time(c->gstreamer_pipeline);
+
+	em_proto_DownMessage msg = em_proto_DownMessage_init_default;
+	msg.has_frame_data = true;
+	msg.frame_data.frame_sequence_id = slot->frame_id;
+	msg.frame_data.render_begin_time = slot->begin_ns;
+	msg.frame_data.frame_push_time = system_clock;
+	msg.frame_data.frame_push_clock_time = pipeline_clock;
+	msg.frame_data.server_system_clock_pipeline_clock_offset = system_clock - pipeline_clock;
+	msg.frame_data.view_poses_count = 2;
+	msg.frame_data.view_poses[0] = to_proto(slot->view_poses[0]);
+	msg.frame_data.view_poses[1] = to_proto(slot->view_poses[1]);
+
+	ems_trace_instant("appsrc_push", EMS_TRACE_LANE_READBACK, slot->frame_id, system_clock);
+
+	GBytes *downMsg_bytes = ems_gstreamer_pipeline_encode_down_msg(&msg);
+	ems_gstreamer_src_push_nv12(c->gstreamer_src, slot->nv12.mapped, (size_t)slot->nv12.size, slot->nv12.width,
+	                            slot->nv12.height, downMsg_bytes);
+
+	slot->nv12.mapped = NULL;
+}
+
+static void *
+readback_thread_func(void *ptr)
+{
+	struct ems_compositor *c = (struct ems_compositor *)ptr;
+	struct vk_bundle *vk = get_vk(c);
+
+	os_thread_helper_lock(&c->readback.oth);
+	while (os_thread_helper_is_running_locked(&c->readback.oth)) {
+		if (c->readback.tail == c->readback.head) {
+			os_thread_helper_wait_locked(&c->readback.oth);
+			continue;
+		}
+
+		struct ems_readback_inflight *slot =
+			&c->readback.slots[c->readback.tail % ARRAY_SIZE(c->readback.slots)];
+		os_thread_helper_unlock(&c->readback.oth);
+
+		int64_t readback_frame_id = slot->frame_id;
+		int64_t readback_begin_ns = os_monotonic_get_ns();
+
+		VkResult ret = vk->vkWaitForFences(vk->device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_ERROR(c, "vkWaitForFences: %s", vk_result_string(ret));
+		}
+
+		// How long the blit sat in the queue plus ran, to see whether the
+		// queue priority holds up when the app loads the GPU.
+		c->readback.submit_to_done_ms = (float)time_ns_to_ms_f(os_monotonic_get_ns() - slot->submit_ns);
+
+		if (slot->wrap != NULL) {
+			push_completed_readback(c, slot);
+		} else if (slot->nv12.mapped != NULL) {
+			push_completed_nv12(c, slot);
+		}
+
+		ems_trace_slice("readback", EMS_TRACE_LANE_READBACK, readback_frame_id, readback_begin_ns,
+		                os_monotonic_get_ns());
+
+		vk_cmd_pool_lock(&slot->cmd_pool);
+		vk->vkFreeCommandBuffers(vk->device, slot->cmd_pool.pool, 1, &slot->cmd);
+		vk_cmd_pool_unlock(&slot->cmd_pool);
+		slot->cmd = VK_NULL_HANDLE;
+
+		os_thread_helper_lock(&c->readback.oth);
+		c->readback.tail++;
+		// Wake a producer that may be waiting for a free slot.
+		os_thread_helper_signal_locked(&c->readback.oth);
+	}
+	os_thread_helper_unlock(&c->readback.oth);
+
+	return NULL;
+}
+
+/*!
+ * Grab the next free slot of the readback ring, or NULL if all of them are
+ * still in flight on the GPU. Only called from the frame loop, which is the
+ * sole producer, so the returned slot stays ours until it is published.
+ */
+static struct ems_readback_inflight *
+readback_acquire_slot(struct ems_compositor *c)
+{
+	os_thread_helper_lock(&c->readback.oth);
+	bool full = c->readback.head - c->readback.tail >= ARRAY_SIZE(c->readback.slots);
+	struct ems_readback_inflight *slot = &c->readback.slots[c->readback.head % ARRAY_SIZE(c->readback.slots)];
+	os_thread_helper_unlock(&c->readback.oth);
+
+	return full ? NULL : slot;
+}
+
+/*!
+ * Submit the recorded blit/copy work with a fence and enqueue it for the
+ * collector thread, returning without waiting on the GPU. Takes ownership of
+ * @p wrap and @p cmd on success. @p wrap is NULL when the slot carries an NV12
+ * conversion instead. Called with the slot's command pool locked.
+ */
+static bool
+submit_readback_async(struct ems_compositor *c,
+                      struct ems_readback_inflight *slot,
+                      VkCommandBuffer cmd,
+                      struct vk_image_readback_to_xf *wrap,
+                      int64_t frame_id,
+                      int64_t begin_ns,
+                      const struct xrt_layer_projection_view_data *lvd,
+                      const struct xrt_layer_projection_view_data *rvd)
+{
+	struct vk_bundle *vk = &c->base.vk;
+
+	VkResult ret = vk->vkEndCommandBuffer(cmd);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vkEndCommandBuffer: %s", vk_result_string(ret));
+		return false;
+	}
+
+	vk->vkResetFences(vk->device, 1, &slot->fence);
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &cmd;
+
+	ret = vk_locked_submit(vk, vk->queue, 1, &submit_info, slot->fence);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_locked_submit: %s", vk_result_string(ret));
+		return false;
+	}
+
+	// Fill the slot before publishing it via head, the mutex orders this
+	// against the collector's read.
+	slot->cmd = cmd;
+	slot->wrap = wrap;
+	slot->frame_id = frame_id;
+	slot->begin_ns = begin_ns;
+	slot->submit_ns = os_monotonic_get_ns();
+	slot->view_poses[0] = lvd->pose;
+	slot->view_poses[1] = rvd->pose;
+
+	os_thread_helper_lock(&c->readback.oth);
+	c->readback.head++;
+	os_thread_helper_signal_locked(&c->readback.oth);
+	os_thread_helper_unlock(&c->readback.oth);
+
+	return true;
+}
+
+static bool
+compositor_init_readback_engine(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	if (!debug_get_bool_option_async_readback()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(c->readback.slots); i++) {
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkResult ret = vk->vkCreateFence(vk->device, &fence_info, NULL, &c->readback.slots[i].fence);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vkCreateFence: %s", vk_result_string(ret));
+			return false;
+		}
+
+		ret = vk_cmd_pool_init(vk, &c->readback.slots[i].cmd_pool, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_WARN(c, "vk_cmd_pool_init: %s", vk_result_string(ret));
+			return false;
+		}
+	}
+
+	if (os_thread_helper_init(&c->readback.oth) != 0) {
+		return false;
+	}
+	if (os_thread_helper_start(&c->readback.oth, readback_thread_func, c) != 0) {
+		os_thread_helper_destroy(&c->readback.oth);
+		return false;
+	}
+
+	EMS_COMP_INFO(c, "Async readback engine running with up to %d frames in flight.", EMS_READBACK_MAX_IN_FLIGHT);
+
+	return true;
+}
+
+static void
+compositor_fini_readback_engine(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	if (c->readback.running) {
+		os_thread_helper_stop_and_wait(&c->readback.oth);
+		os_thread_helper_destroy(&c->readback.oth);
+		c->readback.running = false;
+	}
+
+	// Drain anything the collector did not get to.
+	while (c->readback.tail != c->readback.head) {
+		struct ems_readback_inflight *slot =
+			&c->readback.slots[c->readback.tail % ARRAY_SIZE(c->readback.slots)];
+
+		vk->vkWaitForFences(vk->device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+
+		if (slot->wrap != NULL) {
+			struct xrt_frame *frame = &slot->wrap->base_frame;
+			slot->wrap = NULL;
+			xrt_frame_reference(&frame, NULL);
+		}
+		slot->nv12.mapped = NULL;
+		if (slot->cmd != VK_NULL_HANDLE) {
+			vk_cmd_pool_lock(&slot->cmd_pool);
+			vk->vkFreeCommandBuffers(vk->device, slot->cmd_pool.pool, 1, &slot->cmd);
+			vk_cmd_pool_unlock(&slot->cmd_pool);
+			slot->cmd = VK_NULL_HANDLE;
+		}
+		c->readback.tail++;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(c->readback.slots); i++) {
+		if (c->readback.slots[i].fence != VK_NULL_HANDLE) {
+			vk->vkDestroyFence(vk->device, c->readback.slots[i].fence, NULL);
+			c->readback.slots[i].fence = VK_NULL_HANDLE;
+		}
+		if (c->readback.slots[i].cmd_pool.pool != VK_NULL_HANDLE) {
+			vk_cmd_pool_destroy(vk, &c->readback.slots[i].cmd_pool);
+		}
+	}
+}
+
+static void
+dmabuf_frame_released(gpointer data)
+{
+	struct ems_dmabuf_frame *frame = (struct ems_dmabuf_frame *)data;
+	frame->in_flight = false;
+}
+
+/*!
+ * Zero-copy variant of @ref pack_blit_and_encode: blit the two views directly
+ * into an exported linear image and push its DMABUF fd into the pipeline.
+ */
+static void
+pack_blit_and_encode_dmabuf(struct ems_compositor *c,
+                            int64_t frame_id,
+                            int64_t begin_ns,
+                            const struct xrt_layer_projection_view_data *lvd,
+                            const struct xrt_layer_projection_view_data *rvd,
+                            struct comp_swapchain *lsc,
+                            struct comp_swapchain *rsc,
+                            bool flip_y)
+{
+	struct vk_bundle *vk = &c->base.vk;
+
+	// Getting a frame that the pipeline is not holding on to.
+	struct ems_dmabuf_frame *frame = NULL;
+	for (size_t i = 0; i < ARRAY_SIZE(c->dmabuf.frames); i++) {
+		if (!c->dmabuf.frames[i].in_flight) {
+			frame = &c->dmabuf.frames[i];
+			break;
+		}
+	}
+	if (frame == NULL) {
+		EMS_COMP_ERROR(c, "All DMABUF frames in flight, is the pipeline consuming buffers?");
+		return;
+	}
+
+	const VkCommandBufferUsageFlags flags = 0;
+	VkCommandBuffer cmd = {};
+
+	vk_cmd_pool_lock(&c->cmd_pool);
+
+	VkResult ret = vk_cmd_pool_create_and_begin_cmd_buffer_locked(vk, &c->cmd_pool, flags, &cmd);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_create_and_begin_cmd_buffer_locked: %s", vk_result_string(ret));
+		vk_cmd_pool_unlock(&c->cmd_pool);
+		return;
+	}
+
+	// Blit two views side-by-side directly onto the exported image (does
+	// scaling). The exported images are negotiated with the pipeline once
+	// at init, so this path sticks to c->stream.size and ignores config
+	// updates, see pack_blit_and_encode.
+	{
+		struct vk_cmd_blit_images_side_by_side_info info = {};
+
+		info.src[0].old_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.src[0].src_access_mask = VK_ACCESS_SHADER_READ_BIT;
+		info.src[0].src_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.src[0].rect = lvd->sub.rect;
+		info.src[0].fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.src[0].fm_image.base_array_layer = lvd->sub.array_index;
+		info.src[0].fm_image.image = lsc->vkic.images[lvd->sub.image_index].handle;
+
+		if (flip_y) {
+			info.src[0].rect.offset.h += info.src[0].rect.extent.h;
+			info.src[0].rect.extent.h = -info.src[0].rect.extent.h;
+		}
+
+		info.src[1].old_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.src[1].src_access_mask = VK_ACCESS_SHADER_READ_BIT;
+		info.src[1].src_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.src[1].rect = rvd->sub.rect;
+		info.src[1].fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.src[1].fm_image.base_array_layer = rvd->sub.array_index;
+		info.src[1].fm_image.image = rsc->vkic.images[rvd->sub.image_index].handle;
+
+		if (flip_y) {
+			info.src[1].rect.offset.h += info.src[1].rect.extent.h;
+			info.src[1].rect.extent.h = -info.src[1].rect.extent.h;
+		}
+
+		info.dst.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		info.dst.src_access_mask = VK_ACCESS_TRANSFER_READ_BIT;
+		info.dst.src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.dst.size = c->stream.size;
+		info.dst.fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.dst.fm_image.base_array_layer = 0;
+		info.dst.fm_image.image = frame->image;
+
+		vk_cmd_blit_images_side_by_side_locked(vk, cmd, &info);
+	}
+
+	// Barrier images back, make the exported image ready for external read.
+	{
+		for (int view = 0; view < 2; view++) {
+			const xrt_layer_projection_view_data *data = (view == 0) ? lvd : rvd;
+			struct comp_swapchain *sc = (view == 0) ? lsc : rsc;
+
+			VkImageSubresourceRange view_subresource_range = {
+				VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, data->sub.array_index, 1,
+			};
+
+			vk_cmd_image_barrier_locked( //
+				vk, // vk_bundle
+				cmd, // cmd_buffer
+				sc->vkic.images[data->sub.image_index].handle, // image
+				VK_ACCESS_TRANSFER_READ_BIT, // srcAccessMask
+				VK_ACCESS_SHADER_READ_BIT, // dstAccessMask
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // oldImageLayout
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // newImageLayout
+				VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
+				view_subresource_range); // subresourceRange
+		}
+
+		VkImageSubresourceRange first_color_level_subresource_range = {
+			VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1,
+		};
+
+		vk_cmd_image_barrier_locked( //
+			vk, // vk_bundle
+			cmd, // cmd_buffer
+			frame->image, // image
+			VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
+			VK_ACCESS_MEMORY_READ_BIT, // dstAccessMask
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // oldImageLayout
+			VK_IMAGE_LAYOUT_GENERAL, // newImageLayout
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, // dstStageMask
+			first_color_level_subresource_range); // subresourceRange
+	}
+
+	// Waits for command to finish.
+	ret = vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked(vk, &c->cmd_pool, cmd);
+
+	vk_cmd_pool_unlock(&c->cmd_pool);
+
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked: %s", vk_result_string(ret));
+		return;
+	}
+
+	int64_t system_clock = os_monotonic_get_ns();
+	int64_t pipeline_clock = ems_gstreamer_pipeline_get_current_time(c->gstreamer_pipeline);
+
+	// Set the latest Downstream msg before pushing the frame
+	em_proto_DownMessage msg = em_proto_DownMessage_init_default;
+	msg.has_frame_data = true;
+	msg.frame_data.frame_sequence_id = frame_id;
+	msg.frame_data.render_begin_time = begin_ns;
+	msg.frame_data.frame_push_time = system_clock;
+	msg.frame_data.frame_push_clock_time = pipeline_clock;
+	msg.frame_data.server_system_clock_pipeline_clock_offset = system_clock - pipeline_clock;
+	msg.frame_data.view_poses_count = 2;
+	msg.frame_data.view_poses[0] = to_proto(lvd->pose);
+	msg.frame_data.view_poses[1] = to_proto(rvd->pose);
+
+	if (!c->pipeline_playing) {
+		ems_gstreamer_pipeline_play(c->gstreamer_pipeline);
+		c->pipeline_playing = true;
+	}
+
+	ems_trace_instant("appsrc_push", EMS_TRACE_LANE_READBACK, frame_id, system_clock);
+
+	GBytes *downMsg_bytes = ems_gstreamer_pipeline_encode_down_msg(&msg);
+
+	frame->in_flight = true;
+
+	ems_gstreamer_src_push_dmabuf( //
+		c->gstreamer_src, //
+		frame->fd, //
+		(uint32_t)c->stream.size.w, //
+		(uint32_t)c->stream.size.h, //
+		frame->stride, //
+		(size_t)frame->size, //
+		downMsg_bytes, //
+		dmabuf_frame_released, //
+		frame); //
+}
+
+/*!
+ * NV12 variant of @ref pack_blit_and_encode: after the side-by-side blit one
+ * compute dispatch converts the bounce image to NV12 planes, which are copied
+ * into a host visible buffer and pushed, skipping videoconvert entirely. In
+ * async mode the copy lands in the slot's own staging buffer and the collector
+ * thread does the push, so this returns without waiting on the GPU.
+ */
+static void
+pack_blit_and_encode_nv12(struct ems_compositor *c,
+                          int64_t frame_id,
+                          int64_t begin_ns,
+                          const struct xrt_layer_projection_view_data *lvd,
+                          const struct xrt_layer_projection_view_data *rvd,
+                          struct comp_swapchain *lsc,
+                          struct comp_swapchain *rsc,
+                          bool flip_y)
+{
+	struct vk_bundle *vk = &c->base.vk;
+	struct ems_nv12_pack *p = &c->nv12.pack;
+
+	// The dispatch and copies below are sized against the pack targets,
+	// which pack_blit_and_encode keeps in sync with the config and scale.
+	const uint32_t width = p->extent.width;
+	const uint32_t height = p->extent.height;
+
+	const VkCommandBufferUsageFlags flags = 0;
+	VkCommandBuffer cmd = {};
+
+	// Record on the in-flight slot's own pool in async mode, so we never
+	// contend with the collector thread freeing finished command buffers.
+	struct ems_readback_inflight *slot = NULL;
+	struct vk_cmd_pool *pool = &c->cmd_pool;
+	uint32_t buffer_index = 0;
+	if (c->readback.running) {
+		slot = readback_acquire_slot(c);
+		if (slot == NULL) {
+			EMS_COMP_WARN(c, "Readback ring full, dropping frame %" PRId64, frame_id);
+			return;
+		}
+		pool = &slot->cmd_pool;
+		// Each slot copies into its own staging buffer.
+		buffer_index = (uint32_t)(slot - c->readback.slots);
+	}
+
+	// For submitting commands.
+	vk_cmd_pool_lock(pool);
+
+	VkResult ret = vk_cmd_pool_create_and_begin_cmd_buffer_locked(vk, pool, flags, &cmd);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_create_and_begin_cmd_buffer_locked: %s", vk_result_string(ret));
+		vk_cmd_pool_unlock(pool);
+		return;
+	}
+
+	// Blit two views side-by-side onto c->bounce.image (does scaling).
+	{
+		struct vk_cmd_blit_images_side_by_side_info info = {};
+
+		info.src[0].old_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.src[0].src_access_mask = VK_ACCESS_SHADER_READ_BIT;
+		info.src[0].src_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.src[0].rect = lvd->sub.rect;
+		info.src[0].fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.src[0].fm_image.base_array_layer = lvd->sub.array_index;
+		info.src[0].fm_image.image = lsc->vkic.images[lvd->sub.image_index].handle;
+
+		if (flip_y) {
+			info.src[0].rect.offset.h += info.src[0].rect.extent.h;
+			info.src[0].rect.extent.h = -info.src[0].rect.extent.h;
+		}
+
+		info.src[1].old_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.src[1].src_access_mask = VK_ACCESS_SHADER_READ_BIT;
+		info.src[1].src_stage_mask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.src[1].rect = rvd->sub.rect;
+		info.src[1].fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.src[1].fm_image.base_array_layer = rvd->sub.array_index;
+		info.src[1].fm_image.image = rsc->vkic.images[rvd->sub.image_index].handle;
+
+		if (flip_y) {
+			info.src[1].rect.offset.h += info.src[1].rect.extent.h;
+			info.src[1].rect.extent.h = -info.src[1].rect.extent.h;
+		}
+
+		info.dst.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		info.dst.src_access_mask = VK_ACCESS_TRANSFER_READ_BIT;
+		info.dst.src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.dst.size = c->stream.size;
+		info.dst.fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.dst.fm_image.base_array_layer = 0;
+		info.dst.fm_image.image = c->bounce.image;
+
+		vk_cmd_blit_images_side_by_side_locked(vk, cmd, &info);
+	}
+
+	VkImageSubresourceRange first_color_level_subresource_range = {
+		VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1,
+	};
+
+	// Make the bounce image readable by the compute pass and the plane
+	// targets writable by it.
+	{
+		vk_cmd_image_barrier_locked( //
+			vk, // vk_bundle
+			cmd, // cmd_buffer
+			c->bounce.image, // image
+			VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
+			VK_ACCESS_SHADER_READ_BIT, // dstAccessMask
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // oldImageLayout
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // newImageLayout
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
+			first_color_level_subresource_range); // subresourceRange
+
+		VkImage plane_images[2] = {p->y_image, p->uv_image};
+		for (uint32_t i = 0; i < ARRAY_SIZE(plane_images); i++) {
+			vk_cmd_image_barrier_locked( //
+				vk, // vk_bundle
+				cmd, // cmd_buffer
+				plane_images[i], // image
+				0, // srcAccessMask
+				VK_ACCESS_SHADER_WRITE_BIT, // dstAccessMask
+				VK_IMAGE_LAYOUT_UNDEFINED, // oldImageLayout
+				VK_IMAGE_LAYOUT_GENERAL, // newImageLayout
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
+				first_color_level_subresource_range); // subresourceRange
+		}
+	}
+
+	// The conversion dispatch itself, one invocation per 2x2 quad.
+	{
+		vk->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, p->pipeline);
+		vk->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, p->pipeline_layout, 0, 1,
+		                            &p->descriptor_set, 0, NULL);
+
+		uint32_t extent[2] = {width, height};
+		vk->vkCmdPushConstants(cmd, p->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(extent), extent);
+
+		uint32_t group_x = (width / 2 + 7) / 8;
+		uint32_t group_y = (height / 2 + 7) / 8;
+		vk->vkCmdDispatch(cmd, group_x, group_y, 1);
+	}
+
+	// Copy both planes into the host visible buffer, NV12 layout.
+	{
+		struct
+		{
+			VkImage image;
+			VkExtent3D extent;
+			VkDeviceSize offset;
+		} planes[2] = {
+			{p->y_image, {width, height, 1}, 0},
+			{p->uv_image, {width / 2, height / 2, 1}, (VkDeviceSize)width * height},
+		};
+
+		for (uint32_t i = 0; i < ARRAY_SIZE(planes); i++) {
+			vk_cmd_image_barrier_locked( //
+				vk, // vk_bundle
+				cmd, // cmd_buffer
+				planes[i].image, // image
+				VK_ACCESS_SHADER_WRITE_BIT, // srcAccessMask
+				VK_ACCESS_TRANSFER_READ_BIT, // dstAccessMask
+				VK_IMAGE_LAYOUT_GENERAL, // oldImageLayout
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // newImageLayout
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // srcStageMask
+				VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+				first_color_level_subresource_range); // subresourceRange
+
+			VkBufferImageCopy copy = {};
+			copy.bufferOffset = planes[i].offset;
+			copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			copy.imageExtent = planes[i].extent;
+
+			vk->vkCmdCopyImageToBuffer(cmd, planes[i].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			                           p->buffers[buffer_index], 1, &copy);
+		}
+	}
+
+	// Bring views from TRANSFER ready to COMPUTE ready.
+	for (int view = 0; view < 2; view++) {
+		const xrt_layer_projection_view_data *data = (view == 0) ? lvd : rvd;
+		struct comp_swapchain *sc = (view == 0) ? lsc : rsc;
+
+		VkImageSubresourceRange view_subresource_range = {
+			VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, data->sub.array_index, 1,
+		};
+
+		vk_cmd_image_barrier_locked( //
+			vk, // vk_bundle
+			cmd, // cmd_buffer
+			sc->vkic.images[data->sub.image_index].handle, // image
+			VK_ACCESS_TRANSFER_READ_BIT, // srcAccessMask
+			VK_ACCESS_SHADER_READ_BIT, // dstAccessMask
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // oldImageLayout
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // newImageLayout
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
+			view_subresource_range); // subresourceRange
+	}
+
+	// Done submitting commands.
+
+	if (slot != NULL) {
+		// Hand the work off to the collector thread instead of waiting.
+		if (!c->pipeline_playing) {
+			ems_gstreamer_pipeline_play(c->gstreamer_pipeline);
+			c->pipeline_playing = true;
+		}
+
+		// The collector pushes the planes from the slot's staging
+		// buffer, which stays untouched until the slot is recycled.
+		slot->nv12.mapped = p->mapped[buffer_index];
+		slot->nv12.size = p->buffer_size;
+		slot->nv12.width = width;
+		slot->nv12.height = height;
+
+		bool submitted = submit_readback_async(c, slot, cmd, NULL, frame_id, begin_ns, lvd, rvd);
+		if (!submitted) {
+			slot->nv12.mapped = NULL;
+			vk->vkFreeCommandBuffers(vk->device, pool->pool, 1, &cmd);
+		}
+		vk_cmd_pool_unlock(pool);
+		return;
+	}
+
+	// Waits for command to finish.
+	ret = vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked(vk, pool, cmd);
+
+	// Unlock before checking.
+	vk_cmd_pool_unlock(pool);
+
+	// Do checking here.
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked: %s", vk_result_string(ret));
+		return;
+	}
+
+	int64_t system_clock = os_monotonic_get_ns();
+	int64_t pipeline_clock = ems_gstreamer_pipeline_get_current_time(c->gstreamer_pipeline);
+
+	// Set the latest Downstream msg before pushing the frame
+	em_proto_DownMessage msg = em_proto_DownMessage_init_default;
+	msg.has_frame_data = true;
+	msg.frame_data.frame_sequence_id = frame_id;
+	msg.frame_data.render_begin_time = begin_ns;
+	msg.frame_data.frame_push_time = system_clock;
+	msg.frame_data.frame_push_clock_time = pipeline_clock;
+	msg.frame_data.server_system_clock_pipeline_clock_offset = system_clock - pipeline_clock;
+	msg.frame_data.view_poses_count = 2;
+	msg.frame_data.view_poses[0] = to_proto(lvd->pose);
+	msg.frame_data.view_poses[1] = to_proto(rvd->pose);
+
+	if (!c->pipeline_playing) {
+		ems_gstreamer_pipeline_play(c->gstreamer_pipeline);
+		c->pipeline_playing = true;
+	}
+
+	ems_trace_instant("appsrc_push", EMS_TRACE_LANE_READBACK, frame_id, system_clock);
+
+	GBytes *downMsg_bytes = ems_gstreamer_pipeline_encode_down_msg(&msg);
+	ems_gstreamer_src_push_nv12(c->gstreamer_src, p->mapped[0], (size_t)p->buffer_size, width, height,
+	                            downMsg_bytes);
+}
+
+/*!
+ * Pick up a hot-reloaded device config between frames.
+ *
+ * Only the stream resolution can be applied to a live session, through the
+ * same pool/caps swap a scale switch uses; refresh rate and FOV are consumed
+ * at device creation and wait for the next session.
+ */
+static void
+compositor_apply_config_update(struct ems_compositor *c)
+{
+	const uint64_t version = ems_config_get_version();
+	if (version == c->stream.applied_config_version) {
+		return;
+	}
+	c->stream.applied_config_version = version;
+
+	const struct ems_device_config *config = ems_config_get();
+	struct xrt_size size = config->resolution_stream_stereo_pixels;
+
+	// The bounce image every streamed frame goes through is allocated once
+	// at startup, streaming above that size needs a new session.
+	if ((uint32_t)size.w > c->bounce.extent.width || (uint32_t)size.h > c->bounce.extent.height) {
+		EMS_COMP_WARN(c, "Config stream size %dx%d exceeds the allocated %ux%u, clamping.", //
+		              size.w, size.h, c->bounce.extent.width, c->bounce.extent.height);
+		if ((uint32_t)size.w > c->bounce.extent.width) {
+			size.w = (int32_t)c->bounce.extent.width;
+		}
+		if ((uint32_t)size.h > c->bounce.extent.height) {
+			size.h = (int32_t)c->bounce.extent.height;
+		}
+	}
+
+	if (size.w == c->stream.full.w && size.h == c->stream.full.h) {
+		return;
+	}
+
+	EMS_COMP_INFO(c, "Device config v%" PRIu64 ": stream size %dx%d -> %dx%d.", version, //
+	              c->stream.full.w, c->stream.full.h, size.w, size.h);
+
+	c->stream.full = size;
+
+	// Invalidate the applied scale so the switch below runs even when the
+	// percentage itself did not move.
+	c->stream.scale_percent = 0;
+}
+
+/*!
+ * Apply a pending stream scale switch, called from the frame loop between
+ * frames. Waits out every in-flight readback so nothing still references the
+ * old pool, then reallocates the pool (and on the NV12 path the plane targets)
+ * and renegotiates the appsrc caps. The bounce image stays at its allocated
+ * size and is only partially filled, so the blit does not need to be rebuilt.
+ */
+static void
+compositor_apply_stream_scale(struct ems_compositor *c)
+{
+	uint32_t percent = c->stream.requested_scale_percent;
+	if (percent == c->stream.scale_percent) {
+		return;
+	}
+
+	struct vk_bundle *vk = get_vk(c);
+
+	// Encoders refuse odd sizes, see complain_if_wrong_image_size.
+	struct xrt_size size = {};
+	size.w = (int32_t)((uint32_t)c->stream.full.w * percent / 100 & ~1u);
+	size.h = (int32_t)((uint32_t)c->stream.full.h * percent / 100 & ~1u);
+
+	EMS_COMP_INFO(c, "Switching stream resolution %dx%d -> %dx%d (%u%%).", //
+	              c->stream.size.w, c->stream.size.h, size.w, size.h, percent);
+
+	// Wait for the collector to finish every in-flight frame, they hold
+	// images from the pool we are about to destroy.
+	if (c->readback.running) {
+		os_thread_helper_lock(&c->readback.oth);
+		while (c->readback.tail != c->readback.head) {
+			os_thread_helper_wait_locked(&c->readback.oth);
+		}
+		os_thread_helper_unlock(&c->readback.oth);
+	}
 
-	// Refresh rates.
-	sys_info->refresh_rate_count = 1;
-	sys_info->refresh_rates_hz[0] = (float)(1. / time_ns_to_s(c->settings.frame_interval_ns));
+	vk_image_readback_to_xf_pool_destroy(vk, &c->pool);
 
-	return true;
-}
+	VkExtent2D extent = {(uint32_t)size.w, (uint32_t)size.h};
 
-static inline em_proto_Pose
-to_proto(const struct xrt_pose &pose)
-{
-	em_proto_Pose ret = em_proto_Pose_init_default;
-	ret.has_position = true;
-	ret.position = {pose.position.x, pose.position.y, pose.position.z};
-	ret.has_orientation = true;
-	ret.orientation = {pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z};
-	return ret;
-}
+	vk_image_readback_to_xf_pool_create( //
+		vk, // vk_bundle
+		extent, // extent
+		&c->pool, // out_pool
+		XRT_FORMAT_R8G8B8X8, // xrt_format
+		VK_FORMAT_R8G8B8A8_UNORM); // vk_format
 
-/*
- *
- * Frame handling functions.
- *
- */
+	// The NV12 plane targets and staging buffers are sized to the stream,
+	// rebuild them and repoint the descriptor set at the new extent. The
+	// ring drain above guarantees the GPU is done with the old ones.
+	if (c->nv12.enabled) {
+		compositor_nv12_pack_free_targets(c);
+		if (compositor_nv12_pack_alloc_targets(c, extent)) {
+			compositor_nv12_pack_write_descriptors(c);
+		} else {
+			// The appsrc was negotiated as NV12, there is no way
+			// back to the videoconvert pipeline mid-session.
+			EMS_COMP_ERROR(c, "Failed to rebuild NV12 targets, stream needs a reconnect.");
+			compositor_nv12_pack_free_targets(c);
+			c->nv12.enabled = false;
+		}
+	}
+
+	ems_gstreamer_src_set_resolution(c->gstreamer_src, &size);
+
+	c->stream.size = size;
+	c->stream.scale_percent = percent;
+}
 
 void
 pack_blit_and_encode(struct ems_compositor *c,
@@ -349,6 +1796,23 @@ pack_blit_and_encode(struct ems_compositor *c,
 		c->gstreamer_src->offset_ns = now;
 	}
 
+	if (c->dmabuf.enabled) {
+		// The exported images are negotiated with the pipeline once at
+		// init, this path keeps its fixed resolution.
+		pack_blit_and_encode_dmabuf(c, frame_id, begin_ns, lvd, rvd, lsc, rsc, flip_y);
+		return;
+	}
+
+	// Both the readback and NV12 paths stream at c->stream.size, pick up
+	// config and scale changes before recording against their targets.
+	compositor_apply_config_update(c);
+	compositor_apply_stream_scale(c);
+
+	if (c->nv12.enabled) {
+		pack_blit_and_encode_nv12(c, frame_id, begin_ns, lvd, rvd, lsc, rsc, flip_y);
+		return;
+	}
+
 	struct vk_image_readback_to_xf *wrap = NULL;
 	struct vk_bundle *vk = &c->base.vk;
 
@@ -367,19 +1831,32 @@ pack_blit_and_encode(struct ems_compositor *c,
 	const VkCommandBufferUsageFlags flags = 0;
 	VkCommandBuffer cmd = {};
 
+	// Record on the in-flight slot's own pool in async mode, so we never
+	// contend with the collector thread freeing finished command buffers.
+	struct ems_readback_inflight *slot = NULL;
+	struct vk_cmd_pool *pool = &c->cmd_pool;
+	if (c->readback.running) {
+		slot = readback_acquire_slot(c);
+		if (slot == NULL) {
+			EMS_COMP_WARN(c, "Readback ring full, dropping frame %" PRId64, frame_id);
+			xrt_frame_reference(&frame, NULL);
+			return;
+		}
+		pool = &slot->cmd_pool;
+	}
+
 	// For submitting commands.
-	vk_cmd_pool_lock(&c->cmd_pool);
+	vk_cmd_pool_lock(pool);
 
-	VkResult ret = vk_cmd_pool_create_and_begin_cmd_buffer_locked(vk, &c->cmd_pool, flags, &cmd);
+	VkResult ret = vk_cmd_pool_create_and_begin_cmd_buffer_locked(vk, pool, flags, &cmd);
 	if (ret != VK_SUCCESS) {
 		EMS_COMP_ERROR(c, "vk_cmd_pool_create_and_begin_cmd_buffer_locked: %s", vk_result_string(ret));
 		// Error, unref the frame and return.
+		vk_cmd_pool_unlock(pool);
 		xrt_frame_reference(&frame, NULL);
 		return;
 	}
 
-	const struct ems_device_config *config = ems_config_get();
-
 	// Blit two views side-by-side onto c->bounce.image (does scaling).
 	{
 		struct vk_cmd_blit_images_side_by_side_info info = {};
@@ -413,7 +1890,7 @@ pack_blit_and_encode(struct ems_compositor *c,
 		info.dst.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 		info.dst.src_access_mask = VK_ACCESS_TRANSFER_READ_BIT;
 		info.dst.src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		info.dst.size = config->resolution_stream_stereo_pixels;
+		info.dst.size = c->stream.size;
 		info.dst.fm_image.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
 		info.dst.fm_image.base_array_layer = 0;
 		info.dst.fm_image.image = c->bounce.image;
@@ -439,7 +1916,7 @@ pack_blit_and_encode(struct ems_compositor *c,
 		info.dst.fm_image.base_array_layer = 0;
 		info.dst.fm_image.image = wrap->image;
 
-		info.size = config->resolution_stream_stereo_pixels;
+		info.size = c->stream.size;
 
 		vk_cmd_copy_image_locked(vk, cmd, &info);
 	}
@@ -492,11 +1969,30 @@ pack_blit_and_encode(struct ems_compositor *c,
 
 	// Done submitting commands.
 
+	if (slot != NULL) {
+		// Hand the work off to the collector thread instead of waiting.
+		if (!c->pipeline_playing) {
+			ems_gstreamer_pipeline_play(c->gstreamer_pipeline);
+			c->pipeline_playing = true;
+		}
+
+		bool submitted = submit_readback_async(c, slot, cmd, wrap, frame_id, begin_ns, lvd, rvd);
+		if (!submitted) {
+			vk->vkFreeCommandBuffers(vk->device, pool->pool, 1, &cmd);
+		}
+		vk_cmd_pool_unlock(pool);
+
+		if (!submitted) {
+			xrt_frame_reference(&frame, NULL);
+		}
+		return;
+	}
+
 	// Waits for command to finish.
-	ret = vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked(vk, &c->cmd_pool, cmd);
+	ret = vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked(vk, pool, cmd);
 
 	// Unlock before checking.
-	vk_cmd_pool_unlock(&c->cmd_pool);
+	vk_cmd_pool_unlock(pool);
 
 	// Do checking here.
 	if (ret != VK_SUCCESS) {
@@ -530,6 +2026,8 @@ pack_blit_and_encode(struct ems_compositor *c,
 	// Commented to fix crash on Android
 	// u_sink_debug_push_frame(&c->debug_sink, frame);
 
+	ems_trace_instant("appsrc_push", EMS_TRACE_LANE_READBACK, frame_id, system_clock);
+
 	GBytes *downMsg_bytes = ems_gstreamer_pipeline_encode_down_msg(&msg);
 	ems_gstreamer_src_push_frame(c->gstreamer_src, frame, downMsg_bytes);
 
@@ -563,6 +2061,46 @@ ems_compositor_end_session(struct xrt_compositor *xc)
 	return XRT_SUCCESS;
 }
 
+/// How far ahead of a client vsync the snapped cadence aims, so encoded
+/// frames consistently arrive just before the client compositor's deadline
+/// instead of just after it, which costs a whole refresh of queueing.
+static constexpr int64_t kClientVsyncMarginNs = 2 * U_TIME_1MS_IN_NS;
+
+/*!
+ * Phase-align the fake pacer's schedule with the client's display.
+ *
+ * The pacer free-runs at the nominal refresh rate with an arbitrary phase.
+ * Once the pipeline can map the client's reported display times into our
+ * clock (see @ref ems_gstreamer_pipeline_get_client_vsync_anchor), shift the
+ * whole schedule by less than a period so the predicted display times sit a
+ * small margin ahead of the client's vsync grid. The cadence is unchanged,
+ * only the phase moves.
+ */
+static void
+compositor_align_to_client_vsync(struct ems_compositor *c, int64_t now_ns, int64_t *wake_time_ns, int64_t *display_time_ns)
+{
+	int64_t anchor_ns = 0;
+	if (c->gstreamer_pipeline == NULL ||
+	    !ems_gstreamer_pipeline_get_client_vsync_anchor(c->gstreamer_pipeline, &anchor_ns)) {
+		return;
+	}
+
+	const int64_t period_ns = (int64_t)c->settings.frame_interval_ns;
+	const int64_t target_ns = *display_time_ns + kClientVsyncMarginNs;
+
+	// Nearest point on the client's grid, then back off the margin.
+	const int64_t cycles = (2 * (target_ns - anchor_ns) + period_ns) / (2 * period_ns);
+	int64_t delta_ns = anchor_ns + cycles * period_ns - kClientVsyncMarginNs - *display_time_ns;
+
+	// Never schedule the wake into the past, rather wait out one more vsync.
+	if (*wake_time_ns + delta_ns < now_ns) {
+		delta_ns += period_ns;
+	}
+
+	*wake_time_ns += delta_ns;
+	*display_time_ns += delta_ns;
+}
+
 static xrt_result_t
 ems_compositor_predict_frame(struct xrt_compositor *xc,
                              int64_t *out_frame_id,
@@ -592,6 +2130,8 @@ ems_compositor_predict_frame(struct xrt_compositor *xc,
 		out_predicted_display_period_ns, // out_predicted_display_period_ns
 		&null_min_display_period_ns); // out_min_display_period_ns
 
+	compositor_align_to_client_vsync(c, now_ns, out_wake_time_ns, out_predicted_display_time_ns);
+
 	return XRT_SUCCESS;
 }
 
@@ -636,6 +2176,319 @@ ems_compositor_discard_frame(struct xrt_compositor *xc, int64_t frame_id)
 	return XRT_SUCCESS;
 }
 
+/*
+ *
+ * Quad (UI) layer side stream.
+ *
+ */
+
+//! Magic tag marking a quad layer packet on the ENet message channel.
+//! Must match the client, see em_connection.c.
+#define EM_QUAD_LAYER_MAGIC 0x454D515541443031ULL
+
+/*!
+ * One quad layer update as it travels over the reliable ENet message channel,
+ * followed by @ref payload_size bytes of zlib-compressed RGBA8 rows (top-down,
+ * tightly packed). Layout must match the client, see em_connection.c.
+ */
+struct em_quad_layer_packet
+{
+	uint64_t magic;
+	//! Pixel size of the decompressed payload.
+	uint32_t width;
+	uint32_t height;
+	//! Quad extent in meters.
+	float size_x;
+	float size_y;
+	//! Pose of the quad, interpreted in the client's world space.
+	float position[3];
+	float orientation_xyzw[4];
+	//! 0 hides the quad without discarding the client's pixels.
+	uint32_t visible;
+	//! Compressed bytes following this header, 0 for a placement or
+	//! visibility only update.
+	uint32_t payload_size;
+};
+
+static void
+quad_destroy_staging(struct ems_compositor *c)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	if (c->quad.buffer != VK_NULL_HANDLE) {
+		vk->vkDestroyBuffer(vk->device, c->quad.buffer, NULL);
+		c->quad.buffer = VK_NULL_HANDLE;
+	}
+	if (c->quad.buffer_memory != VK_NULL_HANDLE) {
+		if (c->quad.mapped != NULL) {
+			vk->vkUnmapMemory(vk->device, c->quad.buffer_memory);
+		}
+		vk->vkFreeMemory(vk->device, c->quad.buffer_memory, NULL);
+		c->quad.buffer_memory = VK_NULL_HANDLE;
+		c->quad.mapped = NULL;
+	}
+	c->quad.buffer_size = 0;
+}
+
+//! Make sure the host visible quad staging buffer holds @p size bytes,
+//! mirrors the NV12 readback buffer.
+static bool
+quad_ensure_staging(struct ems_compositor *c, VkDeviceSize size)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	if (c->quad.buffer != VK_NULL_HANDLE && c->quad.buffer_size >= size) {
+		return true;
+	}
+
+	quad_destroy_staging(c);
+
+	VkBufferCreateInfo buffer_info = {};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = size;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult ret = vk->vkCreateBuffer(vk->device, &buffer_info, NULL, &c->quad.buffer);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_WARN(c, "vkCreateBuffer(quad): %s", vk_result_string(ret));
+		return false;
+	}
+
+	VkMemoryRequirements requirements = {};
+	vk->vkGetBufferMemoryRequirements(vk->device, c->quad.buffer, &requirements);
+
+	uint32_t memory_type_index = 0;
+	if (!vk_get_memory_type(vk, requirements.memoryTypeBits,
+	                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                        &memory_type_index)) {
+		EMS_COMP_WARN(c, "No memory type for quad readback buffer.");
+		quad_destroy_staging(c);
+		return false;
+	}
+
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = requirements.size;
+	alloc_info.memoryTypeIndex = memory_type_index;
+
+	ret = vk->vkAllocateMemory(vk->device, &alloc_info, NULL, &c->quad.buffer_memory);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_WARN(c, "vkAllocateMemory(quad): %s", vk_result_string(ret));
+		quad_destroy_staging(c);
+		return false;
+	}
+
+	vk->vkBindBufferMemory(vk->device, c->quad.buffer, c->quad.buffer_memory, 0);
+
+	ret = vk->vkMapMemory(vk->device, c->quad.buffer_memory, 0, VK_WHOLE_SIZE, 0, &c->quad.mapped);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_WARN(c, "vkMapMemory(quad): %s", vk_result_string(ret));
+		quad_destroy_staging(c);
+		return false;
+	}
+
+	c->quad.buffer_size = size;
+
+	return true;
+}
+
+/*!
+ * Read the quad's submitted image back into the staging buffer.
+ *
+ * A blocking one-shot submit is fine here: it only runs when the quad's
+ * pixels actually changed, which for static UI is rare.
+ */
+static bool
+quad_read_back_image(struct ems_compositor *c, struct comp_swapchain *sc, const struct xrt_layer_quad_data *data)
+{
+	struct vk_bundle *vk = get_vk(c);
+
+	const VkCommandBufferUsageFlags flags = 0;
+	VkCommandBuffer cmd = {};
+
+	vk_cmd_pool_lock(&c->cmd_pool);
+
+	VkResult ret = vk_cmd_pool_create_and_begin_cmd_buffer_locked(vk, &c->cmd_pool, flags, &cmd);
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_create_and_begin_cmd_buffer_locked: %s", vk_result_string(ret));
+		vk_cmd_pool_unlock(&c->cmd_pool);
+		return false;
+	}
+
+	VkImage image = sc->vkic.images[data->sub.image_index].handle;
+
+	VkImageSubresourceRange subresource_range = {
+		VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, data->sub.array_index, 1,
+	};
+
+	vk_cmd_image_barrier_locked( //
+		vk, // vk_bundle
+		cmd, // cmd_buffer
+		image, // image
+		VK_ACCESS_SHADER_READ_BIT, // srcAccessMask
+		VK_ACCESS_TRANSFER_READ_BIT, // dstAccessMask
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // oldImageLayout
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // newImageLayout
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+		subresource_range); // subresourceRange
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, data->sub.array_index, 1};
+	copy.imageOffset = {data->sub.rect.offset.w, data->sub.rect.offset.h, 0};
+	copy.imageExtent = {(uint32_t)data->sub.rect.extent.w, (uint32_t)data->sub.rect.extent.h, 1};
+
+	vk->vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, c->quad.buffer, 1, &copy);
+
+	vk_cmd_image_barrier_locked( //
+		vk, // vk_bundle
+		cmd, // cmd_buffer
+		image, // image
+		VK_ACCESS_TRANSFER_READ_BIT, // srcAccessMask
+		VK_ACCESS_SHADER_READ_BIT, // dstAccessMask
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, // oldImageLayout
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, // newImageLayout
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
+		subresource_range); // subresourceRange
+
+	ret = vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked(vk, &c->cmd_pool, cmd);
+
+	vk_cmd_pool_unlock(&c->cmd_pool);
+
+	if (ret != VK_SUCCESS) {
+		EMS_COMP_ERROR(c, "vk_cmd_pool_end_submit_wait_and_free_cmd_buffer_locked: %s", vk_result_string(ret));
+		return false;
+	}
+
+	return true;
+}
+
+/*!
+ * Build one wire packet for the quad and hand it to the ENet broadcast.
+ * @p pixels is NULL for a placement or visibility only update.
+ */
+static void
+quad_send_packet(struct ems_compositor *c,
+                 const struct xrt_pose &pose,
+                 const struct xrt_vec2 &size,
+                 uint32_t width,
+                 uint32_t height,
+                 bool visible,
+                 const uint8_t *pixels,
+                 bool flip_y)
+{
+	struct em_quad_layer_packet header = {};
+	header.magic = EM_QUAD_LAYER_MAGIC;
+	header.width = width;
+	header.height = height;
+	header.size_x = size.x;
+	header.size_y = size.y;
+	header.position[0] = pose.position.x;
+	header.position[1] = pose.position.y;
+	header.position[2] = pose.position.z;
+	header.orientation_xyzw[0] = pose.orientation.x;
+	header.orientation_xyzw[1] = pose.orientation.y;
+	header.orientation_xyzw[2] = pose.orientation.z;
+	header.orientation_xyzw[3] = pose.orientation.w;
+	header.visible = visible ? 1 : 0;
+	header.payload_size = 0;
+
+	GBytes *bytes = NULL;
+
+	if (pixels == NULL) {
+		bytes = g_bytes_new(&header, sizeof(header));
+	} else {
+		const size_t stride = (size_t)width * 4;
+		const uLong raw_size = (uLong)height * stride;
+
+		// The wire format is top-down, flip here so the client's
+		// upload stays a plain copy.
+		uint8_t *rows = NULL;
+		if (flip_y) {
+			rows = (uint8_t *)g_malloc(raw_size);
+			for (uint32_t y = 0; y < height; y++) {
+				memcpy(rows + (size_t)y * stride, pixels + (size_t)(height - 1 - y) * stride, stride);
+			}
+			pixels = rows;
+		}
+
+		uLongf compressed_size = compressBound(raw_size);
+		uint8_t *packet = (uint8_t *)g_malloc(sizeof(header) + compressed_size);
+
+		// Lossless but light: UI layers are mostly flat color and
+		// text, so even the fastest setting shrinks them a lot.
+		int zret = compress2(packet + sizeof(header), &compressed_size, pixels, raw_size, Z_BEST_SPEED);
+		g_free(rows);
+		if (zret != Z_OK) {
+			EMS_COMP_WARN(c, "compress2(quad): %d", zret);
+			g_free(packet);
+			return;
+		}
+
+		header.payload_size = (uint32_t)compressed_size;
+		memcpy(packet, &header, sizeof(header));
+
+		bytes = g_bytes_new_take(packet, sizeof(header) + compressed_size);
+	}
+
+	ems_gstreamer_pipeline_broadcast_quad_layer(c->gstreamer_pipeline, bytes);
+	g_bytes_unref(bytes);
+}
+
+/*!
+ * Ship a quad layer to the client over the side channel.
+ *
+ * The pixels are read back, compressed and resent only when the app submitted
+ * a new image; a quad that merely moved resends just the header. The image is
+ * copied raw, so only 4 byte per pixel color formats can travel - which
+ * covers the RGBA/BGRA swapchains UI layers use. Only one quad is tracked,
+ * see the caller.
+ */
+static void
+quad_layer_commit(struct ems_compositor *c, comp_layer &layer)
+{
+	const struct xrt_layer_quad_data *data = &layer.data.quad;
+	struct comp_swapchain *sc = (struct comp_swapchain *)layer.sc_array[0];
+
+	const uint32_t width = (uint32_t)data->sub.rect.extent.w;
+	const uint32_t height = (uint32_t)data->sub.rect.extent.h;
+	if (width == 0 || height == 0) {
+		return;
+	}
+
+	// A swapchain image the client has not seen means new pixels; a quad
+	// whose image the app did not re-render keeps its index and stays
+	// clean.
+	bool dirty = (struct xrt_swapchain *)sc != c->quad.shipped_xsc || //
+	             data->sub.image_index != c->quad.shipped_image_index;
+
+	bool moved = memcmp(&data->pose, &c->quad.shipped_pose, sizeof(data->pose)) != 0 ||
+	             memcmp(&data->size, &c->quad.shipped_size, sizeof(data->size)) != 0 || !c->quad.client_visible;
+
+	if (!dirty && !moved) {
+		return;
+	}
+
+	const uint8_t *pixels = NULL;
+	if (dirty) {
+		const VkDeviceSize size = (VkDeviceSize)width * height * 4;
+		if (!quad_ensure_staging(c, size) || !quad_read_back_image(c, sc, data)) {
+			return;
+		}
+		pixels = (const uint8_t *)c->quad.mapped;
+	}
+
+	quad_send_packet(c, data->pose, data->size, width, height, true, pixels, layer.data.flip_y);
+
+	c->quad.shipped_xsc = (struct xrt_swapchain *)sc;
+	c->quad.shipped_image_index = data->sub.image_index;
+	c->quad.shipped_pose = data->pose;
+	c->quad.shipped_size = data->size;
+	c->quad.client_visible = true;
+}
+
 static xrt_result_t
 ems_compositor_layer_commit(struct xrt_compositor *xc, xrt_graphics_sync_handle_t sync_handle)
 {
@@ -657,6 +2510,7 @@ ems_compositor_layer_commit(struct xrt_compositor *xc, xrt_graphics_sync_handle_
 	u_pc_mark_point(c->upc, U_TIMING_POINT_BEGIN, frame_id, begin_ns);
 
 	// We want to render here. comp_base filled c->base.slot.layers for us.
+	bool quad_seen = false;
 	for (uint32_t i = 0; i < c->base.layer_accum.layer_count; i++) {
 		comp_layer &layer = c->base.layer_accum.layers[i];
 
@@ -683,11 +2537,26 @@ ems_compositor_layer_commit(struct xrt_compositor *xc, xrt_graphics_sync_handle_
 			pack_blit_and_encode(c, frame_id, begin_ns, lvd, rvd, left, right, layer.data.flip_y);
 		}
 		break;
+		case XRT_LAYER_QUAD:
+			// Shipped out of band instead of being flattened into
+			// the video stream, so static UI keeps its crisp
+			// pixels. One quad only, extra ones are still dropped.
+			if (!quad_seen) {
+				quad_layer_commit(c, layer);
+				quad_seen = true;
+			}
+			break;
 		default: U_LOG_E("Unhandled layer type %d", layer.data.type);
 			break;
 		}
 	}
 
+	// A quad the app stopped submitting is hidden on the client, once.
+	if (!quad_seen && c->quad.client_visible) {
+		quad_send_packet(c, c->quad.shipped_pose, c->quad.shipped_size, 0, 0, false, NULL, false);
+		c->quad.client_visible = false;
+	}
+
 	// When we are submitting to the GPU.
 	{
 		int64_t now_ns = os_monotonic_get_ns();
@@ -697,6 +2566,8 @@ ems_compositor_layer_commit(struct xrt_compositor *xc, xrt_graphics_sync_handle_
 		u_pc_mark_point(c->upc, U_TIMING_POINT_SUBMIT_END, frame_id, now_ns);
 	}
 
+	ems_trace_slice("layer_commit", EMS_TRACE_LANE_LAYER_COMMIT, frame_id, begin_ns, os_monotonic_get_ns());
+
 	// Now is a good point to garbage collect.
 	comp_swapchain_shared_garbage_collect(&c->base.cscs);
 
@@ -779,10 +2650,24 @@ ems_compositor_destroy(struct xrt_compositor *xc)
 	comp_swapchain_shared_garbage_collect(&c->base.cscs);
 	comp_swapchain_shared_destroy(&c->base.cscs, vk);
 
+	// Stop the collector thread and drain in-flight frames before the
+	// pool they came from goes away.
+	compositor_fini_readback_engine(c);
+
 	vk_image_readback_to_xf_pool_destroy(vk, &c->pool);
 
+	compositor_fini_dmabuf_export(c);
+
 	vk_cmd_pool_destroy(vk, &c->cmd_pool);
 
+	compositor_fini_nv12_pack(c);
+
+	quad_destroy_staging(c);
+
+	if (c->bounce.view != VK_NULL_HANDLE) {
+		vk->vkDestroyImageView(vk->device, c->bounce.view, NULL);
+		c->bounce.view = VK_NULL_HANDLE;
+	}
 	if (c->bounce.image != VK_NULL_HANDLE) {
 		vk->vkDestroyImage(vk->device, c->bounce.image, NULL);
 		vk->vkFreeMemory(vk->device, c->bounce.device_memory, NULL);
@@ -815,6 +2700,26 @@ ems_compositor_destroy(struct xrt_compositor *xc)
  *
  */
 
+void
+ems_compositor_set_stream_scale(struct xrt_compositor *xc, uint32_t scale_percent)
+{
+	struct ems_compositor *c = ems_compositor(xc);
+
+	if (scale_percent < 25) {
+		scale_percent = 25;
+	}
+	if (scale_percent > 100) {
+		scale_percent = 100;
+	}
+
+	if (c->dmabuf.enabled || c->nv12.enabled) {
+		EMS_COMP_WARN(c, "Dynamic stream scale is only supported on the readback path, ignoring.");
+		return;
+	}
+
+	c->stream.requested_scale_percent = scale_percent;
+}
+
 xrt_result_t
 ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **out_xsysc)
 {
@@ -867,9 +2772,15 @@ ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **
 
 	const struct ems_device_config *config = ems_config_get();
 
+	c->stream.full = config->resolution_stream_stereo_pixels;
+	c->stream.size = c->stream.full;
+	c->stream.scale_percent = 100;
+	c->stream.requested_scale_percent = 100;
+	c->stream.applied_config_version = ems_config_get_version();
+
 	VkExtent2D readback_extent = {};
-	readback_extent.width = (uint32_t)config->resolution_stream_stereo_pixels.w;
-	readback_extent.height = (uint32_t)config->resolution_stream_stereo_pixels.h;
+	readback_extent.width = (uint32_t)c->stream.size.w;
+	readback_extent.height = (uint32_t)c->stream.size.h;
 
 	vk_image_readback_to_xf_pool_create( //
 		&c->base.vk, // vk_bundle
@@ -878,25 +2789,26 @@ ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **
 		XRT_FORMAT_R8G8B8X8, // xrt_format
 		VK_FORMAT_R8G8B8A8_UNORM); // vk_format
 
-	u_var_add_root(c, "Electric Maple Server compositor", 0);
-	u_var_add_sink_debug(c, &c->debug_sink, "Debug Sink");
-
-#define EMS_VIDEO_APPSRC_NAME "EMS_video_source"
-#define EMS_AUDIO_APPSRC_NAME "EMS_audio_source"
+	// Optional zero-copy path, falls back to the readback pool above.
+	c->dmabuf.enabled = compositor_init_dmabuf_export(c);
+	if (!c->dmabuf.enabled) {
+		compositor_fini_dmabuf_export(c);
+	}
 
-	ems_gstreamer_pipeline_create(&c->xfctx, EMS_VIDEO_APPSRC_NAME, EMS_AUDIO_APPSRC_NAME, emsi.callbacks,
-	                              &c->gstreamer_pipeline);
+	// Pipelined readback, falls back to the synchronous wait if disabled.
+	c->readback.running = compositor_init_readback_engine(c);
+	if (!c->readback.running) {
+		compositor_fini_readback_engine(c);
+	}
 
-	ems_gstreamer_src_create_with_pipeline( //
-		c->gstreamer_pipeline, //
-		&config->resolution_stream_stereo_pixels, //
-		config->refresh_rate_hz, //
-		XRT_FORMAT_R8G8B8X8, //
-		EMS_VIDEO_APPSRC_NAME, //
-		&c->gstreamer_src); //
+	u_var_add_root(c, "Electric Maple Server compositor", 0);
+	u_var_add_sink_debug(c, &c->debug_sink, "Debug Sink");
+	u_var_add_ro_f32(c, &c->readback.submit_to_done_ms, "Blit submit to completion (ms)");
 
 	// Bounce image for scaling.
 	{
+		c->bounce.extent = readback_extent;
+
 		// Use a linear image to fix gamma correction on Android.
 #ifdef ANDROID
 		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
@@ -906,6 +2818,67 @@ ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **
 		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VkResult ret;
 
+#ifdef EMS_HAVE_NV12_COMPUTE
+		// The NV12 compute pass samples the raw bytes through an UNORM
+		// view, so the image needs to be mutable and sampleable.
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		VkImageCreateInfo image_info = {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = format;
+		image_info.extent = {readback_extent.width, readback_extent.height, 1};
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = usage;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		struct vk_bundle *vk = get_vk(c);
+
+		ret = vk->vkCreateImage(vk->device, &image_info, NULL, &c->bounce.image);
+		if (ret != VK_SUCCESS) {
+			EMS_COMP_DEBUG(c, "vkCreateImage(bounce): %s", vk_result_string(ret));
+		}
+
+		if (ret == VK_SUCCESS) {
+			VkMemoryRequirements requirements = {};
+			vk->vkGetImageMemoryRequirements(vk->device, c->bounce.image, &requirements);
+
+			uint32_t memory_type_index = 0;
+			if (!vk_get_memory_type(vk, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			                        &memory_type_index)) {
+				EMS_COMP_DEBUG(c, "No memory type for bounce image.");
+			}
+
+			VkMemoryAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			alloc_info.allocationSize = requirements.size;
+			alloc_info.memoryTypeIndex = memory_type_index;
+
+			ret = vk->vkAllocateMemory(vk->device, &alloc_info, NULL, &c->bounce.device_memory);
+		}
+
+		if (ret == VK_SUCCESS) {
+			ret = vk->vkBindImageMemory(vk->device, c->bounce.image, c->bounce.device_memory, 0);
+		}
+
+		if (ret == VK_SUCCESS) {
+			ret = vk_create_view( //
+				vk, // vk_bundle
+				c->bounce.image, // image
+				VK_IMAGE_VIEW_TYPE_2D, // type
+				VK_FORMAT_R8G8B8A8_UNORM, // format
+				{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, // subresource_range
+				&c->bounce.view); // out_view
+			if (ret != VK_SUCCESS) {
+				EMS_COMP_DEBUG(c, "vk_create_view(bounce): %s", vk_result_string(ret));
+			}
+		}
+#else
 		ret = vk_create_image_simple( //
 			&c->base.vk, // vk_bundle
 			readback_extent, // extent
@@ -916,8 +2889,30 @@ ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **
 		if (ret != VK_SUCCESS) {
 			EMS_COMP_DEBUG(c, "vk_create_image_simple: %s", vk_result_string(ret));
 		}
+#endif
+	}
+
+	// GPU NV12 conversion, decides how the pipeline below is built.
+	c->nv12.enabled = compositor_init_nv12_pack(c);
+	if (!c->nv12.enabled) {
+		compositor_fini_nv12_pack(c);
 	}
 
+#define EMS_VIDEO_APPSRC_NAME "EMS_video_source"
+#define EMS_AUDIO_APPSRC_NAME "EMS_audio_source"
+
+	ems_gstreamer_pipeline_create(&c->xfctx, EMS_VIDEO_APPSRC_NAME, EMS_AUDIO_APPSRC_NAME, c->nv12.enabled,
+	                              emsi.callbacks, &c->gstreamer_pipeline);
+
+	ems_gstreamer_src_create_with_pipeline( //
+		c->gstreamer_pipeline, //
+		&c->stream.size, //
+		config->refresh_rate_hz, //
+		XRT_FORMAT_R8G8B8X8, //
+		c->nv12.enabled, //
+		EMS_VIDEO_APPSRC_NAME, //
+		&c->gstreamer_src); //
+
 	EMS_COMP_DEBUG(c, "Done %p", (void *)c);
 
 	// Standard app pacer.
@@ -926,4 +2921,4 @@ ems_compositor_create_system(ems_instance &emsi, struct xrt_system_compositor **
 	assert(xret == XRT_SUCCESS && upaf != NULL);
 
 	return comp_multi_create_system_compositor(&c->base.base, upaf, &c->sys_info, false, out_xsysc);
-}
\ No newline at end of file
+}
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "gst/ems_gstreamer_pipeline.h"
+#include "os/os_threading.h"
 #include "os/os_time.h"
 #include "util/comp_base.h"
 #include "util/u_logging.h"
@@ -26,6 +27,8 @@
 #include "xrt/xrt_gfx_vk.h"
 #include "xrt/xrt_compositor.h"
 
+#include <atomic>
+
 struct ems_instance;
 
 #ifdef __cplusplus
@@ -71,6 +74,102 @@ struct ems_comp_frame
 	uint64_t present_slop_ns;
 };
 
+//! How many readback frames may be in flight on the GPU at once.
+#define EMS_READBACK_MAX_IN_FLIGHT 3
+
+/*!
+ * A streaming frame whose blit/copy commands have been submitted to the GPU
+ * but not yet collected, allowing @ref ems_compositor_layer_commit to return
+ * without waiting for the GPU.
+ *
+ * @ingroup comp_ems
+ */
+struct ems_readback_inflight
+{
+	//! Pool owning this slot's command buffer, so recording a new frame
+	//! never contends with the collector freeing a finished one.
+	struct vk_cmd_pool cmd_pool;
+	VkFence fence;
+	VkCommandBuffer cmd;
+	struct vk_image_readback_to_xf *wrap;
+	int64_t frame_id;
+	int64_t begin_ns;
+	//! When the blit/copy work was handed to the queue.
+	int64_t submit_ns;
+	struct xrt_pose view_poses[2];
+
+	/*!
+	 * NV12 conversion staged in this slot: when @p mapped is non-NULL the
+	 * collector pushes these planes instead of an RGBx readback frame.
+	 * Points into the slot's staging buffer in @ref ems_nv12_pack.
+	 */
+	struct
+	{
+		void *mapped;
+		VkDeviceSize size;
+		uint32_t width;
+		uint32_t height;
+	} nv12;
+};
+
+/*!
+ * A streaming image whose memory is exported as a DMABUF for zero-copy
+ * hand-off to the encoder pipeline.
+ *
+ * @ingroup comp_ems
+ */
+struct ems_dmabuf_frame
+{
+	VkDeviceMemory device_memory;
+	VkImage image;
+	int fd;
+	VkDeviceSize size;
+	uint32_t stride;
+	//! Set while the GStreamer pipeline holds the buffer.
+	std::atomic<bool> in_flight;
+};
+
+/*!
+ * GPU NV12 packer: a single compute dispatch converts the side-by-side packed
+ * stereo image straight to NV12, so the encoder pipelines can drop their CPU
+ * videoconvert element.
+ *
+ * @ingroup comp_ems
+ */
+struct ems_nv12_pack
+{
+	VkSampler sampler;
+	VkDescriptorSetLayout descriptor_set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+
+	//! Full resolution R8 luma plane target.
+	VkImage y_image;
+	VkImageView y_view;
+	VkDeviceMemory y_memory;
+
+	//! Half resolution R8G8 interleaved chroma plane target.
+	VkImage uv_image;
+	VkImageView uv_view;
+	VkDeviceMemory uv_memory;
+
+	//! Host visible buffers both planes are copied into, NV12 layout. One
+	//! per readback slot in async mode so the collector can push a finished
+	//! frame while the next conversion is recorded, a single one on the
+	//! synchronous fallback.
+	VkBuffer buffers[EMS_READBACK_MAX_IN_FLIGHT];
+	VkDeviceMemory buffer_memories[EMS_READBACK_MAX_IN_FLIGHT];
+	void *mapped[EMS_READBACK_MAX_IN_FLIGHT];
+	uint32_t buffer_count;
+	VkDeviceSize buffer_size;
+
+	//! Extent the plane targets and buffers are allocated at, rebuilt by
+	//! compositor_apply_stream_scale on a resolution switch.
+	VkExtent2D extent;
+};
+
 /*!
  * Main compositor struct tying everything in the compositor together.
  *
@@ -120,8 +219,99 @@ struct ems_compositor
 	{
 		VkDeviceMemory device_memory;
 		VkImage image;
+		//! UNORM view for the NV12 compute pass, sampling the raw bytes.
+		VkImageView view;
+		//! Allocated size, a config update can not stream above this.
+		VkExtent2D extent;
 	} bounce;
 
+	/*!
+	 * GPU NV12 conversion: when enabled the appsrc is negotiated as NV12
+	 * and the encoder pipelines are built without videoconvert.
+	 */
+	struct
+	{
+		bool enabled;
+		struct ems_nv12_pack pack;
+	} nv12;
+
+	/*!
+	 * Zero-copy streaming path: linear images whose memory is exported as
+	 * DMABUFs and handed to the GStreamer pipeline directly, skipping the
+	 * CPU readback entirely. Only used when export succeeded at init.
+	 */
+	struct
+	{
+		bool enabled;
+		struct ems_dmabuf_frame frames[3];
+	} dmabuf;
+
+	/*!
+	 * Low-rate side stream for quad (UI) layers: the quad's pixels travel
+	 * losslessly over the reliable ENet message channel instead of the
+	 * video stream, and only when they changed, so static UI never eats
+	 * video bitrate and never picks up encode artifacts. The client
+	 * composites the quad locally as its own composition layer. See
+	 * quad_layer_commit in ems_compositor.cpp.
+	 */
+	struct
+	{
+		//! Swapchain and image the last shipped pixels came from. Only
+		//! used as an identity token for the dirty check, never
+		//! dereferenced.
+		struct xrt_swapchain *shipped_xsc;
+		uint32_t shipped_image_index;
+		//! Placement as last shipped, a move alone resends only the header.
+		struct xrt_pose shipped_pose;
+		struct xrt_vec2 shipped_size;
+		//! Whether the client currently shows a quad, so dropping the
+		//! layer sends exactly one hide packet.
+		bool client_visible;
+
+		//! Host visible staging buffer the quad image is copied into,
+		//! grown on demand.
+		VkBuffer buffer;
+		VkDeviceMemory buffer_memory;
+		VkDeviceSize buffer_size;
+		void *mapped;
+	} quad;
+
+	/*!
+	 * Stream resolution state: @p full is the configured 100% size, @p size
+	 * is what the readback pool and the appsrc caps currently use. A scale
+	 * switch is requested from any thread via @ref
+	 * ems_compositor_set_stream_scale and applied between frames.
+	 */
+	struct
+	{
+		struct xrt_size full;
+		struct xrt_size size;
+		//! Scale currently applied, only touched by the frame loop.
+		uint32_t scale_percent;
+		//! Scale the next frame should switch to.
+		std::atomic<uint32_t> requested_scale_percent;
+		//! Device config version whose stream size is applied, only
+		//! touched by the frame loop. See compositor_apply_config_update.
+		uint64_t applied_config_version;
+	} stream;
+
+	/*!
+	 * Async readback engine: submissions are enqueued with a fence and a
+	 * collector thread pushes the completed frames into the pipeline,
+	 * so the app's frame loop never blocks on our blit/copy work.
+	 */
+	struct
+	{
+		bool running;
+		struct os_thread_helper oth;
+		struct ems_readback_inflight slots[EMS_READBACK_MAX_IN_FLIGHT];
+		uint64_t head; //!< Next slot to fill (producer), guarded by oth mutex.
+		uint64_t tail; //!< Next slot to collect, guarded by oth mutex.
+		//! Last blit submission-to-completion time, u_var visible so the
+		//! effect of the realtime queue priority can be checked under load.
+		float submit_to_done_ms;
+	} readback;
+
 	bool pipeline_playing = false;
 	struct gstreamer_pipeline *gstreamer_pipeline;
 
@@ -149,6 +339,18 @@ ems_compositor(xrt_compositor *xc)
 	return (struct ems_compositor *)xc;
 }
 
+/*!
+ * Switch the streamed resolution to @p scale_percent of the configured size
+ * (clamped to [25, 100]), without tearing down the streaming session. Applied
+ * at the start of the next streamed frame: the readback pool (and on the NV12
+ * path the plane targets) is reallocated and the appsrc caps renegotiated, the
+ * encoder follows. Only the DMABUF path keeps its fixed resolution.
+ *
+ * @ingroup comp_ems
+ */
+void
+ems_compositor_set_stream_scale(struct xrt_compositor *xc, uint32_t scale_percent);
+
 /*!
  * Spew level logging.
  *
@@ -190,4 +392,4 @@ ems_compositor(xrt_compositor *xc)
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
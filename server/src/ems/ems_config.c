@@ -10,18 +10,33 @@
 
 #include "ems_config.h"
 
+#include <gio/gio.h>
 #include <json-glib/json-glib.h>
 
 #include "util/u_logging.h"
 
 static struct ems_device_config config_instance;
 
+//! Bumped after every successful (re)load, see ems_config_get_version.
+static gint config_version = 1;
+
+//! Path of the active profile, for reloads. NULL when running on defaults.
+static gchar *config_path = NULL;
+
+static GFileMonitor *config_monitor = NULL;
+
 const struct ems_device_config *
 ems_config_get(void)
 {
 	return &config_instance;
 }
 
+uint64_t
+ems_config_get_version(void)
+{
+	return (uint64_t)g_atomic_int_get(&config_version);
+}
+
 void
 ems_config_init_default(void)
 {
@@ -57,8 +72,14 @@ ems_config_init_default(void)
 	};
 }
 
-bool
-ems_config_init_from_json(const gchar *path_str)
+/*!
+ * Parse a device config JSON into @p out_config.
+ *
+ * Writes only into the caller's struct, so a malformed file never leaves the
+ * active config half-updated.
+ */
+static bool
+config_parse_json(const gchar *path_str, struct ems_device_config *out_config)
 {
 	JsonParser *parser = json_parser_new();
 
@@ -74,93 +95,195 @@ ems_config_init_from_json(const gchar *path_str)
 	JsonNode *root = json_parser_get_root(parser);
 	JsonReader *reader = json_reader_new(root);
 
+	bool success = false;
+
 	if (!json_reader_read_member(reader, "refresh_rate_hz")) {
 		U_LOG_E("Failed to read `refresh_rate_hz` from JSON.");
-		return false;
+		goto out;
 	}
-	config_instance.refresh_rate_hz = json_reader_get_int_value(reader);
+	out_config->refresh_rate_hz = json_reader_get_int_value(reader);
 	json_reader_end_member(reader);
 
 	if (!json_reader_read_member(reader, "resolution_native_per_eye_pixels")) {
 		U_LOG_E("Failed to read `resolution_native_per_eye_pixels` from JSON.");
-		return false;
+		goto out;
 	}
 	if (!json_reader_read_member(reader, "width")) {
 		U_LOG_E("Failed to read `width` from JSON.");
-		return false;
+		goto out;
 	}
-	config_instance.resolution_native_per_eye_pixels.w = json_reader_get_int_value(reader);
+	out_config->resolution_native_per_eye_pixels.w = json_reader_get_int_value(reader);
 	json_reader_end_member(reader);
 	if (!json_reader_read_member(reader, "height")) {
 		U_LOG_E("Failed to read `height` from JSON.");
-		return false;
+		goto out;
 	}
-	config_instance.resolution_native_per_eye_pixels.h = json_reader_get_int_value(reader);
+	out_config->resolution_native_per_eye_pixels.h = json_reader_get_int_value(reader);
 	json_reader_end_member(reader);
 	json_reader_end_member(reader);
 
 	if (!json_reader_read_member(reader, "resolution_stream_stereo_pixels")) {
 		U_LOG_E("Failed to read `resolution_stream_stereo_pixels` from JSON.");
-		return false;
+		goto out;
 	}
 	if (!json_reader_read_member(reader, "width")) {
 		U_LOG_E("Failed to read `width` from JSON.");
-		return false;
+		goto out;
 	}
-	config_instance.resolution_stream_stereo_pixels.w = json_reader_get_int_value(reader);
+	out_config->resolution_stream_stereo_pixels.w = json_reader_get_int_value(reader);
 	json_reader_end_member(reader);
 	if (!json_reader_read_member(reader, "height")) {
 		U_LOG_E("Failed to read `height` from JSON.");
-		return false;
+		goto out;
 	}
-	config_instance.resolution_stream_stereo_pixels.h = json_reader_get_int_value(reader);
+	out_config->resolution_stream_stereo_pixels.h = json_reader_get_int_value(reader);
 	json_reader_end_member(reader);
 	json_reader_end_member(reader);
 
 	if (!json_reader_read_member(reader, "fov_radians")) {
 		U_LOG_E("Failed to read `fov_radians` from JSON.");
-		return false;
+		goto out;
 	}
 	for (uint32_t i = 0; i < 2; i++) {
 		if (!json_reader_read_element(reader, i)) {
 			U_LOG_E("Failed to read element %d from JSON.", i);
-			return false;
+			goto out;
 		}
 
 		if (!json_reader_read_member(reader, "angle_left")) {
 			U_LOG_E("Failed to read `angle_left` from JSON.");
-			return false;
+			goto out;
 		}
-		config_instance.fov_radians[i].angle_left = json_reader_get_double_value(reader);
+		out_config->fov_radians[i].angle_left = json_reader_get_double_value(reader);
 		json_reader_end_member(reader);
 
 		if (!json_reader_read_member(reader, "angle_right")) {
 			U_LOG_E("Failed to read `angle_right` from JSON.");
-			return false;
+			goto out;
 		}
-		config_instance.fov_radians[i].angle_right = json_reader_get_double_value(reader);
+		out_config->fov_radians[i].angle_right = json_reader_get_double_value(reader);
 		json_reader_end_member(reader);
 
 		if (!json_reader_read_member(reader, "angle_up")) {
 			U_LOG_E("Failed to read `angle_up` from JSON.");
-			return false;
+			goto out;
 		}
-		config_instance.fov_radians[i].angle_up = json_reader_get_double_value(reader);
+		out_config->fov_radians[i].angle_up = json_reader_get_double_value(reader);
 		json_reader_end_member(reader);
 
 		if (!json_reader_read_member(reader, "angle_down")) {
 			U_LOG_E("Failed to read `angle_down` from JSON.");
-			return false;
+			goto out;
 		}
-		config_instance.fov_radians[i].angle_down = json_reader_get_double_value(reader);
+		out_config->fov_radians[i].angle_down = json_reader_get_double_value(reader);
 		json_reader_end_member(reader);
 
 		json_reader_end_element(reader);
 	}
 	json_reader_end_member(reader);
 
+	success = true;
+
+out:
 	g_object_unref(reader);
 	g_object_unref(parser);
 
+	return success;
+}
+
+/*!
+ * Make a parsed config the active one and publish a new version.
+ *
+ * Consumers poll the version between frames and only then re-read the
+ * fields, so the plain struct copy here is safe in practice: at worst a
+ * reader that raced the copy picks up the rest on the very next frame.
+ */
+static void
+config_commit(const struct ems_device_config *parsed)
+{
+	config_instance = *parsed;
+	g_atomic_int_inc(&config_version);
+}
+
+bool
+ems_config_load_profile(const gchar *path_str)
+{
+	struct ems_device_config parsed = {0};
+	if (!config_parse_json(path_str, &parsed)) {
+		return false;
+	}
+
+	if (g_strcmp0(config_path, path_str) != 0) {
+		g_free(config_path);
+		config_path = g_strdup(path_str);
+	}
+
+	config_commit(&parsed);
+
+	U_LOG_I("Loaded device config profile `%s' (version %" G_GUINT64_FORMAT "): %ux%u stream, %u Hz.", path_str,
+	        ems_config_get_version(), (uint32_t)parsed.resolution_stream_stereo_pixels.w,
+	        (uint32_t)parsed.resolution_stream_stereo_pixels.h, parsed.refresh_rate_hz);
+
 	return true;
 }
+
+bool
+ems_config_init_from_json(const gchar *path_str)
+{
+	return ems_config_load_profile(path_str);
+}
+
+bool
+ems_config_reload(void)
+{
+	if (config_path == NULL) {
+		U_LOG_W("No device config file was loaded, nothing to reload.");
+		return false;
+	}
+
+	return ems_config_load_profile(config_path);
+}
+
+static void
+config_file_changed_cb(
+    GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event, gpointer user_data)
+{
+	// CHANGES_DONE_HINT marks the end of a save; CREATED covers editors
+	// that replace the file instead of rewriting it in place.
+	if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT && event != G_FILE_MONITOR_EVENT_CREATED) {
+		return;
+	}
+
+	U_LOG_I("Device config changed on disk, reloading.");
+	ems_config_reload();
+}
+
+void
+ems_config_start_watch(void)
+{
+	if (config_path == NULL || config_monitor != NULL) {
+		return;
+	}
+
+	GFile *file = g_file_new_for_path(config_path);
+	GError *error = NULL;
+	config_monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, &error);
+	g_object_unref(file);
+
+	if (config_monitor == NULL) {
+		U_LOG_W("Could not watch device config `%s': %s", config_path,
+		        error != NULL ? error->message : "unknown error");
+		g_clear_error(&error);
+		return;
+	}
+
+	g_signal_connect(config_monitor, "changed", G_CALLBACK(config_file_changed_cb), NULL);
+
+	U_LOG_I("Watching device config `%s' for changes.", config_path);
+}
+
+void
+ems_config_stop_watch(void)
+{
+	g_clear_object(&config_monitor);
+}
@@ -28,10 +28,47 @@ struct ems_device_config
 const struct ems_device_config *
 ems_config_get(void);
 
+/*!
+ * Monotonic config version, bumped on every successful load or reload.
+ *
+ * Consumers that cache derived state (readback pool, appsrc caps) compare
+ * this between frames and re-apply when it moved.
+ */
+uint64_t
+ems_config_get_version(void);
+
 void
 ems_config_init_default(void);
 
 bool
 ems_config_init_from_json(const gchar *path_str);
 
+/*!
+ * Load a different device profile JSON and make it the active config.
+ *
+ * Meant for swapping per-device profiles at runtime, e.g. when a new client
+ * model connects. On parse failure the active config is left untouched.
+ * Stream resolution changes are applied live through the compositor's
+ * dynamic-reconfiguration path; refresh rate and FOV take effect for the
+ * next session.
+ */
+bool
+ems_config_load_profile(const gchar *path_str);
+
+//! Re-read the active profile from disk, see ems_config_load_profile.
+bool
+ems_config_reload(void);
+
+/*!
+ * Watch the active profile file and reload it on changes.
+ *
+ * Needs a running default GLib main context; the streaming pipeline's main
+ * loop provides one. No-op when running on built-in defaults.
+ */
+void
+ems_config_start_watch(void);
+
+void
+ems_config_stop_watch(void);
+
 G_END_DECLS
@@ -62,6 +62,10 @@
 
 static constexpr uint64_t kFixedAssumedLatencyUs = 50 * U_TIME_1MS_IN_NS;
 
+/// Never extrapolate further than this past the last received pose, so a
+/// tracking stall degrades to a frozen pose instead of one flying off.
+static constexpr int64_t kMaxPredictionNs = 50 * U_TIME_1MS_IN_NS;
+
 /// Casting helper function
 static ems_hmd *
 ems_hmd(xrt_device *xdev)
@@ -114,13 +118,21 @@ ems_hmd_get_tracked_pose(xrt_device *xdev,
 		eh->received->rel.relation_flags = XRT_SPACE_RELATION_BITMASK_NONE;
 		eh->received->updated = false;
 		if (0 == (rel.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
-			g_print("no XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT\n");
 			// guess our velocities if not reported.
 			m_relation_history_estimate_motion(eh->pose_history, &rel, timestamp, &rel);
 		}
 		m_relation_history_push(eh->pose_history, &rel, timestamp);
+		eh->last_push_ns = (int64_t)timestamp;
+	}
+
+	// Predict forward to the requested display time, clamped so we never
+	// extrapolate too far past the last received sample.
+	int64_t target_ns = at_timestamp_ns;
+	const int64_t last_push_ns = eh->last_push_ns;
+	if (last_push_ns != 0 && target_ns > last_push_ns + kMaxPredictionNs) {
+		target_ns = last_push_ns + kMaxPredictionNs;
 	}
-	m_relation_history_get(eh->pose_history, at_timestamp_ns, out_relation);
+	m_relation_history_get(eh->pose_history, target_ns, out_relation);
 #else
 	if (eh->received->updated) {
 		std::lock_guard lock(eh->received->mutex);
@@ -199,14 +211,12 @@ ems_hmd_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messageS
 		XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
 		XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT);
 	if (message->tracking.has_head_linear_velocity) {
-		g_print("no has_head_linear_velocity\n");
 		rel.linear_velocity = to_xrt_vec3(message->tracking.head_linear_velocity);
 		rel.relation_flags =
 			(xrt_space_relation_flags)(
 				rel.relation_flags | XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT);
 	}
 	if (message->tracking.has_head_angular_velocity) {
-		g_print("no has_head_angular_velocity\n");
 		rel.angular_velocity = to_xrt_vec3(message->tracking.head_angular_velocity);
 		rel.relation_flags =
 			(xrt_space_relation_flags)(
@@ -310,6 +320,7 @@ ems_hmd_create(ems_instance &emsi)
 	identity.pose = xrt_pose{xrt_quat XRT_QUAT_IDENTITY, xrt_vec3{0.0f, 1.6f, 0.0f}};
 	const uint64_t now = os_monotonic_get_ns();
 	m_relation_history_push(eh->pose_history, &identity, now);
+	eh->last_push_ns = (int64_t)now;
 #endif
 
 	// TODO: Are we going to have any actual useful info to show here?
@@ -321,4 +332,4 @@ ems_hmd_create(ems_instance &emsi)
 #endif
 
 	return eh;
-}
\ No newline at end of file
+}
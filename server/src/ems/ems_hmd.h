@@ -16,7 +16,7 @@
 
 #include "electricmaple.pb.h"
 
-// #define USE_PREDICTION
+#define USE_PREDICTION
 
 struct ems_callbacks;
 struct ems_instance;
@@ -42,6 +42,8 @@ struct ems_hmd
 
 #ifdef USE_PREDICTION
 	struct m_relation_history *pose_history;
+	//! Timestamp of the newest relation in @ref pose_history, to clamp prediction.
+	std::atomic<int64_t> last_push_ns;
 #else
 	struct xrt_pose pose;
 #endif
@@ -51,4 +53,4 @@ struct ems_hmd
 };
 
 ems_hmd *
-ems_hmd_create(ems_instance &emsi);
\ No newline at end of file
+ems_hmd_create(ems_instance &emsi);
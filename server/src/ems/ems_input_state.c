@@ -0,0 +1,67 @@
+// Copyright 2023, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+
+/*!
+ * @file
+ * @brief  Fast-path controller input state, shared between the message
+ *         handler and the controller driver through a seqlock
+ * @ingroup aux_util
+ */
+
+#include "ems_input_state.h"
+
+#include <stdatomic.h>
+
+/*
+ * Classic single-writer seqlock. The writer bumps the sequence to an odd
+ * value, stores the payload, then bumps it even again; readers retry until
+ * they get the same even sequence on both sides of their copy. The payload
+ * is a handful of floats, so a retry is nearly free and a writer can never
+ * be blocked by a stalled reader (unlike a mutex) or starve one.
+ *
+ * Sequence 0 means nothing was ever published.
+ */
+static struct ems_input_state input_state;
+static atomic_uint_fast64_t input_state_seq;
+
+void
+ems_input_state_write(const struct ems_input_state *state)
+{
+	uint_fast64_t seq = atomic_load_explicit(&input_state_seq, memory_order_relaxed);
+
+	atomic_store_explicit(&input_state_seq, seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	input_state = *state;
+
+	atomic_store_explicit(&input_state_seq, seq + 2, memory_order_release);
+}
+
+bool
+ems_input_state_read(struct ems_input_state *out_state)
+{
+	struct ems_input_state copy;
+	uint_fast64_t seq_before;
+	uint_fast64_t seq_after;
+
+	do {
+		seq_before = atomic_load_explicit(&input_state_seq, memory_order_acquire);
+		if (seq_before == 0) {
+			return false;
+		}
+		if ((seq_before & 1) != 0) {
+			// A write is in flight, go around.
+			continue;
+		}
+
+		copy = input_state;
+
+		atomic_thread_fence(memory_order_acquire);
+		seq_after = atomic_load_explicit(&input_state_seq, memory_order_relaxed);
+	} while (seq_before != seq_after);
+
+	*out_state = copy;
+
+	return true;
+}
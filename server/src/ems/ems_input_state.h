@@ -0,0 +1,60 @@
+// Copyright 2023, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+
+/*!
+ * @file
+ * @brief  Fast-path controller input state, shared between the message
+ *         handler and the controller driver through a seqlock
+ * @ingroup aux_util
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * One snapshot of the client's controller input values.
+ *
+ * Carried by the compact input-only up message, which the client sends the
+ * moment a value changes; the same values also ride along in the (much
+ * larger) tracking message, so a reader that never sees a fast-path write
+ * just keeps using those.
+ */
+struct ems_input_state
+{
+	float grab_value_left;
+	float grab_value_right;
+
+	//! Client-side send counter, increases with every fast-path message.
+	int64_t sequence_idx;
+
+	//! Monotonic time the message was received, see os_monotonic_get_ns.
+	int64_t receive_time_ns;
+};
+
+/*!
+ * Publish a new input snapshot from the message handler.
+ *
+ * Lock-free single-writer seqlock: only ever call this from the one thread
+ * that decodes up messages.
+ */
+void
+ems_input_state_write(const struct ems_input_state *state);
+
+/*!
+ * Read the latest published input snapshot.
+ *
+ * Never blocks and never observes a torn write; safe to call from
+ * update_inputs at query rate. Returns false if nothing has been published
+ * yet, leaving @p out_state untouched.
+ */
+bool
+ems_input_state_read(struct ems_input_state *out_state);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -229,4 +229,4 @@ xrt_instance_create(struct xrt_instance_info *ii, struct xrt_instance **out_xins
 	*out_xinst = &emsi->xinst_base;
 
 	return XRT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -14,6 +14,7 @@
  */
 
 #include <cassert>
+#include <cfloat>
 #include <cstdio>
 #include <thread>
 
@@ -21,12 +22,14 @@
 
 #include "electricmaple.pb.h"
 #include "ems_callbacks.h"
+#include "ems_input_state.h"
 #include "ems_instance.h"
 #include "util/u_time.h"
 #include "os/os_threading.h"
 #include "include/ems_common.h"
 #include "math/m_api.h"
 #include "math/m_mathinclude.h"
+#include "math/m_relation_history.h"
 #include "math/m_space.h"
 #include "os/os_time.h"
 #include "pb_decode.h"
@@ -36,12 +39,25 @@
 #include "util/u_var.h"
 #include "xrt/xrt_device.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EMS_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 /*
  *
  * Structs and defines.
  *
  */
 
+/// Assumed network + processing age of an incoming controller pose, mirrors
+/// the HMD's kFixedAssumedLatencyUs.
+static constexpr int64_t kFixedAssumedLatencyNs = 50 * U_TIME_1MS_IN_NS;
+
+/// Never extrapolate further than this past the last received pose, so a
+/// tracking stall degrades to a frozen pose instead of one flying off.
+static constexpr int64_t kMaxPredictionNs = 50 * U_TIME_1MS_IN_NS;
+
 xrt_pose
 convert_pose(const _em_proto_Pose &pose)
 {
@@ -57,18 +73,66 @@ convert_pose(const _em_proto_Pose &pose)
 	return new_pose;
 }
 
+/// Convert one hand's worth of proto joints into a snapshot in a single batch
+/// pass: quaternion normalization plus the proto (w,x,y,z) to xrt (x,y,z,w)
+/// layout shuffle, vectorized where SSE2 is available. The message callback
+/// runs this once per tracking message so hand tracking queries only copy.
+static void
+convert_hand_joints_batch(const em_proto_HandJointLocation *joints, ems_hand_joint_snapshot *out)
+{
+	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		const em_proto_Pose &pose = joints[i].pose;
+		xrt_pose &dst = out->poses[i];
+
+#ifdef EMS_HAVE_SSE2
+		// One 4-lane load covers the whole quaternion: [w x y z].
+		__m128 q = _mm_loadu_ps(&pose.orientation.w);
+		__m128 sq = _mm_mul_ps(q, q);
+		__m128 t = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+		t = _mm_add_ps(t, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 3, 2)));
+		const float len_sq = _mm_cvtss_f32(t);
+		if (len_sq < FLT_EPSILON) {
+			// An all-zero quaternion means the joint was never set.
+			dst.orientation = xrt_quat XRT_QUAT_IDENTITY;
+		} else {
+			q = _mm_mul_ps(q, _mm_set1_ps(1.0f / sqrtf(len_sq)));
+			// Shuffle [w x y z] to [x y z w] and store straight into the xrt_quat.
+			q = _mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 3, 2, 1));
+			_mm_storeu_ps(&dst.orientation.x, q);
+		}
+#else
+		const float len_sq = pose.orientation.w * pose.orientation.w +
+		                     pose.orientation.x * pose.orientation.x +
+		                     pose.orientation.y * pose.orientation.y +
+		                     pose.orientation.z * pose.orientation.z;
+		if (len_sq < FLT_EPSILON) {
+			dst.orientation = xrt_quat XRT_QUAT_IDENTITY;
+		} else {
+			const float inv_len = 1.0f / sqrtf(len_sq);
+			dst.orientation.x = pose.orientation.x * inv_len;
+			dst.orientation.y = pose.orientation.y * inv_len;
+			dst.orientation.z = pose.orientation.z * inv_len;
+			dst.orientation.w = pose.orientation.w * inv_len;
+		}
+#endif
+
+		dst.position = {pose.position.x, pose.position.y, pose.position.z};
+		out->radii[i] = joints[i].radius;
+	}
+}
+
 static void
 controller_destroy(xrt_device *xdev)
 {
 	ems_motion_controller *emc = reinterpret_cast<struct ems_motion_controller *>(xdev);
 
+	m_relation_history_destroy(&emc->grip_history);
+	m_relation_history_destroy(&emc->aim_history);
+
 	// Remove the variable tracking.
 	u_var_remove_root(emc);
 
 	u_device_free(&emc->base);
-
-	delete[] emc->hand_joints;
-	emc->hand_joints = NULL;
 }
 
 // You should put code to update the attached input fields (if any)
@@ -88,9 +152,20 @@ controller_update_inputs(xrt_device *xdev)
 		return XRT_SUCCESS;
 	}
 
+	// Prefer the fast-path state published straight from the message
+	// handler: an input-only message skips the whole tracking pipeline,
+	// so this can be fresher than what the last tracking message put in
+	// grab_action. The seqlock read never blocks this query.
+	float grab_value = emc->grab_action;
+	struct ems_input_state input;
+	if (ems_input_state_read(&input)) {
+		grab_value = emc->base.device_type == XRT_DEVICE_TYPE_LEFT_HAND_CONTROLLER ? input.grab_value_left
+		                                                                           : input.grab_value_right;
+	}
+
 	xdev->inputs[0].active = true;
 	xdev->inputs[0].timestamp = now;
-	xdev->inputs[0].value.vec1 = {emc->grab_action};
+	xdev->inputs[0].value.vec1 = {grab_value};
 
 	// AIM for ray casting.
 	xdev->inputs[3].active = true;
@@ -125,15 +200,19 @@ controller_get_hand_tracking(xrt_device *xdev,
 
 	out_value->is_active = true;
 
+	// Joints are already converted, a single acquire picks up the snapshot
+	// the message callback published last.
+	const ems_hand_joint_snapshot *snapshot = emc->hand_snapshot_published.load(std::memory_order_acquire);
+
 	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
 		auto &joint_set = out_value->values.hand_joint_set_default[i];
-		joint_set.relation.pose = convert_pose(emc->hand_joints[i].pose);
+		joint_set.relation.pose = snapshot->poses[i];
 
 		joint_set.relation.relation_flags = (xrt_space_relation_flags)(
 			XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
 			XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
 
-		joint_set.radius = emc->hand_joints[i].radius;
+		joint_set.radius = snapshot->radii[i];
 	}
 
 	// This is a lie
@@ -150,25 +229,21 @@ controller_get_tracked_pose(xrt_device *xdev,
 {
 	ems_motion_controller *emc = reinterpret_cast<struct ems_motion_controller *>(xdev);
 
+	// Predict forward to the requested display time, clamped so we never
+	// extrapolate too far past the last received sample.
+	int64_t target_ns = at_timestamp_ns;
+	const int64_t last_push_ns = emc->last_push_ns;
+	if (last_push_ns != 0 && target_ns > last_push_ns + kMaxPredictionNs) {
+		target_ns = last_push_ns + kMaxPredictionNs;
+	}
+
 	switch (name) {
 	case XRT_INPUT_WMR_GRIP_POSE: {
-		//            math_quat_normalize(&emc->grip_pose.orientation);
-		//            out_relation->pose = emc->grip_pose;
-		//            out_relation->relation_flags = (enum xrt_space_relation_flags) ( //
-		//                    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT |                  //
-		//                    XRT_SPACE_RELATION_POSITION_VALID_BIT |                     //
-		//                    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |                //
-		//                    XRT_SPACE_RELATION_POSITION_TRACKED_BIT);                   //
+		m_relation_history_get(emc->grip_history, target_ns, out_relation);
 	}
 	break;
 	case XRT_INPUT_WMR_AIM_POSE: {
-		math_quat_normalize(&emc->aim_pose.orientation);
-		out_relation->pose = emc->aim_pose;
-		out_relation->relation_flags = (enum xrt_space_relation_flags)( //
-			XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | //
-			XRT_SPACE_RELATION_POSITION_VALID_BIT | //
-			XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | //
-			XRT_SPACE_RELATION_POSITION_TRACKED_BIT); //
+		m_relation_history_get(emc->aim_history, target_ns, out_relation);
 	}
 	break;
 	default: {
@@ -177,8 +252,6 @@ controller_get_tracked_pose(xrt_device *xdev,
 	}
 	}
 
-	// Estimate pose at timestamp at_timestamp_ns!
-
 	return XRT_SUCCESS;
 }
 
@@ -195,6 +268,22 @@ controller_get_view_poses(xrt_device *xdev,
 	return XRT_ERROR_POSE_NOT_ACTIVE;
 }
 
+/// Push a newly received pose into a history, estimating velocities from the
+/// previous samples since the protocol carries no controller velocities.
+static void
+push_pose_to_history(struct m_relation_history *history, const xrt_pose &pose, int64_t timestamp_ns)
+{
+	xrt_space_relation rel = XRT_SPACE_RELATION_ZERO;
+	rel.pose = pose;
+	math_quat_normalize(&rel.pose.orientation);
+	rel.relation_flags = (xrt_space_relation_flags)(
+		XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
+		XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT);
+
+	m_relation_history_estimate_motion(history, &rel, timestamp_ns, &rel);
+	m_relation_history_push(history, &rel, timestamp_ns);
+}
+
 /// Fetch remote input data.
 static void
 controller_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messageSuper, void *userdata)
@@ -208,6 +297,13 @@ controller_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messa
 		return;
 	}
 
+	// Batch convert into whichever snapshot is not published, so queries
+	// never observe a half written hand, then swap it in below.
+	ems_hand_joint_snapshot *back =
+		emc->hand_snapshot_published.load(std::memory_order_relaxed) == &emc->hand_snapshots[0]
+			? &emc->hand_snapshots[1]
+			: &emc->hand_snapshots[0];
+
 	if (emc->base.device_type == XRT_DEVICE_TYPE_LEFT_HAND_CONTROLLER) {
 		if (message->tracking.has_controller_grip_left) {
 			emc->grip_pose = convert_pose(message->tracking.controller_grip_left);
@@ -217,8 +313,7 @@ controller_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messa
 			emc->aim_pose = convert_pose(message->tracking.controller_aim_left);
 		}
 
-		memcpy(emc->hand_joints, messageSuper->hand_joint_locations_left,
-		       sizeof(em_proto_HandJointLocation) * XRT_HAND_JOINT_COUNT);
+		convert_hand_joints_batch(messageSuper->hand_joint_locations_left, back);
 
 		emc->grab_action = message->tracking.controller_grab_value_left;
 	} else if (emc->base.device_type == XRT_DEVICE_TYPE_RIGHT_HAND_CONTROLLER) {
@@ -234,8 +329,7 @@ controller_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messa
 			//         emc->aim_pose.orientation.z, emc->aim_pose.orientation.w);
 		}
 
-		memcpy(emc->hand_joints, messageSuper->hand_joint_locations_right,
-		       sizeof(em_proto_HandJointLocation) * XRT_HAND_JOINT_COUNT);
+		convert_hand_joints_batch(messageSuper->hand_joint_locations_right, back);
 
 		emc->grab_action = message->tracking.controller_grab_value_right;
 	} else {
@@ -245,7 +339,15 @@ controller_handle_data(ems_callbacks_event event, const em_UpMessageSuper *messa
 	// U_LOG_E("handLocalPose %f %f %f", pose.position.x, pose.position.y, pose.position.z);
 	// printf("hand grab %f\n", hand_grab);
 
-	// TODO handle timestamp, etc
+	emc->hand_snapshot_published.store(back, std::memory_order_release);
+
+	// The protocol does not carry a capture timestamp yet, assume a fixed
+	// age like the HMD does.
+	const int64_t timestamp_ns = os_monotonic_get_ns() - kFixedAssumedLatencyNs;
+
+	push_pose_to_history(emc->grip_history, emc->grip_pose, timestamp_ns);
+	push_pose_to_history(emc->aim_history, emc->aim_pose, timestamp_ns);
+	emc->last_push_ns = timestamp_ns;
 
 	emc->active = true;
 }
@@ -337,7 +439,24 @@ ems_motion_controller_create(ems_instance &emsi, xrt_device_name device_name, xr
 	// Private fields.
 	emc->grip_pose = default_pose;
 	emc->aim_pose = default_pose;
-	emc->hand_joints = new struct _em_proto_HandJointLocation[XRT_HAND_JOINT_COUNT];
+
+	// Seed both snapshots with identity orientations so queries made before
+	// the first tracking message return sane poses.
+	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++) {
+		emc->hand_snapshots[0].poses[i].orientation = xrt_quat XRT_QUAT_IDENTITY;
+		emc->hand_snapshots[1].poses[i].orientation = xrt_quat XRT_QUAT_IDENTITY;
+	}
+	emc->hand_snapshot_published = &emc->hand_snapshots[0];
+
+	m_relation_history_create(&emc->grip_history, nullptr);
+	m_relation_history_create(&emc->aim_history, nullptr);
+
+	// Seed the histories so get_tracked_pose has something valid to
+	// return before the first tracking message arrives.
+	const int64_t now = os_monotonic_get_ns();
+	push_pose_to_history(emc->grip_history, default_pose, now);
+	push_pose_to_history(emc->aim_history, default_pose, now);
+	emc->last_push_ns = now;
 
 	// Print name.
 	snprintf(emc->base.str, XRT_DEVICE_NAME_LEN, "Hand %s Controller (Electric Maple)", hand_str);
@@ -371,4 +490,4 @@ ems_motion_controller_create(ems_instance &emsi, xrt_device_name device_name, xr
 }
 
 // Has to be standard layout because of the first element casts we do.
-static_assert(std::is_standard_layout<ems_motion_controller>::value);
\ No newline at end of file
+static_assert(std::is_standard_layout<ems_motion_controller>::value);
@@ -5,12 +5,26 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "electricmaple.pb.h"
 #include "util/u_logging.h"
 #include "xrt/xrt_defines.h"
 #include "xrt/xrt_device.h"
 
 struct ems_instance;
+struct m_relation_history;
+
+/*!
+ * One hand's worth of converted joint data, produced in a single batch pass
+ * from the incoming proto joints and handed over by pointer swap, see
+ * @ref ems_motion_controller::hand_snapshot_published.
+ */
+struct ems_hand_joint_snapshot
+{
+	xrt_pose poses[XRT_HAND_JOINT_COUNT];
+	float radii[XRT_HAND_JOINT_COUNT];
+};
 
 struct ems_motion_controller
 {
@@ -21,14 +35,29 @@ struct ems_motion_controller
 
 	xrt_pose aim_pose;
 
+	//! Prediction histories fed by incoming tracking messages.
+	struct m_relation_history *grip_history;
+	struct m_relation_history *aim_history;
+
+	//! Timestamp of the newest relation in the histories, to clamp prediction.
+	std::atomic<int64_t> last_push_ns;
+
 	u_logging_level log_level;
 
 	bool active;
 
 	float grab_action;
 
-	em_proto_HandJointLocation *hand_joints;
+	/*!
+	 * Double-buffered hand joint snapshots. The tracking message handler
+	 * batch-converts into whichever slot is not published and then swaps
+	 * the pointer; hand tracking queries read the published slot without
+	 * ever taking a lock. Messages arrive milliseconds apart while a query
+	 * only copies a few KB, so a slot is never rewritten under a reader.
+	 */
+	ems_hand_joint_snapshot hand_snapshots[2];
+	std::atomic<ems_hand_joint_snapshot *> hand_snapshot_published;
 };
 
 ems_motion_controller *
-ems_motion_controller_create(ems_instance &emsi, xrt_device_name device_name, xrt_device_type device_type);
\ No newline at end of file
+ems_motion_controller_create(ems_instance &emsi, xrt_device_name device_name, xrt_device_type device_type);
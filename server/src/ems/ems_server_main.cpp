@@ -52,4 +52,4 @@ main(int argc, char *argv[])
 	u_metrics_close();
 
 	return ret;
-}
\ No newline at end of file
+}
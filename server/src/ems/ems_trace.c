@@ -0,0 +1,108 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Per-frame trace events in the Perfetto/Chrome JSON format.
+ * @ingroup aux_util
+ */
+
+#include "ems_trace.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "util/u_debug.h"
+#include "util/u_logging.h"
+
+/*
+ * The monado u_trace_marker percetto backend can neither carry a per-event
+ * frame id nor be merged with a trace taken on the Android client, so the
+ * per-frame stages are written as Chrome JSON trace events instead: the
+ * Perfetto UI opens them directly, and every event carries its
+ * frame_sequence_id as an argument.
+ */
+
+DEBUG_GET_ONCE_OPTION(trace_json_path, "EMS_TRACE_JSON", NULL)
+
+//! The pid all server events are filed under, the client uses another one.
+#define EMS_TRACE_PID 1
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static FILE *trace_file = NULL;
+
+static const char *lane_names[] = {
+    [EMS_TRACE_LANE_LAYER_COMMIT] = "layer commit",
+    [EMS_TRACE_LANE_READBACK] = "readback",
+    [EMS_TRACE_LANE_PIPELINE] = "pipeline",
+};
+
+static void
+trace_open(void)
+{
+	const char *path = debug_get_option_trace_json_path();
+	if (path == NULL) {
+		return;
+	}
+
+	trace_file = fopen(path, "w");
+	if (trace_file == NULL) {
+		U_LOG_W("Failed to open trace file '%s', tracing disabled.", path);
+		return;
+	}
+
+	U_LOG_I("Writing per-frame trace events to '%s'.", path);
+
+	// The JSON array format tolerates a missing closing bracket, so an
+	// aborted run still yields a loadable trace.
+	fprintf(trace_file, "[\n");
+	fprintf(trace_file,
+	        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+	        "\"args\":{\"name\":\"ems-server\"}},\n",
+	        EMS_TRACE_PID);
+	for (size_t i = 0; i < sizeof(lane_names) / sizeof(lane_names[0]); i++) {
+		fprintf(trace_file,
+		        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%zu,"
+		        "\"args\":{\"name\":\"%s\"}},\n",
+		        EMS_TRACE_PID, i, lane_names[i]);
+	}
+}
+
+bool
+ems_trace_is_enabled(void)
+{
+	pthread_once(&trace_once, trace_open);
+	return trace_file != NULL;
+}
+
+void
+ems_trace_slice(const char *name, enum ems_trace_lane lane, int64_t frame_sequence_id, int64_t begin_ns, int64_t end_ns)
+{
+	if (!ems_trace_is_enabled()) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_mutex);
+	fprintf(trace_file,
+	        "{\"name\":\"%s\",\"cat\":\"ems\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+	        "\"pid\":%d,\"tid\":%d,\"args\":{\"frame_sequence_id\":%" PRId64 "}},\n",
+	        name, begin_ns / 1e3, (end_ns - begin_ns) / 1e3, EMS_TRACE_PID, (int)lane, frame_sequence_id);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void
+ems_trace_instant(const char *name, enum ems_trace_lane lane, int64_t frame_sequence_id, int64_t when_ns)
+{
+	if (!ems_trace_is_enabled()) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace_mutex);
+	fprintf(trace_file,
+	        "{\"name\":\"%s\",\"cat\":\"ems\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+	        "\"pid\":%d,\"tid\":%d,\"args\":{\"frame_sequence_id\":%" PRId64 "}},\n",
+	        name, when_ns / 1e3, EMS_TRACE_PID, (int)lane, frame_sequence_id);
+	pthread_mutex_unlock(&trace_mutex);
+}
@@ -0,0 +1,56 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Per-frame trace events in the Perfetto/Chrome JSON format.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Which track a trace event lands on in the viewer. One lane per pipeline
+ * stage, so overlapping work on consecutive frames stays readable.
+ */
+enum ems_trace_lane
+{
+	EMS_TRACE_LANE_LAYER_COMMIT,
+	EMS_TRACE_LANE_READBACK,
+	EMS_TRACE_LANE_PIPELINE,
+};
+
+/*!
+ * Whether tracing was enabled by setting EMS_TRACE_JSON to an output path.
+ *
+ * Checked lazily on first call; use it to skip argument computation that is
+ * only needed for the trace.
+ */
+bool
+ems_trace_is_enabled(void);
+
+/*!
+ * Write one complete slice, timestamps in monotonic ns.
+ *
+ * The frame id is attached as a "frame_sequence_id" argument so slices of
+ * the same frame can be found across lanes (and across the matching client
+ * trace). Thread-safe, cheap no-op while tracing is disabled.
+ */
+void
+ems_trace_slice(
+    const char *name, enum ems_trace_lane lane, int64_t frame_sequence_id, int64_t begin_ns, int64_t end_ns);
+
+//! Write one instant event, same conventions as @ref ems_trace_slice.
+void
+ems_trace_instant(const char *name, enum ems_trace_lane lane, int64_t frame_sequence_id, int64_t when_ns);
+
+#ifdef __cplusplus
+}
+#endif
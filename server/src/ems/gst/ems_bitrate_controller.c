@@ -0,0 +1,336 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Closed-loop bitrate controller fed by client frame feedback.
+ * @ingroup aux_util
+ */
+
+#include "ems_bitrate_controller.h"
+
+#include <glib.h>
+
+#include <stdbool.h>
+
+#include "util/u_logging.h"
+#include "util/u_misc.h"
+#include "util/u_time.h"
+
+/*
+ * The controller is a delay-based AIMD loop. The client's reported average
+ * latency is smoothed with an EWMA and compared against a tracked baseline
+ * (the best latency seen recently, allowed to creep up slowly so a route
+ * change does not pin us to a stale minimum). The difference is treated as
+ * queuing delay:
+ *
+ *  - Queuing above the backoff threshold means buffers are piling up
+ *    somewhere between encoder and display, so back off multiplicatively,
+ *    at most once per cooldown so one congestion event is not punished for
+ *    every report it is visible in.
+ *  - A stable low queuing delay earns small additive increases, but only
+ *    after a hold-off period following the last backoff.
+ *
+ * Increases below the hysteresis fraction of the current rate are
+ * suppressed so we do not thrash the encoder with tiny reconfigurations.
+ *
+ * When the transport returns TWCC feedback, a second, faster input drives
+ * the same AIMD state: the smoothed inter-packet delay gradient
+ * (delta-of-delta) goes positive as soon as a queue starts growing, one
+ * RTT after the packets that caused it, instead of waiting for the queue
+ * to show up in whole-frame latencies. Both paths share the cooldown and
+ * hold-off timestamps, so a backoff on one suppresses probing on the other.
+ */
+
+//! Queuing delay that triggers a multiplicative decrease.
+#define BACKOFF_THRESHOLD_MS 50.0f
+
+//! Queuing delay that triggers the harder halving decrease.
+#define SEVERE_THRESHOLD_MS 200.0f
+
+//! Queuing delay below which we consider the link underused.
+#define INCREASE_THRESHOLD_MS 15.0f
+
+//! Minimum time between two decreases, a few RTTs on Wi-Fi.
+#define DECREASE_COOLDOWN_NS (U_TIME_1MS_IN_NS * 300)
+
+//! Minimum time between two increases.
+#define INCREASE_INTERVAL_NS (U_TIME_1MS_IN_NS * 500)
+
+//! How long after a decrease before we probe upwards again.
+#define INCREASE_HOLDOFF_NS (U_TIME_1S_IN_NS * 2)
+
+//! Smoothing factor for the latency EWMA.
+#define EWMA_ALPHA 0.25f
+
+//! How fast the baseline may creep upwards, in ms per second.
+#define BASELINE_CREEP_MS_PER_S 2.0f
+
+//! Smoothed TWCC delay gradient that signals overuse, ms per packet.
+#define TWCC_OVERUSE_THRESHOLD_MS 1.0f
+
+//! Delay gradient that triggers the harder halving decrease.
+#define TWCC_SEVERE_THRESHOLD_MS 5.0f
+
+//! Delay gradient below which the link counts as underused.
+#define TWCC_UNDERUSE_THRESHOLD_MS 0.25f
+
+//! Packet loss that forces a decrease regardless of the delay gradient.
+#define TWCC_LOSS_BACKOFF_PCT 10.0
+
+//! Packet loss above which increases are withheld.
+#define TWCC_LOSS_HEALTHY_PCT 2.0
+
+//! Android thermal status at which upward probing stops (MODERATE).
+#define HEALTH_THERMAL_HOLD 2
+
+//! Android thermal status that triggers a decrease (SEVERE).
+#define HEALTH_THERMAL_BACKOFF 3
+
+//! Android thermal status that triggers the harder halving decrease (CRITICAL).
+#define HEALTH_THERMAL_SEVERE 4
+
+//! Display misses per report that mean the client's decoder cannot keep up.
+#define HEALTH_MISSES_BACKOFF 3
+
+//! Decode interval growth over its tracked best that triggers a decrease.
+#define HEALTH_DECODE_BACKOFF_FACTOR 1.5f
+
+//! Decode interval growth over its tracked best that blocks increases.
+#define HEALTH_DECODE_HOLD_FACTOR 1.2f
+
+//! How fast the tracked best decode interval may creep upwards, ms per second.
+#define HEALTH_DECODE_CREEP_MS_PER_S 0.1f
+
+struct ems_bitrate_controller
+{
+	int min_bitrate;
+	int max_bitrate;
+	int current_bitrate;
+
+	//! Smoothed client latency, ms. Negative means no sample yet.
+	float ewma_ms;
+
+	//! Tracked best-case latency, ms.
+	float baseline_ms;
+
+	//! Smoothed TWCC delay gradient, ms per packet. Hovers around zero on
+	//! a healthy link, so it needs no seeding.
+	float twcc_dod_ewma_ms;
+
+	//! Best client decode interval seen recently, ms. Negative until the
+	//! first health report.
+	float decode_best_ms;
+
+	//! When the last health report arrived, for the creep above.
+	int64_t last_health_ns;
+
+	//! Upward probing is blocked until this time, set by health reports
+	//! from a device that is warm but not yet worth backing off for.
+	int64_t increase_inhibited_until_ns;
+
+	int64_t last_sample_ns;
+	int64_t last_decrease_ns;
+	int64_t last_increase_ns;
+};
+
+struct ems_bitrate_controller *
+ems_bitrate_controller_create(int initial_bitrate, int min_bitrate, int max_bitrate)
+{
+	struct ems_bitrate_controller *ctrl = U_TYPED_CALLOC(struct ems_bitrate_controller);
+
+	ctrl->min_bitrate = min_bitrate;
+	ctrl->max_bitrate = max_bitrate;
+	ctrl->current_bitrate = CLAMP(initial_bitrate, min_bitrate, max_bitrate);
+	ctrl->ewma_ms = -1.0f;
+	ctrl->baseline_ms = -1.0f;
+	ctrl->decode_best_ms = -1.0f;
+
+	return ctrl;
+}
+
+void
+ems_bitrate_controller_destroy(struct ems_bitrate_controller **ctrl_ptr)
+{
+	struct ems_bitrate_controller *ctrl = *ctrl_ptr;
+	if (ctrl == NULL) {
+		return;
+	}
+
+	free(ctrl);
+	*ctrl_ptr = NULL;
+}
+
+/*!
+ * Multiplicative decrease shared by both feedback paths: respects the
+ * cooldown, stamps it, clamps to the minimum. Returns the new rate or 0
+ * when nothing changed; logging stays with the caller, which knows why.
+ */
+static int
+controller_decrease(struct ems_bitrate_controller *ctrl, bool severe, int64_t now_ns)
+{
+	if (now_ns - ctrl->last_decrease_ns < DECREASE_COOLDOWN_NS) {
+		return 0;
+	}
+
+	int target = severe ? ctrl->current_bitrate / 2 : ctrl->current_bitrate * 7 / 10;
+	target = MAX(target, ctrl->min_bitrate);
+
+	ctrl->last_decrease_ns = now_ns;
+
+	if (target == ctrl->current_bitrate) {
+		return 0;
+	}
+
+	ctrl->current_bitrate = target;
+	return target;
+}
+
+//! Additive increase shared by both feedback paths, see controller_decrease.
+static int
+controller_increase(struct ems_bitrate_controller *ctrl, int64_t now_ns)
+{
+	if (now_ns - ctrl->last_decrease_ns < INCREASE_HOLDOFF_NS ||
+	    now_ns - ctrl->last_increase_ns < INCREASE_INTERVAL_NS ||
+	    now_ns < ctrl->increase_inhibited_until_ns) {
+		return 0;
+	}
+
+	// Additive probe, at least 5% of the current rate so the change is
+	// worth a reconfiguration.
+	int step = MAX(ctrl->current_bitrate / 20, 1);
+	int target = MIN(ctrl->current_bitrate + step, ctrl->max_bitrate);
+
+	ctrl->last_increase_ns = now_ns;
+
+	if (target == ctrl->current_bitrate) {
+		return 0;
+	}
+
+	ctrl->current_bitrate = target;
+	return target;
+}
+
+int
+ems_bitrate_controller_push_latency(struct ems_bitrate_controller *ctrl, int64_t average_latency_ns, int64_t now_ns)
+{
+	const float sample_ms = time_ns_to_ms_f(average_latency_ns);
+
+	if (ctrl->ewma_ms < 0.0f) {
+		// First sample seeds both estimators.
+		ctrl->ewma_ms = sample_ms;
+		ctrl->baseline_ms = sample_ms;
+		ctrl->last_sample_ns = now_ns;
+		return 0;
+	}
+
+	ctrl->ewma_ms += EWMA_ALPHA * (sample_ms - ctrl->ewma_ms);
+
+	// Let the baseline creep upwards with time, then snap it down to any
+	// better latency we observe.
+	float dt_s = (float)time_ns_to_s(now_ns - ctrl->last_sample_ns);
+	ctrl->baseline_ms += BASELINE_CREEP_MS_PER_S * dt_s;
+	ctrl->baseline_ms = MIN(ctrl->baseline_ms, sample_ms);
+	ctrl->last_sample_ns = now_ns;
+
+	const float queuing_ms = ctrl->ewma_ms - ctrl->baseline_ms;
+
+	if (queuing_ms > BACKOFF_THRESHOLD_MS) {
+		int previous = ctrl->current_bitrate;
+		int target = controller_decrease(ctrl, queuing_ms > SEVERE_THRESHOLD_MS, now_ns);
+		if (target > 0) {
+			U_LOG_I("Queuing delay %.1fms (latency %.1fms over baseline %.1fms), backing off %d -> %d", //
+			        queuing_ms, ctrl->ewma_ms, ctrl->baseline_ms, previous, target);
+		}
+		return target;
+	}
+
+	if (queuing_ms < INCREASE_THRESHOLD_MS) {
+		int previous = ctrl->current_bitrate;
+		int target = controller_increase(ctrl, now_ns);
+		if (target > 0) {
+			U_LOG_D("Link healthy (queuing %.1fms), probing %d -> %d", queuing_ms, previous, target);
+		}
+		return target;
+	}
+
+	return 0;
+}
+
+int
+ems_bitrate_controller_push_twcc(struct ems_bitrate_controller *ctrl,
+                                 int64_t avg_delta_of_delta_ns,
+                                 float packet_loss_pct,
+                                 int64_t now_ns)
+{
+	const float dod_ms = time_ns_to_ms_f(avg_delta_of_delta_ns);
+	ctrl->twcc_dod_ewma_ms += EWMA_ALPHA * (dod_ms - ctrl->twcc_dod_ewma_ms);
+
+	if (ctrl->twcc_dod_ewma_ms > TWCC_OVERUSE_THRESHOLD_MS || packet_loss_pct > TWCC_LOSS_BACKOFF_PCT) {
+		int previous = ctrl->current_bitrate;
+		int target = controller_decrease(ctrl, ctrl->twcc_dod_ewma_ms > TWCC_SEVERE_THRESHOLD_MS, now_ns);
+		if (target > 0) {
+			U_LOG_I("TWCC overuse (delay gradient %.2fms/packet, loss %.1f%%), backing off %d -> %d", //
+			        ctrl->twcc_dod_ewma_ms, packet_loss_pct, previous, target);
+		}
+		return target;
+	}
+
+	if (ctrl->twcc_dod_ewma_ms < TWCC_UNDERUSE_THRESHOLD_MS && packet_loss_pct < TWCC_LOSS_HEALTHY_PCT) {
+		int previous = ctrl->current_bitrate;
+		int target = controller_increase(ctrl, now_ns);
+		if (target > 0) {
+			U_LOG_D("TWCC link healthy (delay gradient %.2fms/packet), probing %d -> %d", //
+			        ctrl->twcc_dod_ewma_ms, previous, target);
+		}
+		return target;
+	}
+
+	return 0;
+}
+
+int
+ems_bitrate_controller_push_health(
+    struct ems_bitrate_controller *ctrl, int thermal_status, float decode_interval_ms, int display_misses, int64_t now_ns)
+{
+	// Follow the decoder's cadence the way the latency path follows its
+	// baseline: the best interval seen recently is what the device can
+	// do, and a sustained climb above it is throttling even when the
+	// thermal API does not say so.
+	bool decode_degraded = false;
+	bool decode_warm = false;
+	if (decode_interval_ms > 0.0f) {
+		if (ctrl->decode_best_ms < 0.0f) {
+			ctrl->decode_best_ms = decode_interval_ms;
+		} else {
+			float dt_s = (float)time_ns_to_s(now_ns - ctrl->last_health_ns);
+			ctrl->decode_best_ms += HEALTH_DECODE_CREEP_MS_PER_S * dt_s;
+			ctrl->decode_best_ms = MIN(ctrl->decode_best_ms, decode_interval_ms);
+
+			decode_degraded = decode_interval_ms > HEALTH_DECODE_BACKOFF_FACTOR * ctrl->decode_best_ms;
+			decode_warm = decode_interval_ms > HEALTH_DECODE_HOLD_FACTOR * ctrl->decode_best_ms;
+		}
+		ctrl->last_health_ns = now_ns;
+	}
+
+	if (thermal_status >= HEALTH_THERMAL_BACKOFF || display_misses >= HEALTH_MISSES_BACKOFF || decode_degraded) {
+		int previous = ctrl->current_bitrate;
+		int target = controller_decrease(ctrl, thermal_status >= HEALTH_THERMAL_SEVERE, now_ns);
+		if (target > 0) {
+			U_LOG_I(
+			    "Client health degraded (thermal status %d, decode interval %.1fms over best %.1fms, "
+			    "%d display misses), backing off %d -> %d",
+			    thermal_status, decode_interval_ms, ctrl->decode_best_ms, display_misses, previous, target);
+		}
+		return target;
+	}
+
+	if (thermal_status >= HEALTH_THERMAL_HOLD || display_misses > 0 || decode_warm) {
+		// Not bad enough to back off, but a device this warm must not be
+		// probed upwards either; keep pushing the block out while the
+		// reports stay like this.
+		ctrl->increase_inhibited_until_ns = now_ns + INCREASE_HOLDOFF_NS;
+	}
+
+	return 0;
+}
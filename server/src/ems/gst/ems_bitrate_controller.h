@@ -0,0 +1,72 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Closed-loop bitrate controller fed by client frame feedback.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ems_bitrate_controller;
+
+/*!
+ * Create a controller. All bitrates are in the same unit the pipeline's
+ * encoder was configured with (kbps for most encoders).
+ */
+struct ems_bitrate_controller *
+ems_bitrate_controller_create(int initial_bitrate, int min_bitrate, int max_bitrate);
+
+void
+ems_bitrate_controller_destroy(struct ems_bitrate_controller **ctrl_ptr);
+
+/*!
+ * Feed one client frame report's average latency into the controller.
+ *
+ * Returns the new target bitrate when the controller wants a change, or 0
+ * when the current rate should be kept. Reacts within a few reports of
+ * latency building up, instead of waiting out a multi-second window.
+ */
+int
+ems_bitrate_controller_push_latency(struct ems_bitrate_controller *ctrl, int64_t average_latency_ns, int64_t now_ns);
+
+/*!
+ * Feed one transport-wide congestion control (TWCC) feedback window into the
+ * controller: the session's average inter-packet delay gradient
+ * (delta-of-delta) and packet loss percentage.
+ *
+ * Same contract as @ref ems_bitrate_controller_push_latency, and both inputs
+ * drive one shared AIMD state, so they can be used together. The delay
+ * gradient reacts within roughly one RTT, the frame-level latency only once
+ * a queue has already built up.
+ */
+int
+ems_bitrate_controller_push_twcc(struct ems_bitrate_controller *ctrl,
+                                 int64_t avg_delta_of_delta_ns,
+                                 float packet_loss_pct,
+                                 int64_t now_ns);
+
+/*!
+ * Feed one client health report into the controller: the Android thermal
+ * status (PowerManager THERMAL_STATUS_* value, 0 when unknown), the smoothed
+ * interval between frames leaving the client's decoder in ms (0 when
+ * unknown), and the display misses since the previous report.
+ *
+ * Same contract as @ref ems_bitrate_controller_push_latency. A throttling
+ * client triggers the shared multiplicative decrease even while the network
+ * looks perfectly healthy, and a merely warm one blocks upward probing.
+ */
+int
+ems_bitrate_controller_push_health(
+    struct ems_bitrate_controller *ctrl, int thermal_status, float decode_interval_ms, int display_misses, int64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,271 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Startup encoder auto-probe with micro-benchmark selection.
+ * @ingroup aux_util
+ */
+
+#include "ems_encoder_probe.h"
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "os/os_time.h"
+#include "util/u_logging.h"
+
+//! Frames fed through each candidate encoder.
+#define EMS_PROBE_NUM_FRAMES 120
+
+//! Frames fed through a branch to validate it can encode at all.
+#define EMS_PROBE_VALIDATE_FRAMES 30
+
+//! Give up on a candidate that hasn't finished after this long.
+#define EMS_PROBE_TIMEOUT (10 * GST_SECOND)
+
+/*!
+ * One encoder branch from create_pipeline(), reduced to what a synthetic
+ * videotestsrc feed needs. Property strings intentionally mirror the real
+ * branches so the benchmark measures the configuration we would ship.
+ */
+struct ems_encoder_candidate
+{
+	EmsEncoderType type;
+	//! Human-readable name, matches the --encoder option values.
+	const char *name;
+	//! Element the branch hinges on, probed for existence first.
+	const char *element;
+	//! Branch fragment from NV12 raw video to H.264, with a %u bitrate.
+	const char *fragment;
+};
+
+// clang-format off
+static const struct ems_encoder_candidate candidates[] = {
+	{EMS_ENCODER_TYPE_NVH264, "nvh264", "nvh264enc",
+	 "nvh264enc name=enc zerolatency=true bitrate=%u rc-mode=cbr preset=low-latency ! "
+	 "video/x-h264,profile=main"},
+	{EMS_ENCODER_TYPE_NVAUTOGPUH264, "nvautogpuh264", "nvautogpuh264enc",
+	 "cudaupload ! cudaconvert ! "
+	 "nvautogpuh264enc name=enc bitrate=%u rate-control=cbr preset=p1 tune=low-latency "
+	 "multi-pass=two-pass-quarter zero-reorder-delay=true cc-insert=disabled cabac=false ! "
+	 "video/x-h264,profile=main"},
+	{EMS_ENCODER_TYPE_VAH264, "vah264", "vah264enc",
+	 "vah264enc name=enc bitrate=%u rate-control=cbr aud=true cabac=true target-usage=7 ! "
+	 "video/x-h264,profile=main"},
+	{EMS_ENCODER_TYPE_VAAPIH264, "vaapih264", "vaapih264enc",
+	 "vaapih264enc name=enc bitrate=%u rate-control=cbr aud=true cabac=true quality-level=7 ! "
+	 "video/x-h264,profile=main"},
+	{EMS_ENCODER_TYPE_VULKANH264, "vulkanh264", "vulkanh264enc",
+	 "vulkanupload ! vulkanh264enc name=enc average-bitrate=%u ! h264parse ! "
+	 "video/x-h264,profile=main"},
+	{EMS_ENCODER_TYPE_X264, "x264", "x264enc",
+	 "x264enc name=enc tune=zerolatency sliced-threads=true speed-preset=ultrafast bframes=0 "
+	 "bitrate=%u key-int-max=120 intra-refresh=true ! "
+	 "video/x-h264,profile=baseline"},
+	{EMS_ENCODER_TYPE_OPENH264, "openh264", "openh264enc",
+	 "videoconvert ! video/x-raw,format=I420 ! "
+	 "openh264enc name=enc complexity=high rate-control=quality bitrate=%u ! "
+	 "video/x-h264,profile=main"},
+};
+// clang-format on
+
+//! Benchmark measurements for one candidate, see run_candidate.
+struct ems_probe_result
+{
+	const struct ems_encoder_candidate *candidate;
+	//! Encoded frames per second once the first frame was out.
+	double throughput_fps;
+	//! Wall time from PLAYING to the first encoded frame.
+	int64_t first_frame_ns;
+};
+
+static GstPadProbeReturn
+first_buffer_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	int64_t *first_buffer_ns = user_data;
+
+	*first_buffer_ns = os_monotonic_get_ns();
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static bool
+run_candidate(const struct ems_encoder_candidate *candidate,
+              uint32_t width,
+              uint32_t height,
+              uint32_t bitrate,
+              struct ems_probe_result *out_result)
+{
+	GstElementFactory *factory = gst_element_factory_find(candidate->element);
+	if (factory == NULL) {
+		U_LOG_I("Encoder probe: %s not available, skipping.", candidate->element);
+		return false;
+	}
+	gst_object_unref(factory);
+
+	gchar *fragment = g_strdup_printf(candidate->fragment, bitrate);
+	gchar *pipeline_str = g_strdup_printf(
+	    "videotestsrc num-buffers=%d ! "
+	    "video/x-raw,format=NV12,width=%u,height=%u,framerate=60/1 ! "
+	    "%s ! "
+	    "fakesink name=probesink sync=false",
+	    EMS_PROBE_NUM_FRAMES, width, height, fragment);
+	g_free(fragment);
+
+	GError *error = NULL;
+	GstElement *pipeline = gst_parse_launch(pipeline_str, &error);
+	g_free(pipeline_str);
+	if (error != NULL) {
+		U_LOG_W("Encoder probe: failed to build %s benchmark: %s", candidate->name, error->message);
+		g_clear_error(&error);
+		g_clear_object(&pipeline);
+		return false;
+	}
+
+	int64_t first_buffer_ns = 0;
+	{
+		GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "probesink");
+		GstPad *pad = gst_element_get_static_pad(sink, "sink");
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, first_buffer_probe_cb, &first_buffer_ns, NULL);
+		gst_object_unref(pad);
+		gst_object_unref(sink);
+	}
+
+	const int64_t start_ns = os_monotonic_get_ns();
+
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+		U_LOG_W("Encoder probe: %s refused to start.", candidate->name);
+		gst_element_set_state(pipeline, GST_STATE_NULL);
+		gst_object_unref(pipeline);
+		return false;
+	}
+
+	GstBus *bus = gst_element_get_bus(pipeline);
+	GstMessage *msg = gst_bus_timed_pop_filtered(bus, EMS_PROBE_TIMEOUT, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	gst_object_unref(bus);
+
+	const int64_t end_ns = os_monotonic_get_ns();
+
+	bool success = msg != NULL && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+	if (msg == NULL) {
+		U_LOG_W("Encoder probe: %s timed out.", candidate->name);
+	} else if (!success) {
+		GError *err = NULL;
+		gst_message_parse_error(msg, &err, NULL);
+		U_LOG_W("Encoder probe: %s failed: %s", candidate->name, err->message);
+		g_clear_error(&err);
+	}
+	gst_clear_message(&msg);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+
+	if (!success || first_buffer_ns == 0 || end_ns <= first_buffer_ns) {
+		return false;
+	}
+
+	// Startup cost is reported separately, steady-state throughput is
+	// measured from the first encoded frame onwards.
+	out_result->candidate = candidate;
+	out_result->first_frame_ns = first_buffer_ns - start_ns;
+	out_result->throughput_fps =
+	    (double)(EMS_PROBE_NUM_FRAMES - 1) * (double)GST_SECOND / (double)(end_ns - first_buffer_ns);
+
+	return true;
+}
+
+static gint
+compare_results(gconstpointer a, gconstpointer b)
+{
+	const struct ems_probe_result *ra = a;
+	const struct ems_probe_result *rb = b;
+
+	if (ra->throughput_fps != rb->throughput_fps) {
+		return ra->throughput_fps < rb->throughput_fps ? 1 : -1;
+	}
+
+	// Equal throughput: the one that got its first frame out sooner wins.
+	return ra->first_frame_ns < rb->first_frame_ns ? -1 : 1;
+}
+
+bool
+ems_encoder_probe_validate(const char *encoder_str, uint32_t width, uint32_t height)
+{
+	gchar *pipeline_str = g_strdup_printf(
+	    "videotestsrc num-buffers=%d ! "
+	    "video/x-raw,format=NV12,width=%u,height=%u,framerate=60/1 ! "
+	    "%s ! "
+	    "fakesink sync=false",
+	    EMS_PROBE_VALIDATE_FRAMES, width, height, encoder_str);
+
+	GError *error = NULL;
+	GstElement *pipeline = gst_parse_launch(pipeline_str, &error);
+	g_free(pipeline_str);
+	if (error != NULL) {
+		U_LOG_W("Encoder validation: failed to build the branch: %s", error->message);
+		g_clear_error(&error);
+		g_clear_object(&pipeline);
+		return false;
+	}
+
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+		U_LOG_W("Encoder validation: branch refused to start.");
+		gst_element_set_state(pipeline, GST_STATE_NULL);
+		gst_object_unref(pipeline);
+		return false;
+	}
+
+	GstBus *bus = gst_element_get_bus(pipeline);
+	GstMessage *msg = gst_bus_timed_pop_filtered(bus, EMS_PROBE_TIMEOUT, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	gst_object_unref(bus);
+
+	bool success = msg != NULL && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+	if (msg == NULL) {
+		U_LOG_W("Encoder validation: timed out.");
+	} else if (!success) {
+		GError *err = NULL;
+		gst_message_parse_error(msg, &err, NULL);
+		U_LOG_W("Encoder validation: %s", err->message);
+		g_clear_error(&err);
+	}
+	gst_clear_message(&msg);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+
+	return success;
+}
+
+EmsEncoderType
+ems_encoder_probe_select(uint32_t width, uint32_t height, uint32_t bitrate)
+{
+	struct ems_probe_result results[G_N_ELEMENTS(candidates)];
+	guint result_count = 0;
+
+	U_LOG_I("Encoder probe: benchmarking %d frames at %ux%u.", EMS_PROBE_NUM_FRAMES, width, height);
+
+	for (guint i = 0; i < G_N_ELEMENTS(candidates); i++) {
+		if (run_candidate(&candidates[i], width, height, bitrate, &results[result_count])) {
+			result_count++;
+		}
+	}
+
+	if (result_count == 0) {
+		U_LOG_W("Encoder probe: no candidate completed the benchmark, falling back to x264.");
+		return EMS_ENCODER_TYPE_X264;
+	}
+
+	qsort(results, result_count, sizeof(results[0]), compare_results);
+
+	for (guint i = 0; i < result_count; i++) {
+		U_LOG_I("Encoder probe: #%u %-13s %7.1f fps, first frame after %.1f ms", i + 1,
+		        results[i].candidate->name, results[i].throughput_fps,
+		        (double)results[i].first_frame_ns / 1e6);
+	}
+
+	U_LOG_I("Encoder probe: selected %s.", results[0].candidate->name);
+
+	return results[0].candidate->type;
+}
@@ -0,0 +1,50 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Startup encoder auto-probe with micro-benchmark selection.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ems_pipeline_args.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Pick the best available H.264 encoder by micro-benchmark.
+ *
+ * Runs a short synthetic encode of a few frames at the given stream
+ * resolution through every encoder branch whose elements exist on this
+ * machine, ranks them by measured throughput (with time-to-first-frame as
+ * tie-breaker), logs the ranking and returns the winner.
+ *
+ * gst_init() must have been called. Falls back to x264 when no candidate
+ * completes the benchmark.
+ */
+EmsEncoderType
+ems_encoder_probe_select(uint32_t width, uint32_t height, uint32_t bitrate);
+
+/*!
+ * Verify that an encode branch actually works before shipping it.
+ *
+ * Feeds a short synthetic clip at the given stream resolution through
+ * @p encoder_str, the branch fragment from raw video to parsed bitstream.
+ * Used at startup when --encode-gpu moves the encode session to another
+ * device, where element availability alone does not prove the session can
+ * open. Logs the failure reason and returns false when the branch cannot
+ * encode.
+ */
+bool
+ems_encoder_probe_validate(const char *encoder_str, uint32_t width, uint32_t height);
+
+#ifdef __cplusplus
+}
+#endif
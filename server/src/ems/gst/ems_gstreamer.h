@@ -12,6 +12,8 @@
 #include "xrt/xrt_frame.h"
 
 typedef struct _GstElement GstElement;
+typedef struct _GstAllocator GstAllocator;
+typedef struct _GstBufferPool GstBufferPool;
 
 
 #ifdef __cplusplus
@@ -71,6 +73,23 @@ struct ems_gstreamer_src
 
 	//! Cached appsrc element.
 	GstElement *appsrc;
+
+	//! Format string the appsrc caps were negotiated with.
+	const char *format_str;
+
+	//! Framerate the appsrc caps were negotiated with.
+	uint32_t refresh_rate_hz;
+
+	//! Attach foveated region-of-interest meta to every pushed frame,
+	//! from the EMS_ROI_ENCODING env option.
+	bool roi_enabled;
+
+	//! Lazily created allocator for wrapping compositor-exported DMABUFs.
+	GstAllocator *dmabuf_allocator;
+
+	//! Fixed-size pool for the serialized down-message payload attached to
+	//! every pushed frame, sized to the nanopb message bound.
+	GstBufferPool *payload_pool;
 };
 
 
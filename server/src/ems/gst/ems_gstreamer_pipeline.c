@@ -20,9 +20,17 @@
 #include <gst/gst.h>
 #include <gst/gststructure.h>
 #include <gst/rtp/gstrtpbuffer.h>
+#include <gst/rtp/gstrtphdrext.h>
+#include <gst/video/video-event.h>
 
 #include "electricmaple.pb.h"
+#include "ems_bitrate_controller.h"
 #include "ems_callbacks.h"
+#include "ems_encoder_probe.h"
+#include "ems_input_state.h"
+#include "ems_metrics.h"
+#include "ems_recorder.h"
+#include "ems_trace.h"
 #include "ems_signaling_server.h"
 #include "include/ems_common.h"
 #include "os/os_threading.h"
@@ -44,6 +52,13 @@
 
 #define WEBRTC_TEE_NAME "webrtctee"
 
+//! Transport-wide congestion control sequence number header extension, the
+//! feedback that drives the packet-level path of the bitrate controller.
+#define TWCC_EXT_URI "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"
+
+//! extmap id of @ref TWCC_EXT_URI, matching the client's receive caps.
+#define TWCC_EXT_ID 1
+
 #ifdef ANDROID
 #define DEFAULT_BITRATE 40000000
 #else
@@ -55,30 +70,186 @@
 #define RTP_TWOBYTES_HDR_EXT_ID 1 // Must be in the [1,15] range
 #define RTP_TWOBYTES_HDR_EXT_MAX_SIZE 255
 
+//! Must be larger than any encoder's frame latency, in frames.
+#define EMS_METADATA_RING_SIZE 8
+
+//! One frame's worth of down-message metadata, see metadata_ring below.
+struct ems_metadata_slot
+{
+	GstClockTime pts;
+	guint size;
+	char data[RTP_TWOBYTES_HDR_EXT_MAX_SIZE];
+};
+
+/*!
+ * One rung of the simulcast encode ladder.
+ *
+ * All rungs branch off a tee in front of the encoders, with a valve per rung
+ * so only the active one is actually fed, and feed one input-selector in
+ * front of the single payloader, so a switch never changes what RTP stream
+ * the client receives. The primary rung uses the empty suffix, keeping the
+ * historical element names ("enc", "rungvalve") valid for everything that
+ * looks them up.
+ */
+struct ems_encode_rung
+{
+	//! Element-name suffix for this rung's chain, e.g. "-low".
+	const char *suffix;
+	//! Divisor applied to the configured bitrate for this rung.
+	uint32_t bitrate_divisor;
+	//! Encode at half the stream resolution instead of full.
+	bool half_res;
+};
+
+static const struct ems_encode_rung ems_encode_rungs[] = {
+	{"", 1, false},
+	{"-mid", 2, false},
+	{"-low", 4, true},
+};
+
 EmsSignalingServer *signaling_server = NULL;
 
+//! Magic tag distinguishing clock sync packets from protobuf messages on the
+//! data channel. Must match the client, see em_connection.c.
+#define EM_CLOCK_SYNC_MAGIC 0x454D434C4B303100ULL
+
+/*!
+ * One NTP-style clock sync round trip over the reliable data channel.
+ *
+ * The client fills in @ref magic, @ref t0_client_tx and its current filtered
+ * result, we echo the packet back with @ref t1_server_rx and
+ * @ref t2_server_tx filled in. Layout must match the client, see
+ * em_connection.c.
+ */
+struct em_clock_sync_packet
+{
+	uint64_t magic;
+	//! Client monotonic time the request was sent.
+	int64_t t0_client_tx;
+	//! Server monotonic time the request was received.
+	int64_t t1_server_rx;
+	//! Server monotonic time the reply was sent.
+	int64_t t2_server_tx;
+	//! The client's current filtered offset (client - server).
+	int64_t reported_offset;
+	//! The client's current minimum RTT.
+	int64_t reported_rtt;
+};
+
+struct ems_gstreamer_pipeline;
+
+/*!
+ * Per-client streaming state.
+ *
+ * Owned by the pipeline's session table, keyed by @ref EmsClientId, so
+ * signaling events resolve their client's webrtcbin in O(1) instead of
+ * printf'ing the id into an element name and scanning the bin.
+ */
+struct ems_client_session
+{
+	//! Owning pipeline, for callbacks that only get handed the session.
+	struct ems_gstreamer_pipeline *egp;
+
+	EmsClientId client_id;
+
+	//! This client's webrtcbin, also owned by the pipeline bin.
+	GstElement *webrtcbin;
+
+	//! Reliable/ordered channel carrying clock sync and frame messages.
+	GObject *data_channel;
+
+	//! Unreliable/unordered channel carrying high-rate tracking messages.
+	GObject *tracking_data_channel;
+
+	//! The client's filtered clock offset (client - server), piggybacked on
+	//! its clock sync requests. Zero until the first round trips complete.
+	int64_t clock_offset;
+
+	//! The client's filtered data channel round trip time.
+	int64_t clock_rtt;
+
+	/*!
+	 * Preallocated decode arena for this client's UpMessages, reused across
+	 * messages so steady-state decoding never touches the heap. The joint
+	 * arrays double as the client's persistent last-known hand state:
+	 * sparse (delta-encoded) tracking messages only overwrite the joints
+	 * they actually carry.
+	 */
+	em_UpMessageSuper up_message_scratch;
+};
+
 struct ems_gstreamer_pipeline
 {
 	struct gstreamer_pipeline base;
 
 	GstElement *webrtc;
 
-	GObject *data_channel;
+	//! EmsClientId -> struct ems_client_session.
+	GHashTable *client_sessions;
+
+	//! Decode arena for up messages arriving over the WebSocket fallback,
+	//! which has no per-client session. See ems_client_session.
+	em_UpMessageSuper ws_up_message_scratch;
 
 	GstNetTimeProvider *ntp;
 
-	guint timeout_src_id;
 	guint timeout_src_id_dot_data;
 
+	guint timeout_src_id_twcc;
+
 	struct ems_callbacks *callbacks;
 
-	// todo: this may not be an ideal way to handle data racing
-	GMutex metadata_preservation_mutex;
-	char preserved_metadata[RTP_TWOBYTES_HDR_EXT_MAX_SIZE];
-	guint preserved_metadata_size;
+	/*!
+	 * SPSC ring of per-frame metadata, written by the payloader sink
+	 * probe and read by the payloader src probe, keyed by buffer PTS so
+	 * packets always carry the metadata of the frame they belong to even
+	 * when the payloader runs more than one frame behind. Publishing
+	 * happens through the atomic head, so neither side ever blocks.
+	 */
+	struct ems_metadata_slot metadata_ring[EMS_METADATA_RING_SIZE];
+	gint metadata_head;
 
 	int64_t client_average_latency;
 
+	/*!
+	 * Most recent client-predicted display time mapped into the server
+	 * clock via the session's clock sync offset, anchoring the client's
+	 * vsync grid for the compositor's frame pacing. Zero until the first
+	 * frame message from a clock-synced client arrives.
+	 */
+	int64_t client_vsync_anchor_ns;
+
+	/*!
+	 * Latest per-eye gaze points reported by the client, normalized to
+	 * each eye's half of the stream texture. The appsrc centers its
+	 * encoding region of interest here, see ems_gstreamer_src. The
+	 * timestamp stays zero until the first gaze-carrying tracking
+	 * message arrives.
+	 */
+	struct xrt_vec2 gaze_points[2];
+	int64_t gaze_timestamp_ns;
+
+	//! Encoder actually in the pipeline, with auto resolved by the probe.
+	EmsEncoderType encoder_type;
+
+	//! Index into ems_encode_rungs of the rung the selector is sending.
+	guint active_rung;
+
+	//! Adapts the encoder bitrate to the latency the client reports.
+	struct ems_bitrate_controller *bitrate_controller;
+
+	//! packets-sent of the last TWCC stats poll, to skip stale windows.
+	guint twcc_last_packets_sent;
+
+	//! Periodic statistics sampler, optionally exporting to CSV.
+	struct ems_metrics *metrics;
+
+	//! Session recording branch, hanging off "rectee" while recording.
+	struct ems_recorder *recorder;
+
+	//! PTS of the last frame a trace rtp_send event was written for.
+	GstClockTime trace_last_pts;
+
 	GMainLoop *main_loop;
 };
 
@@ -194,14 +365,27 @@ webrtcbin_get_stats(GstElement *webrtcbin)
 	return G_SOURCE_REMOVE;
 }
 
+static void
+ems_client_session_free(gpointer data)
+{
+	struct ems_client_session *session = data;
+
+	g_clear_object(&session->data_channel);
+	g_clear_object(&session->tracking_data_channel);
+	gst_clear_object(&session->webrtcbin);
+	free(session);
+}
+
+//! Returns a new reference, or NULL for an unknown client.
 static GstElement *
-get_webrtcbin_for_client(GstBin *pipeline, EmsClientId client_id)
+get_webrtcbin_for_client(struct ems_gstreamer_pipeline *egp, EmsClientId client_id)
 {
-	gchar *name = g_strdup_printf("webrtcbin_%p", client_id);
-	GstElement *webrtcbin = gst_bin_get_by_name(pipeline, name);
-	g_free(name);
+	struct ems_client_session *session = g_hash_table_lookup(egp->client_sessions, client_id);
+	if (session == NULL) {
+		return NULL;
+	}
 
-	return webrtcbin;
+	return gst_object_ref(session->webrtcbin);
 }
 
 static void
@@ -217,10 +401,24 @@ connect_webrtc_to_tee(GstElement *webrtcbin)
 
 	GstPadTemplate *pad_template = gst_element_class_get_pad_template(GST_ELEMENT_GET_CLASS(webrtcbin), "sink_%u");
 
-	// GstCaps *caps = gst_caps_from_string("application/x-rtp,encoding-name=VP8,media=video,payload=96");
-	GstCaps *caps = gst_caps_from_string(
-		"application/x-rtp, "
-		"payload=96,encoding-name=H264,clock-rate=90000,media=video,packetization-mode=(string)1");
+	// packetization-mode only exists for H.264.
+	const char *caps_str = NULL;
+	switch (ems_arguments_get()->codec) {
+	case EMS_VIDEO_CODEC_H265:
+		caps_str = "application/x-rtp, "
+		           "payload=96,encoding-name=H265,clock-rate=90000,media=video";
+		break;
+	case EMS_VIDEO_CODEC_AV1:
+		caps_str = "application/x-rtp, "
+		           "payload=96,encoding-name=AV1,clock-rate=90000,media=video";
+		break;
+	case EMS_VIDEO_CODEC_H264:
+	default:
+		caps_str = "application/x-rtp, "
+		           "payload=96,encoding-name=H264,clock-rate=90000,media=video,packetization-mode=(string)1";
+		break;
+	}
+	GstCaps *caps = gst_caps_from_string(caps_str);
 
 	GstPad *sink_pad = gst_element_request_pad(webrtcbin, pad_template, "sink_0", caps);
 
@@ -228,12 +426,24 @@ connect_webrtc_to_tee(GstElement *webrtcbin)
 	g_assert(ret == GST_PAD_LINK_OK);
 
 	{
+		const struct ems_arguments *args = ems_arguments_get();
+
 		GArray *transceivers;
 		g_signal_emit_by_name(webrtcbin, "get-transceivers", &transceivers);
 		g_assert(transceivers != NULL && transceivers->len == 1);
 		GstWebRTCRTPTransceiver *trans = g_array_index(transceivers, GstWebRTCRTPTransceiver *, 0);
 		g_object_set(trans, "direction", GST_WEBRTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY, NULL);
-		g_object_set(trans, "fec-type", GST_WEBRTC_FEC_TYPE_ULP_RED, "fec-percentage", 5, NULL);
+		// webrtcbin only implements ULPFEC/RED (no flexfec), so the
+		// redundancy percentage is the whole knob. The encoder bitrate
+		// leaves room for it, see ems_gstreamer_pipeline_adjust_bitrate.
+		if (args->fec_percentage > 0) {
+			g_object_set(trans, "fec-type", GST_WEBRTC_FEC_TYPE_ULP_RED, "fec-percentage",
+			             args->fec_percentage, NULL);
+		}
+		// do-nack adds an rtprtxsend so a lost packet can be repaired
+		// within the client's jitter buffer window instead of stalling
+		// the decoder until the next intra point.
+		g_object_set(trans, "do-nack", args->enable_rtx, NULL);
 		g_array_unref(transceivers);
 	}
 
@@ -275,7 +485,7 @@ webrtc_on_ice_candidate_cb(GstElement *webrtcbin, guint mlineindex, gchar *candi
 }
 
 static void
-data_channel_error_cb(GstWebRTCDataChannel *datachannel, struct ems_gstreamer_pipeline *egp)
+data_channel_error_cb(GstWebRTCDataChannel *datachannel, struct ems_client_session *session)
 {
 	U_LOG_E("error");
 }
@@ -292,41 +502,58 @@ datachannel_send_message(GstWebRTCDataChannel *datachannel)
 	return G_SOURCE_CONTINUE;
 }
 
-gboolean
-datachannel_send_clock(GstWebRTCDataChannel *datachannel)
+/*!
+ * Answer a clock sync request from the client.
+ *
+ * The client runs the NTP-style filtering, all we have to do is timestamp the
+ * request on arrival and again right before the echo leaves, so our
+ * turnaround time does not count towards the measured path delay. The
+ * client's filtered result from previous round trips piggybacks on the
+ * request, that is our view of this client's clock.
+ */
+static void
+handle_clock_sync_request(GstWebRTCDataChannel *data_channel,
+                          const struct em_clock_sync_packet *request,
+                          struct ems_client_session *session)
 {
-	uint64_t *now = (uint64_t *)malloc(sizeof(uint64_t));
+	struct em_clock_sync_packet reply = *request;
+	reply.t1_server_rx = (int64_t)os_monotonic_get_ns();
 
-	*now = os_monotonic_get_ns();
+	session->clock_offset = request->reported_offset;
+	session->clock_rtt = request->reported_rtt;
 
-	GBytes *now_bytes = g_bytes_new_with_free_func(now, sizeof(uint64_t), (GDestroyNotify)g_free, now);
+	reply.t2_server_tx = (int64_t)os_monotonic_get_ns();
+	GBytes *bytes = g_bytes_new(&reply, sizeof(reply));
 
 	GError *error = NULL;
-	if (!gst_webrtc_data_channel_send_data_full(datachannel, now_bytes, &error)) {
-		U_LOG_E("Failed to send timestamp over data channel (%d): %s", error->code, error->message);
+	if (!gst_webrtc_data_channel_send_data_full(data_channel, bytes, &error)) {
+		U_LOG_E("Failed to send clock sync reply (%d): %s", error->code, error->message);
 		g_clear_error(&error);
 	}
 
-	g_bytes_unref(now_bytes);
-
-	return G_SOURCE_CONTINUE;
+	g_bytes_unref(bytes);
 }
 
 static void
-data_channel_open_cb(GstWebRTCDataChannel *datachannel, struct ems_gstreamer_pipeline *egp)
+data_channel_open_cb(GstWebRTCDataChannel *datachannel, struct ems_client_session *session)
 {
 	U_LOG_I("data channel opened");
-
-	egp->timeout_src_id = g_timeout_add_seconds(1, G_SOURCE_FUNC(datachannel_send_clock), datachannel);
 }
 
 static void
-data_channel_close_cb(GstWebRTCDataChannel *datachannel, struct ems_gstreamer_pipeline *egp)
+data_channel_close_cb(GstWebRTCDataChannel *datachannel, struct ems_client_session *session)
 {
 	U_LOG_I("data channel closed");
 
-	g_clear_handle_id(&egp->timeout_src_id, g_source_remove);
-	g_clear_object(&egp->data_channel);
+	g_clear_object(&session->data_channel);
+}
+
+static void
+tracking_data_channel_close_cb(GstWebRTCDataChannel *datachannel, struct ems_client_session *session)
+{
+	U_LOG_I("tracking data channel closed");
+
+	g_clear_object(&session->tracking_data_channel);
 }
 
 bool
@@ -351,100 +578,243 @@ ProtoMessage_decode_hand_joint_locations(pb_istream_t *istream, const pb_field_t
 	return true;
 }
 
-/// Used by both WebRTC & WebSocket
 static void
-handle_up_message(GBytes *data, struct ems_gstreamer_pipeline *egp)
+ems_gstreamer_pipeline_set_rung_valve(struct ems_gstreamer_pipeline *egp, guint rung, gboolean drop)
+{
+	gchar *name = g_strdup_printf("rungvalve%s", ems_encode_rungs[rung].suffix);
+	GstElement *valve = gst_bin_get_by_name(GST_BIN(egp->base.pipeline), name);
+	g_free(name);
+	if (valve == NULL) {
+		return;
+	}
+	g_object_set(valve, "drop", drop, NULL);
+	gst_object_unref(valve);
+}
+
+/*!
+ * Move the stream to a different simulcast rung.
+ *
+ * All rungs feed the one input-selector in front of the single payloader, so
+ * the client keeps seeing one RTP stream with one SSRC across switches. The
+ * new rung's valve is opened before the selector moves so the selected input
+ * never runs dry, the old valve closes last so only one encoder keeps working
+ * once the switch is done, and a refresh is requested so the client's decoder
+ * can join the new bitstream at an intra point.
+ */
+static void
+ems_gstreamer_pipeline_set_active_rung(struct ems_gstreamer_pipeline *egp, guint rung)
+{
+	if (rung >= G_N_ELEMENTS(ems_encode_rungs) || rung == egp->active_rung) {
+		return;
+	}
+
+	GstElement *selector = gst_bin_get_by_name(GST_BIN(egp->base.pipeline), "rungselect");
+	if (selector == NULL) {
+		U_LOG_E("No 'rungselect' element in pipeline, can not switch rung.");
+		return;
+	}
+
+	guint old_rung = egp->active_rung;
+	egp->active_rung = rung;
+
+	ems_gstreamer_pipeline_set_rung_valve(egp, rung, FALSE);
+
+	gchar *pad_name = g_strdup_printf("sink_%u", rung);
+	GstPad *pad = gst_element_get_static_pad(selector, pad_name);
+	g_free(pad_name);
+	if (pad != NULL) {
+		g_object_set(selector, "active-pad", pad, NULL);
+		gst_object_unref(pad);
+	}
+	gst_object_unref(selector);
+
+	ems_gstreamer_pipeline_set_rung_valve(egp, old_rung, TRUE);
+
+	U_LOG_I("Switched to encode rung %u (bitrate / %u%s).", rung, ems_encode_rungs[rung].bitrate_divisor,
+	        ems_encode_rungs[rung].half_res ? ", half resolution" : "");
+
+	ems_gstreamer_pipeline_request_refresh(&egp->base);
+}
+
+/*!
+ * Route a bitrate controller decision to the encoders, shared by the
+ * frame-latency and the TWCC feedback paths. A target of zero means the
+ * controller wants no change.
+ */
+static void
+ems_gstreamer_pipeline_apply_target_bitrate(struct ems_gstreamer_pipeline *egp, int target_bitrate)
+{
+	if (target_bitrate <= 0) {
+		return;
+	}
+
+	// The controller already applies hysteresis, the rung just follows
+	// its output in thirds of the configured bitrate.
+	const uint32_t bitrate = ems_arguments_get()->bitrate;
+	guint rung = 0;
+	if ((uint32_t)target_bitrate * 3 <= bitrate) {
+		rung = 2;
+	} else if ((uint32_t)target_bitrate * 3 <= bitrate * 2) {
+		rung = 1;
+	}
+	ems_gstreamer_pipeline_set_active_rung(egp, rung);
+
+	ems_gstreamer_pipeline_adjust_bitrate(&egp->base, target_bitrate);
+}
+
+/// Used by both WebRTC & WebSocket. @p clock_offset is the client's filtered
+/// (client - server) clock offset, or zero when unknown (WebSocket fallback,
+/// or before the first sync round trips complete).
+static void
+handle_up_message(GBytes *data,
+                  struct ems_gstreamer_pipeline *egp,
+                  em_UpMessageSuper *message_super,
+                  int64_t clock_offset)
 {
-	em_UpMessageSuper message_super = {};
-	em_proto_UpMessage message = em_proto_UpMessage_init_default;
+	static const em_proto_UpMessage up_message_init = em_proto_UpMessage_init_default;
+
+	// Only the proto part of the arena is reset per message; the joint
+	// arrays keep this client's last known state so a sparse
+	// (delta-encoded) message overlays just the joints it carries. Full
+	// messages simply overwrite everything. The stream reads straight out
+	// of the mapped GBytes and the decode callbacks write straight into
+	// the arena, so nothing here allocates or copies.
+	message_super->protoMessage = up_message_init;
+	em_proto_UpMessage *message = &message_super->protoMessage;
 
 	size_t n = 0;
 	const unsigned char *buf = g_bytes_get_data(data, &n);
 
 	pb_istream_t our_istream = pb_istream_from_buffer(buf, n);
 
-	message.tracking.hand_joint_locations_left.funcs.decode = ProtoMessage_decode_hand_joint_locations;
-	message.tracking.hand_joint_locations_left.arg = message_super.hand_joint_locations_left;
+	message->tracking.hand_joint_locations_left.funcs.decode = ProtoMessage_decode_hand_joint_locations;
+	message->tracking.hand_joint_locations_left.arg = message_super->hand_joint_locations_left;
 
-	message.tracking.hand_joint_locations_right.funcs.decode = ProtoMessage_decode_hand_joint_locations;
-	message.tracking.hand_joint_locations_right.arg = message_super.hand_joint_locations_right;
+	message->tracking.hand_joint_locations_right.funcs.decode = ProtoMessage_decode_hand_joint_locations;
+	message->tracking.hand_joint_locations_right.arg = message_super->hand_joint_locations_right;
 
-	bool result = pb_decode_ex(&our_istream, &em_proto_UpMessage_msg, &message, PB_DECODE_NULLTERMINATED);
+	bool result = pb_decode_ex(&our_istream, &em_proto_UpMessage_msg, message, PB_DECODE_NULLTERMINATED);
 	if (!result) {
 		U_LOG_E("Error! %s", PB_GET_ERROR(&our_istream));
 		return;
 	}
 
-	message_super.protoMessage = message;
+	// Input goes first: button and trigger edges are what players feel
+	// most, so they reach app-visible state before any tracking work
+	// below. Input-only messages carry no joints at all and are done
+	// right here, without ever touching the callback fan-out.
+	if (message->has_input) {
+		struct ems_input_state state = {
+			.grab_value_left = message->input.grab_value_left,
+			.grab_value_right = message->input.grab_value_right,
+			.sequence_idx = message->input.sequence_idx,
+			.receive_time_ns = os_monotonic_get_ns(),
+		};
+		ems_input_state_write(&state);
+	}
+
+	if (message->has_tracking) {
+		ems_callbacks_call(egp->callbacks, EMS_CALLBACKS_EVENT_TRACKING, message_super);
+		ems_callbacks_call(egp->callbacks, EMS_CALLBACKS_EVENT_CONTROLLER, message_super);
 
-	if (message.has_tracking) {
-		ems_callbacks_call(egp->callbacks, EMS_CALLBACKS_EVENT_TRACKING, &message_super);
-		ems_callbacks_call(egp->callbacks, EMS_CALLBACKS_EVENT_CONTROLLER, &message_super);
+		if (message->tracking.gaze_points_count == 2) {
+			for (int i = 0; i < 2; i++) {
+				egp->gaze_points[i].x = message->tracking.gaze_points[i].x;
+				egp->gaze_points[i].y = message->tracking.gaze_points[i].y;
+			}
+			egp->gaze_timestamp_ns = os_monotonic_get_ns();
+		}
 	}
 
-	if (message.has_frame) {
+	if (message->has_frame) {
 		U_LOG_D(
 			"Client frame message: frame_sequence_id %ld decode_complete_time %ld begin_frame_time %ld "
 			"display_time %ld average latency %.1f",
-			message.frame.frame_sequence_id, message.frame.decode_complete_time,
-			message.frame.begin_frame_time,
-			message.frame.display_time, time_ns_to_ms_f(message.frame.average_latency));
-		egp->client_average_latency = message.frame.average_latency;
+			message->frame.frame_sequence_id, message->frame.decode_complete_time,
+			message->frame.begin_frame_time,
+			message->frame.display_time, time_ns_to_ms_f(message->frame.average_latency));
+		egp->client_average_latency = message->frame.average_latency;
+		ems_metrics_push_client_latency(egp->metrics, message->frame.average_latency);
+
+		// Display times come straight off the client's vsync grid, so the
+		// latest one is a good phase anchor once we can map it into our
+		// clock domain; the compositor extrapolates the grid from there.
+		if (clock_offset != 0 && message->frame.display_time != 0) {
+			egp->client_vsync_anchor_ns = message->frame.display_time - clock_offset;
+		}
 
-		static int64_t last_time_change_bitrate = 0;
-		static float max_latency_over_window = 0;
-		static int current_bitrate = 4000;
+		int target_bitrate = ems_bitrate_controller_push_latency(
+			egp->bitrate_controller, message->frame.average_latency, os_monotonic_get_ns());
+		ems_gstreamer_pipeline_apply_target_bitrate(egp, target_bitrate);
+	}
 
-		if (last_time_change_bitrate == 0) {
-			last_time_change_bitrate = os_monotonic_get_ns();
-		} else {
-			if (time_ns_to_s(os_monotonic_get_ns() - last_time_change_bitrate) > 5) {
-				float max_latency_f = time_ns_to_ms_f(max_latency_over_window);
-				U_LOG_E("Max client latency %.1f", max_latency_f);
-				int target_bitrate = 0;
-
-				if (max_latency_f < 100) {
-					target_bitrate = 8000;
-				} else if (max_latency_f >= 100 && max_latency_f < 200) {
-					target_bitrate = 4000;
-				} else if (max_latency_f >= 200 && max_latency_f < 300) {
-					target_bitrate = 2000;
-				} else {
-					target_bitrate = 1000;
-				}
-
-				// if (target_bitrate != current_bitrate) {
-				// 	U_LOG_E("Adjust bitrate from %d to %d", current_bitrate, target_bitrate);
-				// 	ems_gstreamer_pipeline_adjust_bitrate(&egp->base, target_bitrate);
-				// 	current_bitrate = target_bitrate;
-				// }
-
-				last_time_change_bitrate = os_monotonic_get_ns();
-				max_latency_over_window = 0;
-			}
-		}
-		max_latency_over_window = MAX(egp->client_average_latency, max_latency_over_window);
+	if (message->has_health) {
+		U_LOG_D("Client health: thermal status %d, decode interval %.1fms, %d display misses",
+		        (int)message->health.thermal_status, message->health.decode_interval_ms,
+		        (int)message->health.display_misses);
+
+		// A throttling headset is a congestion point like any other:
+		// step the ladder down before the stutter becomes visible, the
+		// half-resolution rung also cuts the client's decode cost.
+		int target_bitrate = ems_bitrate_controller_push_health(
+			egp->bitrate_controller, message->health.thermal_status, message->health.decode_interval_ms,
+			message->health.display_misses, os_monotonic_get_ns());
+		ems_gstreamer_pipeline_apply_target_bitrate(egp, target_bitrate);
+	}
+
+	if (message->has_refresh_request) {
+		U_LOG_I("Client requested a stream refresh, %ld packets lost.",
+		        (long)message->refresh_request.lost_packets);
+		ems_gstreamer_pipeline_request_refresh(&egp->base);
 	}
 }
 
 static void
-data_channel_message_data_cb(GstWebRTCDataChannel *data_channel, GBytes *data, struct ems_gstreamer_pipeline *egp)
+data_channel_message_data_cb(GstWebRTCDataChannel *data_channel, GBytes *data, struct ems_client_session *session)
 {
-	handle_up_message(data, egp);
+	gsize size = 0;
+	gconstpointer ptr = g_bytes_get_data(data, &size);
+
+	if (size == sizeof(struct em_clock_sync_packet) &&
+	    ((const struct em_clock_sync_packet *)ptr)->magic == EM_CLOCK_SYNC_MAGIC) {
+		handle_clock_sync_request(data_channel, ptr, session);
+		return;
+	}
+
+	handle_up_message(data, session->egp, &session->up_message_scratch, session->clock_offset);
 }
 
 static void
 ws_up_message_cb(EmsSignalingServer *server, GBytes *data, struct ems_gstreamer_pipeline *egp)
 {
-	handle_up_message(data, egp);
+	handle_up_message(data, egp, &egp->ws_up_message_scratch, 0);
 }
 
 static void
-data_channel_message_string_cb(GstWebRTCDataChannel *data_channel, gchar *str, struct ems_gstreamer_pipeline *egp)
+data_channel_message_string_cb(GstWebRTCDataChannel *data_channel, gchar *str, struct ems_client_session *session)
 {
 	U_LOG_I("Received data channel message: %s\n", str);
 }
 
+/*!
+ * Pull the frame id out of an encoded DownMessage, for trace events.
+ *
+ * Only called while tracing is enabled; the message is a handful of bytes
+ * so decoding it per frame is cheap.
+ */
+static int64_t
+down_msg_frame_id(const uint8_t *data, size_t size)
+{
+	em_proto_DownMessage msg = em_proto_DownMessage_init_default;
+	pb_istream_t stream = pb_istream_from_buffer(data, size);
+
+	if (!pb_decode(&stream, em_proto_DownMessage_fields, &msg) || !msg.has_frame_data) {
+		return -1;
+	}
+
+	return msg.frame_data.frame_sequence_id;
+}
+
 GstPadProbeReturn
 rtppay_sink_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 {
@@ -472,15 +842,33 @@ rtppay_sink_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 		return GST_PAD_PROBE_OK;
 	}
 
-	g_mutex_lock(&egp->metadata_preservation_mutex);
+	if (map_info.size > RTP_TWOBYTES_HDR_EXT_MAX_SIZE) {
+		U_LOG_E("Metadata too large for RTP header (%" G_GSIZE_FORMAT " > %d bytes).", map_info.size,
+		        RTP_TWOBYTES_HDR_EXT_MAX_SIZE);
+		gst_buffer_unmap(struct_buf, &map_info);
+		return GST_PAD_PROBE_OK;
+	}
+
+	// The payloader sits right behind the encoder, so its sink pad sees
+	// each frame the moment the encoder is done with it.
+	if (ems_trace_is_enabled()) {
+		ems_trace_instant("encoder_out", EMS_TRACE_LANE_PIPELINE,
+		                  down_msg_frame_id(map_info.data, map_info.size), os_monotonic_get_ns());
+	}
 
-	// Copy struct_buf to egp->preserved_metadata
-	memcpy(egp->preserved_metadata, map_info.data, map_info.size);
-	egp->preserved_metadata_size = map_info.size;
+	// Fill the next ring slot, then publish it by bumping the head. The
+	// src probe only ever looks at slots below the head, so it never sees
+	// a partially written one.
+	gint head = g_atomic_int_get(&egp->metadata_head);
+	struct ems_metadata_slot *slot = &egp->metadata_ring[head % EMS_METADATA_RING_SIZE];
+
+	slot->pts = GST_BUFFER_PTS(buffer);
+	memcpy(slot->data, map_info.data, map_info.size);
+	slot->size = (guint)map_info.size;
 
 	gst_buffer_unmap(struct_buf, &map_info);
 
-	g_mutex_unlock(&egp->metadata_preservation_mutex);
+	g_atomic_int_set(&egp->metadata_head, head + 1);
 
 	return GST_PAD_PROBE_OK;
 }
@@ -537,13 +925,35 @@ rtppay_src_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 	// 	return GST_PAD_PROBE_OK;
 	// }
 
-	g_mutex_lock(&egp->metadata_preservation_mutex);
+	// Find this packet's frame in the ring by PTS, the payloader keeps the
+	// frame's timestamp on every packet it produces. Newest first, since
+	// that is the common case.
+	GstClockTime pts = GST_BUFFER_PTS(buffer);
+	gint head = g_atomic_int_get(&egp->metadata_head);
+
+	const struct ems_metadata_slot *match = NULL;
+	for (gint i = head - 1; i >= head - EMS_METADATA_RING_SIZE && i >= 0; i--) {
+		const struct ems_metadata_slot *slot = &egp->metadata_ring[i % EMS_METADATA_RING_SIZE];
+		if (slot->pts == pts) {
+			match = slot;
+			break;
+		}
+	}
+	if (match == NULL && head > 0) {
+		// No exact match (meta got dropped somewhere), fall back to the
+		// newest metadata like the old single-slot code did.
+		match = &egp->metadata_ring[(head - 1) % EMS_METADATA_RING_SIZE];
+	}
+	if (match == NULL) {
+		gst_rtp_buffer_unmap(&rtp_buffer);
+		return GST_PAD_PROBE_OK;
+	}
 
 	// Copy metadata into RTP header
-	if (!gst_rtp_buffer_add_extension_twobytes_header(&rtp_buffer, 0, RTP_TWOBYTES_HDR_EXT_ID,
-	                                                  egp->preserved_metadata, egp->preserved_metadata_size)) {
+	if (!gst_rtp_buffer_add_extension_twobytes_header(&rtp_buffer, 0, RTP_TWOBYTES_HDR_EXT_ID, match->data,
+	                                                  match->size)) {
 		U_LOG_E("Failed to add extension data!");
-		g_mutex_unlock(&egp->metadata_preservation_mutex);
+		gst_rtp_buffer_unmap(&rtp_buffer);
 		return GST_PAD_PROBE_OK;
 	}
 
@@ -552,10 +962,15 @@ rtppay_src_pad_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 		U_LOG_E("The RTP extension bit was not set!");
 	}
 
-	gst_rtp_buffer_unmap(&rtp_buffer);
-	// gst_buffer_unmap(struct_buf, &map_info);
+	// One rtp_send event per frame, not per packet: this probe runs for
+	// every packet the payloader produces.
+	if (ems_trace_is_enabled() && pts != egp->trace_last_pts) {
+		egp->trace_last_pts = pts;
+		ems_trace_instant("rtp_send", EMS_TRACE_LANE_PIPELINE,
+		                  down_msg_frame_id((const uint8_t *)match->data, match->size), os_monotonic_get_ns());
+	}
 
-	g_mutex_unlock(&egp->metadata_preservation_mutex);
+	gst_rtp_buffer_unmap(&rtp_buffer);
 
 	return GST_PAD_PROBE_OK;
 }
@@ -578,6 +993,8 @@ ems_gstreamer_pipeline_add_payload_pad_probe(struct ems_gstreamer_pipeline *self
 {
 	GstPipeline *pipeline = GST_PIPELINE(self->base.pipeline);
 
+	// The whole encode ladder funnels through this one payloader, so the
+	// metadata ring keeps a single writer by construction.
 	GstElement *rtppay = gst_bin_get_by_name(GST_BIN(pipeline), "rtppay");
 	if (rtppay == NULL) {
 		U_LOG_E("Could not find rtppay element.");
@@ -588,6 +1005,7 @@ ems_gstreamer_pipeline_add_payload_pad_probe(struct ems_gstreamer_pipeline *self
 		GstPad *pad = gst_element_get_static_pad(rtppay, "sink");
 		if (pad == NULL) {
 			U_LOG_E("Could not find static sink pad in rtppay.");
+			gst_object_unref(rtppay);
 			return false;
 		}
 
@@ -599,6 +1017,7 @@ ems_gstreamer_pipeline_add_payload_pad_probe(struct ems_gstreamer_pipeline *self
 		GstPad *pad = gst_element_get_static_pad(rtppay, "src");
 		if (pad == NULL) {
 			U_LOG_E("Could not find static src pad in rtppay.");
+			gst_object_unref(rtppay);
 			return false;
 		}
 
@@ -611,6 +1030,90 @@ ems_gstreamer_pipeline_add_payload_pad_probe(struct ems_gstreamer_pipeline *self
 	return true;
 }
 
+/*!
+ * Attach the transport-wide sequence number header extension to the video
+ * payloader. The client advertises the matching extmap in its receive caps,
+ * which makes its rtpsession return TWCC feedback over the existing RTCP
+ * path; our session aggregates that feedback into "twcc-stats", polled by
+ * sample_twcc_stats below.
+ */
+static void
+ems_gstreamer_pipeline_add_twcc_extension(struct ems_gstreamer_pipeline *self)
+{
+	GstPipeline *pipeline = GST_PIPELINE(self->base.pipeline);
+
+	GstRTPHeaderExtension *ext = gst_rtp_header_extension_create_from_uri(TWCC_EXT_URI);
+	if (ext == NULL) {
+		// The extension element lives in gst-plugins-good; without it
+		// the controller simply keeps running on the slower
+		// frame-level latency signal alone.
+		U_LOG_W("No TWCC header extension element, keeping frame-level congestion control only.");
+		return;
+	}
+	gst_rtp_header_extension_set_id(ext, TWCC_EXT_ID);
+
+	GstElement *rtppay = gst_bin_get_by_name(GST_BIN(pipeline), "rtppay");
+	g_assert(rtppay);
+	g_signal_emit_by_name(rtppay, "add-extension", ext);
+	gst_object_unref(rtppay);
+	gst_object_unref(ext);
+}
+
+/*!
+ * Periodic poll of the video session's TWCC statistics, feeding the
+ * inter-packet delay gradient and packet loss into the bitrate controller.
+ * Packet-level feedback turns congestion around within about one RTT, where
+ * the frame-level latency signal in handle_up_message needs the queue to
+ * already be tens of milliseconds deep before it reacts.
+ */
+static gboolean
+sample_twcc_stats(struct ems_gstreamer_pipeline *egp)
+{
+	if (!egp || !egp->base.pipeline) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	GstElement *rtpbin = gst_bin_get_by_name(GST_BIN(egp->base.pipeline), "rtpbin");
+	if (rtpbin == NULL) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	GObject *session = NULL;
+	g_signal_emit_by_name(rtpbin, "get-internal-session", 0, &session);
+	gst_object_unref(rtpbin);
+	if (session == NULL) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	GstStructure *stats = NULL;
+	g_object_get(session, "twcc-stats", &stats, NULL);
+	g_object_unref(session);
+	if (stats == NULL) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	guint packets_sent = 0;
+	gint64 avg_delta_of_delta = 0;
+	gdouble packet_loss_pct = 0.0;
+	gst_structure_get_uint(stats, "packets-sent", &packets_sent);
+	gst_structure_get_int64(stats, "avg-delta-of-delta", &avg_delta_of_delta);
+	gst_structure_get_double(stats, "packet-loss-pct", &packet_loss_pct);
+	gst_structure_free(stats);
+
+	// No feedback since the last poll (or a client without the extension):
+	// don't replay a stale window, the frame-level signal still runs.
+	if (packets_sent == egp->twcc_last_packets_sent) {
+		return G_SOURCE_CONTINUE;
+	}
+	egp->twcc_last_packets_sent = packets_sent;
+
+	int target_bitrate = ems_bitrate_controller_push_twcc(egp->bitrate_controller, avg_delta_of_delta,
+	                                                      (float)packet_loss_pct, os_monotonic_get_ns());
+	ems_gstreamer_pipeline_apply_target_bitrate(egp, target_bitrate);
+
+	return G_SOURCE_CONTINUE;
+}
+
 /// When a WebSocket connection is established, we start creating a WebRTC connection.
 static void
 webrtc_client_connected_cb(EmsSignalingServer *server,
@@ -623,6 +1126,8 @@ webrtc_client_connected_cb(EmsSignalingServer *server,
 #ifdef USE_WEBRTC
 	GstBin *pipeline = GST_BIN(egp->base.pipeline);
 
+	// The element name is only kept for dot dumps, lookup goes through the
+	// session table.
 	gchar *name = g_strdup_printf("webrtcbin_%p", client_id);
 	GstElement *webrtcbin = gst_element_factory_make("webrtcbin", name);
 	g_free(name);
@@ -631,6 +1136,12 @@ webrtc_client_connected_cb(EmsSignalingServer *server,
 	g_object_set_data(G_OBJECT(webrtcbin), "client_id", client_id);
 	gst_bin_add(pipeline, webrtcbin);
 
+	struct ems_client_session *session = U_TYPED_CALLOC(struct ems_client_session);
+	session->egp = egp;
+	session->client_id = client_id;
+	session->webrtcbin = gst_object_ref(webrtcbin);
+	g_hash_table_insert(egp->client_sessions, client_id, session);
+
 	GstStateChangeReturn ret = gst_element_set_state(webrtcbin, GST_STATE_READY);
 	g_assert(ret != GST_STATE_CHANGE_FAILURE);
 
@@ -640,21 +1151,43 @@ webrtc_client_connected_cb(EmsSignalingServer *server,
 
 	// TODO add priority
 	GstStructure *data_channel_options = gst_structure_new_from_string("data-channel-options, ordered=true");
-	g_signal_emit_by_name(webrtcbin, "create-data-channel", "channel", data_channel_options, &egp->data_channel);
+	g_signal_emit_by_name(webrtcbin, "create-data-channel", "channel", data_channel_options,
+	                      &session->data_channel);
 	gst_clear_structure(&data_channel_options);
 
-	if (!egp->data_channel) {
+	if (!session->data_channel) {
 		U_LOG_E("Couldn't make datachannel!");
 		assert(false);
 	} else {
 		U_LOG_I("Successfully created datachannel!");
 
-		g_signal_connect(egp->data_channel, "on-open", G_CALLBACK(data_channel_open_cb), egp);
-		g_signal_connect(egp->data_channel, "on-close", G_CALLBACK(data_channel_close_cb), egp);
-		g_signal_connect(egp->data_channel, "on-error", G_CALLBACK(data_channel_error_cb), egp);
-		g_signal_connect(egp->data_channel, "on-message-data", G_CALLBACK(data_channel_message_data_cb), egp);
-		g_signal_connect(egp->data_channel, "on-message-string", G_CALLBACK(data_channel_message_string_cb),
-		                 egp);
+		g_signal_connect(session->data_channel, "on-open", G_CALLBACK(data_channel_open_cb), session);
+		g_signal_connect(session->data_channel, "on-close", G_CALLBACK(data_channel_close_cb), session);
+		g_signal_connect(session->data_channel, "on-error", G_CALLBACK(data_channel_error_cb), session);
+		g_signal_connect(session->data_channel, "on-message-data", G_CALLBACK(data_channel_message_data_cb),
+		                 session);
+		g_signal_connect(session->data_channel, "on-message-string", G_CALLBACK(data_channel_message_string_cb),
+		                 session);
+	}
+
+	// Unreliable/unordered channel dedicated to high-rate tracking: a lost
+	// packet must never head-of-line-block the poses that follow it.
+	GstStructure *tracking_channel_options =
+	    gst_structure_new_from_string("data-channel-options, ordered=false, max-retransmits=0");
+	g_signal_emit_by_name(webrtcbin, "create-data-channel", "tracking", tracking_channel_options,
+	                      &session->tracking_data_channel);
+	gst_clear_structure(&tracking_channel_options);
+
+	if (!session->tracking_data_channel) {
+		U_LOG_E("Couldn't make tracking datachannel!");
+	} else {
+		U_LOG_I("Successfully created tracking datachannel!");
+
+		g_signal_connect(session->tracking_data_channel, "on-close",
+		                 G_CALLBACK(tracking_data_channel_close_cb), session);
+		g_signal_connect(session->tracking_data_channel, "on-error", G_CALLBACK(data_channel_error_cb), session);
+		g_signal_connect(session->tracking_data_channel, "on-message-data",
+		                 G_CALLBACK(data_channel_message_data_cb), session);
 	}
 
 	g_signal_connect(webrtcbin, "on-ice-candidate", G_CALLBACK(webrtc_on_ice_candidate_cb), NULL);
@@ -688,9 +1221,15 @@ webrtc_client_connected_cb(EmsSignalingServer *server,
 	if (!ems_gstreamer_pipeline_add_payload_pad_probe(egp)) {
 		U_LOG_E("Failed to add payload pad probe.");
 	}
+
+	ems_gstreamer_pipeline_add_twcc_extension(egp);
 #endif
 
 	egp->timeout_src_id_dot_data = g_timeout_add_seconds(3, G_SOURCE_FUNC(check_pipeline_dot_data), egp);
+
+	// Poll faster than the client's RTCP feedback arrives so no TWCC
+	// window goes unused; unchanged windows are skipped in the sampler.
+	egp->timeout_src_id_twcc = g_timeout_add(100, G_SOURCE_FUNC(sample_twcc_stats), egp);
 }
 
 static void
@@ -699,7 +1238,6 @@ webrtc_sdp_answer_cb(EmsSignalingServer *server,
                      const gchar *sdp,
                      struct ems_gstreamer_pipeline *egp)
 {
-	GstBin *pipeline = GST_BIN(egp->base.pipeline);
 	GstSDPMessage *sdp_msg = NULL;
 	GstWebRTCSessionDescription *desc = NULL;
 
@@ -712,7 +1250,7 @@ webrtc_sdp_answer_cb(EmsSignalingServer *server,
 	if (desc) {
 		GstPromise *promise;
 
-		GstElement *webrtcbin = get_webrtcbin_for_client(pipeline, client_id);
+		GstElement *webrtcbin = get_webrtcbin_for_client(egp, client_id);
 		if (!webrtcbin) {
 			goto out;
 		}
@@ -739,10 +1277,8 @@ webrtc_candidate_cb(EmsSignalingServer *server,
                     const gchar *candidate,
                     struct ems_gstreamer_pipeline *egp)
 {
-	GstBin *pipeline = GST_BIN(egp->base.pipeline);
-
 	if (strlen(candidate)) {
-		GstElement *webrtcbin = get_webrtcbin_for_client(pipeline, client_id);
+		GstElement *webrtcbin = get_webrtcbin_for_client(egp, client_id);
 		if (webrtcbin) {
 			g_signal_emit_by_name(webrtcbin, "add-ice-candidate", mlineindex, candidate);
 			gst_object_unref(webrtcbin);
@@ -768,8 +1304,7 @@ webrtc_client_disconnected_cb(EmsSignalingServer *server, EmsClientId client_id,
 {
 	U_LOG_I("WebRTC client disconnected: %p", client_id);
 
-	GstBin *pipeline = GST_BIN(egp->base.pipeline);
-	GstElement *webrtcbin = get_webrtcbin_for_client(pipeline, client_id);
+	GstElement *webrtcbin = get_webrtcbin_for_client(egp, client_id);
 
 	if (webrtcbin) {
 		webrtcbin_get_stats(webrtcbin);
@@ -783,6 +1318,42 @@ webrtc_client_disconnected_cb(EmsSignalingServer *server, EmsClientId client_id,
 			gst_clear_object(&sinkpad);
 		}
 	}
+
+	// Drops the session's channel and webrtcbin references, the probe above
+	// holds its own reference until the element is out of the bin.
+	g_hash_table_remove(egp->client_sessions, client_id);
+}
+
+/*!
+ * A client reconnected within the resume grace window: hand its parked
+ * webrtcbin and channels over to the new connection and kick an ICE restart,
+ * skipping the SDP renegotiation and channel setup of a fresh connect.
+ */
+static void
+webrtc_client_resumed_cb(EmsSignalingServer *server,
+                         EmsClientId client_id,
+                         EmsClientId old_client_id,
+                         struct ems_gstreamer_pipeline *egp)
+{
+	U_LOG_I("WebRTC client resumed: %p (was %p)", client_id, old_client_id);
+
+	struct ems_client_session *session = NULL;
+	if (!g_hash_table_steal_extended(egp->client_sessions, old_client_id, NULL, (gpointer *)&session)) {
+		U_LOG_W("No session to resume for client %p!", old_client_id);
+		return;
+	}
+
+	session->client_id = client_id;
+	g_hash_table_insert(egp->client_sessions, client_id, session);
+	g_object_set_data(G_OBJECT(session->webrtcbin), "client_id", client_id);
+
+	// Only the transport addresses changed, so an ICE restart is all the
+	// new offer needs to carry; the encoder and the data channels stay up.
+	GstStructure *options = gst_structure_new("options", "ice-restart", G_TYPE_BOOLEAN, TRUE, NULL);
+	GstPromise *promise =
+	    gst_promise_new_with_change_func((GstPromiseChangeFunc)on_offer_created, session->webrtcbin, NULL);
+	g_signal_emit_by_name(session->webrtcbin, "create-offer", options, promise);
+	gst_clear_structure(&options);
 }
 
 /*
@@ -811,12 +1382,19 @@ static void
 destroy(struct xrt_frame_node *node)
 {
 	struct gstreamer_pipeline *gp = container_of(node, struct gstreamer_pipeline, node);
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
 
 	/*
 	 * All the nodes have been broken apart, and none of our functions will
 	 * be called, it's now safe to destroy and free ourselves.
 	 */
 
+	ems_config_stop_watch();
+	ems_recorder_destroy(&egp->recorder);
+	ems_metrics_destroy(&egp->metrics);
+	ems_bitrate_controller_destroy(&egp->bitrate_controller);
+	g_clear_pointer(&egp->client_sessions, g_hash_table_destroy);
+
 	free(gp);
 }
 
@@ -848,6 +1426,18 @@ ems_gstreamer_pipeline_encode_down_msg(em_proto_DownMessage *msg)
 	return g_bytes_new(buf, os.bytes_written);
 }
 
+void
+ems_gstreamer_pipeline_broadcast_quad_layer(struct gstreamer_pipeline *gp, GBytes *bytes)
+{
+	(void)gp;
+
+	if (signaling_server == NULL) {
+		return;
+	}
+
+	ems_signaling_server_broadcast_data(signaling_server, bytes);
+}
+
 void
 ems_gstreamer_pipeline_play(struct gstreamer_pipeline *gp)
 {
@@ -861,6 +1451,19 @@ ems_gstreamer_pipeline_play(struct gstreamer_pipeline *gp)
 
 	g_signal_connect(signaling_server, "ws-client-connected", G_CALLBACK(webrtc_client_connected_cb), egp);
 
+	egp->metrics = ems_metrics_create(egp->base.pipeline);
+
+	// Hot-reload of the device config JSON; the watcher fires on the main
+	// loop this thread is about to run.
+	ems_config_start_watch();
+
+	// Runtime start/stop goes through ems_gstreamer_pipeline_start_recording,
+	// the launch option just starts one right away.
+	const struct ems_arguments *args = ems_arguments_get();
+	if (args->stream_output_file_path != NULL) {
+		ems_gstreamer_pipeline_start_recording(gp, args->stream_output_file_path);
+	}
+
 	pthread_t thread;
 	pthread_create(&thread, NULL, loop_thread, egp);
 }
@@ -871,6 +1474,9 @@ ems_gstreamer_pipeline_stop(struct gstreamer_pipeline *gp)
 	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
 	U_LOG_I("Stopping pipeline");
 
+	// Finalize a running recording while the branch can still drain.
+	ems_gstreamer_pipeline_stop_recording(gp);
+
 	// Settle the pipeline.
 	U_LOG_T("Sending EOS");
 	gst_element_send_event(egp->base.pipeline, gst_event_new_eos());
@@ -925,103 +1531,142 @@ check_element_exists(const gchar *element_name)
 	}
 }
 
-void
-ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
-                              const char *video_appsrc_name,
-                              const char *audio_appsrc_name,
-                              struct ems_callbacks *callbacks_collection,
-                              struct gstreamer_pipeline **out_gp)
+/*!
+ * Build one simulcast rung's encode branch, from raw video to parsed
+ * bitstream. @p suffix distinguishes the per-rung element names, the primary
+ * rung passes "" so the historical "enc"/"encqueue" names stay valid.
+ */
+static gchar *
+build_encoder_str(EmsEncoderType encoder_type, const char *convert, uint32_t bitrate, const char *suffix)
 {
-	GError *error = NULL;
-
-	// In case this function is called many times
-	if (signaling_server) {
-		g_object_unref(signaling_server);
-	}
-
-	signaling_server = ems_signaling_server_new();
-
-	struct ems_gstreamer_pipeline *egp = U_TYPED_CALLOC(struct ems_gstreamer_pipeline);
-	egp->base.node.break_apart = break_apart;
-	egp->base.node.destroy = destroy;
-	egp->base.xfctx = xfctx;
-	egp->callbacks = callbacks_collection;
-
-	// setenv("GST_TRACERS", "latency(flags=pipeline+element+reported)", 1);
-	// setenv("GST_DEBUG", "GST_TRACER:7", 1);
-	// setenv("GST_DEBUG_FILE", "./latency.log", 1);
-
-	gst_init(NULL, NULL);
-
-#ifdef __ANDROID__
-	gst_debug_add_log_function(&gstAndroidLog, NULL, NULL);
-#endif
-	gst_debug_set_default_threshold(GST_LEVEL_WARNING);
-	gst_debug_set_threshold_for_name("decodebin2", GST_LEVEL_INFO);
-	gst_debug_set_threshold_for_name("webrtcbin", GST_LEVEL_INFO);
-	gst_debug_set_threshold_for_name("webrtcbindatachannel", GST_LEVEL_INFO);
-
-	const struct ems_arguments *args = ems_arguments_get();
+	// --encode-gpu: the NVENC family takes a CUDA device index property,
+	// also set on the upload/convert elements so the raw frames go straight
+	// to the encode card. The VA family selects by element name instead,
+	// see the VAH264 branch.
+	const gint encode_gpu = ems_arguments_get()->encode_gpu;
+	gchar *cuda_dev = encode_gpu >= 0 ? g_strdup_printf(" cuda-device-id=%d", encode_gpu) : g_strdup("");
+
+	// --slices: a fixed slice count decouples the slice layout from the
+	// thread count and gives the payloader (aggregate-mode=zero-latency)
+	// and slice-threaded decoders sub-frame chunks to work on.
+	const guint slices = ems_arguments_get()->slices;
 
 	gchar *encoder_str = NULL;
-	if (args->encoder_type == EMS_ENCODER_TYPE_X264) {
+	if (encoder_type == EMS_ENCODER_TYPE_X264) {
+		gchar *slice_str = slices > 1 ? g_strdup_printf("option-string=\"slices=%u\" ", slices) : g_strdup("");
 		encoder_str = g_strdup_printf(
-			"videoconvert ! "
+			"%s"
 			"videorate ! "
 			"video/x-raw,format=NV12,framerate=60/1 ! "
 			// Removing this queue will result in readback errors (Gst can't keep up consuming) and introduce 4x
 			// latency This does not seem to happen for GPU encoders.
-			"queue ! "
-			"x264enc name=enc tune=zerolatency sliced-threads=true speed-preset=ultrafast bframes=0 bitrate=%d "
-			"key-int-max=120 ! "
+			"queue name=encqueue%s ! "
+			// intra-refresh sweeps I-macroblock columns through the stream
+			// instead of emitting periodic full-size IDR frames, keeping
+			// frame sizes flat at our bitrates.
+			"x264enc name=enc%s tune=zerolatency sliced-threads=true speed-preset=ultrafast bframes=0 "
+			"bitrate=%d %s"
+			"key-int-max=120 intra-refresh=true ! "
 			// "amfh264enc name=enc preset=speed rate-control=cbr bitrate=%d ! "
 			"video/x-h264,profile=baseline",
-			args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_NVH264) {
+			convert, suffix, suffix, bitrate, slice_str);
+		g_free(slice_str);
+	} else if (encoder_type == EMS_ENCODER_TYPE_NVH264) {
 		const char *nvenc_pipe =
-			"videoconvert !"
-			"nvh264enc name=enc zerolatency=true bitrate=%d rc-mode=cbr preset=low-latency ! "
+			"%s"
+			"nvh264enc name=enc%s%s zerolatency=true bitrate=%d rc-mode=cbr preset=low-latency ! "
 			"video/x-h264,profile=main";
-		encoder_str = g_strdup_printf(nvenc_pipe, args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_NVAUTOGPUH264) {
+		encoder_str = g_strdup_printf(nvenc_pipe, convert, suffix, cuda_dev, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_NVAUTOGPUH264) {
 		const char *nvenc_pipe =
-			"cudaupload ! cudaconvert ! "
-			"nvautogpuh264enc name=enc bitrate=%d rate-control=cbr preset=p1 tune=low-latency "
+			"cudaupload%s ! cudaconvert%s ! "
+			"nvautogpuh264enc name=enc%s%s bitrate=%d rate-control=cbr preset=p1 tune=low-latency "
 			"multi-pass=two-pass-quarter zero-reorder-delay=true cc-insert=disabled cabac=false ! "
 			"video/x-h264,profile=main";
-		encoder_str = g_strdup_printf(nvenc_pipe, args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_VULKANH264) {
+		encoder_str = g_strdup_printf(nvenc_pipe, cuda_dev, cuda_dev, suffix, cuda_dev, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_VULKANH264) {
 		// TODO: Make vulkancolorconvert work with vulkanh264enc
 		encoder_str = g_strdup_printf(
-			"videoconvert ! videorate ! "
+			"%svideorate ! "
 			"video/x-raw,format=NV12,framerate=60/1 ! "
-			"vulkanupload ! vulkanh264enc name=enc average-bitrate=%d ! h264parse ! "
+			"vulkanupload ! vulkanh264enc name=enc%s average-bitrate=%d ! h264parse ! "
 			"video/x-h264,profile=main",
-			args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_OPENH264) {
+			convert, suffix, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_OPENH264) {
+		gchar *slice_str =
+			slices > 1 ? g_strdup_printf("slice-mode=n-slices num-slices=%u ", slices) : g_strdup("");
 		encoder_str = g_strdup_printf(
 			"videoconvert ! videorate ! "
 			"video/x-raw,format=I420,framerate=60/1 ! "
 			// Removing this queue will result in readback errors (Gst can't keep up consuming) and introduce
 			// 10x latency This does not seem to happen for GPU encoders.
-			"queue ! "
-			"openh264enc name=enc complexity=high rate-control=quality bitrate=%d ! "
+			"queue name=encqueue%s ! "
+			"openh264enc name=enc%s complexity=high rate-control=quality bitrate=%d %s! "
 			"video/x-h264,profile=main",
-			args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_VAAPIH264) {
+			suffix, suffix, bitrate, slice_str);
+		g_free(slice_str);
+	} else if (encoder_type == EMS_ENCODER_TYPE_VAAPIH264) {
 		encoder_str = g_strdup_printf(
-			"videoconvert ! videorate ! video/x-raw,format=NV12,framerate=60/1 ! "
-			"vaapih264enc name=enc bitrate=%d rate-control=cbr aud=true cabac=true quality-level=7 ! "
+			"%svideorate ! video/x-raw,format=NV12,framerate=60/1 ! "
+			"vaapih264enc name=enc%s bitrate=%d rate-control=cbr aud=true cabac=true quality-level=7 ! "
 			"video/x-h264,profile=main",
-			args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_VAH264) {
+			convert, suffix, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_VAH264) {
+		// The VA plugin registers one element per render node: the primary
+		// device gets plain vah264enc, the others varenderD<minor>h264enc.
+		gchar *va_element = NULL;
+		if (encode_gpu > 0) {
+			va_element = g_strdup_printf("varenderD%dh264enc", 128 + encode_gpu);
+			if (!check_element_exists(va_element)) {
+				U_LOG_W("No VA encoder on /dev/dri/renderD%d, using the primary device.",
+				        128 + encode_gpu);
+				g_free(va_element);
+				va_element = g_strdup("vah264enc");
+			}
+		} else {
+			va_element = g_strdup("vah264enc");
+		}
 		encoder_str = g_strdup_printf(
-			"videoconvert ! videorate ! video/x-raw,format=NV12,framerate=60/1 ! "
-			"vah264enc name=enc bitrate=%d rate-control=cbr aud=true cabac=true target-usage=7 ! "
+			"%svideorate ! video/x-raw,format=NV12,framerate=60/1 ! "
+			"%s name=enc%s bitrate=%d rate-control=cbr aud=true cabac=true target-usage=7 ! "
 			"video/x-h264,profile=main",
-			args->bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_AMC) {
-		uint32_t bitrate = args->bitrate * 10000;
+			convert, va_element, suffix, bitrate);
+		g_free(va_element);
+	} else if (encoder_type == EMS_ENCODER_TYPE_NVH265) {
+		encoder_str = g_strdup_printf(
+			"%s"
+			"nvh265enc name=enc%s%s zerolatency=true bitrate=%d rc-mode=cbr preset=low-latency ! "
+			"video/x-h265,profile=main ! "
+			"h265parse",
+			convert, suffix, cuda_dev, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_X265) {
+		encoder_str = g_strdup_printf(
+			"videoconvert ! videorate ! "
+			"video/x-raw,format=I420,framerate=60/1 ! "
+			// Same readback problem as the other software encoders.
+			"queue name=encqueue%s ! "
+			"x265enc name=enc%s tune=zerolatency speed-preset=ultrafast bitrate=%d key-int-max=120 ! "
+			"video/x-h265,profile=main ! "
+			"h265parse",
+			suffix, suffix, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_NVAV1) {
+		encoder_str = g_strdup_printf(
+			"%s"
+			"nvav1enc name=enc%s%s bitrate=%d rate-control=cbr preset=p1 tune=low-latency "
+			"zero-reorder-delay=true ! "
+			"av1parse",
+			convert, suffix, cuda_dev, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_SVTAV1) {
+		encoder_str = g_strdup_printf(
+			"videoconvert ! videorate ! "
+			"video/x-raw,format=I420,framerate=60/1 ! "
+			// Same readback problem as the other software encoders.
+			"queue name=encqueue%s ! "
+			"svtav1enc name=enc%s target-bitrate=%d preset=12 ! "
+			"av1parse",
+			suffix, suffix, bitrate);
+	} else if (encoder_type == EMS_ENCODER_TYPE_AMC) {
+		uint32_t amc_bitrate = bitrate * 10000;
 
 		const char *encoder_name = NULL;
 		if (check_element_exists("amcvidenc-c2qtiavcencoder")) {
@@ -1036,73 +1681,329 @@ ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
 		U_LOG_W("Using AMC encoder: %s", encoder_name);
 
 		encoder_str = g_strdup_printf(
-			"videoconvert ! "
+			"%s"
 			"videorate ! "
 			"video/x-raw,format=NV12,framerate=30/1 ! "
-			"%s name=enc bitrate=%d ! "
+			"%s name=enc%s bitrate=%d ! "
 			"video/x-h264,profile=high ! "
 			"h264parse",
-			encoder_name, bitrate);
-	} else if (args->encoder_type == EMS_ENCODER_TYPE_AUTO) {
-#ifdef ANDROID
-		uint32_t bitrate = args->bitrate * 10000;
-#else
-		uint32_t bitrate = args->bitrate;
-#endif
-
-		encoder_str = g_strdup_printf(
-			"videoconvert ! videorate ! "
-			"video/x-raw,format=NV12,framerate=30/1 ! "
-			"encodebin2 profile=\"video/"
-			"x-h264|element-properties,tune=4,sliced-threads=1,speed-preset=1,bframes=0,bitrate=%d,key-int-max="
-			"120\"",
-			bitrate);
+			convert, encoder_name, suffix, amc_bitrate);
 	} else {
 		U_LOG_E("Unexpected encoder type.");
 		abort();
 	}
 
+	g_free(cuda_dev);
+
+	return encoder_str;
+}
+
+/*!
+ * Point the GStreamer registry cache at a persistent, writable path.
+ *
+ * The cold plugin scan dominates gst_init time (seconds on our hosts).
+ * GStreamer caches the registry itself, but service users often run without
+ * a usable HOME and rescan on every launch; giving the cache an explicit
+ * location means only the very first launch pays the scan. GStreamer
+ * validates the cache against plugin mtimes on load, so a changed plugin
+ * set only rescans what differs.
+ */
+static void
+setup_registry_cache(void)
+{
+	if (g_getenv("GST_REGISTRY") != NULL) {
+		return;
+	}
+
+	gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "electric-maple", NULL);
+	if (g_mkdir_with_parents(cache_dir, 0700) != 0) {
+		U_LOG_W("Could not create registry cache dir '%s', keeping GStreamer defaults.", cache_dir);
+		g_free(cache_dir);
+		return;
+	}
+
+	gchar *registry_path = g_build_filename(cache_dir, "gst-registry.bin", NULL);
+	g_setenv("GST_REGISTRY", registry_path, FALSE);
+	// The fork-based scan helper only buys crash isolation during the scan
+	// and costs startup time; skip it for the service.
+	g_setenv("GST_REGISTRY_FORK", "no", FALSE);
+
+	g_free(registry_path);
+	g_free(cache_dir);
+}
+
+//! The payloader has to match the codec, see the client's decode chain.
+static gchar *
+build_payloader_str(EmsVideoCodec codec)
+{
+	switch (codec) {
+	case EMS_VIDEO_CODEC_H265:
+		return g_strdup("rtph265pay name=rtppay config-interval=-1 aggregate-mode=zero-latency");
+	case EMS_VIDEO_CODEC_AV1: return g_strdup("rtpav1pay name=rtppay");
+	case EMS_VIDEO_CODEC_H264:
+	default: return g_strdup("rtph264pay name=rtppay config-interval=-1 aggregate-mode=zero-latency");
+	}
+}
+
+void
+ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
+                              const char *video_appsrc_name,
+                              const char *audio_appsrc_name,
+                              bool nv12_input,
+                              struct ems_callbacks *callbacks_collection,
+                              struct gstreamer_pipeline **out_gp)
+{
+	GError *error = NULL;
+
+	// In case this function is called many times
+	if (signaling_server) {
+		g_object_unref(signaling_server);
+	}
+
+	signaling_server = ems_signaling_server_new();
+
+	struct ems_gstreamer_pipeline *egp = U_TYPED_CALLOC(struct ems_gstreamer_pipeline);
+	egp->base.node.break_apart = break_apart;
+	egp->base.node.destroy = destroy;
+	egp->base.xfctx = xfctx;
+	egp->callbacks = callbacks_collection;
+	egp->client_sessions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, ems_client_session_free);
+
+	// setenv("GST_TRACERS", "latency(flags=pipeline+element+reported)", 1);
+	// setenv("GST_DEBUG", "GST_TRACER:7", 1);
+	// setenv("GST_DEBUG_FILE", "./latency.log", 1);
+
+	setup_registry_cache();
+	gst_init(NULL, NULL);
+
+#ifdef __ANDROID__
+	gst_debug_add_log_function(&gstAndroidLog, NULL, NULL);
+#endif
+	gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+	gst_debug_set_threshold_for_name("decodebin2", GST_LEVEL_INFO);
+	gst_debug_set_threshold_for_name("webrtcbin", GST_LEVEL_INFO);
+	gst_debug_set_threshold_for_name("webrtcbindatachannel", GST_LEVEL_INFO);
+
+	const struct ems_arguments *args = ems_arguments_get();
+
+	// Closed-loop bitrate adaptation, fed by the client's frame reports.
+	egp->bitrate_controller = ems_bitrate_controller_create(args->bitrate, MAX(args->bitrate / 16, 500), //
+	                                                        args->bitrate);
+
+	EmsEncoderType encoder_type = args->encoder_type;
+	if (encoder_type == EMS_ENCODER_TYPE_AUTO) {
+		// Fleet machines are heterogeneous, measure instead of guessing.
+		const struct ems_device_config *config = ems_config_get();
+		encoder_type = ems_encoder_probe_select(config->resolution_stream_stereo_pixels.w,
+		                                        config->resolution_stream_stereo_pixels.h, args->bitrate);
+	}
+
+	// --codec overrides a mismatched (or defaulted) encoder choice,
+	// hardware first with a software fallback.
+	if (ems_encoder_type_codec(encoder_type) != args->codec) {
+		switch (args->codec) {
+		case EMS_VIDEO_CODEC_H265:
+			encoder_type =
+				check_element_exists("nvh265enc") ? EMS_ENCODER_TYPE_NVH265 : EMS_ENCODER_TYPE_X265;
+			break;
+		case EMS_VIDEO_CODEC_AV1:
+			encoder_type =
+				check_element_exists("nvav1enc") ? EMS_ENCODER_TYPE_NVAV1 : EMS_ENCODER_TYPE_SVTAV1;
+			break;
+		case EMS_VIDEO_CODEC_H264:
+		default: encoder_type = EMS_ENCODER_TYPE_X264; break;
+		}
+		U_LOG_I("Picked an encoder for the requested codec %s.", ems_video_codec_to_string(args->codec));
+	}
+	egp->encoder_type = encoder_type;
+
+	if (args->slices > 1 && encoder_type != EMS_ENCODER_TYPE_X264 && encoder_type != EMS_ENCODER_TYPE_OPENH264) {
+		U_LOG_W("--slices is only honored by the x264 and openh264 encoders, "
+		        "keeping this encoder's own slice layout.");
+	}
+
+	// With the compositor's GPU NV12 packing the appsrc already delivers
+	// NV12 and the CPU conversion element can be dropped entirely.
+	const char *convert = nv12_input ? "" : "videoconvert ! ";
+
+	gchar *encoder_str = build_encoder_str(encoder_type, convert, args->bitrate, "");
+	gchar *payloader_str = build_payloader_str(args->codec);
+
+	/*
+	 * Frames reach the encoder through the readback in system memory, so an
+	 * encode GPU other than the render GPU needs no cross-device sharing
+	 * extension - but element availability alone does not prove the chosen
+	 * device can open an encode session, so prove it with a short synthetic
+	 * encode before committing the whole pipeline to it.
+	 */
+	if (args->encode_gpu >= 0) {
+		switch (encoder_type) {
+		case EMS_ENCODER_TYPE_NVH264:
+		case EMS_ENCODER_TYPE_NVAUTOGPUH264:
+		case EMS_ENCODER_TYPE_NVH265:
+		case EMS_ENCODER_TYPE_NVAV1:
+		case EMS_ENCODER_TYPE_VAH264: break;
+		default:
+			U_LOG_W("--encode-gpu is only honored by the nv* and va* encoders, "
+			        "the configured encoder stays on its default device.");
+			break;
+		}
+
+		const struct ems_device_config *gpu_config = ems_config_get();
+		if (!ems_encoder_probe_validate(encoder_str, gpu_config->resolution_stream_stereo_pixels.w,
+		                                gpu_config->resolution_stream_stereo_pixels.h)) {
+			U_LOG_E("Encode GPU %d cannot run the configured encoder, exiting.", args->encode_gpu);
+			abort();
+		}
+		U_LOG_I("Encode sessions pinned to GPU %d, render GPU stays free for the app.", args->encode_gpu);
+	}
+
+	/*
+	 * Reproducible network impairment: a netsim stage in front of every
+	 * video udpsink stands in for the lossy link, so ABR and FEC changes
+	 * can be validated against fixed loss/delay/rate scenarios instead of
+	 * whatever the office Wi-Fi does today. See scripts/benchmark/.
+	 */
+	gchar *impair_str = NULL;
+	if (args->impair_loss_percent > 0.0 || args->impair_delay_ms > 0 || args->impair_jitter_ms > 0 ||
+	    args->impair_rate_kbps > 0) {
+		gchar drop_buf[G_ASCII_DTOSTR_BUF_SIZE];
+		g_ascii_dtostr(drop_buf, sizeof(drop_buf), args->impair_loss_percent / 100.0);
+
+		const gboolean delaying = args->impair_delay_ms > 0 || args->impair_jitter_ms > 0;
+		impair_str = g_strdup_printf(
+		    "netsim drop-probability=%s delay-probability=%s min-delay=%u max-delay=%u "
+		    "allow-reordering=false max-kbps=%d ! ",
+		    drop_buf, delaying ? "1.0" : "0.0", args->impair_delay_ms,
+		    args->impair_delay_ms + args->impair_jitter_ms,
+		    args->impair_rate_kbps > 0 ? (gint)args->impair_rate_kbps : -1);
+		U_LOG_I("Network impairment active: %s", impair_str);
+	} else {
+		impair_str = g_strdup("");
+	}
+
+	/*
+	 * The secondary simulcast rungs, branching off the pre-encode tee into
+	 * the input-selector in front of the single payloader. Their valves sit
+	 * in front of the encoders and start closed, so the rungs negotiate at
+	 * startup but do not encode until a rung switch opens them. The client
+	 * keeps seeing one RTP stream with one SSRC whichever rung is selected.
+	 */
+	const struct ems_device_config *stream_config = ems_config_get();
+	GString *rungs_str = g_string_new(NULL);
+	for (guint i = 1; i < G_N_ELEMENTS(ems_encode_rungs); i++) {
+		const struct ems_encode_rung *rung = &ems_encode_rungs[i];
+
+		gchar *scale_str = NULL;
+		if (rung->half_res) {
+			scale_str = g_strdup_printf("videoscale ! video/x-raw,width=%u,height=%u ! ",
+			                            stream_config->resolution_stream_stereo_pixels.w / 2,
+			                            stream_config->resolution_stream_stereo_pixels.h / 2);
+		} else {
+			scale_str = g_strdup("");
+		}
+
+		gchar *rung_encoder_str =
+			build_encoder_str(encoder_type, convert, args->bitrate / rung->bitrate_divisor, rung->suffix);
+
+		g_string_append_printf(rungs_str,
+		                       "enctee. ! "
+		                       "queue ! "
+		                       "valve name=rungvalve%s drop=true ! "
+		                       "%s"
+		                       "%s ! "
+		                       "rungselect.sink_%u ",
+		                       rung->suffix, scale_str, rung_encoder_str, i);
+
+		g_free(scale_str);
+		g_free(rung_encoder_str);
+	}
+
+	/*
+	 * Audio capture, one source per platform. On Linux PipeWire captures
+	 * the app's stream directly when the machine has it, with the Pulse
+	 * monitor of the HDMI sink as the fallback.
+	 */
+#ifdef __linux__
+	const char *audio_src_str =
+		check_element_exists("pipewiresrc")
+			? "pipewiresrc ! "
+			: "pulsesrc device=\"alsa_output.pci-0000_c6_00.1.hdmi-stereo-extra2.monitor\" ! ";
+#elif defined(_WIN32)
+	const char *audio_src_str = "wasapi2src loopback=true low-latency=true ! ";
+#else
+	const char *audio_src_str = "audiotestsrc is-live=true ! ";
+#endif
+
 	gchar *pipeline_str = g_strdup_printf(
 		"rtpbin name=rtpbin "
-		// Video
-		"appsrc name=%s ! "
-		"%s ! " //
-		"rtph264pay name=rtppay config-interval=-1 aggregate-mode=zero-latency ! "
+		/*
+		 * Single video send chain: every rung of the encode ladder
+		 * feeds the input-selector, so the client sees one payloader,
+		 * one SSRC and one RTP session whichever rung is active. The
+		 * shipped client links rtpbin's first video pad once and has
+		 * no new-SSRC handling, so switching between per-rung
+		 * payloaders mid-stream would leave its depayloader unlinked.
+		 */
+		"input-selector name=rungselect ! "
+		// Recording taps the encoded bitstream here; with no recording
+		// branch requested the tee just forwards, see ems_recorder.h.
+		"tee name=rectee allow-not-linked=true ! "
+		"%s ! "
 		"application/x-rtp,payload=96 ! "
 #ifdef USE_WEBRTC
 #error No longer available
 		"tee name=%s allow-not-linked=true",
-		appsrc_name, encoder_str, WEBRTC_TEE_NAME);
+		payloader_str, WEBRTC_TEE_NAME);
 #else
 		"rtpbin.send_rtp_sink_0 "
 		"rtpbin. ! "
+		"%s"
 		"udpsink name=udpsink-video port=5000 sync=false " // Host will be assigned later
 		"rtpbin.send_rtcp_src_0 ! udpsink name=video-rtcp-send port=5001 sync=false async=false "
 		"udpsrc port=5005 ! rtpbin.recv_rtcp_sink_0 "
-		// Audio
-#ifdef __linux__
-		"pulsesrc device=\"alsa_output.pci-0000_c6_00.1.hdmi-stereo-extra2.monitor\" ! "
-#elif defined(_WIN32)
-		"wasapi2src loopback=true low-latency=true ! "
+		// Video, primary simulcast rung
+		"appsrc name=%s ! "
+		"tee name=enctee ! "
 		"queue ! "
-#else
-		"audiotestsrc is-live=true ! "
-#endif
+		"valve name=rungvalve drop=false ! "
+		"%s ! "
+		"rungselect.sink_0 "
+		// Audio
+		"%s"
+		// The leaky queue puts the capture device on its own streaming
+		// thread and drops stale audio under load instead of
+		// backpressuring: the audio branch may never delay video.
+		"queue name=audio-capture-queue max-size-time=40000000 leaky=downstream ! "
 		"audioconvert ! "
 		"audioresample ! "
+		// The capture device clock drifts against the pipeline clock
+		// over a session; audiorate inserts or drops samples so the
+		// audio timestamps stay on the timeline the video stamps use.
+		"audiorate ! "
+		// Inband FEC lets the decoder reconstruct a lost 10 ms frame
+		// from the following packet, no retransmission round trip.
 		"opusenc name=audio-enc audio-type=restricted-lowdelay perfect-timestamp=true frame-size=10 "
-		"bitrate-type=cbr ! "
+		"bitrate-type=cbr inband-fec=true packet-loss-percentage=5 ! "
+		// Encode runs on its own thread too, the payloader and sink
+		// only ever see finished packets.
+		"queue name=audio-send-queue ! "
 		"rtpopuspay ! "
 		"application/x-rtp,encoding-name=OPUS,media=audio,payload=127 ! "
 		"rtpbin.send_rtp_sink_1 "
 		"rtpbin. ! "
 		"udpsink name=udpsink-audio port=5002 sync=false " // Host will be assigned later
 		"rtpbin.send_rtcp_src_1 ! udpsink name=audio-rtcp-send port=5003 sync=false async=false "
-		"udpsrc port=5007 ! rtpbin.recv_rtcp_sink_1 ",
-		video_appsrc_name, encoder_str);
+		"udpsrc port=5007 ! rtpbin.recv_rtcp_sink_1 "
+		// Secondary simulcast rungs
+		"%s",
+		payloader_str, impair_str, video_appsrc_name, encoder_str, audio_src_str, rungs_str->str);
 #endif
 
 	g_free(encoder_str);
+	g_free(payloader_str);
+	g_free(impair_str);
+	g_string_free(rungs_str, TRUE);
 
 	// No webrtc bin yet until later!
 
@@ -1118,6 +2019,7 @@ ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
 
 #ifdef USE_WEBRTC
 	g_signal_connect(signaling_server, "ws-client-disconnected", G_CALLBACK(webrtc_client_disconnected_cb), egp);
+	g_signal_connect(signaling_server, "ws-client-resumed", G_CALLBACK(webrtc_client_resumed_cb), egp);
 	g_signal_connect(signaling_server, "sdp-answer", G_CALLBACK(webrtc_sdp_answer_cb), egp);
 	g_signal_connect(signaling_server, "candidate", G_CALLBACK(webrtc_candidate_cb), egp);
 #else
@@ -1127,6 +2029,16 @@ ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
 	// Setup pipeline.
 	egp->base.pipeline = pipeline;
 
+	/*
+	 * Warm start: take the pipeline to PAUSED right away so element setup
+	 * and the encoder session initialization run at service start instead
+	 * of when the first headset connects; ems_gstreamer_pipeline_play only
+	 * has the PAUSED->PLAYING hop left. The live sources answer with
+	 * NO_PREROLL here, which is expected.
+	 */
+	const GstStateChangeReturn ret = gst_element_set_state(pipeline, GST_STATE_PAUSED);
+	g_assert(ret != GST_STATE_CHANGE_FAILURE);
+
 	/*
 	 * Add ourselves to the context so we are destroyed.
 	 * This is done once we know everything is completed.
@@ -1156,10 +2068,123 @@ ems_gstreamer_pipeline_get_current_time(struct gstreamer_pipeline *gp)
 	return current_time;
 }
 
+bool
+ems_gstreamer_pipeline_get_client_vsync_anchor(struct gstreamer_pipeline *gp, int64_t *out_anchor_ns)
+{
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+	const int64_t anchor_ns = egp->client_vsync_anchor_ns;
+	if (anchor_ns == 0) {
+		return false;
+	}
+
+	*out_anchor_ns = anchor_ns;
+	return true;
+}
+
+bool
+ems_gstreamer_pipeline_get_gaze(struct gstreamer_pipeline *gp, struct xrt_vec2 out_points[2])
+{
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+	// Stale gaze is worse than none: with tracking gone the user may be
+	// looking anywhere, so fall back to the lens-centered regions.
+	const int64_t stamp_ns = egp->gaze_timestamp_ns;
+	if (stamp_ns == 0 || os_monotonic_get_ns() - stamp_ns > 250 * (int64_t)GST_MSECOND) {
+		return false;
+	}
+
+	out_points[0] = egp->gaze_points[0];
+	out_points[1] = egp->gaze_points[1];
+	return true;
+}
+
 void
 ems_gstreamer_pipeline_adjust_bitrate(struct gstreamer_pipeline *gp, int target_bitrate)
 {
-	GstElement *encoder = gst_bin_get_by_name(GST_BIN(gp->pipeline), "enc");
-	g_object_set(encoder, "bitrate", target_bitrate, NULL);
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+#ifdef USE_WEBRTC
+	// The ULPFEC packets ride the same link as the media, so give them their
+	// share of the controller's budget: encoder plus redundancy together add
+	// up to the target, not the encoder alone.
+	const guint fec_percentage = ems_arguments_get()->fec_percentage;
+	target_bitrate = target_bitrate * 100 / (100 + (int)fec_percentage);
+#endif
+
+	gchar *enc_name = g_strdup_printf("enc%s", ems_encode_rungs[egp->active_rung].suffix);
+	GstElement *encoder = gst_bin_get_by_name(GST_BIN(gp->pipeline), enc_name);
+	g_free(enc_name);
+	if (encoder == NULL) {
+		U_LOG_W("No 'enc' element in pipeline, can not adjust bitrate.");
+		return;
+	}
+
+	// The property name and unit differ per encoder, use the same scaling
+	// the pipeline string was built with.
+	switch (egp->encoder_type) {
+	case EMS_ENCODER_TYPE_VULKANH264:
+		g_object_set(encoder, "average-bitrate", target_bitrate, NULL);
+		break;
+	case EMS_ENCODER_TYPE_AMC:
+		g_object_set(encoder, "bitrate", target_bitrate * 10000, NULL);
+		break;
+	case EMS_ENCODER_TYPE_SVTAV1:
+		g_object_set(encoder, "target-bitrate", target_bitrate, NULL);
+		break;
+	case EMS_ENCODER_TYPE_NVH264:
+	case EMS_ENCODER_TYPE_NVAUTOGPUH264:
+	case EMS_ENCODER_TYPE_X264:
+	case EMS_ENCODER_TYPE_OPENH264:
+	case EMS_ENCODER_TYPE_VAAPIH264:
+	case EMS_ENCODER_TYPE_VAH264:
+	default: g_object_set(encoder, "bitrate", target_bitrate, NULL);
+		break;
+	}
+
+	gst_object_unref(encoder);
+}
+
+bool
+ems_gstreamer_pipeline_start_recording(struct gstreamer_pipeline *gp, const char *path)
+{
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+	if (egp->recorder == NULL) {
+		egp->recorder = ems_recorder_create(egp->base.pipeline);
+	}
+
+	return ems_recorder_start(egp->recorder, path);
+}
+
+void
+ems_gstreamer_pipeline_stop_recording(struct gstreamer_pipeline *gp)
+{
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+	if (egp->recorder != NULL) {
+		ems_recorder_stop(egp->recorder);
+	}
+}
+
+void
+ems_gstreamer_pipeline_request_refresh(struct gstreamer_pipeline *gp)
+{
+	struct ems_gstreamer_pipeline *egp = (struct ems_gstreamer_pipeline *)gp;
+
+	gchar *enc_name = g_strdup_printf("enc%s", ems_encode_rungs[egp->active_rung].suffix);
+	GstElement *encoder = gst_bin_get_by_name(GST_BIN(gp->pipeline), enc_name);
+	g_free(enc_name);
+	if (encoder == NULL) {
+		U_LOG_W("No 'enc' element in pipeline, can not request a refresh.");
+		return;
+	}
+
+	// x264 with intra-refresh answers this with a column sweep instead of
+	// an IDR, the other encoders (nvenc does not expose intra-refresh in
+	// GStreamer) emit a regular keyframe.
+	GstEvent *event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0);
+	gst_element_send_event(encoder, event);
+
 	gst_object_unref(encoder);
-}
\ No newline at end of file
+}
@@ -27,23 +27,78 @@ typedef struct _em_proto_DownMessage em_proto_DownMessage;
 GBytes *
 ems_gstreamer_pipeline_encode_down_msg(em_proto_DownMessage *msg);
 
+/*!
+ * Ship a quad (UI) layer packet to every connected client, reliably over the
+ * ENet message channel instead of the video stream. Quad layers change rarely,
+ * so the compositor only sends one when its pixels or placement did, see
+ * ems_compositor.cpp. Safe to call from the frame loop, the send happens on
+ * the ENet thread.
+ */
+void
+ems_gstreamer_pipeline_broadcast_quad_layer(struct gstreamer_pipeline *gp, GBytes *bytes);
+
 void
 ems_gstreamer_pipeline_play(struct gstreamer_pipeline *gp);
 
 void
 ems_gstreamer_pipeline_stop(struct gstreamer_pipeline *gp);
 
+/*!
+ * @p nv12_input means the video appsrc pushes NV12 directly, so the encoder
+ * branches are built without their videoconvert element.
+ */
 void
 ems_gstreamer_pipeline_create(struct xrt_frame_context *xfctx,
                               const char *video_appsrc_name,
                               const char *audio_appsrc_name,
+                              bool nv12_input,
                               struct ems_callbacks *callbacks_collection,
                               struct gstreamer_pipeline **out_gp);
 
 uint64_t
 ems_gstreamer_pipeline_get_current_time(struct gstreamer_pipeline *gp);
 
+/*!
+ * Get a recent point on the client's vsync grid, mapped into the server's
+ * monotonic clock via the data channel clock sync. The compositor uses it to
+ * phase-align its frame cadence with the client display. Returns false until
+ * a clock-synced client has reported its first predicted display time.
+ */
+bool
+ems_gstreamer_pipeline_get_client_vsync_anchor(struct gstreamer_pipeline *gp, int64_t *out_anchor_ns);
+
+/*!
+ * Get the client's most recent per-eye gaze points, normalized to each eye's
+ * half of the stream texture. Returns false when the client has not reported
+ * gaze recently (no eye tracking, or tracking lost), in which case ROI
+ * encoding falls back to the lens-centered regions from the device config.
+ */
+bool
+ems_gstreamer_pipeline_get_gaze(struct gstreamer_pipeline *gp, struct xrt_vec2 out_points[2]);
+
 void
 ems_gstreamer_pipeline_adjust_bitrate(struct gstreamer_pipeline *gp, int target_bitrate);
 
+/*!
+ * Start recording the encoded session to an MKV file at @p path.
+ *
+ * The recording branch is fully decoupled from the live path, see
+ * ems_recorder.h. Returns false when a recording is already running.
+ */
+bool
+ems_gstreamer_pipeline_start_recording(struct gstreamer_pipeline *gp, const char *path);
+
+//! Stop a running recording and finalize the file. Safe to call when idle.
+void
+ems_gstreamer_pipeline_stop_recording(struct gstreamer_pipeline *gp);
+
+/*!
+ * Ask the encoder to refresh the picture, after the client reported loss.
+ *
+ * With intra-refresh enabled (x264 branch) this starts a rolling column
+ * sweep at the steady frame size; other encoders emit a keyframe.
+ */
+void
+ems_gstreamer_pipeline_request_refresh(struct gstreamer_pipeline *gp);
+
 G_END_DECLS
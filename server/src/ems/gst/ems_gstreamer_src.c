@@ -13,18 +13,29 @@
 #include "ems_gstreamer_src.h"
 
 #include <assert.h>
+#include <math.h>
 
+#include "electricmaple.pb.h"
+#include "ems_config.h"
 #include "ems_gstreamer.h"
+#include "ems_gstreamer_pipeline.h"
+#include "gst/allocators/gstdmabuf.h"
 #include "gst/app/gstappsink.h"
 #include "gst/app/gstappsrc.h"
 #include "gst/video/gstvideometa.h"
 #include "gst/video/video-format.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
 #include "os/os_time.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
 #include "util/u_misc.h"
 #include "util/u_trace_marker.h"
 
+DEBUG_GET_ONCE_BOOL_OPTION(roi_encoding, "EMS_ROI_ENCODING", false)
+
 /*
  *
  * Internal sink functions.
@@ -69,6 +80,153 @@ complain_if_wrong_image_size(struct xrt_frame *xf)
 	}
 }
 
+/*!
+ * Stamp PTS/duration on @p buffer and attach the down-message custom meta,
+ * shared between the readback and DMABUF push paths.
+ */
+static bool
+timestamp_and_attach_down_msg(struct ems_gstreamer_src *gs, GstBuffer *buffer, GBytes *downMsg_bytes)
+{
+	const uint64_t now = os_monotonic_get_ns();
+
+	// Use the first frame as offset.
+	if (gs->offset_ns == 0) {
+		gs->offset_ns = now;
+	}
+
+	// Need to be offset or gstreamer becomes sad.
+	GST_BUFFER_PTS(buffer) = now - gs->offset_ns;
+
+	// Duration is measured from last time stamp.
+	GST_BUFFER_DURATION(buffer) = now - gs->timestamp_ns;
+	gs->timestamp_ns = now;
+
+	size_t payload_size;
+	const gconstpointer payload_ptr = g_bytes_get_data(downMsg_bytes, &payload_size);
+
+	// Repack the protobuf into a pooled GstBuffer, falling back to a fresh
+	// allocation if the payload somehow outgrew the nanopb bound.
+	GstBuffer *struct_buf = NULL;
+	if (gs->payload_pool != NULL && payload_size <= em_proto_DownMessage_size &&
+	    gst_buffer_pool_acquire_buffer(gs->payload_pool, &struct_buf, NULL) == GST_FLOW_OK) {
+		gst_buffer_fill(struct_buf, 0, payload_ptr, payload_size);
+		gst_buffer_set_size(struct_buf, payload_size);
+	} else {
+		struct_buf = gst_buffer_new_memdup(payload_ptr, payload_size);
+	}
+	if (!struct_buf) {
+		U_LOG_E("Failed to allocate GstBuffer with payload.");
+		return false;
+	}
+
+	// Add it to a custom meta
+	GstCustomMeta *custom_meta = gst_buffer_add_custom_meta(buffer, "down-message");
+	if (custom_meta == NULL) {
+		U_LOG_E("Failed to add GstCustomMeta");
+		gst_buffer_unref(struct_buf);
+		return false;
+	}
+	GstStructure *custom_structure = gst_custom_meta_get_structure(custom_meta);
+	gst_structure_set(custom_structure, "protobuf", GST_TYPE_BUFFER, struct_buf, NULL);
+
+	gst_buffer_unref(struct_buf);
+
+	return true;
+}
+
+// Delta-QP steps for the foveated encode regions, positive is coarser.
+// ROI-capable encoders (the va/vaapi and nv branches) read the
+// "roi/delta-qp" param off the meta, everything else ignores it.
+static const int roi_fovea_delta_qp = -4;
+static const int roi_periphery_delta_qp = 6;
+
+// Half-extent of the full-quality fovea box and of the untouched transition
+// band around it, in tangent space of the eye's view frustum. Roughly 15 and
+// 30 degrees of visual angle.
+static const float roi_fovea_half_tan = 0.27f;
+static const float roi_mid_half_tan = 0.58f;
+
+static void
+add_roi(GstBuffer *buffer, int x, int y, int w, int h, int delta_qp)
+{
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+
+	GstVideoRegionOfInterestMeta *meta =
+		gst_buffer_add_video_region_of_interest_meta(buffer, "roi", (guint)x, (guint)y, (guint)w, (guint)h);
+	gst_video_region_of_interest_meta_add_param(
+		meta, gst_structure_new("roi/delta-qp", "delta-qp", G_TYPE_INT, delta_qp, NULL));
+}
+
+/*!
+ * Attach foveated region-of-interest metadata to a side-by-side stereo frame.
+ *
+ * Three quality zones per eye: a fovea box encoded finer than the base QP, an
+ * untouched transition band around it and a coarser periphery, split into
+ * non-overlapping rectangles. The zones center on the client's gaze when it
+ * reports one (see ems_gstreamer_pipeline_get_gaze) and on the optical axis
+ * derived from the lens FOV otherwise - the lens resolves the edges of the
+ * panel poorly either way, so peripheral bits are largely wasted.
+ */
+static void
+attach_roi_meta(struct ems_gstreamer_src *gs, GstBuffer *buffer, uint32_t width, uint32_t height)
+{
+	const struct ems_device_config *config = ems_config_get();
+
+	struct xrt_vec2 gaze[2];
+	const bool have_gaze = ems_gstreamer_pipeline_get_gaze(gs->gp, gaze);
+
+	const int eye_w = (int)width / 2;
+	const int h = (int)height;
+
+	for (uint32_t eye = 0; eye < 2; eye++) {
+		const struct xrt_fov *fov = &config->fov_radians[eye];
+		const float tan_left = tanf(fov->angle_left);
+		const float tan_w = tanf(fov->angle_right) - tan_left;
+		const float tan_up = tanf(fov->angle_up);
+		const float tan_h = tan_up - tanf(fov->angle_down);
+		if (tan_w <= 0.0f || tan_h <= 0.0f) {
+			continue;
+		}
+
+		// The optical axis in normalized eye coordinates; asymmetric
+		// lens frusta put it off center.
+		float cu = -tan_left / tan_w;
+		float cv = tan_up / tan_h;
+		if (have_gaze) {
+			cu = CLAMP(gaze[eye].x, 0.0f, 1.0f);
+			cv = CLAMP(gaze[eye].y, 0.0f, 1.0f);
+		}
+
+		const int x0 = (int)eye * eye_w;
+		const int cx = x0 + (int)(cu * (float)eye_w);
+		const int cy = (int)(cv * (float)h);
+
+		const int fovea_half_w = (int)(roi_fovea_half_tan / tan_w * (float)eye_w);
+		const int fovea_half_h = (int)(roi_fovea_half_tan / tan_h * (float)h);
+		const int mid_half_w = (int)(roi_mid_half_tan / tan_w * (float)eye_w);
+		const int mid_half_h = (int)(roi_mid_half_tan / tan_h * (float)h);
+
+		const int fx0 = MAX(cx - fovea_half_w, x0);
+		const int fy0 = MAX(cy - fovea_half_h, 0);
+		const int fx1 = MIN(cx + fovea_half_w, x0 + eye_w);
+		const int fy1 = MIN(cy + fovea_half_h, h);
+		add_roi(buffer, fx0, fy0, fx1 - fx0, fy1 - fy0, roi_fovea_delta_qp);
+
+		// Everything outside the transition band, as side strips plus
+		// top and bottom strips so the rectangles never overlap.
+		const int mx0 = MAX(cx - mid_half_w, x0);
+		const int my0 = MAX(cy - mid_half_h, 0);
+		const int mx1 = MIN(cx + mid_half_w, x0 + eye_w);
+		const int my1 = MIN(cy + mid_half_h, h);
+		add_roi(buffer, x0, 0, mx0 - x0, h, roi_periphery_delta_qp);
+		add_roi(buffer, mx1, 0, x0 + eye_w - mx1, h, roi_periphery_delta_qp);
+		add_roi(buffer, mx0, 0, mx1 - mx0, my0, roi_periphery_delta_qp);
+		add_roi(buffer, mx0, my1, mx1 - mx0, h - my1, roi_periphery_delta_qp);
+	}
+}
+
 void
 ems_gstreamer_src_push_frame(struct ems_gstreamer_src *gs, struct xrt_frame *xf, GBytes *downMsg_bytes)
 {
@@ -107,44 +265,112 @@ ems_gstreamer_src_push_frame(struct ems_gstreamer_src *gs, struct xrt_frame *xf,
 	gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, gst_fmt_from_xf_format(xf->format), xf->width,
 	                               xf->height, 1, offsets, strides);
 
-	const uint64_t now = os_monotonic_get_ns();
+	if (gs->roi_enabled) {
+		attach_roi_meta(gs, buffer, xf->width, xf->height);
+	}
 
-	// Use the first frame as offset.
-	if (gs->offset_ns == 0) {
-		gs->offset_ns = now;
+	if (!timestamp_and_attach_down_msg(gs, buffer, downMsg_bytes)) {
+		gst_buffer_unref(buffer);
+		return;
 	}
 
-	// Need to be offset or gstreamer becomes sad.
-	GST_BUFFER_PTS(buffer) = now - gs->offset_ns;
+	// All done, send it to the gstreamer pipeline.
+	ret = gst_app_src_push_buffer((GstAppSrc *)gs->appsrc, buffer);
+	if (ret != GST_FLOW_OK) {
+		U_LOG_E("Got GST error '%i'", ret);
+	}
+}
 
-	// Duration is measured from last time stamp.
-	GST_BUFFER_DURATION(buffer) = now - gs->timestamp_ns;
-	gs->timestamp_ns = now;
+void
+ems_gstreamer_src_push_dmabuf(struct ems_gstreamer_src *gs,
+                              int fd,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t stride,
+                              size_t size,
+                              GBytes *downMsg_bytes,
+                              GDestroyNotify release,
+                              gpointer release_data)
+{
+	SINK_TRACE_MARKER();
 
-	size_t payload_size;
-	const gconstpointer payload_ptr = g_bytes_get_data(downMsg_bytes, &payload_size);
+	if (gs->dmabuf_allocator == NULL) {
+		gs->dmabuf_allocator = gst_dmabuf_allocator_new();
+	}
 
-	// Repack the protobuf into a GstBuffer
-	GstBuffer *struct_buf = gst_buffer_new_memdup(payload_ptr, payload_size);
-	if (!struct_buf) {
-		U_LOG_E("Failed to allocate GstBuffer with payload.");
+	// The allocator takes ownership of the fd it is given, so hand it a dup
+	// and let the caller keep the exported fd for the image's lifetime.
+	int dup_fd = dup(fd);
+	if (dup_fd < 0) {
+		U_LOG_E("Failed to dup DMABUF fd %d", fd);
+		release(release_data);
 		return;
 	}
 
-	// Add it to a custom meta
-	GstCustomMeta *custom_meta = gst_buffer_add_custom_meta(buffer, "down-message");
-	if (custom_meta == NULL) {
-		U_LOG_E("Failed to add GstCustomMeta");
-		gst_buffer_unref(struct_buf);
+	GstMemory *mem = gst_dmabuf_allocator_alloc(gs->dmabuf_allocator, dup_fd, size);
+	if (mem == NULL) {
+		U_LOG_E("Failed to wrap DMABUF fd %d in GstMemory", dup_fd);
+		close(dup_fd);
+		release(release_data);
 		return;
 	}
-	GstStructure *custom_structure = gst_custom_meta_get_structure(custom_meta);
-	gst_structure_set(custom_structure, "protobuf", GST_TYPE_BUFFER, struct_buf, NULL);
 
-	gst_buffer_unref(struct_buf);
+	GstBuffer *buffer = gst_buffer_new();
+	gst_buffer_append_memory(buffer, mem);
 
-	// All done, send it to the gstreamer pipeline.
-	ret = gst_app_src_push_buffer((GstAppSrc *)gs->appsrc, buffer);
+	// Tell the caller when the pipeline is done with the image.
+	gst_mini_object_set_qdata(GST_MINI_OBJECT(buffer), g_quark_from_static_string("ems-dmabuf-release"),
+	                          release_data, release);
+
+	gsize offsets[4] = {0, 0, 0, 0};
+	gint strides[4] = {(gint)stride, 0, 0, 0};
+	gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_FORMAT_RGBx, width, height, 1,
+	                               offsets, strides);
+
+	if (gs->roi_enabled) {
+		attach_roi_meta(gs, buffer, width, height);
+	}
+
+	if (!timestamp_and_attach_down_msg(gs, buffer, downMsg_bytes)) {
+		gst_buffer_unref(buffer);
+		return;
+	}
+
+	GstFlowReturn ret = gst_app_src_push_buffer((GstAppSrc *)gs->appsrc, buffer);
+	if (ret != GST_FLOW_OK) {
+		U_LOG_E("Got GST error '%i'", ret);
+	}
+}
+
+void
+ems_gstreamer_src_push_nv12(struct ems_gstreamer_src *gs,
+                            const void *data,
+                            size_t size,
+                            uint32_t width,
+                            uint32_t height,
+                            GBytes *downMsg_bytes)
+{
+	SINK_TRACE_MARKER();
+
+	// The compositor reuses its readback buffer for the next frame as soon
+	// as we return, so the planes have to be copied out here.
+	GstBuffer *buffer = gst_buffer_new_memdup(data, size);
+
+	gsize offsets[4] = {0, (gsize)width * height, 0, 0};
+	gint strides[4] = {(gint)width, (gint)width, 0, 0};
+	gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_FORMAT_NV12, width, height, 2,
+	                               offsets, strides);
+
+	if (gs->roi_enabled) {
+		attach_roi_meta(gs, buffer, width, height);
+	}
+
+	if (!timestamp_and_attach_down_msg(gs, buffer, downMsg_bytes)) {
+		gst_buffer_unref(buffer);
+		return;
+	}
+
+	GstFlowReturn ret = gst_app_src_push_buffer((GstAppSrc *)gs->appsrc, buffer);
 	if (ret != GST_FLOW_OK) {
 		U_LOG_E("Got GST error '%i'", ret);
 	}
@@ -183,6 +409,15 @@ destroy(struct xrt_frame_node *node)
 	 * be called, it's now safe to destroy and free ourselves.
 	 */
 
+	if (gs->dmabuf_allocator != NULL) {
+		gst_object_unref(gs->dmabuf_allocator);
+	}
+
+	if (gs->payload_pool != NULL) {
+		gst_buffer_pool_set_active(gs->payload_pool, FALSE);
+		gst_object_unref(gs->payload_pool);
+	}
+
 	free(gs);
 }
 
@@ -192,28 +427,48 @@ destroy(struct xrt_frame_node *node)
  *
  */
 
+void
+ems_gstreamer_src_set_resolution(struct ems_gstreamer_src *gs, const struct xrt_size *extent)
+{
+	GstCaps *caps = gst_caps_new_simple( //
+		"video/x-raw", //
+		"format", G_TYPE_STRING, gs->format_str, //
+		"width", G_TYPE_INT, extent->w, //
+		"height", G_TYPE_INT, extent->h, //
+		"framerate", GST_TYPE_FRACTION, gs->refresh_rate_hz, 1, //
+		NULL);
+
+	gst_app_src_set_caps((GstAppSrc *)gs->appsrc, caps);
+	gst_caps_unref(caps);
+}
+
 void
 ems_gstreamer_src_create_with_pipeline(struct gstreamer_pipeline *gp,
                                        const struct xrt_size *extent,
                                        uint32_t refresh_rate_hz,
                                        enum xrt_format format,
+                                       bool nv12,
                                        const char *appsrc_name,
                                        struct ems_gstreamer_src **out_gs)
 {
 	const char *format_str = NULL;
-	switch (format) {
-	case XRT_FORMAT_R8G8B8: format_str = "RGB";
-		break;
-	case XRT_FORMAT_R8G8B8A8: format_str = "RGBA";
-		break;
-	case XRT_FORMAT_R8G8B8X8: format_str = "RGBx";
-		break;
-	case XRT_FORMAT_YUYV422: format_str = "YUY2";
-		break;
-	case XRT_FORMAT_L8: format_str = "GRAY8";
-		break;
-	default: assert(false);
-		break;
+	if (nv12) {
+		format_str = "NV12";
+	} else {
+		switch (format) {
+		case XRT_FORMAT_R8G8B8: format_str = "RGB";
+			break;
+		case XRT_FORMAT_R8G8B8A8: format_str = "RGBA";
+			break;
+		case XRT_FORMAT_R8G8B8X8: format_str = "RGBx";
+			break;
+		case XRT_FORMAT_YUYV422: format_str = "YUY2";
+			break;
+		case XRT_FORMAT_L8: format_str = "GRAY8";
+			break;
+		default: assert(false);
+			break;
+		}
 	}
 
 	const gchar *tags[] = {NULL};
@@ -228,6 +483,9 @@ ems_gstreamer_src_create_with_pipeline(struct gstreamer_pipeline *gp,
 	gs->node.destroy = destroy;
 	gs->gp = gp;
 	gs->appsrc = gst_bin_get_by_name(GST_BIN(gp->pipeline), appsrc_name);
+	gs->format_str = format_str;
+	gs->refresh_rate_hz = refresh_rate_hz;
+	gs->roi_enabled = debug_get_bool_option_roi_encoding();
 
 	GstCaps *caps = gst_caps_new_simple( //
 		"video/x-raw", //
@@ -250,6 +508,19 @@ ems_gstreamer_src_create_with_pipeline(struct gstreamer_pipeline *gp,
 
 	g_signal_connect(G_OBJECT(gs->appsrc), "enough-data", G_CALLBACK(enough_data), gs);
 
+	// Payloads have a bounded encoded size, so a few fixed-size buffers can
+	// cycle between push and meta teardown instead of a malloc+memdup+free
+	// per frame on the streaming thread.
+	gs->payload_pool = gst_buffer_pool_new();
+	GstStructure *pool_config = gst_buffer_pool_get_config(gs->payload_pool);
+	gst_buffer_pool_config_set_params(pool_config, NULL, em_proto_DownMessage_size, 4, 0);
+	if (!gst_buffer_pool_set_config(gs->payload_pool, pool_config) ||
+	    !gst_buffer_pool_set_active(gs->payload_pool, TRUE)) {
+		U_LOG_W("Failed to set up down-message payload pool, payloads will be allocated per frame.");
+		gst_object_unref(gs->payload_pool);
+		gs->payload_pool = NULL;
+	}
+
 	/*
 	 * Add ourselves to the context so we are destroyed.
 	 * This is done once we know everything is completed.
@@ -257,4 +528,4 @@ ems_gstreamer_src_create_with_pipeline(struct gstreamer_pipeline *gp,
 	xrt_frame_context_add(gp->xfctx, &gs->node);
 
 	*out_gs = gs;
-}
\ No newline at end of file
+}
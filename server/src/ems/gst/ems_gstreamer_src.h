@@ -25,14 +25,57 @@ struct gstreamer_pipeline;
 void
 ems_gstreamer_src_push_frame(struct ems_gstreamer_src *gs, struct xrt_frame *xf, GBytes *downMsg_bytes);
 
+/*!
+ * Push a frame that lives in a DMABUF exported by the compositor, avoiding any
+ * GPU->CPU readback. The fd is dup()'d internally, the caller keeps ownership
+ * of @p fd. @p release is called with @p release_data once the pipeline has
+ * released the buffer and the underlying image may be reused.
+ */
+void
+ems_gstreamer_src_push_dmabuf(struct ems_gstreamer_src *gs,
+                              int fd,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t stride,
+                              size_t size,
+                              GBytes *downMsg_bytes,
+                              GDestroyNotify release,
+                              gpointer release_data);
+
+/*!
+ * Push an NV12 frame produced by the compositor's compute conversion pass.
+ * @p data is the Y plane immediately followed by the interleaved UV plane,
+ * both tightly packed; it is copied, the caller may reuse it on return.
+ */
+void
+ems_gstreamer_src_push_nv12(struct ems_gstreamer_src *gs,
+                            const void *data,
+                            size_t size,
+                            uint32_t width,
+                            uint32_t height,
+                            GBytes *downMsg_bytes);
+
+/*!
+ * Renegotiate the appsrc caps for a new resolution, keeping the format and
+ * framerate from creation. The encoder follows on the next pushed buffer, so
+ * call this before pushing the first frame of the new size.
+ */
+void
+ems_gstreamer_src_set_resolution(struct ems_gstreamer_src *gs, const struct xrt_size *extent);
+
+/*!
+ * @p nv12 negotiates the appsrc as video/x-raw,format=NV12 instead of
+ * @p format, for use with @ref ems_gstreamer_src_push_nv12.
+ */
 void
 ems_gstreamer_src_create_with_pipeline(struct gstreamer_pipeline *gp,
                                        const struct xrt_size *extent,
                                        uint32_t refresh_rate_hz,
                                        enum xrt_format format,
+                                       bool nv12,
                                        const char *appsrc_name,
                                        struct ems_gstreamer_src **out_gs);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
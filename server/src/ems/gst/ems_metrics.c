@@ -0,0 +1,256 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Periodic pipeline statistics sampler with CSV export.
+ * @ingroup aux_util
+ */
+
+#include "ems_metrics.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ems_pipeline_args.h"
+#include "os/os_time.h"
+#include "util/u_logging.h"
+#include "util/u_misc.h"
+#include "util/u_time.h"
+
+//! How many samples the in-memory ring keeps. At the default one second
+//! interval this covers the last ~4 minutes.
+#define EMS_METRICS_RING_SIZE 256
+
+//! RTCP round-trip times are reported in NTP short format, 1/65536 s units.
+#define NTP_SHORT_TO_NS(x) ((int64_t)(x)*GST_SECOND / 65536)
+
+struct ems_metrics
+{
+	//! Borrowed, not reffed: the pipeline outlives the sampler.
+	GstElement *pipeline;
+
+	guint timeout_src_id;
+
+	//! CSV sink, NULL when no --metrics-csv path was given.
+	FILE *csv;
+
+	//! Guards the ring and the latency handoff below: up messages arrive
+	//! on a different thread than the sampler timer.
+	GMutex lock;
+
+	struct ems_metrics_sample ring[EMS_METRICS_RING_SIZE];
+	//! Total samples taken, not wrapped: ring index is modulo the size.
+	guint head;
+
+	int64_t client_average_latency_ns;
+};
+
+/*!
+ * Pull RTT and NACK counters out of the video RTP session.
+ *
+ * The server is the sender, so the round-trip time lives on our own
+ * internal sender source, computed from the client's receiver reports.
+ */
+static void
+sample_rtp_session(struct ems_metrics *metrics, struct ems_metrics_sample *sample)
+{
+	GstElement *rtpbin = gst_bin_get_by_name(GST_BIN(metrics->pipeline), "rtpbin");
+	if (rtpbin == NULL) {
+		return;
+	}
+
+	GObject *session = NULL;
+	g_signal_emit_by_name(rtpbin, "get-internal-session", 0, &session);
+	gst_object_unref(rtpbin);
+	if (session == NULL) {
+		return;
+	}
+
+	GstStructure *stats = NULL;
+	g_object_get(session, "stats", &stats, NULL);
+	g_object_unref(session);
+	if (stats == NULL) {
+		return;
+	}
+
+	gst_structure_get_uint(stats, "sent-nack-count", &sample->sent_nack_count);
+	gst_structure_get_uint(stats, "recv-nack-count", &sample->recv_nack_count);
+
+	const GValue *source_stats = gst_structure_get_value(stats, "source-stats");
+	if (source_stats != NULL) {
+		GValueArray *sources = g_value_get_boxed(source_stats);
+		for (guint i = 0; sources != NULL && i < sources->n_values; i++) {
+			const GstStructure *source = gst_value_get_structure(&sources->values[i]);
+
+			gboolean internal = FALSE;
+			gboolean is_sender = FALSE;
+			gst_structure_get_boolean(source, "internal", &internal);
+			gst_structure_get_boolean(source, "is-sender", &is_sender);
+			if (!internal || !is_sender) {
+				continue;
+			}
+
+			guint rb_round_trip = 0;
+			gst_structure_get_uint(source, "rb-round-trip", &rb_round_trip);
+			sample->rtt_ns = NTP_SHORT_TO_NS(rb_round_trip);
+			break;
+		}
+	}
+
+	gst_structure_free(stats);
+}
+
+static void
+sample_encoder(struct ems_metrics *metrics, struct ems_metrics_sample *sample)
+{
+	GstElement *encoder = gst_bin_get_by_name(GST_BIN(metrics->pipeline), "enc");
+	if (encoder == NULL) {
+		// The auto/encodebin2 branch has no named encoder to poke.
+		return;
+	}
+
+	// The property name differs per encoder, take whichever one exists.
+	GObjectClass *klass = G_OBJECT_GET_CLASS(encoder);
+	if (g_object_class_find_property(klass, "bitrate") != NULL) {
+		g_object_get(encoder, "bitrate", &sample->encoder_bitrate, NULL);
+	} else if (g_object_class_find_property(klass, "average-bitrate") != NULL) {
+		g_object_get(encoder, "average-bitrate", &sample->encoder_bitrate, NULL);
+	}
+
+	gst_object_unref(encoder);
+}
+
+static void
+sample_enc_queue(struct ems_metrics *metrics, struct ems_metrics_sample *sample)
+{
+	GstElement *queue = gst_bin_get_by_name(GST_BIN(metrics->pipeline), "encqueue");
+	if (queue == NULL) {
+		// Only the CPU encoder branches have a queue in front of the encoder.
+		return;
+	}
+
+	g_object_get(queue,                                          //
+	             "current-level-buffers", &sample->enc_queue_buffers, //
+	             "current-level-bytes", &sample->enc_queue_bytes,     //
+	             NULL);
+
+	gst_object_unref(queue);
+}
+
+static void
+write_csv_row(struct ems_metrics *metrics, const struct ems_metrics_sample *sample)
+{
+	if (metrics->csv == NULL) {
+		return;
+	}
+
+	fprintf(metrics->csv, "%" PRId64 ",%.3f,%u,%u,%u,%" G_GUINT64_FORMAT ",%u,%.3f\n", //
+	        sample->timestamp_ns,                                                      //
+	        time_ns_to_ms_f(sample->rtt_ns),                                           //
+	        sample->sent_nack_count,                                                   //
+	        sample->recv_nack_count,                                                   //
+	        sample->enc_queue_buffers,                                                 //
+	        sample->enc_queue_bytes,                                                   //
+	        sample->encoder_bitrate,                                                   //
+	        time_ns_to_ms_f(sample->client_average_latency_ns));
+	fflush(metrics->csv);
+}
+
+static gboolean
+sample_timer_cb(gpointer user_data)
+{
+	struct ems_metrics *metrics = user_data;
+
+	struct ems_metrics_sample sample = {0};
+	sample.timestamp_ns = os_monotonic_get_ns();
+
+	sample_rtp_session(metrics, &sample);
+	sample_encoder(metrics, &sample);
+	sample_enc_queue(metrics, &sample);
+
+	g_mutex_lock(&metrics->lock);
+	sample.client_average_latency_ns = metrics->client_average_latency_ns;
+	metrics->ring[metrics->head % EMS_METRICS_RING_SIZE] = sample;
+	metrics->head++;
+	g_mutex_unlock(&metrics->lock);
+
+	write_csv_row(metrics, &sample);
+
+	return G_SOURCE_CONTINUE;
+}
+
+struct ems_metrics *
+ems_metrics_create(GstElement *pipeline)
+{
+	const struct ems_arguments *args = ems_arguments_get();
+
+	struct ems_metrics *metrics = U_TYPED_CALLOC(struct ems_metrics);
+	metrics->pipeline = pipeline;
+	g_mutex_init(&metrics->lock);
+
+	if (args->metrics_csv_path != NULL) {
+		metrics->csv = fopen(args->metrics_csv_path, "w");
+		if (metrics->csv == NULL) {
+			U_LOG_W("Failed to open metrics CSV '%s', keeping in-memory samples only.",
+			        args->metrics_csv_path);
+		} else {
+			fprintf(metrics->csv,
+			        "timestamp_ns,rtt_ms,sent_nack,recv_nack,enc_queue_buffers,enc_queue_bytes,"
+			        "encoder_bitrate,client_average_latency_ms\n");
+		}
+	}
+
+	guint interval = MAX(args->stats_interval, 1);
+	metrics->timeout_src_id = g_timeout_add_seconds(interval, sample_timer_cb, metrics);
+
+	return metrics;
+}
+
+void
+ems_metrics_destroy(struct ems_metrics **metrics_ptr)
+{
+	struct ems_metrics *metrics = *metrics_ptr;
+	if (metrics == NULL) {
+		return;
+	}
+
+	g_clear_handle_id(&metrics->timeout_src_id, g_source_remove);
+
+	if (metrics->csv != NULL) {
+		fclose(metrics->csv);
+	}
+
+	g_mutex_clear(&metrics->lock);
+
+	free(metrics);
+	*metrics_ptr = NULL;
+}
+
+void
+ems_metrics_push_client_latency(struct ems_metrics *metrics, int64_t average_latency_ns)
+{
+	if (metrics == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&metrics->lock);
+	metrics->client_average_latency_ns = average_latency_ns;
+	g_mutex_unlock(&metrics->lock);
+}
+
+bool
+ems_metrics_get_latest(struct ems_metrics *metrics, struct ems_metrics_sample *out_sample)
+{
+	bool have_sample = false;
+
+	g_mutex_lock(&metrics->lock);
+	if (metrics->head > 0) {
+		*out_sample = metrics->ring[(metrics->head - 1) % EMS_METRICS_RING_SIZE];
+		have_sample = true;
+	}
+	g_mutex_unlock(&metrics->lock);
+
+	return have_sample;
+}
@@ -0,0 +1,87 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Periodic pipeline statistics sampler with CSV export.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * One sampler tick's worth of pipeline statistics.
+ *
+ * Fields that could not be sampled (element missing, no RTCP report yet)
+ * are left at zero.
+ */
+struct ems_metrics_sample
+{
+	int64_t timestamp_ns;
+
+	//! Round-trip time from the client's RTCP receiver reports, ns.
+	int64_t rtt_ns;
+
+	//! NACK totals from the video RTP session.
+	guint sent_nack_count;
+	guint recv_nack_count;
+
+	//! Fill level of the queue feeding the encoder.
+	guint enc_queue_buffers;
+	guint64 enc_queue_bytes;
+
+	//! Bitrate the encoder is currently configured with, in encoder units.
+	guint encoder_bitrate;
+
+	//! Latest client-reported average latency from UpFrameMessage, ns.
+	int64_t client_average_latency_ns;
+};
+
+struct ems_metrics;
+
+/*!
+ * Create a sampler for @p pipeline and start its periodic timer on the
+ * default main context.
+ *
+ * Sampling interval and the optional CSV output path come from
+ * @ref ems_arguments_get. Samples always land in the in-memory ring (see
+ * @ref ems_metrics_get_latest); when a CSV path was given, each sample is
+ * also appended there.
+ *
+ * Does not take a reference on @p pipeline: destroy the sampler before the
+ * pipeline.
+ */
+struct ems_metrics *
+ems_metrics_create(GstElement *pipeline);
+
+void
+ems_metrics_destroy(struct ems_metrics **metrics_ptr);
+
+/*!
+ * Record the client-reported average latency so the next sample carries it.
+ *
+ * Safe to call from any thread, the up message handlers do not run on the
+ * sampler's main context.
+ */
+void
+ems_metrics_push_client_latency(struct ems_metrics *metrics, int64_t average_latency_ns);
+
+/*!
+ * Copy the most recent sample into @p out_sample.
+ *
+ * Returns false when nothing has been sampled yet.
+ */
+bool
+ems_metrics_get_latest(struct ems_metrics *metrics, struct ems_metrics_sample *out_sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -30,14 +30,50 @@ ems_arguments_get(void)
 	return &arguments_instance;
 }
 
+EmsVideoCodec
+ems_encoder_type_codec(EmsEncoderType encoder_type)
+{
+	switch (encoder_type) {
+	case EMS_ENCODER_TYPE_NVH265:
+	case EMS_ENCODER_TYPE_X265: return EMS_VIDEO_CODEC_H265;
+	case EMS_ENCODER_TYPE_NVAV1:
+	case EMS_ENCODER_TYPE_SVTAV1: return EMS_VIDEO_CODEC_AV1;
+	default: return EMS_VIDEO_CODEC_H264;
+	}
+}
+
+const char *
+ems_video_codec_to_string(EmsVideoCodec codec)
+{
+	switch (codec) {
+	case EMS_VIDEO_CODEC_H265: return "h265";
+	case EMS_VIDEO_CODEC_AV1: return "av1";
+	case EMS_VIDEO_CODEC_H264:
+	default: return "h264";
+	}
+}
+
 // defaults
 static gchar *output_file_name = NULL;
 static gchar *encoder_name = NULL;
+static gchar *codec_name = NULL;
 static gchar *device_config_json_path = "configs/bb.json";
+static gchar *metrics_csv_path = NULL;
+static gint stats_interval = 1;
 static gboolean benchmark_down_msg_loss = FALSE;
 static gboolean benchmark_latency = FALSE;
 static gboolean use_localhost = FALSE;
+// The webrtcbin pipeline branch was removed, so raw RTP/UDP with ENet message channels is the only transport.
+static gboolean use_udp = TRUE;
 static gint bitrate = 16384;
+static gint fec_percentage = 5;
+static gboolean disable_rtx = FALSE;
+static gdouble impair_loss = 0.0;
+static gint impair_delay_ms = 0;
+static gint impair_jitter_ms = 0;
+static gint impair_rate_kbps = 0;
+static gint encode_gpu = -1;
+static gint slices = 0;
 static EmsEncoderType default_encoder_type = EMS_ENCODER_TYPE_X264;
 
 gboolean
@@ -50,11 +86,23 @@ ems_arguments_parse(int argc, char *argv[])
 	const GOptionEntry entries[] = {
 		{"stream-output-file-path", 'o', 0, G_OPTION_ARG_FILENAME, &output_file_name, "Path to store the stream in a MKV file.", "path"},
 		{"bitrate", 'b', 0, G_OPTION_ARG_INT, &bitrate, "Stream bitrate", "N"},
-		{"encoder", 'e', 0, G_OPTION_ARG_STRING, &encoder_name, "Encoder (x264, openh264, vulkanh264, vaapih264, vah264, nvh264, nvautogpuh264)", "str"},
+		{"encoder", 'e', 0, G_OPTION_ARG_STRING, &encoder_name, "Encoder (auto, x264, openh264, vulkanh264, vaapih264, vah264, nvh264, nvautogpuh264, nvh265, x265, nvav1, svtav1)", "str"},
+		{"codec", 0, 0, G_OPTION_ARG_STRING, &codec_name, "Video codec (h264, h265, av1), picks a matching encoder by availability", "str"},
 		{"config", 'c', 0, G_OPTION_ARG_STRING, &device_config_json_path, "Path to device config JSON", "str"},
 		{"benchmark-down-msg-loss", 0, 0, G_OPTION_ARG_NONE, &benchmark_down_msg_loss, "Benchmark DownMessage Loss", NULL},
 		{"benchmark-latency", 0, 0, G_OPTION_ARG_NONE, &benchmark_latency, "Benchmark server compositor begin to after client decode time", NULL},
 		{"use-localhost", 'l', 0, G_OPTION_ARG_NONE, &use_localhost, "Connect the electric maple client through localhost for network-over-usb", NULL},
+		{"use-udp", 'u', 0, G_OPTION_ARG_NONE, &use_udp, "Ship the stream as raw RTP over UDP with ENet message channels instead of WebRTC (trusted LANs only)", NULL},
+		{"metrics-csv", 'm', 0, G_OPTION_ARG_FILENAME, &metrics_csv_path, "Append per-sample pipeline statistics (RTT, NACKs, queue level, bitrate, client latency) to this CSV file.", "path"},
+		{"fec-percentage", 0, 0, G_OPTION_ARG_INT, &fec_percentage, "ULPFEC redundancy as a percentage of the video bitrate, 0 disables FEC (WebRTC only)", "N"},
+		{"disable-rtx", 0, 0, G_OPTION_ARG_NONE, &disable_rtx, "Disable NACK-driven retransmission on the WebRTC video transceiver", NULL},
+		{"stats-interval", 's', 0, G_OPTION_ARG_INT, &stats_interval, "Seconds between pipeline statistics samples", "N"},
+		{"impair-loss", 0, 0, G_OPTION_ARG_DOUBLE, &impair_loss, "Benchmark impairment: drop this percentage of outgoing video packets", "pct"},
+		{"impair-delay-ms", 0, 0, G_OPTION_ARG_INT, &impair_delay_ms, "Benchmark impairment: delay outgoing video packets by N milliseconds", "N"},
+		{"impair-jitter-ms", 0, 0, G_OPTION_ARG_INT, &impair_jitter_ms, "Benchmark impairment: add up to N milliseconds of random extra delay", "N"},
+		{"impair-rate-kbps", 0, 0, G_OPTION_ARG_INT, &impair_rate_kbps, "Benchmark impairment: cap the outgoing video rate at N kbit/s", "N"},
+		{"encode-gpu", 0, 0, G_OPTION_ARG_INT, &encode_gpu, "Run the encoder on this GPU (CUDA device index for nv*, DRM render node 128+N for va*), leaving the render GPU to the app", "N"},
+		{"slices", 0, 0, G_OPTION_ARG_INT, &slices, "Encode each frame as N slices so packetization and slice-threaded decode work in sub-frame chunks (x264, openh264)", "N"},
 		G_OPTION_ENTRY_NULL,
 	};
 	// clang-format on
@@ -66,14 +114,22 @@ ems_arguments_parse(int argc, char *argv[])
 		return FALSE;
 	}
 
-	// if (output_file_name) {
-	// 	arguments_instance.stream_debug_file = g_file_new_for_path(output_file_name);
-	// }
-
+	arguments_instance.stream_output_file_path = output_file_name;
 	arguments_instance.bitrate = bitrate;
 	arguments_instance.benchmark_down_msg_loss = benchmark_down_msg_loss;
 	arguments_instance.benchmark_latency = benchmark_latency;
 	arguments_instance.use_localhost = use_localhost;
+	arguments_instance.use_udp = use_udp;
+	arguments_instance.metrics_csv_path = metrics_csv_path;
+	arguments_instance.stats_interval = MAX(stats_interval, 1);
+	arguments_instance.fec_percentage = CLAMP(fec_percentage, 0, 100);
+	arguments_instance.enable_rtx = !disable_rtx;
+	arguments_instance.impair_loss_percent = CLAMP(impair_loss, 0.0, 100.0);
+	arguments_instance.impair_delay_ms = MAX(impair_delay_ms, 0);
+	arguments_instance.impair_jitter_ms = MAX(impair_jitter_ms, 0);
+	arguments_instance.impair_rate_kbps = MAX(impair_rate_kbps, 0);
+	arguments_instance.encode_gpu = MAX(encode_gpu, -1);
+	arguments_instance.slices = MAX(slices, 0);
 
 	if (encoder_name) {
 		if (g_strcmp0(encoder_name, "nvh264") == 0) {
@@ -90,6 +146,16 @@ ems_arguments_parse(int argc, char *argv[])
 			arguments_instance.encoder_type = EMS_ENCODER_TYPE_VAAPIH264;
 		} else if (g_strcmp0(encoder_name, "vah264") == 0) {
 			arguments_instance.encoder_type = EMS_ENCODER_TYPE_VAH264;
+		} else if (g_strcmp0(encoder_name, "nvh265") == 0) {
+			arguments_instance.encoder_type = EMS_ENCODER_TYPE_NVH265;
+		} else if (g_strcmp0(encoder_name, "x265") == 0) {
+			arguments_instance.encoder_type = EMS_ENCODER_TYPE_X265;
+		} else if (g_strcmp0(encoder_name, "nvav1") == 0) {
+			arguments_instance.encoder_type = EMS_ENCODER_TYPE_NVAV1;
+		} else if (g_strcmp0(encoder_name, "svtav1") == 0) {
+			arguments_instance.encoder_type = EMS_ENCODER_TYPE_SVTAV1;
+		} else if (g_strcmp0(encoder_name, "auto") == 0) {
+			arguments_instance.encoder_type = EMS_ENCODER_TYPE_AUTO;
 		} else {
 			U_LOG_W("Unknown encoder option '%s'. Falling back to default.", encoder_name);
 			arguments_instance.encoder_type = default_encoder_type;
@@ -98,6 +164,22 @@ ems_arguments_parse(int argc, char *argv[])
 		arguments_instance.encoder_type = default_encoder_type;
 	}
 
+	// An explicit encoder implies its codec, --codec can request one on top
+	// and lets the pipeline pick a matching encoder by availability.
+	arguments_instance.codec = ems_encoder_type_codec(arguments_instance.encoder_type);
+	if (codec_name) {
+		if (g_strcmp0(codec_name, "h264") == 0) {
+			arguments_instance.codec = EMS_VIDEO_CODEC_H264;
+		} else if (g_strcmp0(codec_name, "h265") == 0) {
+			arguments_instance.codec = EMS_VIDEO_CODEC_H265;
+		} else if (g_strcmp0(codec_name, "av1") == 0) {
+			arguments_instance.codec = EMS_VIDEO_CODEC_AV1;
+		} else {
+			U_LOG_W("Unknown codec option '%s'. Keeping %s.", codec_name,
+			        ems_video_codec_to_string(arguments_instance.codec));
+		}
+	}
+
 	g_print(device_config_json_path);
 
 	if (device_config_json_path) {
@@ -112,4 +194,4 @@ ems_arguments_parse(int argc, char *argv[])
 	g_option_context_free(context);
 
 	return TRUE;
-}
\ No newline at end of file
+}
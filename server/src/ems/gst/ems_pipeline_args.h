@@ -25,21 +25,73 @@ typedef enum
 	EMS_ENCODER_TYPE_OPENH264,
 	EMS_ENCODER_TYPE_VAAPIH264,
 	EMS_ENCODER_TYPE_VAH264,
+	EMS_ENCODER_TYPE_NVH265,
+	EMS_ENCODER_TYPE_X265,
+	EMS_ENCODER_TYPE_NVAV1,
+	EMS_ENCODER_TYPE_SVTAV1,
 	EMS_ENCODER_TYPE_AMC,
 	EMS_ENCODER_TYPE_AUTO,
 } EmsEncoderType;
 
+typedef enum
+{
+	EMS_VIDEO_CODEC_H264,
+	EMS_VIDEO_CODEC_H265,
+	EMS_VIDEO_CODEC_AV1,
+} EmsVideoCodec;
+
 struct ems_arguments
 {
-	// GFile *stream_debug_file;
+	//! Record the session to this MKV path from launch, NULL to disable.
+	gchar *stream_output_file_path;
 	uint32_t bitrate;
 	EmsEncoderType encoder_type;
+	//! Video codec shipped to clients, announced over signaling.
+	EmsVideoCodec codec;
 	gboolean benchmark_down_msg_loss;
 	gboolean benchmark_latency;
 	gboolean use_localhost;
-	guint webrtc_stats_print_interval;
-	// GFile *webrtc_stats_out_directory;
+	//! Seconds between pipeline statistics samples.
+	guint stats_interval;
+	//! Append one CSV row per statistics sample here, NULL to disable.
+	gchar *metrics_csv_path;
 	gboolean use_udp;
+	//! ULPFEC redundancy as a percentage of the video bitrate, 0 disables FEC.
+	guint fec_percentage;
+	//! Enable NACK-driven retransmission (RTX) on the WebRTC video transceiver.
+	gboolean enable_rtx;
+
+	/*!
+	 * Reproducible network impairment: a netsim stage in front of the video
+	 * udpsinks drops, delays and rate-caps packets, so loss/jitter scenarios
+	 * can be replayed without real radio conditions. All zero leaves the
+	 * pipeline untouched. See scripts/benchmark/.
+	 */
+	gdouble impair_loss_percent;
+	guint impair_delay_ms;
+	guint impair_jitter_ms;
+	guint impair_rate_kbps;
+
+	/*!
+	 * Encode every frame as a fixed number of slices, 0 keeps the encoder
+	 * default. Slices bound the packetization granularity - together with
+	 * the payloader's zero-latency aggregation each slice leaves the
+	 * machine as soon as it is payloaded - and give slice-threaded
+	 * decoders independent chunks to start on. Honored by the x264 and
+	 * openh264 branches.
+	 */
+	guint slices;
+
+	/*!
+	 * GPU the encoder runs on, keeping the render GPU free for the app on
+	 * multi-GPU hosts: a CUDA device index for the NVENC family, a DRM
+	 * render node (/dev/dri/renderD<128+N>) for the VA family. -1 keeps
+	 * the plugin default. Frames travel to the encode device through the
+	 * readback in system memory, so no cross-device sharing extension is
+	 * required; the selection is validated with a short synthetic encode
+	 * at startup.
+	 */
+	gint encode_gpu;
 };
 
 const struct ems_arguments *
@@ -48,4 +100,12 @@ ems_arguments_get(void);
 gboolean
 ems_arguments_parse(int argc, char *argv[]);
 
-G_END_DECLS
\ No newline at end of file
+//! Codec a given encoder produces.
+EmsVideoCodec
+ems_encoder_type_codec(EmsEncoderType encoder_type);
+
+//! Codec name as used in signaling messages ("h264", "h265", "av1").
+const char *
+ems_video_codec_to_string(EmsVideoCodec codec);
+
+G_END_DECLS
@@ -0,0 +1,305 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Session recording on a tee branch decoupled from the live path.
+ * @ingroup aux_util
+ */
+
+#include "ems_recorder.h"
+
+#include "ems_pipeline_args.h"
+#include "util/u_logging.h"
+#include "util/u_misc.h"
+
+/*!
+ * How much encoded video the recording queue holds before it starts
+ * dropping. One second rides out short seek storms on network storage
+ * without letting a real stall grow an unbounded backlog.
+ */
+#define EMS_RECORDER_QUEUE_TIME (1 * GST_SECOND)
+
+//! How long ems_recorder_stop waits for the EOS to reach the filesink.
+#define EMS_RECORDER_FINALIZE_TIMEOUT_MS 2000
+
+struct ems_recorder
+{
+	//! Borrowed, not reffed: the pipeline outlives the recorder.
+	GstElement *pipeline;
+
+	//! Serializes start/stop; the signal/probe callbacks below only touch
+	//! atomics and the finalize cond.
+	GMutex lock;
+
+	//! The branch elements while recording, all owned by the pipeline bin.
+	GstElement *queue;
+	GstElement *parser;
+	GstElement *mux;
+	GstElement *filesink;
+
+	//! The requested "rectee" src pad feeding the branch.
+	GstPad *tee_pad;
+
+	//! Times the leaky queue hit its cap and dropped, i.e. disk stalls.
+	gint dropped_buffers;
+
+	//! Signalled by the filesink EOS probe once the muxer has finalized.
+	GCond finalize_cond;
+	gboolean finalized;
+
+	gboolean recording;
+};
+
+struct ems_recorder *
+ems_recorder_create(GstElement *pipeline)
+{
+	struct ems_recorder *recorder = U_TYPED_CALLOC(struct ems_recorder);
+	recorder->pipeline = pipeline;
+	g_mutex_init(&recorder->lock);
+	g_cond_init(&recorder->finalize_cond);
+
+	return recorder;
+}
+
+static void
+recqueue_overrun_cb(GstElement *queue, struct ems_recorder *recorder)
+{
+	// A leaky queue drops the incoming buffer when it is full, so every
+	// overrun is one recording buffer that never made it to disk.
+	gint dropped = g_atomic_int_add(&recorder->dropped_buffers, 1) + 1;
+
+	if ((dropped & (dropped - 1)) == 0) {
+		// Log at 1, 2, 4, 8, ... so a stalled disk doesn't flood the log.
+		U_LOG_W("Recording disk can not keep up, dropped %d buffers so far.", dropped);
+	}
+}
+
+static GstPadProbeReturn
+filesink_eos_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	struct ems_recorder *recorder = user_data;
+
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_DATA(info)) != GST_EVENT_EOS) {
+		return GST_PAD_PROBE_OK;
+	}
+
+	g_mutex_lock(&recorder->lock);
+	recorder->finalized = TRUE;
+	g_cond_signal(&recorder->finalize_cond);
+	g_mutex_unlock(&recorder->lock);
+
+	// Swallow the EOS so it never reaches the pipeline bus: only the
+	// recording branch is ending, not the session.
+	return GST_PAD_PROBE_DROP;
+}
+
+//! The muxer needs aligned, format-tagged input, which the encoder caps
+//! alone don't guarantee; a parser per codec provides both.
+static const char *
+parser_factory_for_codec(EmsVideoCodec codec)
+{
+	switch (codec) {
+	case EMS_VIDEO_CODEC_H265: return "h265parse";
+	case EMS_VIDEO_CODEC_AV1: return "av1parse";
+	case EMS_VIDEO_CODEC_H264:
+	default: return "h264parse";
+	}
+}
+
+bool
+ems_recorder_start(struct ems_recorder *recorder, const char *path)
+{
+	g_mutex_lock(&recorder->lock);
+	if (recorder->recording) {
+		g_mutex_unlock(&recorder->lock);
+		U_LOG_W("A recording is already running.");
+		return false;
+	}
+
+	GstElement *tee = gst_bin_get_by_name(GST_BIN(recorder->pipeline), "rectee");
+	if (tee == NULL) {
+		g_mutex_unlock(&recorder->lock);
+		U_LOG_E("No 'rectee' element in pipeline, can not record.");
+		return false;
+	}
+
+	// leaky=downstream makes the tee's push into this queue non-blocking no
+	// matter what the muxer and disk are doing: when full, the new buffer
+	// is dropped and the live path continues untouched. The queue's src
+	// side is the branch's own streaming thread.
+	recorder->queue = gst_element_factory_make("queue", "recqueue");
+	g_object_set(recorder->queue,                         //
+	             "leaky", 2 /* downstream */,             //
+	             "max-size-buffers", 0u,                  //
+	             "max-size-bytes", 0u,                    //
+	             "max-size-time", EMS_RECORDER_QUEUE_TIME, NULL);
+	g_signal_connect(recorder->queue, "overrun", G_CALLBACK(recqueue_overrun_cb), recorder);
+
+	recorder->parser =
+	    gst_element_factory_make(parser_factory_for_codec(ems_arguments_get()->codec), "recparse");
+	recorder->mux = gst_element_factory_make("matroskamux", "recmux");
+	recorder->filesink = gst_element_factory_make("filesink", "recsink");
+
+	if (recorder->queue == NULL || recorder->parser == NULL || recorder->mux == NULL ||
+	    recorder->filesink == NULL) {
+		U_LOG_E("Failed to create the recording branch elements.");
+		gst_clear_object(&recorder->queue);
+		gst_clear_object(&recorder->parser);
+		gst_clear_object(&recorder->mux);
+		gst_clear_object(&recorder->filesink);
+		gst_object_unref(tee);
+		g_mutex_unlock(&recorder->lock);
+		return false;
+	}
+
+	// sync=false: write as fast as the disk allows, the queue is the only
+	// pacing. A large write buffer keeps the writes disk-friendly on
+	// network storage.
+	g_object_set(recorder->filesink,     //
+	             "location", path,       //
+	             "sync", FALSE,          //
+	             "async", FALSE,         //
+	             "buffer-size", 1 << 20, NULL);
+
+	gst_bin_add_many(GST_BIN(recorder->pipeline), gst_object_ref(recorder->queue),
+	                 gst_object_ref(recorder->parser), gst_object_ref(recorder->mux),
+	                 gst_object_ref(recorder->filesink), NULL);
+	gst_element_link_many(recorder->queue, recorder->parser, recorder->mux, recorder->filesink, NULL);
+
+	recorder->tee_pad = gst_element_request_pad_simple(tee, "src_%u");
+	GstPad *queue_sink = gst_element_get_static_pad(recorder->queue, "sink");
+	GstPadLinkReturn ret = gst_pad_link(recorder->tee_pad, queue_sink);
+	g_assert(ret == GST_PAD_LINK_OK);
+	gst_object_unref(queue_sink);
+	gst_object_unref(tee);
+
+	gst_element_sync_state_with_parent(recorder->filesink);
+	gst_element_sync_state_with_parent(recorder->mux);
+	gst_element_sync_state_with_parent(recorder->parser);
+	gst_element_sync_state_with_parent(recorder->queue);
+
+	recorder->dropped_buffers = 0;
+	recorder->finalized = FALSE;
+	recorder->recording = TRUE;
+	g_mutex_unlock(&recorder->lock);
+
+	U_LOG_I("Recording session to '%s'.", path);
+
+	return true;
+}
+
+static GstPadProbeReturn
+tee_pad_idle_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	struct ems_recorder *recorder = user_data;
+
+	// The pad is idle: unlink the branch and push an EOS into it so the
+	// muxer drains and finalizes the file on its own streaming thread.
+	GstPad *queue_sink = gst_element_get_static_pad(recorder->queue, "sink");
+	gst_pad_unlink(pad, queue_sink);
+	gst_pad_send_event(queue_sink, gst_event_new_eos());
+	gst_object_unref(queue_sink);
+
+	return GST_PAD_PROBE_REMOVE;
+}
+
+/*!
+ * Tear the branch elements out of the pipeline. Caller holds the lock and
+ * has already detached the tee pad from dataflow.
+ */
+static void
+ems_recorder_teardown_branch(struct ems_recorder *recorder)
+{
+	GstElement *elements[] = {recorder->queue, recorder->parser, recorder->mux, recorder->filesink};
+	for (gsize i = 0; i < G_N_ELEMENTS(elements); i++) {
+		gst_element_set_state(elements[i], GST_STATE_NULL);
+		gst_bin_remove(GST_BIN(recorder->pipeline), elements[i]);
+	}
+	gst_clear_object(&recorder->queue);
+	gst_clear_object(&recorder->parser);
+	gst_clear_object(&recorder->mux);
+	gst_clear_object(&recorder->filesink);
+
+	GstElement *tee = gst_bin_get_by_name(GST_BIN(recorder->pipeline), "rectee");
+	if (tee != NULL) {
+		gst_element_release_request_pad(tee, recorder->tee_pad);
+		gst_object_unref(tee);
+	}
+	gst_clear_object(&recorder->tee_pad);
+
+	recorder->recording = FALSE;
+}
+
+void
+ems_recorder_stop(struct ems_recorder *recorder)
+{
+	g_mutex_lock(&recorder->lock);
+	if (!recorder->recording) {
+		g_mutex_unlock(&recorder->lock);
+		return;
+	}
+
+	// Catch the EOS right before the filesink so we know when the muxer
+	// has written everything, and keep it off the shared pipeline bus.
+	GstPad *sink_pad = gst_element_get_static_pad(recorder->filesink, "sink");
+	gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, filesink_eos_probe_cb, recorder, NULL);
+	gst_object_unref(sink_pad);
+
+	// IDLE runs the unlink + EOS injection as soon as no buffer is in
+	// flight on the tee pad, possibly right now on this thread.
+	gst_pad_add_probe(recorder->tee_pad, GST_PAD_PROBE_TYPE_IDLE, tee_pad_idle_probe_cb, recorder, NULL);
+
+	gint64 deadline = g_get_monotonic_time() + EMS_RECORDER_FINALIZE_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+	while (!recorder->finalized) {
+		if (!g_cond_wait_until(&recorder->finalize_cond, &recorder->lock, deadline)) {
+			U_LOG_W("Timed out waiting for the recording to finalize, the file may be truncated.");
+			break;
+		}
+	}
+
+	const gint dropped = g_atomic_int_get(&recorder->dropped_buffers);
+	ems_recorder_teardown_branch(recorder);
+	g_mutex_unlock(&recorder->lock);
+
+	U_LOG_I("Recording stopped, %d buffers dropped to keep the live path clean.", dropped);
+}
+
+bool
+ems_recorder_is_recording(struct ems_recorder *recorder)
+{
+	g_mutex_lock(&recorder->lock);
+	bool recording = recorder->recording;
+	g_mutex_unlock(&recorder->lock);
+
+	return recording;
+}
+
+uint64_t
+ems_recorder_get_dropped_buffers(struct ems_recorder *recorder)
+{
+	return (uint64_t)g_atomic_int_get(&recorder->dropped_buffers);
+}
+
+void
+ems_recorder_destroy(struct ems_recorder **recorder_ptr)
+{
+	struct ems_recorder *recorder = *recorder_ptr;
+	if (recorder == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&recorder->lock);
+	if (recorder->recording) {
+		// The pipeline is going away with us, no point draining: just rip
+		// the branch out. matroskamux writes self-contained clusters, the
+		// file stays readable up to the last flush.
+		ems_recorder_teardown_branch(recorder);
+	}
+	g_mutex_unlock(&recorder->lock);
+
+	g_cond_clear(&recorder->finalize_cond);
+	g_mutex_clear(&recorder->lock);
+	free(recorder);
+	*recorder_ptr = NULL;
+}
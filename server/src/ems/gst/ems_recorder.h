@@ -0,0 +1,72 @@
+// Copyright 2024, Pluto VR, Inc.
+//
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Session recording on a tee branch decoupled from the live path.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ems_recorder;
+
+/*!
+ * Create a recorder for @p pipeline.
+ *
+ * The pipeline must contain the "rectee" tee sitting between the primary
+ * rung's encoder and payloader; the recorder taps the already-encoded
+ * bitstream there, so recording costs no extra encode.
+ *
+ * Does not take a reference on @p pipeline: destroy the recorder before the
+ * pipeline.
+ */
+struct ems_recorder *
+ems_recorder_create(GstElement *pipeline);
+
+//! Stops a running recording (without the EOS finalization) first.
+void
+ems_recorder_destroy(struct ems_recorder **recorder_ptr);
+
+/*!
+ * Start recording the stream to an MKV file at @p path.
+ *
+ * The branch hangs off "rectee" behind a leaky queue with its own streaming
+ * thread, so a stalling disk fills the queue and drops recording buffers
+ * instead of ever backpressuring the encoder. Returns false when a recording
+ * is already running or the branch could not be built.
+ */
+bool
+ems_recorder_start(struct ems_recorder *recorder, const char *path);
+
+/*!
+ * Stop recording and finalize the file.
+ *
+ * Drains the branch with an EOS so the muxer writes its headers/cues, then
+ * tears the branch down. The live path is never blocked; only the recording
+ * branch is waited on, with a timeout.
+ */
+void
+ems_recorder_stop(struct ems_recorder *recorder);
+
+bool
+ems_recorder_is_recording(struct ems_recorder *recorder);
+
+/*!
+ * Buffers dropped by the recording queue over the life of the current or
+ * last recording, i.e. moments the disk could not keep up.
+ */
+uint64_t
+ems_recorder_get_dropped_buffers(struct ems_recorder *recorder);
+
+#ifdef __cplusplus
+}
+#endif
@@ -15,6 +15,7 @@
 
 #include <glib/gstdio.h>
 #include <json-glib/json-glib.h>
+#include <libsoup/soup-form.h>
 #include <libsoup/soup-server.h>
 #include <libsoup/soup-version.h>
 
@@ -22,6 +23,7 @@
 #include <libsoup/soup-server-message.h>
 #endif
 
+#include "ems_pipeline_args.h"
 #include "util/u_logging.h"
 
 // clang-format off
@@ -33,24 +35,95 @@
 
 const static int EMS_DEFAULT_PORT = 52356;
 
+//! How long after a WebSocket drop a session can still be resumed.
+const static int EMS_RESUME_GRACE_SECONDS = 10;
+
+/*!
+ * Per-client signaling session state.
+ *
+ * Owned by the server's session table, so every signaling operation resolves
+ * its client in O(1) instead of walking a list of connections.
+ */
+struct ems_ws_session
+{
+	//! Owning reference, dropped when the session is removed.
+	SoupWebsocketConnection *connection;
+
+	//! Remote address the client connected from, for logging.
+	gchar *remote_address;
+
+	//! When the client was admitted, from g_get_monotonic_time().
+	gint64 connect_time_us;
+
+	//! Token the client presents to resume this session after a brief
+	//! WebSocket drop, issued at admission.
+	gchar *resume_token;
+};
+
+/*!
+ * A session parked after its WebSocket dropped, waiting for the client to
+ * reconnect with its resume token within the grace window. Holds the old
+ * session (and thereby a reference on the dead connection) so the client id
+ * pointer cannot be recycled for a different client while parked.
+ */
+struct ems_pending_resume
+{
+	EmsSignalingServer *server;
+	struct ems_ws_session *session;
+	EmsClientId client_id;
+	guint expiry_source;
+};
+
 struct _EmsSignalingServer
 {
 	GObject parent;
 
 	SoupServer *soup_server;
 
-	GSList *websocket_connections;
+	//! EmsClientId -> struct ems_ws_session.
+	GHashTable *sessions;
+
+	//! Resume token string -> struct ems_pending_resume, sessions whose
+	//! WebSocket dropped but whose streaming state is kept for the grace
+	//! window.
+	GHashTable *pending_resumes;
 
 	ENetHost *enet_host;
 	struct os_thread_helper enet_thread;
+
+	//! GBytes queued for a reliable broadcast to every ENet client, put on
+	//! the wire by the ENet thread since ENet hosts are not thread-safe.
+	GAsyncQueue *broadcast_queue;
 };
 
+static void
+ems_ws_session_free(gpointer data)
+{
+	struct ems_ws_session *session = data;
+
+	g_object_unref(session->connection);
+	g_free(session->remote_address);
+	g_free(session->resume_token);
+	g_free(session);
+}
+
+static void
+ems_pending_resume_free(gpointer data)
+{
+	struct ems_pending_resume *pending = data;
+
+	g_clear_handle_id(&pending->expiry_source, g_source_remove);
+	ems_ws_session_free(pending->session);
+	g_free(pending);
+}
+
 G_DEFINE_TYPE(EmsSignalingServer, ems_signaling_server, G_TYPE_OBJECT)
 
 enum
 {
 	SIGNAL_WS_CLIENT_CONNECTED,
 	SIGNAL_WS_CLIENT_DISCONNECTED,
+	SIGNAL_WS_CLIENT_RESUMED,
 	SIGNAL_SDP_ANSWER,
 	SIGNAL_CANDIDATE,
 	SIGNAL_UP_MESSAGE,
@@ -96,6 +169,19 @@ enet_thread_func(void *ptr)
 			continue;
 		}
 
+		// Put queued broadcasts on the wire.
+		GBytes *bytes;
+		while ((bytes = g_async_queue_try_pop(server->broadcast_queue)) != NULL) {
+			gsize size = 0;
+			gconstpointer data = g_bytes_get_data(bytes, &size);
+
+			ENetPacket *packet = enet_packet_create(data, size, ENET_PACKET_FLAG_RELIABLE);
+			if (packet != NULL) {
+				enet_host_broadcast(server->enet_host, 0, packet);
+			}
+			g_bytes_unref(bytes);
+		}
+
 		// Block for up to 10 milliseconds, or until an event occurs
 		if (enet_host_service(server->enet_host, &event, 10) > 0) {
 			// Handle the event
@@ -126,9 +212,7 @@ ems_signaling_server_new(void)
 	address.host = ENET_HOST_ANY; /* Bind the server to the default localhost.     */
 	address.port = 7777;          /* Bind the server to port 7777. */
 
-#define MAX_CLIENTS 32
-
-	server->enet_host = enet_host_create(&address, MAX_CLIENTS, 2, 0, 0);
+	server->enet_host = enet_host_create(&address, EMS_MAX_CLIENTS, 2, 0, 0);
 	if (server->enet_host == NULL) {
 		printf("An error occurred while trying to create an ENet server host.\n");
 		return server;
@@ -163,7 +247,26 @@ ems_signaling_server_handle_text_message(EmsSignalingServer *server,
 		}
 
 		msg_type = json_object_get_string_member(msg, "msg");
-		if (g_str_equal(msg_type, "answer")) {
+		if (g_str_equal(msg_type, "codecs")) {
+			// The client advertises the codecs it can decode, the stream
+			// codec is fixed at startup, so only sanity-check the match
+			// with what was already announced.
+			const gchar *codec = ems_video_codec_to_string(ems_arguments_get()->codec);
+			JsonArray *supported = json_object_get_array_member(msg, "supported");
+			gboolean found = FALSE;
+
+			for (guint i = 0; i < json_array_get_length(supported); i++) {
+				if (g_str_equal(json_array_get_string_element(supported, i), codec)) {
+					found = TRUE;
+					break;
+				}
+			}
+
+			if (!found) {
+				g_warning("Client does not advertise a %s decoder, it may fall back to software.",
+				          codec);
+			}
+		} else if (g_str_equal(msg_type, "answer")) {
 			const gchar *answer_sdp = json_object_get_string_member(msg, "sdp");
 			g_debug("Received answer:\n %s", answer_sdp);
 
@@ -194,14 +297,31 @@ ws_message_cb(SoupWebsocketConnection *connection, gint type, GBytes *message, g
 #endif
 	} break;
 	case SOUP_WEBSOCKET_DATA_TEXT: {
-#ifdef USE_WEBRTC
 		ems_signaling_server_handle_text_message(EMS_SIGNALING_SERVER(user_data), connection, message);
-#endif
 	} break;
 	default: g_assert_not_reached();
 	}
 }
 
+static gboolean
+ems_pending_resume_expired_cb(gpointer data)
+{
+	struct ems_pending_resume *pending = data;
+	EmsSignalingServer *server = pending->server;
+	const EmsClientId client_id = pending->client_id;
+
+	g_info("Resume window for client %p expired.", client_id);
+
+	// We are inside the source's own callback, don't let the free function
+	// remove it again.
+	pending->expiry_source = 0;
+	g_hash_table_remove(server->pending_resumes, pending->session->resume_token);
+
+	g_signal_emit(server, signals[SIGNAL_WS_CLIENT_DISCONNECTED], 0, client_id);
+
+	return G_SOURCE_REMOVE;
+}
+
 static void
 ems_signaling_server_remove_websocket_connection(EmsSignalingServer *server, SoupWebsocketConnection *connection)
 {
@@ -209,7 +329,33 @@ ems_signaling_server_remove_websocket_connection(EmsSignalingServer *server, Sou
 
 	const EmsClientId client_id = g_object_get_data(G_OBJECT(connection), "client_id");
 
-	server->websocket_connections = g_slist_remove(server->websocket_connections, client_id);
+	struct ems_ws_session *session = NULL;
+
+	// Connections rejected at admission never got a session, so don't
+	// report a disconnect nobody was told about either.
+	if (!g_hash_table_steal_extended(server->sessions, client_id, NULL, (gpointer *)&session)) {
+		return;
+	}
+
+	if (session->resume_token != NULL) {
+		// Park the session instead of tearing the client down: the
+		// streaming state stays up for the grace window, and a client
+		// reconnecting with the token gets it back with an ICE restart
+		// only.
+		struct ems_pending_resume *pending = g_new0(struct ems_pending_resume, 1);
+		pending->server = server;
+		pending->session = session;
+		pending->client_id = client_id;
+		pending->expiry_source =
+		    g_timeout_add_seconds(EMS_RESUME_GRACE_SECONDS, ems_pending_resume_expired_cb, pending);
+		g_hash_table_insert(server->pending_resumes, session->resume_token, pending);
+
+		g_info("Client %p disconnected, holding its session for %d seconds.", client_id,
+		       EMS_RESUME_GRACE_SECONDS);
+		return;
+	}
+
+	ems_ws_session_free(session);
 
 	g_signal_emit(server, signals[SIGNAL_WS_CLIENT_DISCONNECTED], 0, client_id);
 }
@@ -222,6 +368,84 @@ ws_closed_cb(SoupWebsocketConnection *connection, gpointer user_data)
 	ems_signaling_server_remove_websocket_connection(EMS_SIGNALING_SERVER(user_data), connection);
 }
 
+/*!
+ * Tell a freshly admitted client which codec the stream carries, so it can
+ * build the matching decode chain before any media (or SDP offer) arrives.
+ */
+static void
+ems_signaling_server_announce_video_codec(SoupWebsocketConnection *connection)
+{
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+	json_builder_set_member_name(builder, "msg");
+	json_builder_add_string_value(builder, "codec");
+
+	json_builder_set_member_name(builder, "codec");
+	json_builder_add_string_value(builder, ems_video_codec_to_string(ems_arguments_get()->codec));
+	json_builder_end_object(builder);
+
+	JsonNode *root = json_builder_get_root(builder);
+	gchar *msg_str = json_to_string(root, TRUE);
+
+	soup_websocket_connection_send_text(connection, msg_str);
+
+	g_free(msg_str);
+	json_node_unref(root);
+	g_object_unref(builder);
+}
+
+/*!
+ * Issue the client its resume token, so a reconnect within the grace window
+ * can restore the session with an ICE restart instead of a renegotiation.
+ */
+static void
+ems_signaling_server_announce_session(SoupWebsocketConnection *connection, const gchar *token)
+{
+	JsonBuilder *builder = json_builder_new();
+	json_builder_begin_object(builder);
+	json_builder_set_member_name(builder, "msg");
+	json_builder_add_string_value(builder, "session");
+
+	json_builder_set_member_name(builder, "token");
+	json_builder_add_string_value(builder, token);
+
+	json_builder_set_member_name(builder, "grace_seconds");
+	json_builder_add_int_value(builder, EMS_RESUME_GRACE_SECONDS);
+	json_builder_end_object(builder);
+
+	JsonNode *root = json_builder_get_root(builder);
+	gchar *msg_str = json_to_string(root, TRUE);
+
+	soup_websocket_connection_send_text(connection, msg_str);
+
+	g_free(msg_str);
+	json_node_unref(root);
+	g_object_unref(builder);
+}
+
+//! Resume token carried in the connection URI query, or NULL.
+static gchar *
+ems_signaling_server_get_resume_token(SoupWebsocketConnection *connection)
+{
+#if SOUP_CHECK_VERSION(3, 0, 0)
+	GUri *uri = soup_websocket_connection_get_uri(connection);
+	const gchar *query = g_uri_get_query(uri);
+#else
+	SoupURI *uri = soup_websocket_connection_get_uri(connection);
+	const gchar *query = soup_uri_get_query(uri);
+#endif
+
+	if (query == NULL) {
+		return NULL;
+	}
+
+	GHashTable *params = soup_form_decode(query);
+	gchar *token = g_strdup(g_hash_table_lookup(params, "resume"));
+	g_hash_table_destroy(params);
+
+	return token;
+}
+
 static void
 ems_signaling_server_add_websocket_connection(EmsSignalingServer *server,
                                               SoupWebsocketConnection *connection,
@@ -229,13 +453,65 @@ ems_signaling_server_add_websocket_connection(EmsSignalingServer *server,
 {
 	g_info("New WebSocket connection %s", __func__);
 
-	g_object_ref(connection);
-	server->websocket_connections = g_slist_append(server->websocket_connections, connection);
+	gchar *token = ems_signaling_server_get_resume_token(connection);
+	if (token != NULL) {
+		struct ems_pending_resume *pending = NULL;
+
+		if (g_hash_table_steal_extended(server->pending_resumes, token, NULL, (gpointer *)&pending)) {
+			const EmsClientId old_client_id = pending->client_id;
+
+			g_clear_handle_id(&pending->expiry_source, g_source_remove);
+			ems_ws_session_free(pending->session);
+			g_free(pending);
+
+			// Hand the new connection the parked session's identity;
+			// the token stays valid for the next drop.
+			struct ems_ws_session *session = g_new0(struct ems_ws_session, 1);
+			session->connection = g_object_ref(connection);
+			session->remote_address = g_strdup(client_address);
+			session->connect_time_us = g_get_monotonic_time();
+			session->resume_token = token;
+
+			g_object_set_data(G_OBJECT(connection), "client_id", connection);
+			g_hash_table_insert(server->sessions, connection, session);
+
+			g_signal_connect(connection, "message", (GCallback)ws_message_cb, server);
+			g_signal_connect(connection, "closed", (GCallback)ws_closed_cb, server);
+
+			g_info("Client %s resumed the session of %p within the grace window.", client_address,
+			       old_client_id);
+			g_signal_emit(server, signals[SIGNAL_WS_CLIENT_RESUMED], 0, connection, old_client_id);
+			return;
+		}
+
+		g_info("Client %s presented an unknown or expired resume token, renegotiating.", client_address);
+		g_free(token);
+	}
+
+	// Parked sessions still hold their webrtcbin, so they count against the
+	// client limit too.
+	if (g_hash_table_size(server->sessions) + g_hash_table_size(server->pending_resumes) >= EMS_MAX_CLIENTS) {
+		g_warning("Rejecting connection from %s, already serving %u clients.", client_address,
+		          EMS_MAX_CLIENTS);
+		soup_websocket_connection_close(connection, SOUP_WEBSOCKET_CLOSE_TRY_AGAIN_LATER, "server full");
+		return;
+	}
+
+	struct ems_ws_session *session = g_new0(struct ems_ws_session, 1);
+	session->connection = g_object_ref(connection);
+	session->remote_address = g_strdup(client_address);
+	session->connect_time_us = g_get_monotonic_time();
+	session->resume_token = g_uuid_string_random();
+
 	g_object_set_data(G_OBJECT(connection), "client_id", connection);
+	g_hash_table_insert(server->sessions, connection, session);
 
 	g_signal_connect(connection, "message", (GCallback)ws_message_cb, server);
 	g_signal_connect(connection, "closed", (GCallback)ws_closed_cb, server);
 
+	ems_signaling_server_announce_video_codec(connection);
+	ems_signaling_server_announce_session(connection, session->resume_token);
+
 	g_signal_emit(server, signals[SIGNAL_WS_CLIENT_CONNECTED], 0, connection, client_address);
 }
 
@@ -299,6 +575,13 @@ websocket_cb(SoupServer *server,
 static void
 ems_signaling_server_init(EmsSignalingServer *server)
 {
+	server->sessions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, ems_ws_session_free);
+
+	// Keyed by the parked session's own resume_token string, freed with it.
+	server->pending_resumes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, ems_pending_resume_free);
+
+	server->broadcast_queue = g_async_queue_new_full((GDestroyNotify)g_bytes_unref);
+
 	server->soup_server = soup_server_new(NULL, NULL);
 	g_assert(server->soup_server != NULL);
 
@@ -313,13 +596,15 @@ ems_signaling_server_init(EmsSignalingServer *server)
 static void
 ems_signaling_server_send_to_websocket_client(EmsSignalingServer *server, EmsClientId client_id, JsonNode *msg)
 {
-	SoupWebsocketConnection *connection = client_id;
+	struct ems_ws_session *session = g_hash_table_lookup(server->sessions, client_id);
 
-	if (!g_slist_find(server->websocket_connections, connection)) {
+	if (session == NULL) {
 		g_warning("Failed to send a WebSocket message, unknown connection!");
 		return;
 	}
 
+	SoupWebsocketConnection *connection = session->connection;
+
 	SoupWebsocketState socket_state = soup_websocket_connection_get_state(connection);
 
 	if (socket_state == SOUP_WEBSOCKET_STATE_OPEN) {
@@ -385,6 +670,18 @@ ems_signaling_server_send_candidate(EmsSignalingServer *server,
 	g_object_unref(builder);
 }
 
+guint
+ems_signaling_server_get_client_count(EmsSignalingServer *server)
+{
+	return g_hash_table_size(server->sessions);
+}
+
+void
+ems_signaling_server_broadcast_data(EmsSignalingServer *server, GBytes *bytes)
+{
+	g_async_queue_push(server->broadcast_queue, g_bytes_ref(bytes));
+}
+
 static void
 ems_signaling_server_dispose(GObject *object)
 {
@@ -392,6 +689,9 @@ ems_signaling_server_dispose(GObject *object)
 
 	soup_server_disconnect(self->soup_server);
 	g_clear_object(&self->soup_server);
+	g_clear_pointer(&self->sessions, g_hash_table_destroy);
+	g_clear_pointer(&self->pending_resumes, g_hash_table_destroy);
+	g_clear_pointer(&self->broadcast_queue, g_async_queue_unref);
 }
 
 static void
@@ -409,6 +709,11 @@ ems_signaling_server_class_init(EmsSignalingServerClass *klass)
 	    g_signal_new("ws-client-disconnected", G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
 	                 G_TYPE_NONE, 1, G_TYPE_POINTER);
 
+	// New client id followed by the id the resumed session was known under.
+	signals[SIGNAL_WS_CLIENT_RESUMED] =
+	    g_signal_new("ws-client-resumed", G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+	                 G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_POINTER);
+
 	signals[SIGNAL_SDP_ANSWER] = g_signal_new("sdp-answer", G_OBJECT_CLASS_TYPE(klass), G_SIGNAL_RUN_LAST, 0, NULL,
 	                                          NULL, NULL, G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_STRING);
 
@@ -19,6 +19,10 @@
 
 #define EMS_TYPE_SIGNALING_SERVER ems_signaling_server_get_type()
 
+//! Maximum number of simultaneously admitted clients, shared between the
+//! WebSocket signaling endpoint and the ENet host.
+#define EMS_MAX_CLIENTS 32
+
 G_DECLARE_FINAL_TYPE(EmsSignalingServer, ems_signaling_server, EMS, SIGNALING_SERVER, GObject)
 
 typedef gpointer EmsClientId;
@@ -26,6 +30,20 @@ typedef gpointer EmsClientId;
 EmsSignalingServer *
 ems_signaling_server_new(void);
 
+//! Number of currently admitted WebSocket clients.
+guint
+ems_signaling_server_get_client_count(EmsSignalingServer *server);
+
+/*!
+ * Send @p bytes reliably to every connected ENet client.
+ *
+ * Safe to call from any thread: the message is queued and put on the wire by
+ * the server's ENet thread, since ENet hosts are not thread-safe. Takes a
+ * reference on @p bytes.
+ */
+void
+ems_signaling_server_broadcast_data(EmsSignalingServer *server, GBytes *bytes);
+
 void
 ems_signaling_server_send_sdp_offer(EmsSignalingServer *server, EmsClientId client_id, const gchar *msg);
 
@@ -7,36 +7,81 @@
 
 #define GST_USE_UNSTABLE_API
 #include <gst/webrtc/webrtc.h>
+#include <inttypes.h>
 #include <json-glib/json-glib.h>
 #include <libsoup/soup-message.h>
 #include <libsoup/soup-session.h>
+#include <math.h>
+#include <string.h>
 
+#include "electricmaple.pb.h"
 #include "os/os_time.h"
+#include "pb_encode.h"
 #include "stdio.h"
+#include "stdlib.h"
 #include "util/u_logging.h"
 
 #define USE_DECODEBIN
 
 static gchar *websocket_uri = NULL;
-
-static GOptionEntry options[] = {{
-                                     "websocket-uri",
-                                     'u',
-                                     0,
-                                     G_OPTION_ARG_STRING,
-                                     &websocket_uri,
-                                     "Websocket URI of webrtc signaling connection",
-                                     "URI",
-                                 },
-                                 {NULL}};
+static gint num_clients = 1;
+static gboolean use_fakesink = FALSE;
+static gint tracking_rate = 72;
+static gint report_interval = 2;
+
+// clang-format off
+static GOptionEntry options[] = {
+	{"websocket-uri", 'u', 0, G_OPTION_ARG_STRING, &websocket_uri, "Websocket URI of webrtc signaling connection", "URI"},
+	{"clients", 'n', 0, G_OPTION_ARG_INT, &num_clients, "Number of simulated clients to connect", "N"},
+	{"fakesink", 'f', 0, G_OPTION_ARG_NONE, &use_fakesink, "Drop frames after RTP depayloading instead of decoding/displaying them", NULL},
+	{"tracking-rate", 't', 0, G_OPTION_ARG_INT, &tracking_rate, "Rate to send synthetic UpMessage tracking at, in Hz (0 disables)", "HZ"},
+	{"report-interval", 'r', 0, G_OPTION_ARG_INT, &report_interval, "Seconds between per-client stats reports", "SEC"},
+	{NULL},
+};
+// clang-format on
 
 #define WEBSOCKET_URI_DEFAULT "ws://127.0.0.1:52356/ws"
 
-//!@todo Don't use global state
-static SoupWebsocketConnection *ws = NULL;
-static GstElement *pipeline = NULL;
-static GstElement *webrtcbin = NULL;
-static GstWebRTCDataChannel *datachannel = NULL;
+//! Ring buffer size for frame interval percentiles, per client.
+#define MAX_FRAME_INTERVAL_SAMPLES 2048
+
+/*!
+ * One simulated headset: its own signaling connection, webrtcbin pipeline and
+ * receive statistics.
+ */
+struct test_client
+{
+	//! Client index, for log output.
+	guint id;
+
+	SoupWebsocketConnection *ws;
+	GstElement *pipeline;
+	GstElement *webrtcbin;
+	GstWebRTCDataChannel *datachannel;
+
+	//! Source id of the tracking replay timer. 0 while the data channel is down.
+	guint tracking_timer_id;
+	//! Monotonically increasing UpMessage id / tracking sequence index.
+	int64_t message_id;
+
+	//! Guards the counters below: the buffer probe runs on a streaming thread.
+	GMutex stats_lock;
+	guint64 bytes_received;
+	guint64 frames_received;
+	int64_t last_frame_time_ns;
+	int64_t frame_intervals_ns[MAX_FRAME_INTERVAL_SAMPLES];
+	//! Total intervals recorded, not wrapped: ring index is modulo the array size.
+	guint frame_interval_count;
+	//! Totals from the most recent inbound-rtp stats reply.
+	gint64 packets_lost;
+	guint64 packets_received;
+
+	//! Snapshots at the previous report, for rate computation.
+	guint64 prev_bytes_received;
+	int64_t prev_report_time_ns;
+};
+
+static struct test_client *clients = NULL;
 
 /*
  *
@@ -45,58 +90,209 @@ static GstWebRTCDataChannel *datachannel = NULL;
  */
 
 static void
-data_channel_error_cb(GstWebRTCDataChannel *datachannel, void *data)
+data_channel_error_cb(GstWebRTCDataChannel *datachannel, gpointer user_data)
 {
-	U_LOG_E("Error");
+	struct test_client *client = user_data;
+
+	U_LOG_E("client %u: data channel error", client->id);
 	abort();
 }
 
 static void
-data_channel_close_cb(GstWebRTCDataChannel *datachannel, gpointer timeout_src_id)
+data_channel_close_cb(GstWebRTCDataChannel *datachannel, gpointer user_data)
 {
-	U_LOG_I("Data channel closed");
+	struct test_client *client = user_data;
 
-	g_source_remove(GPOINTER_TO_UINT(timeout_src_id));
-	g_clear_object(&datachannel);
+	U_LOG_I("client %u: data channel closed", client->id);
+
+	if (client->tracking_timer_id != 0) {
+		g_source_remove(client->tracking_timer_id);
+		client->tracking_timer_id = 0;
+	}
+	g_clear_object(&client->datachannel);
 }
 
 static void
-data_channel_message_data_cb(GstWebRTCDataChannel *datachannel, GBytes *data, void *user_data)
+data_channel_message_data_cb(GstWebRTCDataChannel *datachannel, GBytes *data, gpointer user_data)
 {
-	U_LOG_I("Received data channel message data: %u", (uint32_t)g_bytes_get_size(data));
+	struct test_client *client = user_data;
+
+	U_LOG_D("client %u: received data channel message data: %u", client->id, (uint32_t)g_bytes_get_size(data));
 }
 
 static void
-data_channel_message_string_cb(GstWebRTCDataChannel *datachannel, gchar *str, void *user_data)
+data_channel_message_string_cb(GstWebRTCDataChannel *datachannel, gchar *str, gpointer user_data)
 {
-	U_LOG_I("Received data channel message string: %s", str);
+	struct test_client *client = user_data;
+
+	U_LOG_I("client %u: received data channel message string: %s", client->id, str);
 }
 
+/*!
+ * Send one synthetic UpMessage with tracking over the data channel.
+ *
+ * The head orbits slowly so the server sees plausible, always-changing poses
+ * at the same rate a real headset would produce them.
+ */
 static gboolean
-datachannel_send_message(gpointer unused)
+send_tracking_message(gpointer user_data)
 {
-	g_signal_emit_by_name(datachannel, "send-string", "Hi! from EMS test client");
+	struct test_client *client = user_data;
+
+	em_proto_UpMessage up_message = em_proto_UpMessage_init_default;
+	up_message.id = ++client->message_id;
+	up_message.has_tracking = true;
+
+	double phase = 2.0 * G_PI * 0.1 * (double)client->message_id / (double)tracking_rate;
+
+	em_proto_TrackingMessage *tracking = &up_message.tracking;
+	tracking->has_head_pose = true;
+	tracking->head_pose.has_position = true;
+	tracking->head_pose.position.x = 0.1f * (float)cos(phase);
+	tracking->head_pose.position.y = 1.6f;
+	tracking->head_pose.position.z = 0.1f * (float)sin(phase);
+	tracking->head_pose.has_orientation = true;
+	tracking->head_pose.orientation.w = 1.0f;
+	tracking->timestamp = os_monotonic_get_ns();
+	tracking->sequence_idx = client->message_id;
+
+	uint8_t buffer[1024];
+	pb_ostream_t os = pb_ostream_from_buffer(buffer, sizeof(buffer));
+	if (!pb_encode(&os, &em_proto_UpMessage_msg, &up_message)) {
+		U_LOG_E("client %u: pb_encode failed: %s", client->id, PB_GET_ERROR(&os));
+		return G_SOURCE_CONTINUE;
+	}
+
+	GBytes *bytes = g_bytes_new(buffer, os.bytes_written);
+	g_signal_emit_by_name(client->datachannel, "send-data", bytes);
+	g_bytes_unref(bytes);
 
 	return G_SOURCE_CONTINUE;
 }
 
 static void
-webrtc_on_data_channel_cb(GstElement *webrtcbin, GstWebRTCDataChannel *data_channel, void *user_data)
+webrtc_on_data_channel_cb(GstElement *webrtcbin, GstWebRTCDataChannel *data_channel, gpointer user_data)
 {
-	guint timeout_src_id;
+	struct test_client *client = user_data;
 
-	U_LOG_I("Successfully created datachannel");
+	U_LOG_I("client %u: successfully created datachannel", client->id);
 
-	g_assert_null(datachannel);
+	g_assert_null(client->datachannel);
 
-	datachannel = GST_WEBRTC_DATA_CHANNEL(data_channel);
+	client->datachannel = GST_WEBRTC_DATA_CHANNEL(data_channel);
 
-	timeout_src_id = g_timeout_add_seconds(3, datachannel_send_message, NULL);
+	if (tracking_rate > 0) {
+		client->tracking_timer_id = g_timeout_add(1000 / tracking_rate, send_tracking_message, client);
+	}
 
-	g_signal_connect(datachannel, "on-close", G_CALLBACK(data_channel_close_cb), GUINT_TO_POINTER(timeout_src_id));
-	g_signal_connect(datachannel, "on-error", G_CALLBACK(data_channel_error_cb), GUINT_TO_POINTER(timeout_src_id));
-	g_signal_connect(datachannel, "on-message-data", G_CALLBACK(data_channel_message_data_cb), NULL);
-	g_signal_connect(datachannel, "on-message-string", G_CALLBACK(data_channel_message_string_cb), NULL);
+	g_signal_connect(client->datachannel, "on-close", G_CALLBACK(data_channel_close_cb), client);
+	g_signal_connect(client->datachannel, "on-error", G_CALLBACK(data_channel_error_cb), client);
+	g_signal_connect(client->datachannel, "on-message-data", G_CALLBACK(data_channel_message_data_cb), client);
+	g_signal_connect(client->datachannel, "on-message-string", G_CALLBACK(data_channel_message_string_cb), client);
+}
+
+/*
+ *
+ * Statistics reporting.
+ *
+ */
+
+static gboolean
+inbound_rtp_stats_foreach(GQuark field_id, const GValue *value, gpointer user_data)
+{
+	struct test_client *client = user_data;
+
+	if (!GST_VALUE_HOLDS_STRUCTURE(value)) {
+		return TRUE;
+	}
+
+	const GstStructure *s = gst_value_get_structure(value);
+
+	GstWebRTCStatsType type;
+	if (!gst_structure_get(s, "type", GST_TYPE_WEBRTC_STATS_TYPE, &type, NULL) ||
+	    type != GST_WEBRTC_STATS_TYPE_INBOUND_RTP) {
+		return TRUE;
+	}
+
+	gint64 packets_lost = 0;
+	guint64 packets_received = 0;
+	gst_structure_get(s, "packets-lost", G_TYPE_INT64, &packets_lost, NULL);
+	gst_structure_get(s, "packets-received", G_TYPE_UINT64, &packets_received, NULL);
+
+	g_mutex_lock(&client->stats_lock);
+	client->packets_lost = packets_lost;
+	client->packets_received = packets_received;
+	g_mutex_unlock(&client->stats_lock);
+
+	return TRUE;
+}
+
+static void
+on_webrtcbin_get_stats(GstPromise *promise, gpointer user_data)
+{
+	struct test_client *client = user_data;
+
+	g_return_if_fail(gst_promise_wait(promise) == GST_PROMISE_RESULT_REPLIED);
+
+	const GstStructure *stats = gst_promise_get_reply(promise);
+	gst_structure_foreach(stats, inbound_rtp_stats_foreach, client);
+}
+
+static int
+compare_int64(const void *a, const void *b)
+{
+	int64_t va = *(const int64_t *)a;
+	int64_t vb = *(const int64_t *)b;
+	return (va > vb) - (va < vb);
+}
+
+static gboolean
+report_stats_cb(gpointer user_data)
+{
+	int64_t now = os_monotonic_get_ns();
+
+	for (gint i = 0; i < num_clients; i++) {
+		struct test_client *client = &clients[i];
+
+		// Refresh the packet loss counters for the next report.
+		if (client->webrtcbin != NULL) {
+			GstPromise *promise =
+			    gst_promise_new_with_change_func((GstPromiseChangeFunc)on_webrtcbin_get_stats, client, NULL);
+			g_signal_emit_by_name(client->webrtcbin, "get-stats", NULL, promise);
+			gst_promise_unref(promise);
+		}
+
+		g_mutex_lock(&client->stats_lock);
+		guint64 bytes = client->bytes_received;
+		guint64 frames = client->frames_received;
+		gint64 packets_lost = client->packets_lost;
+		guint64 packets_received = client->packets_received;
+		guint count = MIN(client->frame_interval_count, MAX_FRAME_INTERVAL_SAMPLES);
+		int64_t intervals[MAX_FRAME_INTERVAL_SAMPLES];
+		memcpy(intervals, client->frame_intervals_ns, count * sizeof(int64_t));
+		g_mutex_unlock(&client->stats_lock);
+
+		double seconds = (now - client->prev_report_time_ns) / 1e9;
+		double mbps = (double)(bytes - client->prev_bytes_received) * 8.0 / 1e6 / seconds;
+		client->prev_bytes_received = bytes;
+		client->prev_report_time_ns = now;
+
+		if (count == 0) {
+			U_LOG_I("client %u: no frames received yet", client->id);
+			continue;
+		}
+
+		qsort(intervals, count, sizeof(int64_t), compare_int64);
+		double p50 = intervals[MIN(count - 1, count * 50 / 100)] / 1e6;
+		double p90 = intervals[MIN(count - 1, count * 90 / 100)] / 1e6;
+		double p99 = intervals[MIN(count - 1, count * 99 / 100)] / 1e6;
+
+		U_LOG_I("client %u: %7.2f Mbit/s, %" PRIu64 " frames, %" G_GINT64_FORMAT "/%" G_GUINT64_FORMAT
+		        " packets lost, frame interval p50 %.2f p90 %.2f p99 %.2f ms",
+		        client->id, mbps, frames, packets_lost, packets_received, p50, p90, p99);
+	}
+
+	return G_SOURCE_CONTINUE;
 }
 
 /*
@@ -142,14 +338,14 @@ gst_bus_cb(GstBus *bus, GstMessage *message, gpointer data)
 	return TRUE;
 }
 
-void
-send_sdp_answer(const gchar *sdp)
+static void
+send_sdp_answer(struct test_client *client, const gchar *sdp)
 {
 	JsonBuilder *builder;
 	JsonNode *root;
 	gchar *msg_str;
 
-	g_print("Send SDP answer: %s\n", sdp);
+	g_print("client %u: send SDP answer: %s\n", client->id, sdp);
 
 	builder = json_builder_new();
 	json_builder_begin_object(builder);
@@ -163,7 +359,7 @@ send_sdp_answer(const gchar *sdp)
 	root = json_builder_get_root(builder);
 
 	msg_str = json_to_string(root, TRUE);
-	soup_websocket_connection_send_text(ws, msg_str);
+	soup_websocket_connection_send_text(client->ws, msg_str);
 	g_clear_pointer(&msg_str, g_free);
 
 	json_node_unref(root);
@@ -171,13 +367,14 @@ send_sdp_answer(const gchar *sdp)
 }
 
 static void
-webrtc_on_ice_candidate_cb(GstElement *webrtcbin, guint mlineindex, gchar *candidate)
+webrtc_on_ice_candidate_cb(GstElement *webrtcbin, guint mlineindex, gchar *candidate, gpointer user_data)
 {
+	struct test_client *client = user_data;
 	JsonBuilder *builder;
 	JsonNode *root;
 	gchar *msg_str;
 
-	g_print("Send candidate: %u %s\n", mlineindex, candidate);
+	g_print("client %u: send candidate: %u %s\n", client->id, mlineindex, candidate);
 
 	builder = json_builder_new();
 	json_builder_begin_object(builder);
@@ -196,7 +393,7 @@ webrtc_on_ice_candidate_cb(GstElement *webrtcbin, guint mlineindex, gchar *candi
 	root = json_builder_get_root(builder);
 
 	msg_str = json_to_string(root, TRUE);
-	soup_websocket_connection_send_text(ws, msg_str);
+	soup_websocket_connection_send_text(client->ws, msg_str);
 	g_clear_pointer(&msg_str, g_free);
 
 	json_node_unref(root);
@@ -263,28 +460,29 @@ on_negotiation_needed(GstElement *element, gpointer user_data)
 static void
 on_answer_created(GstPromise *promise, gpointer user_data)
 {
+	struct test_client *client = user_data;
 	GstWebRTCSessionDescription *answer = NULL;
 	gchar *sdp;
 
 	gst_structure_get(gst_promise_get_reply(promise), "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
 	gst_promise_unref(promise);
 
-	g_signal_emit_by_name(webrtcbin, "set-local-description", answer, NULL);
+	g_signal_emit_by_name(client->webrtcbin, "set-local-description", answer, NULL);
 
 	sdp = gst_sdp_message_as_text(answer->sdp);
-	send_sdp_answer(sdp);
+	send_sdp_answer(client, sdp);
 	g_free(sdp);
 
 	gst_webrtc_session_description_free(answer);
 }
 
 static void
-process_sdp_offer(const gchar *sdp)
+process_sdp_offer(struct test_client *client, const gchar *sdp)
 {
 	GstSDPMessage *sdp_msg = NULL;
 	GstWebRTCSessionDescription *desc = NULL;
 
-	g_print("Received offer: %s\n", sdp);
+	g_print("client %u: received offer: %s\n", client->id, sdp);
 
 	if (gst_sdp_message_new_from_text(sdp, &sdp_msg) != GST_SDP_OK) {
 		g_debug("Error parsing SDP description");
@@ -297,14 +495,14 @@ process_sdp_offer(const gchar *sdp)
 
 		promise = gst_promise_new();
 
-		g_signal_emit_by_name(webrtcbin, "set-remote-description", desc, promise);
+		g_signal_emit_by_name(client->webrtcbin, "set-remote-description", desc, promise);
 
 		gst_promise_wait(promise);
 		gst_promise_unref(promise);
 
 		g_signal_emit_by_name(
-		    webrtcbin, "create-answer", NULL,
-		    gst_promise_new_with_change_func((GstPromiseChangeFunc)on_answer_created, NULL, NULL));
+		    client->webrtcbin, "create-answer", NULL,
+		    gst_promise_new_with_change_func((GstPromiseChangeFunc)on_answer_created, client, NULL));
 	} else {
 		gst_sdp_message_free(sdp_msg);
 	}
@@ -314,16 +512,17 @@ out:
 }
 
 static void
-process_candidate(guint mlineindex, const gchar *candidate)
+process_candidate(struct test_client *client, guint mlineindex, const gchar *candidate)
 {
-	g_print("Received candidate: %d %s\n", mlineindex, candidate);
+	g_print("client %u: received candidate: %d %s\n", client->id, mlineindex, candidate);
 
-	g_signal_emit_by_name(webrtcbin, "add-ice-candidate", mlineindex, candidate);
+	g_signal_emit_by_name(client->webrtcbin, "add-ice-candidate", mlineindex, candidate);
 }
 
 static void
 message_cb(SoupWebsocketConnection *connection, gint type, GBytes *message, gpointer user_data)
 {
+	struct test_client *client = user_data;
 	gsize length = 0;
 	const gchar *msg_data = g_bytes_get_data(message, &length);
 	JsonParser *parser = json_parser_new();
@@ -339,17 +538,17 @@ message_cb(SoupWebsocketConnection *connection, gint type, GBytes *message, gpoi
 		}
 
 		msg_type = json_object_get_string_member(msg, "msg");
-		g_print("Websocket message received: %s\n", msg_type);
+		g_print("client %u: websocket message received: %s\n", client->id, msg_type);
 
 		if (g_str_equal(msg_type, "offer")) {
 			const gchar *offer_sdp = json_object_get_string_member(msg, "sdp");
-			process_sdp_offer(offer_sdp);
+			process_sdp_offer(client, offer_sdp);
 		} else if (g_str_equal(msg_type, "candidate")) {
 			JsonObject *candidate;
 
 			candidate = json_object_get_object_member(msg, "candidate");
 
-			process_candidate(json_object_get_int_member(candidate, "sdpMLineIndex"),
+			process_candidate(client, json_object_get_int_member(candidate, "sdpMLineIndex"),
 			                  json_object_get_string_member(candidate, "candidate"));
 		}
 	} else {
@@ -364,21 +563,22 @@ out:
 static GstPadProbeReturn
 buffer_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 {
+	struct test_client *client = user_data;
+
 	if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
 		GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
-		GstClockTime pts = GST_BUFFER_PTS(buf);
-
-		static GstClockTime previous_pts = 0;
-		static int64_t previous_time = 0;
 		int64_t now = os_monotonic_get_ns();
-		if (previous_pts != 0) {
-			int64_t pts_diff = (pts - previous_pts) / 1e6;
-			int64_t time_diff = (now - previous_time) / 1e6;
-			g_print("Received frame PTS: %" GST_TIME_FORMAT ", PTS diff: %ld, Time diff: %ld\n",
-			        GST_TIME_ARGS(pts), pts_diff, time_diff);
+
+		g_mutex_lock(&client->stats_lock);
+		client->bytes_received += gst_buffer_get_size(buf);
+		client->frames_received++;
+		if (client->last_frame_time_ns != 0) {
+			client->frame_intervals_ns[client->frame_interval_count % MAX_FRAME_INTERVAL_SAMPLES] =
+			    now - client->last_frame_time_ns;
+			client->frame_interval_count++;
 		}
-		previous_pts = pts;
-		previous_time = now;
+		client->last_frame_time_ns = now;
+		g_mutex_unlock(&client->stats_lock);
 	}
 	return GST_PAD_PROBE_OK;
 }
@@ -386,53 +586,70 @@ buffer_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
 static void
 websocket_connected_cb(GObject *session, GAsyncResult *res, gpointer user_data)
 {
+	struct test_client *client = user_data;
 	GError *error = NULL;
 
-	g_assert(!ws);
+	g_assert(!client->ws);
 
-	ws = soup_session_websocket_connect_finish(SOUP_SESSION(session), res, &error);
+	client->ws = soup_session_websocket_connect_finish(SOUP_SESSION(session), res, &error);
 	if (error) {
-		g_print("Error creating websocket: %s\n", error->message);
+		g_print("client %u: error creating websocket: %s\n", client->id, error->message);
 		g_clear_error(&error);
 	} else {
 		GstBus *bus;
 
-		g_print("Websocket connected\n");
-		g_signal_connect(ws, "message", G_CALLBACK(message_cb), NULL);
+		g_print("client %u: websocket connected\n", client->id);
+		g_signal_connect(client->ws, "message", G_CALLBACK(message_cb), client);
 
-		pipeline = gst_parse_launch(
-		    "webrtcbin name=webrtc bundle-policy=max-bundle latency=5 ! "
+		gchar *pipeline_string;
+		if (use_fakesink) {
+			pipeline_string = g_strdup(
+			    "webrtcbin name=webrtc bundle-policy=max-bundle latency=5 ! "
+			    "rtph264depay name=depay ! "
+			    "fakesink sync=false");
+		} else {
+			pipeline_string = g_strdup(
+			    "webrtcbin name=webrtc bundle-policy=max-bundle latency=5 ! "
+			    "rtph264depay name=depay ! "
 #ifdef USE_DECODEBIN
-		    "decodebin3 ! "
-		    "videoconvert ! "
+			    "decodebin3 ! "
+			    "videoconvert ! "
 #else
-		    "avdec_h264 ! " // sudo apt install gstreamer1.0-libav
+			    "avdec_h264 ! " // sudo apt install gstreamer1.0-libav
 #endif
-		    "autovideosink",
-		    &error);
-		g_assert_no_error(error);
+			    "autovideosink");
+		}
 
-		// GstPad *pad = gst_element_get_static_pad(gst_bin_get_by_name(GST_BIN(pipeline), "depay"), "src");
-		// gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)buffer_probe_cb, NULL, NULL);
-		// gst_object_unref(pad);
+		client->pipeline = gst_parse_launch(pipeline_string, &error);
+		g_free(pipeline_string);
+		g_assert_no_error(error);
 
-		// Connect callbacks on sinks.
-		webrtcbin = gst_bin_get_by_name(GST_BIN(pipeline), "webrtc");
+		// Account frames as they leave the depayloader, so --fakesink numbers
+		// match the decode path.
+		{
+			GstElement *depay = gst_bin_get_by_name(GST_BIN(client->pipeline), "depay");
+			GstPad *pad = gst_element_get_static_pad(depay, "src");
+			gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)buffer_probe_cb,
+			                  client, NULL);
+			gst_object_unref(pad);
+			gst_object_unref(depay);
+		}
 
-		g_signal_connect(webrtcbin, "on-data-channel", G_CALLBACK(webrtc_on_data_channel_cb), NULL);
-		g_signal_connect(webrtcbin, "on-ice-candidate", G_CALLBACK(webrtc_on_ice_candidate_cb), NULL);
-		g_signal_connect(webrtcbin, "on-new-transceiver", G_CALLBACK(on_new_transceiver), NULL);
-		g_signal_connect(webrtcbin, "pad-added", G_CALLBACK(on_pad_added), NULL);
-		g_signal_connect(webrtcbin, "on-negotiation-needed", G_CALLBACK(on_negotiation_needed), NULL);
-		g_signal_connect(webrtcbin, "prepare-data-channel", G_CALLBACK(on_prepare_data_channel), NULL);
+		// Connect callbacks on sinks. Keep a webrtcbin ref around for the stats timer.
+		client->webrtcbin = gst_bin_get_by_name(GST_BIN(client->pipeline), "webrtc");
 
-		gst_object_unref(webrtcbin);
+		g_signal_connect(client->webrtcbin, "on-data-channel", G_CALLBACK(webrtc_on_data_channel_cb), client);
+		g_signal_connect(client->webrtcbin, "on-ice-candidate", G_CALLBACK(webrtc_on_ice_candidate_cb), client);
+		g_signal_connect(client->webrtcbin, "on-new-transceiver", G_CALLBACK(on_new_transceiver), NULL);
+		g_signal_connect(client->webrtcbin, "pad-added", G_CALLBACK(on_pad_added), NULL);
+		g_signal_connect(client->webrtcbin, "on-negotiation-needed", G_CALLBACK(on_negotiation_needed), NULL);
+		g_signal_connect(client->webrtcbin, "prepare-data-channel", G_CALLBACK(on_prepare_data_channel), NULL);
 
-		bus = gst_element_get_bus(pipeline);
-		gst_bus_add_watch(bus, gst_bus_cb, pipeline);
+		bus = gst_element_get_bus(client->pipeline);
+		gst_bus_add_watch(bus, gst_bus_cb, client->pipeline);
 		gst_clear_object(&bus);
 
-		g_assert(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+		g_assert(gst_element_set_state(client->pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
 	}
 }
 
@@ -454,28 +671,44 @@ main(int argc, char *argv[])
 	if (!websocket_uri) {
 		websocket_uri = g_strdup(WEBSOCKET_URI_DEFAULT);
 	}
+	if (num_clients < 1) {
+		num_clients = 1;
+	}
 
 	SoupSession *soup_session = soup_session_new();
 
+	int64_t now = os_monotonic_get_ns();
+	clients = g_new0(struct test_client, num_clients);
+	for (gint i = 0; i < num_clients; i++) {
+		struct test_client *client = &clients[i];
+		client->id = i;
+		client->prev_report_time_ns = now;
+		g_mutex_init(&client->stats_lock);
+
 #if !SOUP_CHECK_VERSION(3, 0, 0)
-	soup_session_websocket_connect_async(soup_session,                                     // session
-	                                     soup_message_new(SOUP_METHOD_GET, websocket_uri), // message
-	                                     NULL,                                             // origin
-	                                     NULL,                                             // protocols
-	                                     NULL,                                             // cancellable
-	                                     websocket_connected_cb,                           // callback
-	                                     NULL);                                            // user_data
+		soup_session_websocket_connect_async(soup_session,                                     // session
+		                                     soup_message_new(SOUP_METHOD_GET, websocket_uri), // message
+		                                     NULL,                                             // origin
+		                                     NULL,                                             // protocols
+		                                     NULL,                                             // cancellable
+		                                     websocket_connected_cb,                           // callback
+		                                     client);                                          // user_data
 #else
-	soup_session_websocket_connect_async(soup_session,                                     // session
-	                                     soup_message_new(SOUP_METHOD_GET, websocket_uri), // message
-	                                     NULL,                                             // origin
-	                                     NULL,                                             // protocols
-	                                     0,                                                // io_priority
-	                                     NULL,                                             // cancellable
-	                                     websocket_connected_cb,                           // callback
-	                                     NULL);                                            // user_data
+		soup_session_websocket_connect_async(soup_session,                                     // session
+		                                     soup_message_new(SOUP_METHOD_GET, websocket_uri), // message
+		                                     NULL,                                             // origin
+		                                     NULL,                                             // protocols
+		                                     0,                                                // io_priority
+		                                     NULL,                                             // cancellable
+		                                     websocket_connected_cb,                           // callback
+		                                     client);                                          // user_data
 
 #endif
+	}
+
+	if (report_interval > 0) {
+		g_timeout_add_seconds(report_interval, report_stats_cb, NULL);
+	}
 
 	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
 	g_unix_signal_add(SIGINT, sigint_handler, loop);